@@ -434,7 +434,7 @@ void Application::ToggleChatState() {
                 }
                 SetDeviceState(kDeviceStateConnecting);
 
-                if (!protocol_->OpenAudioChannel()) {
+                if (!OpenAudioChannel()) {
                     return;
                 }
             }
@@ -471,7 +471,7 @@ void Application::StartListening() {
         Schedule([this]() {
             if (!protocol_->IsAudioChannelOpened()) {
                 SetDeviceState(kDeviceStateConnecting);
-                if (!protocol_->OpenAudioChannel()) {
+                if (!OpenAudioChannel()) {
                     return;
                 }
             }
@@ -606,6 +606,15 @@ void Application::Start() {
     callbacks.on_vad_change = [this](bool speaking) {
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
+    callbacks.on_endpoint = [this]() {
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateListening && listening_mode_ == kListeningModeAutoStop) {
+                ESP_LOGI(TAG, "End of speech detected on the device, stop listening");
+                protocol_->SendStopListening();
+                SetDeviceState(kDeviceStateIdle);
+            }
+        });
+    };
     audio_service_.SetCallbacks(callbacks);
 
     // Start the main event loop task with priority 5
@@ -677,8 +686,9 @@ void Application::Start() {
         ESP_LOGE(TAG, "Network error: %s", message.c_str());
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
-    protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
+    protocol_->OnIncomingAudio([this](AudioStreamPacketPtr packet) {
         if (device_state_ == kDeviceStateSpeaking) {
+            packet->time_us = esp_timer_get_time();
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
     });
@@ -692,6 +702,9 @@ void Application::Start() {
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
         Schedule([this]() {
+#if CONFIG_OPUS_FRAME_DURATION_ADAPTIVE
+            audio_service_.AdaptFrameDuration(protocol_->rtt_ms());
+#endif
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
@@ -1038,9 +1051,8 @@ void Application:: music_http_get_task()
                             if (!excluded_songs.empty()) {
                                 music->SetExcludedSongs(excluded_songs);
                             }
-                            // 拿到屏蔽名单以后，统一去扫描构建播放列表以过滤掉这些歌
+                            // 拿到屏蔽名单以后，统一去扫描构建播放列表以过滤掉这些歌；扫描在后台进行，完成后自行重建统一媒体库
                             music->ScanAndLoadMusic(device_function_ == Function_Light); // 灯光模式下只加载故事
-                            music->RebuildUnifiedMediaLibrary();
                         }
                     }
                     cJSON_Delete(root);
@@ -1050,7 +1062,6 @@ void Application:: music_http_get_task()
                 auto music = Board::GetInstance().GetMusic();
                 if (music) {
                     music->ScanAndLoadMusic(device_function_ == Function_Light);
-                    music->RebuildUnifiedMediaLibrary();
                 }
             }
             free(buffer);
@@ -1059,7 +1070,6 @@ void Application:: music_http_get_task()
             auto music = Board::GetInstance().GetMusic();
             if (music) {
                 music->ScanAndLoadMusic(device_function_ == Function_Light);
-                music->RebuildUnifiedMediaLibrary();
             }
         }
         esp_http_client_close(client);
@@ -1837,6 +1847,7 @@ void Application::MainEventLoop() {
 
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 SystemInfo::PrintHeapStats();
+                audio_service_.PrintStatistics();
             }   
             if(Offline_ticks_>=3)         
             {
@@ -1926,7 +1937,7 @@ void Application::OnWakeWordDetected() {
 
         if (!protocol_->IsAudioChannelOpened()) {
             SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
+            if (!OpenAudioChannel()) {
                 audio_service_.EnableWakeWordDetection(true);
                 return;
             }
@@ -1965,6 +1976,12 @@ void Application::AbortSpeaking(AbortReason reason) {
     }
 }
 
+bool Application::OpenAudioChannel() {
+    // The hello message announces the uplink frame duration for the whole session
+    protocol_->SetFrameDuration(audio_service_.frame_duration_ms());
+    return protocol_->OpenAudioChannel();
+}
+
 void Application::SetListeningMode(ListeningMode mode) {
     listening_mode_ = mode;
     SetDeviceState(kDeviceStateListening);
@@ -2014,15 +2031,17 @@ void Application::SetDeviceState(DeviceState state) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
                 audio_service_.EnableVoiceProcessing(true);
-                audio_service_.EnableWakeWordDetection(false);
             }
+            // Barge-in detection from the speaking state is no longer needed
+            audio_service_.EnableWakeWordDetection(false);
             break;
         case kDeviceStateSpeaking:
             display->SetStatus(Lang::Strings::SPEAKING);
 
             if (listening_mode_ != kListeningModeRealtime) {
                 audio_service_.EnableVoiceProcessing(false);
-                // Only AFE wake word can be detected in speaking mode
+                // Barge-in: only the AFE wake word cancels the echo of the reply, the others would trigger
+                // on the reply itself. Realtime mode keeps listening while speaking and needs no wake word.
                 audio_service_.EnableWakeWordDetection(audio_service_.IsAfeWakeWord());
             }
             audio_service_.ResetDecoder();
@@ -2236,103 +2255,41 @@ void Application::AddAudioData(AudioStreamPacket&& packet) {
         codec->EnableOutput(true);
     }
     
-    if (device_state_ == kDeviceStateIdle) {
-    //     // packet.payload包含的是原始PCM数据（int16_t）
-        if (packet.payload.size() >= 2) {
-            size_t num_samples = packet.payload.size() / sizeof(int16_t);
-            std::vector<int16_t> pcm_data(num_samples);
-            memcpy(pcm_data.data(), packet.payload.data(), packet.payload.size());
-            
-            // 检查采样率是否匹配，如果不匹配则进行简单重采样
-            if (packet.sample_rate != codec->output_sample_rate()) {
-                // ESP_LOGI(TAG, "Resampling music audio from %d to %d Hz", 
-                //         packet.sample_rate, codec->output_sample_rate());
-                
-                // 验证采样率参数
-                if (packet.sample_rate <= 0 || codec->output_sample_rate() <= 0) {
-                    ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", 
-                            packet.sample_rate, codec->output_sample_rate());
-                    return;
-                }
-                
-                std::vector<int16_t> resampled;
-                
-                if (packet.sample_rate > codec->output_sample_rate()) {
-                    ESP_LOGI(TAG, "Music Player: Adjust the sampling rate from %d Hz to %d Hz", 
-                        codec->output_sample_rate(), packet.sample_rate);
+    // packet.payload包含的是原始PCM数据（int16_t，单声道）
+    // 说话时音乐不停止，由混音器压低音量
+    if ((device_state_ != kDeviceStateIdle && device_state_ != kDeviceStateSpeaking) || packet.payload.size() < 2) {
+        return;
+    }
+    int output_sample_rate = codec->output_sample_rate();
+    if (packet.sample_rate <= 0 || output_sample_rate <= 0) {
+        ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", packet.sample_rate, output_sample_rate);
+        return;
+    }
 
-                    // 尝试动态切换采样率
-                    if (codec->SetOutputSampleRate(packet.sample_rate)) {
-                        ESP_LOGI(TAG, "Successfully switched to music playback sampling rate: %d Hz", packet.sample_rate);
-                    } else {
-                        ESP_LOGW(TAG, "Unable to switch sampling rate, continue using current sampling rate: %d Hz", codec->output_sample_rate());
-                    }
-                } else {
-                    if (packet.sample_rate > codec->output_sample_rate()) {
-                        // 下采样：简单丢弃部分样本
-                        float downsample_ratio = static_cast<float>(packet.sample_rate) / codec->output_sample_rate();
-                        size_t expected_size = static_cast<size_t>(pcm_data.size() / downsample_ratio + 0.5f);
-                        std::vector<int16_t> resampled(expected_size);
-                        size_t resampled_index = 0;
-                        
-                        for (size_t i = 0; i < pcm_data.size(); ++i) {
-                            if (i % static_cast<size_t>(downsample_ratio) == 0) {
-                                resampled[resampled_index++] = pcm_data[i];
-                            }
-                        }
-                        
-                        pcm_data = std::move(resampled);
-                        ESP_LOGI(TAG, "Downsampled %d -> %d samples (ratio: %.2f)", 
-                                pcm_data.size(), resampled.size(), downsample_ratio);
-                    } else if (packet.sample_rate < codec->output_sample_rate()) {
-                        // 上采样：线性插值
-                        float upsample_ratio = codec->output_sample_rate() / static_cast<float>(packet.sample_rate);
-                        size_t expected_size = static_cast<size_t>(pcm_data.size() * upsample_ratio + 0.5f);
-                        resampled.reserve(expected_size);
-                    
-                        for (size_t i = 0; i < pcm_data.size(); ++i) {
-                            // 添加原始样本
-                            resampled.push_back(pcm_data[i]);
-                        
-                        
-                            // 计算需要插值的样本数
-                            int interpolation_count = static_cast<int>(upsample_ratio) - 1;
-                            if (interpolation_count > 0 && i + 1 < pcm_data.size()) {
-                                int16_t current = pcm_data[i];
-                                int16_t next = pcm_data[i + 1];
-                                for (int j = 1; j <= interpolation_count; ++j) {
-                                    float t = static_cast<float>(j) / (interpolation_count + 1);
-                                    int16_t interpolated = static_cast<int16_t>(current + (next - current) * t);
-                                    resampled.push_back(interpolated);
-                                }
-                            } else if (interpolation_count > 0) {
-                                // 最后一个样本，直接重复
-                                for (int j = 1; j <= interpolation_count; ++j) {
-                                    resampled.push_back(pcm_data[i]);
-                                }
-                            }
-                        }
+    // 切歌、停止或跳转后丢弃上一段音频残留的滤波历史，避免新曲目开头带出旧曲目的尾音
+    if (music_resampler_reset_.exchange(false)) {
+        music_resampler_.Reset();
+    }
 
-                        ESP_LOGI(TAG, "Upsampled %d -> %d samples (ratio: %.2f)", 
-                            pcm_data.size(), resampled.size(), upsample_ratio);
-                            pcm_data = std::move(resampled);
-                    }
-                }
-                
-                
-            }
-            
-            // 确保音频输出已启用
-            if (!codec->output_enabled()) {
-                codec->EnableOutput(true);
+    size_t num_samples = packet.payload.size() / sizeof(int16_t);
+    const int16_t* pcm = reinterpret_cast<const int16_t*>(packet.payload.data());
+    if (packet.sample_rate == output_sample_rate) {
+        music_pcm_.assign(pcm, pcm + num_samples);
+    } else {
+        // 统一重采样到设备固定的输出采样率，切歌时不再重新配置 I2S 时钟
+        if (music_resampler_.input_sample_rate() != packet.sample_rate ||
+            music_resampler_.output_sample_rate() != output_sample_rate) {
+            ESP_LOGI(TAG, "Music Player: resampling %d Hz to %d Hz", packet.sample_rate, output_sample_rate);
+            if (!music_resampler_.Configure(packet.sample_rate, output_sample_rate)) {
+                return;
             }
-            
-            // 发送PCM数据到音频编解码器
-            codec->OutputData(pcm_data);
-            
-            audio_service_.UpdateOutputTimestamp();
         }
+        music_pcm_.resize(music_resampler_.GetOutputSamples(num_samples));
+        music_pcm_.resize(music_resampler_.Process(pcm, num_samples, music_pcm_.data()));
     }
+
+    // 送入混音器的音乐通道，通道满时阻塞，由扬声器控制播放节奏
+    audio_service_.PushMusicData(music_pcm_.data(), music_pcm_.size());
 }
 
 static void PlayDurationTimerCallback(void* arg) {
@@ -10,10 +10,12 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <atomic>
 
 #include "protocol.h"
 #include "ota.h"
 #include "audio_service.h"
+#include "polyphase_resampler.h"
 #include "device_state_event.h"
 
 #define LEDMODE_GPIO         GPIO_NUM_4
@@ -82,6 +84,7 @@ public:
     void RFID_TASK();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
+    bool IsSpeakingAborted() const { return aborted_; }
     void Schedule(std::function<void()> callback);
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
@@ -101,6 +104,8 @@ public:
     AudioService& GetAudioService() { return audio_service_; }
 
     void AddAudioData(AudioStreamPacket&& packet);
+    // Drops the resampler history at a track start, stop or seek, applied by the next AddAudioData()
+    void ResetMusicResampler() { music_resampler_reset_ = true; }
     void SendMessage(std::string &message);
 
     void EnableBleWifiConfig(bool enable) { ble_wifi_config_enabled_ = enable; }
@@ -161,6 +166,10 @@ private:
     AecMode aec_mode_ = kAecOff;
     std::string last_error_message_;
     AudioService audio_service_;
+    // Local music is resampled to the codec output rate, only touched by AddAudioData()
+    PolyphaseResampler music_resampler_;
+    std::vector<int16_t> music_pcm_;
+    std::atomic<bool> music_resampler_reset_{false};
 
     bool has_server_time_ = false;
     bool aborted_ = false;
@@ -182,6 +191,7 @@ private:
     void CheckNewVersion(Ota& ota);
     void CheckAssetsVersion();
     // void ShowActivationCode(const std::string& code, const std::string& message);
+    bool OpenAudioChannel();
     void SetListeningMode(ListeningMode mode);
     void ShowBatteryLevel(int percent);
 
@@ -0,0 +1,167 @@
+#include "aec_aligner.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <algorithm>
+
+#define TAG "AecAligner"
+
+// A timestamp further than this from the line is a new stream (next response, seek, server restart)
+#define AEC_ALIGNER_JUMP_MS 120
+// Clocks of real devices are much closer than this, a steeper fit comes from jitter
+#define AEC_ALIGNER_MAX_DRIFT 0.02
+// Anchors of the line a reference is read from, about four seconds with 32 of them
+#define AEC_ALIGNER_ANCHOR_SPACING_US 120000
+// Drift reports lose half their weight in about a minute, so the estimate follows temperature changes
+#define AEC_ALIGNER_DRIFT_MEMORY_US 90000000
+// Spread of the report times (s^2) before the drift is trusted, what 10 s of 60 ms frames give.
+// With 3 ms of playback jitter the slope is then known to about 80 ppm, and gets better from there
+#define AEC_ALIGNER_DRIFT_MIN_SPREAD 1400.0
+// Echo keeps arriving for a while after the last frame has played
+#define AEC_ALIGNER_TAIL_US 200000
+
+void AecAligner::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    EndDriftStream();
+    anchor_head_ = 0;
+    anchor_count_ = 0;
+    playing_until_us_ = 0;
+    slope_ = 1.0;
+    offset_ms_ = 0.0;
+}
+
+double AecAligner::Predict(int64_t time_us) const {
+    return offset_ms_ + slope_ * (time_us - base_us_) / 1000.0;
+}
+
+// Least squares over the anchors of the current stream, relative to the oldest one
+void AecAligner::Fit() {
+    const Anchor& oldest = anchors_[anchor_head_];
+    base_us_ = oldest.play_us;
+    base_timestamp_ = oldest.timestamp;
+
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    for (size_t i = 0; i < anchor_count_; i++) {
+        const Anchor& anchor = anchors_[(anchor_head_ + i) % AEC_ALIGNER_MAX_ANCHORS];
+        double x = (anchor.play_us - base_us_) / 1000.0;
+        double y = (int32_t)(anchor.timestamp - base_timestamp_);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+    }
+
+    double n = anchor_count_;
+    double denominator = n * sum_xx - sum_x * sum_x;
+    /* One anchor, or all at the same time: assume both clocks run at the same rate */
+    double slope = 1.0;
+    if (drift_known_) {
+        slope = drift_slope_;
+    } else if (anchor_count_ >= 2 && denominator > 1e-6) {
+        slope = (n * sum_xy - sum_x * sum_y) / denominator;
+    }
+    slope_ = std::clamp(slope, 1.0 - AEC_ALIGNER_MAX_DRIFT, 1.0 + AEC_ALIGNER_MAX_DRIFT);
+    offset_ms_ = (sum_y - slope_ * sum_x) / n;
+}
+
+// Folds the current stream into the drift estimate, the next report starts a new one
+void AecAligner::EndDriftStream() {
+    if (drift_w_ > 0) {
+        drift_sxx_ += drift_xx_ - drift_x_ * drift_x_ / drift_w_;
+        drift_sxy_ += drift_xy_ - drift_x_ * drift_y_ / drift_w_;
+    }
+    drift_w_ = drift_x_ = drift_y_ = drift_xx_ = drift_xy_ = 0;
+}
+
+/*
+ * Every report counts, not only the anchors: the drift comes from many seconds of playback and
+ * their number averages the jitter out. Streams have unrelated offsets, so each one contributes
+ * its own centered sums and the slope is their pooled least squares fit.
+ */
+void AecAligner::AddDriftReport(uint32_t timestamp, int64_t play_us) {
+    if (drift_last_us_ != 0 && play_us > drift_last_us_) {
+        double decay = std::exp(-(double)(play_us - drift_last_us_) / AEC_ALIGNER_DRIFT_MEMORY_US);
+        drift_w_ *= decay;
+        drift_x_ *= decay;
+        drift_y_ *= decay;
+        drift_xx_ *= decay;
+        drift_xy_ *= decay;
+        drift_sxx_ *= decay;
+        drift_sxy_ *= decay;
+    }
+    drift_last_us_ = std::max(drift_last_us_, play_us);
+    if (drift_w_ == 0) {
+        drift_base_us_ = play_us;
+        drift_base_timestamp_ = timestamp;
+    }
+
+    double x = (play_us - drift_base_us_) / 1000000.0;
+    double y = (int32_t)(timestamp - drift_base_timestamp_) / 1000.0;
+    drift_w_ += 1;
+    drift_x_ += x;
+    drift_y_ += y;
+    drift_xx_ += x * x;
+    drift_xy_ += x * y;
+
+    double sxx = drift_sxx_ + drift_xx_ - drift_x_ * drift_x_ / drift_w_;
+    double sxy = drift_sxy_ + drift_xy_ - drift_x_ * drift_y_ / drift_w_;
+    if (sxx >= AEC_ALIGNER_DRIFT_MIN_SPREAD) {
+        drift_slope_ = std::clamp(sxy / sxx, 1.0 - AEC_ALIGNER_MAX_DRIFT, 1.0 + AEC_ALIGNER_MAX_DRIFT);
+        drift_known_ = true;
+    }
+}
+
+void AecAligner::OnPlayback(uint32_t timestamp, int64_t play_us, int64_t duration_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (anchor_count_ > 0) {
+        double expected = Predict(play_us);
+        double actual = (int32_t)(timestamp - base_timestamp_);
+        if (std::fabs(actual - expected) > AEC_ALIGNER_JUMP_MS) {
+            ESP_LOGD(TAG, "Timestamp %lu is %.0f ms off the stream, starting over", (unsigned long)timestamp, actual - expected);
+            anchor_count_ = 0;
+            EndDriftStream();
+        }
+    }
+    if (anchor_count_ == 0) {
+        anchor_head_ = 0;
+        stream_start_us_ = play_us;
+    }
+    AddDriftReport(timestamp, play_us);
+
+    playing_until_us_ = std::max(playing_until_us_, play_us + duration_us);
+    if (anchor_count_ > 0) {
+        const Anchor& newest = anchors_[(anchor_head_ + anchor_count_ - 1) % AEC_ALIGNER_MAX_ANCHORS];
+        if (play_us - newest.play_us < AEC_ALIGNER_ANCHOR_SPACING_US) {
+            return;
+        }
+    }
+
+    /* Keep the newest anchors, so the fit follows a drift that changes with temperature */
+    if (anchor_count_ == AEC_ALIGNER_MAX_ANCHORS) {
+        anchor_head_ = (anchor_head_ + 1) % AEC_ALIGNER_MAX_ANCHORS;
+        anchor_count_--;
+    }
+    anchors_[(anchor_head_ + anchor_count_) % AEC_ALIGNER_MAX_ANCHORS] = { play_us, timestamp };
+    anchor_count_++;
+    Fit();
+}
+
+uint32_t AecAligner::GetReference(int64_t capture_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (anchor_count_ == 0 || capture_us < stream_start_us_ || capture_us > playing_until_us_ + AEC_ALIGNER_TAIL_US) {
+        return 0;
+    }
+    uint32_t reference = base_timestamp_ + (int32_t)std::lround(Predict(capture_us));
+    // 0 means no reference to the server
+    return reference != 0 ? reference : 1;
+}
+
+bool AecAligner::drift_known() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return drift_known_;
+}
+
+int AecAligner::drift_ppm() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return drift_known_ ? (int)std::lround((drift_slope_ - 1.0) * 1000000) : 0;
+}
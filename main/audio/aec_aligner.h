@@ -0,0 +1,74 @@
+#ifndef AEC_ALIGNER_H
+#define AEC_ALIGNER_H
+
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#define AEC_ALIGNER_MAX_ANCHORS 32
+
+/*
+ * Maps the capture time of an uplink frame to the timestamp of the downlink audio that was
+ * playing at that moment, for server-side AEC.
+ *
+ * The output task reports when each stamped downlink frame reaches the speaker, some of them
+ * are kept as anchors. The anchors of the last few seconds of one continuous stream are fitted
+ * with a line, timestamp = a + b * time. The reference of a capture time is read from that line,
+ * so uplink and downlink frames may have any cadence. A timestamp that does not fit the line
+ * starts a new stream. Capture times outside the played audio (plus an echo tail) have no reference.
+ *
+ * A few seconds of anchors are too short to tell a drift of some hundred ppm from playback
+ * jitter, so the slope b comes from a separate drift estimate once that is known: a least squares
+ * slope over every report of every stream (each stream with its own offset), where older reports
+ * are slowly forgotten. Reset() ends a stream but keeps the drift, which belongs to the clocks.
+ *
+ * OnPlayback() and GetReference() may be called from different tasks.
+ */
+class AecAligner {
+public:
+    AecAligner() = default;
+
+    void Reset();
+    // A downlink frame stamped timestamp (ms) starts playing at play_us and lasts duration_us
+    void OnPlayback(uint32_t timestamp, int64_t play_us, int64_t duration_us);
+    // Timestamp (ms) of the downlink audio played at capture_us, 0 if nothing was playing
+    uint32_t GetReference(int64_t capture_us);
+    // Whether enough playback was seen to estimate the drift
+    bool drift_known();
+    // Server clock drift against ours, in parts per million, 0 until known
+    int drift_ppm();
+
+private:
+    struct Anchor {
+        int64_t play_us;
+        uint32_t timestamp;
+    };
+
+    std::mutex mutex_;
+    Anchor anchors_[AEC_ALIGNER_MAX_ANCHORS];
+    size_t anchor_head_ = 0;
+    size_t anchor_count_ = 0;
+    int64_t stream_start_us_ = 0;
+    int64_t playing_until_us_ = 0;
+    // timestamp = base_timestamp_ + offset_ms_ + slope_ * (time - base_us_) / 1000
+    int64_t base_us_ = 0;
+    uint32_t base_timestamp_ = 0;
+    double offset_ms_ = 0.0;
+    double slope_ = 1.0;
+    // Drift estimate: weighted sums (seconds) of the current stream relative to its first report,
+    // and the centered sums of the finished streams
+    int64_t drift_base_us_ = 0;
+    uint32_t drift_base_timestamp_ = 0;
+    int64_t drift_last_us_ = 0;
+    double drift_w_ = 0, drift_x_ = 0, drift_y_ = 0, drift_xx_ = 0, drift_xy_ = 0;
+    double drift_sxx_ = 0, drift_sxy_ = 0;
+    double drift_slope_ = 1.0;
+    bool drift_known_ = false;
+
+    void Fit();
+    double Predict(int64_t time_us) const;
+    void AddDriftReport(uint32_t timestamp, int64_t play_us);
+    void EndDriftStream();
+};
+
+#endif // AEC_ALIGNER_H
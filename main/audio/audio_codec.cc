@@ -18,6 +18,18 @@ void AudioCodec::OutputData(std::vector<int16_t>& data) {
     Write(data.data(), data.size());
 }
 
+int16_t* AudioCodec::AcquireOutputBuffer(size_t samples) {
+    if (output_buffer_.size() < samples) {
+        size_t dma_samples = AUDIO_CODEC_DMA_FRAME_NUM * output_channels_;
+        output_buffer_.resize((samples + dma_samples - 1) / dma_samples * dma_samples);
+    }
+    return output_buffer_.data();
+}
+
+void AudioCodec::CommitOutputBuffer(size_t samples) {
+    Write(output_buffer_.data(), samples);
+}
+
 bool AudioCodec::InputData(std::vector<int16_t>& data) {
     int samples = Read(data.data(), data.size());
     if (samples > 0) {
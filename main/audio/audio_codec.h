@@ -26,6 +26,11 @@ public:
     virtual bool SetOutputSampleRate(int sample_rate);
     
     virtual void OutputData(std::vector<int16_t>& data);
+    // Playback sink: the last stage of the output path writes its samples straight into the
+    // returned buffer, then CommitOutputBuffer() plays them. The buffer is a staging buffer owned
+    // by the codec, not the DMA memory; it grows in whole DMA frames and stays valid until the next call.
+    virtual int16_t* AcquireOutputBuffer(size_t samples);
+    virtual void CommitOutputBuffer(size_t samples);
     virtual bool InputData(std::vector<int16_t>& data);
     virtual void Start();
 
@@ -56,6 +61,7 @@ protected:
     int output_channels_ = 1;
     int output_volume_ = 70;
     float input_gain_ = 0.0;
+    std::vector<int16_t> output_buffer_;
 
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
@@ -0,0 +1,141 @@
+#ifndef AUDIO_KERNELS_H
+#define AUDIO_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/*
+ * Sample shuffling and format conversion kernels for the audio paths.
+ *
+ * The shuffling kernels move two 16-bit samples per 32-bit load / store and handle four
+ * frames per iteration, which roughly halves the memory operations of the plain per-sample
+ * loops on every target (Xtensa and RISC-V alike). memcpy() keeps the word accesses free of
+ * alignment and aliasing issues and compiles down to single loads / stores.
+ * All targets are little-endian: the first sample of a pair is the low half-word.
+ *
+ * The conversion kernels come with a plain scalar reference; both must give bit-exact results.
+ */
+
+static inline uint32_t LoadSamplePair(const int16_t* p) {
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline void StoreSamplePair(int16_t* p, uint32_t word) {
+    memcpy(p, &word, sizeof(word));
+}
+
+// Split interleaved stereo into two mono buffers
+static inline void DeinterleaveStereo(const int16_t* input, int16_t* left, int16_t* right, size_t frames) {
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        uint32_t f0 = LoadSamplePair(input + 2 * i);
+        uint32_t f1 = LoadSamplePair(input + 2 * i + 2);
+        uint32_t f2 = LoadSamplePair(input + 2 * i + 4);
+        uint32_t f3 = LoadSamplePair(input + 2 * i + 6);
+        StoreSamplePair(left + i, (f0 & 0xFFFF) | (f1 << 16));
+        StoreSamplePair(left + i + 2, (f2 & 0xFFFF) | (f3 << 16));
+        StoreSamplePair(right + i, (f0 >> 16) | (f1 & 0xFFFF0000));
+        StoreSamplePair(right + i + 2, (f2 >> 16) | (f3 & 0xFFFF0000));
+    }
+    for (; i < frames; i++) {
+        left[i] = input[2 * i];
+        right[i] = input[2 * i + 1];
+    }
+}
+
+// Merge two mono buffers into interleaved stereo
+static inline void InterleaveStereo(const int16_t* left, const int16_t* right, int16_t* output, size_t frames) {
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        uint32_t l01 = LoadSamplePair(left + i);
+        uint32_t l23 = LoadSamplePair(left + i + 2);
+        uint32_t r01 = LoadSamplePair(right + i);
+        uint32_t r23 = LoadSamplePair(right + i + 2);
+        StoreSamplePair(output + 2 * i, (l01 & 0xFFFF) | (r01 << 16));
+        StoreSamplePair(output + 2 * i + 2, (l01 >> 16) | (r01 & 0xFFFF0000));
+        StoreSamplePair(output + 2 * i + 4, (l23 & 0xFFFF) | (r23 << 16));
+        StoreSamplePair(output + 2 * i + 6, (l23 >> 16) | (r23 & 0xFFFF0000));
+    }
+    for (; i < frames; i++) {
+        output[2 * i] = left[i];
+        output[2 * i + 1] = right[i];
+    }
+}
+
+// Keep the left channel of interleaved stereo, output may alias input
+static inline void ExtractLeftChannel(const int16_t* input, int16_t* output, size_t frames) {
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        uint32_t f0 = LoadSamplePair(input + 2 * i);
+        uint32_t f1 = LoadSamplePair(input + 2 * i + 2);
+        StoreSamplePair(output + i, (f0 & 0xFFFF) | (f1 << 16));
+    }
+    for (; i < frames; i++) {
+        output[i] = input[2 * i];
+    }
+}
+
+#define AUDIO_VOLUME_FACTOR_ONE 65536
+
+// Reference: int16 to int32 scaled by factor (Q16), saturated
+static inline void ScaleToInt32Reference(const int16_t* input, int32_t* output, size_t samples, int32_t factor) {
+    for (size_t i = 0; i < samples; i++) {
+        int64_t value = int64_t(input[i]) * factor;
+        output[i] = value > INT32_MAX ? INT32_MAX : value < INT32_MIN ? INT32_MIN : static_cast<int32_t>(value);
+    }
+}
+
+// int16 to int32 scaled by factor (Q16), saturated. A factor within [0, 1.0] can not overflow
+// (32767 * 65536 < 2^31, -32768 * 65536 == -2^31), so the common case is a plain 32-bit multiply.
+static inline void ScaleToInt32(const int16_t* input, int32_t* output, size_t samples, int32_t factor) {
+    if (factor < 0 || factor > AUDIO_VOLUME_FACTOR_ONE) {
+        ScaleToInt32Reference(input, output, samples, factor);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        uint32_t s01 = LoadSamplePair(input + i);
+        uint32_t s23 = LoadSamplePair(input + i + 2);
+        output[i] = int32_t(int16_t(s01)) * factor;
+        output[i + 1] = int32_t(int16_t(s01 >> 16)) * factor;
+        output[i + 2] = int32_t(int16_t(s23)) * factor;
+        output[i + 3] = int32_t(int16_t(s23 >> 16)) * factor;
+    }
+    for (; i < samples; i++) {
+        output[i] = int32_t(input[i]) * factor;
+    }
+}
+
+// Reference: int32 to int16 by an arithmetic right shift, saturated to [-INT16_MAX, INT16_MAX]
+static inline void ShiftToInt16Reference(const int32_t* input, int16_t* output, size_t samples, int shift) {
+    for (size_t i = 0; i < samples; i++) {
+        int32_t value = input[i] >> shift;
+        output[i] = value > INT16_MAX ? INT16_MAX : value < -INT16_MAX ? -INT16_MAX : static_cast<int16_t>(value);
+    }
+}
+
+static inline int16_t SaturateToInt16(int32_t value) {
+    value = value > INT16_MAX ? INT16_MAX : value;
+    return static_cast<int16_t>(value < -INT16_MAX ? -INT16_MAX : value);
+}
+
+// int32 to int16 by an arithmetic right shift, saturated to [-INT16_MAX, INT16_MAX]
+static inline void ShiftToInt16(const int32_t* input, int16_t* output, size_t samples, int shift) {
+    size_t i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        int16_t s0 = SaturateToInt16(input[i] >> shift);
+        int16_t s1 = SaturateToInt16(input[i + 1] >> shift);
+        int16_t s2 = SaturateToInt16(input[i + 2] >> shift);
+        int16_t s3 = SaturateToInt16(input[i + 3] >> shift);
+        StoreSamplePair(output + i, uint16_t(s0) | (uint32_t(uint16_t(s1)) << 16));
+        StoreSamplePair(output + i + 2, uint16_t(s2) | (uint32_t(uint16_t(s3)) << 16));
+    }
+    for (; i < samples; i++) {
+        output[i] = SaturateToInt16(input[i] >> shift);
+    }
+}
+
+#endif // AUDIO_KERNELS_H
@@ -0,0 +1,152 @@
+#include "audio_mixer.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "AudioMixer"
+
+#define MIXER_UNITY_GAIN 32768
+// Music level under voice, about -15 dB
+#define MIXER_DUCK_GAIN 5827
+#define MIXER_ATTACK_MS 20
+#define MIXER_RELEASE_MS 400
+// Keeps music ducked across the pauses between sentences
+#define MIXER_HOLD_MS 600
+
+static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AudioMixer::AudioMixer(size_t voice_capacity, size_t music_capacity) {
+    size_t capacities[kAudioMixerBusCount] = { voice_capacity, music_capacity };
+    for (int i = 0; i < kAudioMixerBusCount; i++) {
+        Bus& bus = buses_[i];
+        bus.samples.resize(RoundUpToPowerOfTwo(capacities[i]));
+        bus.mask = bus.samples.size() - 1;
+        bus.gain = MIXER_UNITY_GAIN;
+        bus.target = MIXER_UNITY_GAIN;
+    }
+}
+
+void AudioMixer::Configure(int sample_rate) {
+    sample_rate_ = sample_rate;
+    attack_step_ = std::max(1, MIXER_UNITY_GAIN / std::max(1, sample_rate * MIXER_ATTACK_MS / 1000));
+    release_step_ = std::max(1, MIXER_UNITY_GAIN / std::max(1, sample_rate * MIXER_RELEASE_MS / 1000));
+    hold_samples_ = sample_rate * MIXER_HOLD_MS / 1000;
+    ESP_LOGI(TAG, "Mixing at %d Hz", sample_rate);
+}
+
+size_t AudioMixer::Write(AudioMixerBus bus, const int16_t* data, size_t samples) {
+    Bus& b = buses_[bus];
+    uint32_t head = b.head.load(std::memory_order_relaxed);
+    uint32_t tail = b.tail.load();
+    size_t count = std::min(samples, b.samples.size() - (head - tail));
+
+    /* At most two copies, before and after the end of the ring */
+    size_t offset = head & b.mask;
+    size_t first = std::min(count, b.samples.size() - offset);
+    memcpy(b.samples.data() + offset, data, first * sizeof(int16_t));
+    memcpy(b.samples.data(), data + first, (count - first) * sizeof(int16_t));
+    b.head.store(head + count);
+    return count;
+}
+
+int16_t* AudioMixer::AcquireWrite(AudioMixerBus bus, size_t samples, size_t* count) {
+    Bus& b = buses_[bus];
+    uint32_t head = b.head.load(std::memory_order_relaxed);
+    uint32_t tail = b.tail.load();
+    size_t offset = head & b.mask;
+    *count = std::min({ samples, b.samples.size() - (head - tail), b.samples.size() - offset });
+    return b.samples.data() + offset;
+}
+
+void AudioMixer::CommitWrite(AudioMixerBus bus, size_t samples) {
+    Bus& b = buses_[bus];
+    b.head.store(b.head.load(std::memory_order_relaxed) + samples);
+}
+
+void AudioMixer::Clear(AudioMixerBus bus) {
+    buses_[bus].clear = true;
+}
+
+size_t AudioMixer::available(AudioMixerBus bus) const {
+    const Bus& b = buses_[bus];
+    if (b.clear.load()) {
+        return 0;
+    }
+    return b.head.load() - b.tail.load();
+}
+
+size_t AudioMixer::space(AudioMixerBus bus) const {
+    const Bus& b = buses_[bus];
+    return b.samples.size() - (b.head.load() - b.tail.load());
+}
+
+bool AudioMixer::empty() const {
+    for (int i = 0; i < kAudioMixerBusCount; i++) {
+        if (available(static_cast<AudioMixerBus>(i)) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t AudioMixer::Mix(int16_t* output, size_t max_samples, int sample_rate) {
+    if (sample_rate != sample_rate_) {
+        Configure(sample_rate);
+    }
+
+    size_t counts[kAudioMixerBusCount];
+    size_t samples = 0;
+    for (int i = 0; i < kAudioMixerBusCount; i++) {
+        Bus& bus = buses_[i];
+        if (bus.clear.exchange(false)) {
+            bus.tail.store(bus.head.load());
+        }
+        counts[i] = std::min<size_t>(bus.head.load() - bus.tail.load(std::memory_order_relaxed), max_samples);
+        samples = std::max(samples, counts[i]);
+    }
+    if (samples == 0) {
+        return 0;
+    }
+
+    /* Hold time counts mixed samples, so music that comes back after silence fades in */
+    if (counts[kAudioMixerBusVoice] > 0) {
+        hold_remaining_ = hold_samples_;
+    }
+    bool ducking = hold_remaining_ > 0;
+    hold_remaining_ = hold_remaining_ > samples ? hold_remaining_ - samples : 0;
+    buses_[kAudioMixerBusMusic].target = ducking ? MIXER_DUCK_GAIN : MIXER_UNITY_GAIN;
+    if (ducking != ducking_.load()) {
+        ducking_ = ducking;
+        ESP_LOGD(TAG, "Music %s", ducking ? "ducked" : "restored");
+    }
+
+    memset(output, 0, samples * sizeof(int16_t));
+    for (int i = 0; i < kAudioMixerBusCount; i++) {
+        Bus& bus = buses_[i];
+        size_t count = counts[i];
+        if (count == 0) {
+            continue;
+        }
+        uint32_t tail = bus.tail.load(std::memory_order_relaxed);
+        int32_t gain = bus.gain;
+        int32_t target = bus.target;
+        int32_t step = target < gain ? attack_step_ : release_step_;
+        for (size_t j = 0; j < count; j++) {
+            if (gain != target) {
+                gain = gain < target ? std::min(gain + step, target) : std::max(gain - step, target);
+            }
+            int32_t value = output[j] + ((int32_t(bus.samples[(tail + j) & bus.mask]) * gain) >> 15);
+            output[j] = std::clamp<int32_t>(value, INT16_MIN, INT16_MAX);
+        }
+        bus.gain = gain;
+        bus.tail.store(tail + count);
+    }
+    return samples;
+}
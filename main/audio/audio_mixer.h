@@ -0,0 +1,73 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+enum AudioMixerBus {
+    kAudioMixerBusVoice,    // Decoded downlink speech and prompt sounds, they share the Opus decoder
+    kAudioMixerBusMusic,
+    kAudioMixerBusCount,
+};
+
+/*
+ * Sums the output buses into the codec frame, ducking music under voice.
+ *
+ * Every bus is a single-producer / single-consumer sample ring at the codec output rate.
+ * Mix() takes at most one frame from each bus and adds them in Q15 with a per-bus gain
+ * that ramps linearly towards its target every sample, so gain changes never click.
+ * While the voice bus carries samples (and for a hold time after), the music target drops
+ * to the duck gain; it ramps back to unity afterwards.
+ *
+ * Write() and AcquireWrite() / CommitWrite() are called by the producer of their bus, Mix() by
+ * the output task only.
+ * Clear() may be called from any task and takes effect on the next Mix().
+ */
+class AudioMixer {
+public:
+    AudioMixer(size_t voice_capacity, size_t music_capacity);
+
+    AudioMixer(const AudioMixer&) = delete;
+    AudioMixer& operator=(const AudioMixer&) = delete;
+
+    // Returns the samples written, less than requested when the bus is full
+    size_t Write(AudioMixerBus bus, const int16_t* data, size_t samples);
+    // For a producer that fills the bus in place: the free space after the head, up to samples and
+    // without wrapping, with its size in *count. CommitWrite() then publishes the samples written.
+    int16_t* AcquireWrite(AudioMixerBus bus, size_t samples, size_t* count);
+    void CommitWrite(AudioMixerBus bus, size_t samples);
+    void Clear(AudioMixerBus bus);
+    size_t available(AudioMixerBus bus) const;
+    size_t space(AudioMixerBus bus) const;
+    bool empty() const;
+
+    // Mixes up to max_samples into output and returns the samples produced, 0 when all buses are empty
+    size_t Mix(int16_t* output, size_t max_samples, int sample_rate);
+
+    inline bool ducking() const { return ducking_.load(); }
+
+private:
+    struct Bus {
+        std::vector<int16_t> samples;
+        size_t mask = 0;
+        std::atomic<uint32_t> head = 0;
+        std::atomic<uint32_t> tail = 0;
+        std::atomic<bool> clear = false;
+        int32_t gain = 0;           // Q15
+        int32_t target = 0;         // Q15
+    };
+
+    Bus buses_[kAudioMixerBusCount];
+    int sample_rate_ = 0;
+    int32_t attack_step_ = 0;
+    int32_t release_step_ = 0;
+    uint32_t hold_samples_ = 0;
+    uint32_t hold_remaining_ = 0;
+    std::atomic<bool> ducking_ = false;
+
+    void Configure(int sample_rate);
+};
+
+#endif // AUDIO_MIXER_H
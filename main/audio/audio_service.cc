@@ -1,6 +1,11 @@
 #include "audio_service.h"
+#include "audio_kernels.h"
+#include "assets/lang_config.h"
 #include <esp_log.h>
+#include <cJSON.h>
+#include <cinttypes>
 #include <cstring>
+#include <algorithm>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -17,9 +22,50 @@
 
 #define TAG "AudioService"
 
+// Frame duration policy: one step longer on slow or lossy links, one step shorter on fast and clean ones.
+// The gap between the thresholds keeps the duration from flapping between sessions.
+#define FRAME_DURATION_LONGER_RTT_MS 300
+#define FRAME_DURATION_LONGER_LOSS_PERCENT 5
+#define FRAME_DURATION_SHORTER_RTT_MS 120
+#define FRAME_DURATION_SHORTER_LOSS_PERCENT 1
+// Sessions with fewer downlink packets say too little about the link
+#define FRAME_DURATION_MIN_PACKETS 50
+
+// The testing queue may also hold the frames that were still in the encode queue when it filled up,
+// and the decode ring has to take the whole testing recording when it is played back.
+#define TESTING_QUEUE_CAPACITY (MAX_TESTING_PACKETS_IN_QUEUE + MAX_ENCODE_TASKS_IN_QUEUE)
+#define DECODE_QUEUE_CAPACITY std::max(MAX_DECODE_PACKETS_IN_QUEUE, TESTING_QUEUE_CAPACITY)
+
+static BaseType_t GetTaskCoreId(int core_id) {
+    return (core_id >= 0 && core_id < portNUM_PROCESSORS) ? core_id : tskNO_AFFINITY;
+}
+
 
-AudioService::AudioService() {
+AudioService::AudioService()
+    : input_distributor_(AUDIO_INPUT_RING_FRAMES),
+      audio_decode_queue_(DECODE_QUEUE_CAPACITY),
+      audio_send_queue_(MAX_SEND_PACKETS_IN_QUEUE),
+      audio_testing_queue_(TESTING_QUEUE_CAPACITY),
+      audio_encode_queue_(MAX_ENCODE_TASKS_IN_QUEUE),
+      audio_playback_queue_(MAX_PLAYBACK_TASKS_IN_QUEUE),
+      audio_task_pool_(AUDIO_TASK_POOL_SIZE, nullptr, [](AudioTask& task) {
+          task.pcm.clear();
+          task.timestamp = 0;
+          task.sample_rate = 0;
+          task.time_us = 0;
+      }),
+      mixer_(AUDIO_MIXER_VOICE_SAMPLES, AUDIO_MIXER_MUSIC_SAMPLES),
+      jitter_buffer_(CONFIG_JITTER_BUFFER_MIN_FRAMES, CONFIG_JITTER_BUFFER_MAX_FRAMES, CONFIG_JITTER_BUFFER_JITTER_MULTIPLIER),
+      complexity_governor_(CONFIG_OPUS_ENCODER_COMPLEXITY_MIN, CONFIG_OPUS_ENCODER_COMPLEXITY_MAX) {
     event_group_ = xEventGroupCreate();
+
+    audio_encode_queue_.SetConsumerWaiter(&opus_encoder_waiter_);
+    audio_encode_queue_.SetProducerWaiter(&encode_space_waiter_);
+    audio_decode_queue_.SetConsumerWaiter(&opus_decoder_waiter_);
+    audio_decode_queue_.SetProducerWaiter(&decode_space_waiter_);
+    audio_send_queue_.SetProducerWaiter(&opus_encoder_waiter_);
+    audio_playback_queue_.SetConsumerWaiter(&audio_output_waiter_);
+    audio_playback_queue_.SetProducerWaiter(&opus_decoder_waiter_);
 }
 
 AudioService::~AudioService() {
@@ -35,14 +81,34 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, frame_duration_ms_);
+    opus_encoder_->SetComplexity(complexity_governor_.complexity());
 
+    /* Warm up the pools so that steady-state streaming does not allocate */
+    GetAudioStreamPacketPool().SetMaxCached(AUDIO_STREAM_PACKET_POOL_SIZE);
+    GetAudioStreamPacketPool().Reserve(AUDIO_STREAM_PACKET_POOL_RESERVE);
+    audio_task_pool_.Reserve(AUDIO_TASK_POOL_SIZE);
+
+    input_distributor_.SetChannels(codec->input_channels());
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
     }
 
+#if CONFIG_USE_EARLY_ENDPOINTING
+    endpointer_.Configure({
+        .min_speech_ms = CONFIG_ENDPOINT_MIN_SPEECH_MS,
+        .hangover_ms = CONFIG_ENDPOINT_HANGOVER_MS,
+        .max_hangover_ms = CONFIG_ENDPOINT_MAX_HANGOVER_MS,
+        .decay_db = CONFIG_ENDPOINT_DECAY_DB,
+        .vad_min_noise_ms = CONFIG_VAD_MIN_NOISE_MS,
+    });
+#endif
+
+#if CONFIG_USE_AUDIO_DEBUGGER
+    audio_debugger_ = std::make_unique<AudioDebugger>();
+#endif
+
 #if CONFIG_USE_AUDIO_PROCESSOR
     audio_processor_ = std::make_unique<AfeAudioProcessor>();
 #else
@@ -50,11 +116,28 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
-        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
+        [[maybe_unused]] int64_t latency_us = RecordProcessorLatency(data.size());
+#if CONFIG_USE_AUDIO_DEBUGGER
+        audio_debugger_->Feed(kAudioDebugTapProcessed, data.data(), data.size(), 16000);
+#endif
+        if (endpointer_.Process(data.data(), data.size(), voice_detected_) && callbacks_.on_endpoint) {
+            callbacks_.on_endpoint();
+        }
+        uint32_t timestamp = 0;
+#if CONFIG_USE_SERVER_AEC
+        /* Reference of the first sample, latency_us is the one of the newest */
+        if (latency_us >= 0) {
+            int64_t capture_us = esp_timer_get_time() - latency_us - (int64_t)data.size() * 1000000 / 16000;
+            timestamp = aec_aligner_.GetReference(capture_us);
+        }
+#endif
+        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data), timestamp);
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
+        /* The end of speech starts the response latency measurement */
+        speech_end_time_us_ = speaking ? 0 : esp_timer_get_time();
         if (callbacks_.on_vad_change) {
             callbacks_.on_vad_change(speaking);
         }
@@ -75,7 +158,12 @@ void AudioService::Initialize(AudioCodec* codec) {
 
 void AudioService::Start() {
     service_stopped_ = false;
-    xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING | AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+    xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING | AS_EVENT_WAKE_WORD_RUNNING |
+        AS_EVENT_AUDIO_PROCESSOR_RUNNING | AS_EVENT_INPUT_TAP_RUNNING);
+    /* The tap belongs to another task, it stays enabled across a restart */
+    if (input_distributor_.enabled(kInputConsumerTap)) {
+        xEventGroupSetBits(event_group_, AS_EVENT_INPUT_TAP_RUNNING);
+    }
 
     esp_timer_start_periodic(audio_power_timer_, 1000000);
 
@@ -109,12 +197,20 @@ void AudioService::Start() {
     }, "audio_output", 2048, this, 4, &audio_output_task_handle_);
 #endif
 
-    /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    /* Start the opus encoder and decoder tasks */
+    xTaskCreatePinnedToCore([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusEncoderTask();
+        vTaskDelete(NULL);
+    }, "opus_encoder", CONFIG_OPUS_ENCODER_TASK_STACK_SIZE, this, CONFIG_OPUS_ENCODER_TASK_PRIORITY,
+        &opus_encoder_task_handle_, GetTaskCoreId(CONFIG_OPUS_ENCODER_TASK_CORE_ID));
+
+    xTaskCreatePinnedToCore([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
-        audio_service->OpusCodecTask();
+        audio_service->OpusDecoderTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, "opus_decoder", CONFIG_OPUS_DECODER_TASK_STACK_SIZE, this, CONFIG_OPUS_DECODER_TASK_PRIORITY,
+        &opus_decoder_task_handle_, GetTaskCoreId(CONFIG_OPUS_DECODER_TASK_CORE_ID));
 }
 
 void AudioService::Stop() {
@@ -122,14 +218,19 @@ void AudioService::Stop() {
     service_stopped_ = true;
     xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
         AS_EVENT_WAKE_WORD_RUNNING |
-        AS_EVENT_AUDIO_PROCESSOR_RUNNING);
-
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+        AS_EVENT_AUDIO_PROCESSOR_RUNNING |
+        AS_EVENT_INPUT_TAP_RUNNING);
+
+    audio_encode_queue_.Clear();
+    audio_decode_queue_.Clear();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    opus_encoder_waiter_.Signal();
+    opus_decoder_waiter_.Signal();
+    audio_output_waiter_.Signal();
+    encode_space_waiter_.Signal();
+    decode_space_waiter_.Signal();
+    music_space_waiter_.Signal();
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
@@ -144,26 +245,25 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         if (!codec_->InputData(data)) {
             return false;
         }
+        /* The scratch buffers keep their capacity, so steady-state reads do not allocate */
         if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
+            size_t frames = data.size() / 2;
+            mic_scratch_.resize(frames);
+            reference_scratch_.resize(frames);
+            DeinterleaveStereo(data.data(), mic_scratch_.data(), reference_scratch_.data(), frames);
+
+            size_t output_frames = input_resampler_.GetOutputSamples(frames);
+            resampled_mic_scratch_.resize(output_frames);
+            resampled_reference_scratch_.resize(output_frames);
+            input_resampler_.Process(mic_scratch_.data(), frames, resampled_mic_scratch_.data());
+            reference_resampler_.Process(reference_scratch_.data(), frames, resampled_reference_scratch_.data());
+
+            data.resize(output_frames * 2);
+            InterleaveStereo(resampled_mic_scratch_.data(), resampled_reference_scratch_.data(), data.data(), output_frames);
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            resampled_mic_scratch_.resize(input_resampler_.GetOutputSamples(data.size()));
+            input_resampler_.Process(data.data(), data.size(), resampled_mic_scratch_.data());
+            data.swap(resampled_mic_scratch_);
         }
     } else {
         data.resize(samples * codec_->input_channels());
@@ -178,19 +278,22 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 
 #if CONFIG_USE_AUDIO_DEBUGGER
     // 音频调试：发送原始音频数据
-    if (audio_debugger_ == nullptr) {
-        audio_debugger_ = std::make_unique<AudioDebugger>();
+    int channels = codec_->input_channels();
+    audio_debugger_->Feed(kAudioDebugTapMic, data.data(), data.size() / channels, sample_rate, channels);
+    if (channels == 2) {
+        audio_debugger_->Feed(kAudioDebugTapReference, data.data() + 1, data.size() / 2, sample_rate, 2);
     }
-    audio_debugger_->Feed(data);
 #endif
 
     return true;
 }
 
 void AudioService::AudioInputTask() {
+    // Reused across reads, it keeps its capacity unless a consumer takes it over
+    std::vector<int16_t> data;
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
-            AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
+            AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING | AS_EVENT_INPUT_TAP_RUNNING,
             pdFALSE, pdFALSE, portMAX_DELAY);
 
         if (service_stopped_) {
@@ -202,173 +305,307 @@ void AudioService::AudioInputTask() {
             continue;
         }
 
-        /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
-        if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+        /* One codec read per DMA period, shared by every consumer that is running */
+        int samples = AUDIO_CODEC_DMA_FRAME_NUM * 16000 / codec_->input_sample_rate();
+        if (!ReadAudioData(data, 16000, samples)) {
+            ESP_LOGE(TAG, "Failed to read audio data");
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        input_distributor_.Write(data.data(), data.size() / codec_->input_channels());
+        FeedInputConsumers(bits);
+    }
+
+    ESP_LOGW(TAG, "Audio input task stopped");
+}
+
+void AudioService::FeedInputConsumers(EventBits_t bits) {
+    /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
+    if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
+        int samples = frame_duration_ms_ * 16000 / 1000;
+        while (input_distributor_.Read(kInputConsumerTesting, testing_chunk_, samples)) {
+            if (audio_testing_queue_.size() >= GetMaxTestingPackets()) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
-                continue;
+                break;
             }
-            std::vector<int16_t> data;
-            int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-            if (ReadAudioData(data, 16000, samples)) {
-                // If input channels is 2, we need to fetch the left channel data
-                if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
-                }
-                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
-                continue;
+            // If input channels is 2, we need to fetch the left channel data
+            if (codec_->input_channels() == 2) {
+                ExtractLeftChannel(testing_chunk_.data(), testing_chunk_.data(), testing_chunk_.size() / 2);
+                testing_chunk_.resize(testing_chunk_.size() / 2);
             }
+            PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(testing_chunk_));
         }
+    }
 
-        /* Feed the wake word */
-        if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
-            int samples = wake_word_->GetFeedSize();
-            if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    wake_word_->Feed(data);
-                    continue;
-                }
-            }
+    /* Feed the wake word */
+    if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
+        int samples = wake_word_->GetFeedSize();
+        while (samples > 0 && input_distributor_.Read(kInputConsumerWakeWord, wake_word_chunk_, samples)) {
+            wake_word_->Feed(wake_word_chunk_);
         }
+    }
 
-        /* Feed the audio processor */
-        if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
-            int samples = audio_processor_->GetFeedSize();
-            if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    audio_processor_->Feed(std::move(data));
-                    continue;
-                }
-            }
+    /* Feed the audio processor */
+    if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
+        int samples = audio_processor_->GetFeedSize();
+        while (samples > 0 && input_distributor_.Read(kInputConsumerProcessor, processor_chunk_, samples)) {
+            processor_input_samples_ += samples;
+            last_processor_feed_us_ = esp_timer_get_time();
+            audio_processor_->Feed(std::move(processor_chunk_));
         }
+    }
+}
 
-        ESP_LOGE(TAG, "Should not be here, bits: %lx", bits);
-        break;
+void AudioService::EnableInputTap(bool enable) {
+    ESP_LOGI(TAG, "%s input tap", enable ? "Enabling" : "Disabling");
+    input_distributor_.Enable(kInputConsumerTap, enable);
+    if (enable) {
+        xEventGroupSetBits(event_group_, AS_EVENT_INPUT_TAP_RUNNING);
+    } else {
+        xEventGroupClearBits(event_group_, AS_EVENT_INPUT_TAP_RUNNING);
     }
+}
 
-    ESP_LOGW(TAG, "Audio input task stopped");
+bool AudioService::ReadInputTap(std::vector<int16_t>& data, int samples) {
+    return input_distributor_.WaitRead(kInputConsumerTap, data, samples, AUDIO_INPUT_TAP_TIMEOUT_MS * 1000);
 }
 
 void AudioService::AudioOutputTask() {
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
+        audio_output_waiter_.Wait([this]() { return audio_playback_queue_.pending() || !mixer_.empty() || service_stopped_; });
         if (service_stopped_) {
             break;
         }
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
+        /* Top up the voice bus only when it runs low, so voice stays at most one codec frame ahead of the speaker */
+        AudioTaskPtr task;
+        int output_sample_rate = codec_->output_sample_rate();
+        if (mixer_.available(kAudioMixerBusVoice) < AUDIO_CODEC_DMA_FRAME_NUM && audio_playback_queue_.TryPop(task)) {
+            if (task->time_us > 0) {
+                int64_t now = esp_timer_get_time();
+                latency_tracker_.Record(kLatencyStagePlayback, now - task->time_us);
+                int64_t speech_end = response_speech_end_us_.exchange(0);
+                if (speech_end > 0) {
+                    latency_tracker_.Record(kLatencyStageEndToEnd, now - speech_end);
+                }
+            }
+#if CONFIG_USE_SERVER_AEC
+            /* Samples queued ahead of this frame: the voice bus and the DMA buffers of the codec */
+            size_t queued = mixer_.available(kAudioMixerBusVoice) + AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM;
+#endif
+            const int16_t* pcm = task->pcm.data();
+            size_t samples = task->pcm.size();
+            size_t written = 0;
+            if (task->sample_rate != 0 && task->sample_rate != output_sample_rate) {
+                if (task->sample_rate != resampler_input_rate_ || output_sample_rate != resampler_output_rate_) {
+                    ESP_LOGI(TAG, "Resampling audio from %d to %d", task->sample_rate, output_sample_rate);
+                    output_resampler_.Configure(task->sample_rate, output_sample_rate);
+                    resampler_input_rate_ = task->sample_rate;
+                    resampler_output_rate_ = output_sample_rate;
+                }
+                /* Resample straight into the voice bus, through the scratch buffer only where the ring wraps */
+                size_t resampled = output_resampler_.GetOutputSamples(samples);
+                size_t span = 0;
+                int16_t* dest = mixer_.AcquireWrite(kAudioMixerBusVoice, resampled, &span);
+                if (span == resampled) {
+                    output_resampler_.Process(pcm, samples, dest);
+                    mixer_.CommitWrite(kAudioMixerBusVoice, resampled);
+                    written = resampled;
+                } else {
+                    voice_scratch_.resize(resampled);
+                    output_resampler_.Process(pcm, samples, voice_scratch_.data());
+                    written = mixer_.Write(kAudioMixerBusVoice, voice_scratch_.data(), resampled);
+                }
+                samples = resampled;
+            } else {
+                written = mixer_.Write(kAudioMixerBusVoice, pcm, samples);
+            }
+            if (written < samples) {
+                ESP_LOGW(TAG, "Voice bus full, dropped %u samples", (unsigned)(samples - written));
+            }
+            debug_statistics_.playback_count++;
+
+#if CONFIG_USE_SERVER_AEC
+            /* Record when this frame reaches the speaker for server AEC */
+            if (task->timestamp > 0) {
+                aec_aligner_.OnPlayback(task->timestamp, esp_timer_get_time() + (int64_t)queued * 1000000 / output_sample_rate,
+                    (int64_t)samples * 1000000 / output_sample_rate);
+            }
+#endif
+        }
 
+        /* Mix one codec frame straight into the codec output buffer, the codec applies its volume stage from there */
+        int16_t* frame = codec_->AcquireOutputBuffer(AUDIO_CODEC_DMA_FRAME_NUM);
+        size_t samples = mixer_.Mix(frame, AUDIO_CODEC_DMA_FRAME_NUM, output_sample_rate);
+        music_space_waiter_.Signal();
+        if (samples == 0) {
+            continue;
+        }
         if (!codec_->output_enabled()) {
             esp_timer_stop(audio_power_timer_);
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
             codec_->EnableOutput(true);
         }
-        codec_->OutputData(task->pcm);
+        codec_->CommitOutputBuffer(samples);
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
-        debug_statistics_.playback_count++;
+    }
 
-#if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
+    ESP_LOGW(TAG, "Audio output task stopped");
+}
+
+void AudioService::OpusDecoderTask() {
+    auto can_decode = [this]() {
+        return service_stopped_ || decoder_reset_ ||
+            (audio_decode_queue_.pending() && !jitter_buffer_.full()) ||
+            (!audio_playback_queue_.full() && jitter_buffer_.IsReady(esp_timer_get_time()));
+    };
+
+    while (true) {
+        /* While the jitter buffer builds up its delay, wake up when the delay has passed */
+        int64_t wait_time = jitter_buffer_.GetWaitTime(esp_timer_get_time());
+        if (wait_time > 0) {
+            opus_decoder_waiter_.WaitFor(can_decode, wait_time);
+        } else {
+            opus_decoder_waiter_.Wait(can_decode);
+        }
+        if (service_stopped_) {
+            break;
+        }
+        if (decoder_reset_.exchange(false)) {
+            jitter_buffer_.Reset();
+            opus_decoder_->ResetState();
+        }
+
+        /* Move the received packets into the jitter buffer */
+        AudioStreamPacketPtr packet;
+        while (!jitter_buffer_.full() && audio_decode_queue_.TryPop(packet)) {
+            jitter_buffer_.Put(std::move(packet), esp_timer_get_time());
+        }
+        if (audio_playback_queue_.full() || !jitter_buffer_.IsReady(esp_timer_get_time())) {
+            continue;
+        }
+
+        auto result = jitter_buffer_.Get(packet);
+        if (result == JitterBuffer::kJitterBufferEmpty) {
+            continue;
+        }
+
+        int64_t start_time = esp_timer_get_time();
+        auto task = audio_task_pool_.Acquire();
+        task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+
+        bool decoded_ok;
+        if (result == JitterBuffer::kJitterBufferPacket) {
+            task->timestamp = packet->timestamp;
+            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
+            if (packet->static_payload != nullptr) {
+                // The decoder only takes a vector, fill the pooled payload from flash right before decoding
+                packet->payload.assign(packet->static_payload, packet->static_payload + packet->static_payload_size);
+            }
+            decoded_ok = opus_decoder_->Decode(std::move(packet->payload), task->pcm);
+            if (decoded_ok && packet->time_us > 0) {
+                task->time_us = esp_timer_get_time();
+                latency_tracker_.Record(kLatencyStageDecode, task->time_us - packet->time_us);
+            }
+            packet.reset();
+        } else {
+            /* An empty packet makes the decoder run packet loss concealment */
+            if (!opus_decoder_->Decode(std::vector<uint8_t>(), task->pcm)) {
+                task->pcm.assign(opus_decoder_->sample_rate() * opus_decoder_->duration_ms() / 1000, 0);
+            }
+            decoded_ok = true;
         }
+
+        if (decoded_ok) {
+            // Resampled by the output task, straight into the codec output buffer
+            task->sample_rate = opus_decoder_->sample_rate();
+#if CONFIG_USE_AUDIO_DEBUGGER
+            audio_debugger_->Feed(kAudioDebugTapDownlink, task->pcm.data(), task->pcm.size(), task->sample_rate);
 #endif
+            if (!audio_playback_queue_.TryPush(std::move(task))) {
+                ESP_LOGW(TAG, "Playback queue is full, dropping decoded audio");
+                debug_statistics_.decode_dropped++;
+            }
+        } else {
+            ESP_LOGE(TAG, "Failed to decode audio");
+            debug_statistics_.decode_errors++;
+        }
+
+        uint32_t elapsed_us = esp_timer_get_time() - start_time;
+        debug_statistics_.decode_time_us += elapsed_us;
+        debug_statistics_.decode_max_us = std::max(debug_statistics_.decode_max_us, elapsed_us);
+        debug_statistics_.decode_count++;
     }
 
-    ESP_LOGW(TAG, "Audio output task stopped");
+    ESP_LOGW(TAG, "Opus decoder task stopped");
 }
 
-void AudioService::OpusCodecTask() {
+void AudioService::OpusEncoderTask() {
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
+        opus_encoder_waiter_.Wait([this]() {
             return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
+                (audio_encode_queue_.pending() && audio_send_queue_.size() < GetMaxSendPackets());
         });
         if (service_stopped_) {
             break;
         }
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
+        /* Encode the audio to send queue */
+        AudioTaskPtr task;
+        if (audio_send_queue_.size() >= GetMaxSendPackets() || !audio_encode_queue_.TryPop(task)) {
+            continue;
+        }
 
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
+        /* Follow frame duration changes, the frames tell which duration they were cut for */
+        int frame_duration = task->pcm.size() * 1000 / 16000;
+        if (frame_duration != opus_encoder_->duration_ms() &&
+            (frame_duration == 20 || frame_duration == 40 || frame_duration == 60)) {
+            ESP_LOGI(TAG, "Opus encoder frame duration %d -> %d ms", opus_encoder_->duration_ms(), frame_duration);
+            opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, frame_duration);
+            opus_encoder_->SetComplexity(complexity_governor_.complexity());
+        }
 
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
-                }
+        int64_t start_time = esp_timer_get_time();
+        auto packet = AcquireAudioStreamPacket();
+        packet->frame_duration = opus_encoder_->duration_ms();
+        packet->sample_rate = 16000;
+        packet->timestamp = task->timestamp;
+        if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+            ESP_LOGE(TAG, "Failed to encode audio");
+            debug_statistics_.encode_errors++;
+            continue;
+        }
+        packet->time_us = esp_timer_get_time();
+        latency_tracker_.Record(kLatencyStageEncode, packet->time_us - task->time_us);
+        complexity_governor_.RecordEncode(packet->time_us - start_time, packet->frame_duration);
+        if (complexity_governor_.Update(packet->time_us)) {
+            opus_encoder_->SetComplexity(complexity_governor_.complexity());
+        }
 
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
-            } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
+        if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+            if (!audio_send_queue_.TryPush(std::move(packet))) {
+                debug_statistics_.encode_dropped++;
             }
-            debug_statistics_.decode_count++;
-        }
-        
-        /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
-            auto task = std::move(audio_encode_queue_.front());
-            audio_encode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-                continue;
+            if (callbacks_.on_send_queue_available) {
+                callbacks_.on_send_queue_available();
             }
-
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
-                }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
+        } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
+            if (!audio_testing_queue_.TryPush(std::move(packet))) {
+                ESP_LOGW(TAG, "Audio testing queue is full, dropping packet");
+                debug_statistics_.encode_dropped++;
             }
-            debug_statistics_.encode_count++;
-            lock.lock();
         }
+
+        uint32_t elapsed_us = esp_timer_get_time() - start_time;
+        debug_statistics_.encode_time_us += elapsed_us;
+        debug_statistics_.encode_max_us = std::max(debug_statistics_.encode_max_us, elapsed_us);
+        debug_statistics_.encode_count++;
     }
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+    ESP_LOGW(TAG, "Opus encoder task stopped");
 }
 
 void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
@@ -378,65 +615,71 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
 
     opus_decoder_.reset();
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
-
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
-    }
 }
 
-void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
-    auto task = std::make_unique<AudioTask>();
+void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, uint32_t timestamp) {
+    auto task = audio_task_pool_.Acquire();
     task->type = type;
-    task->pcm = std::move(pcm);
-    
+    task->time_us = esp_timer_get_time();
+    task->timestamp = timestamp;
+    // Hand the pooled buffer back to the caller, so a reused input buffer keeps its capacity
+    task->pcm.swap(pcm);
+
     /* Push the task to the encode queue */
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+    while (!service_stopped_) {
+        encode_space_waiter_.Wait([this]() { return !audio_encode_queue_.full() || service_stopped_; });
+        std::lock_guard<std::mutex> lock(encode_producer_mutex_);
+        if (audio_encode_queue_.TryPush(std::move(task))) {
+            return;
+        }
+    }
+}
 
-    /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+bool AudioService::PushPacketToDecodeQueue(AudioStreamPacketPtr packet, bool wait) {
+    /* Only packets from the network carry a receive time */
+    if (packet->time_us > 0) {
+        int64_t speech_end = speech_end_time_us_.exchange(0);
+        if (speech_end > 0) {
+            latency_tracker_.Record(kLatencyStageResponse, packet->time_us - speech_end);
+            response_speech_end_us_ = speech_end;
         }
-        timestamp_queue_.pop_front();
     }
 
-    audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
-    audio_encode_queue_.push_back(std::move(task));
-    audio_queue_cv_.notify_all();
-}
+    if (packet->frame_duration > 0) {
+        decode_frame_duration_ms_ = packet->frame_duration;
+    }
 
-bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
-        if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
-        } else {
-            return false;
+    while (true) {
+        if (audio_decode_queue_.size() >= GetMaxDecodePackets() || audio_decode_queue_.full()) {
+            if (!wait || service_stopped_) {
+                return false;
+            }
+            decode_space_waiter_.Wait([this]() {
+                return (audio_decode_queue_.size() < GetMaxDecodePackets() && !audio_decode_queue_.full()) || service_stopped_;
+            });
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(decode_producer_mutex_);
+        if (audio_decode_queue_.TryPush(std::move(packet))) {
+            return true;
         }
     }
-    audio_decode_queue_.push_back(std::move(packet));
-    audio_queue_cv_.notify_all();
-    return true;
 }
 
-std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    if (audio_send_queue_.empty()) {
+AudioStreamPacketPtr AudioService::PopPacketFromSendQueue() {
+    AudioStreamPacketPtr packet;
+    if (!audio_send_queue_.TryPop(packet)) {
         return nullptr;
     }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
-    audio_queue_cv_.notify_all();
+    if (packet->time_us > 0) {
+        latency_tracker_.Record(kLatencyStageSend, esp_timer_get_time() - packet->time_us);
+    }
     return packet;
 }
 
 void AudioService::EncodeWakeWord() {
     if (wake_word_) {
-        wake_word_->EncodeWakeWordData();
+        wake_word_->EncodeWakeWordData(frame_duration_ms_);
     }
 }
 
@@ -444,8 +687,8 @@ const std::string& AudioService::GetLastWakeWord() const {
     return wake_word_->GetLastDetectedWakeWord();
 }
 
-std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
-    auto packet = std::make_unique<AudioStreamPacket>();
+AudioStreamPacketPtr AudioService::PopWakeWordPacket() {
+    auto packet = AcquireAudioStreamPacket();
     if (wake_word_->GetWakeWordOpus(packet->payload)) {
         return packet;
     }
@@ -467,10 +710,12 @@ void AudioService::EnableWakeWordDetection(bool enable) {
             wake_word_initialized_ = true;
         }
         wake_word_->Start();
+        input_distributor_.Enable(kInputConsumerWakeWord, true);
         xEventGroupSetBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
     } else {
         wake_word_->Stop();
         xEventGroupClearBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
+        input_distributor_.Enable(kInputConsumerWakeWord, false);
     }
 }
 
@@ -478,44 +723,89 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!audio_processor_initialized_) {
-            audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, models_list_);
+            audio_processor_->Initialize(codec_, frame_duration_ms_, models_list_);
             audio_processor_initialized_ = true;
         }
+        audio_processor_->SetFrameDuration(frame_duration_ms_);
 
         /* We should make sure no audio is playing */
         ResetDecoder();
+        processor_input_samples_ = 0;
+        processor_output_samples_ = 0;
+        endpointer_.Reset();
         audio_input_need_warmup_ = true;
         audio_processor_->Start();
+        input_distributor_.Enable(kInputConsumerProcessor, true);
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
         audio_processor_->Stop();
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+        input_distributor_.Enable(kInputConsumerProcessor, false);
     }
 }
 
 void AudioService::EnableAudioTesting(bool enable) {
     ESP_LOGI(TAG, "%s audio testing", enable ? "Enabling" : "Disabling");
     if (enable) {
+        input_distributor_.Enable(kInputConsumerTesting, true);
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
-        audio_queue_cv_.notify_all();
+        input_distributor_.Enable(kInputConsumerTesting, false);
+        /* Move audio_testing_queue_ to audio_decode_queue_ */
+        std::lock_guard<std::mutex> lock(decode_producer_mutex_);
+        AudioStreamPacketPtr packet;
+        while (audio_testing_queue_.TryPop(packet)) {
+            if (!audio_decode_queue_.TryPush(std::move(packet))) {
+                ESP_LOGW(TAG, "Decode queue is full, dropping audio testing packets");
+                break;
+            }
+        }
     }
 }
 
 void AudioService::EnableDeviceAec(bool enable) {
     ESP_LOGI(TAG, "%s device AEC", enable ? "Enabling" : "Disabling");
     if (!audio_processor_initialized_) {
-        audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, models_list_);
+        audio_processor_->Initialize(codec_, frame_duration_ms_, models_list_);
         audio_processor_initialized_ = true;
     }
 
     audio_processor_->EnableDeviceAec(enable);
 }
 
+void AudioService::SetFrameDuration(int frame_duration_ms) {
+    if (frame_duration_ms != 20 && frame_duration_ms != 40 && frame_duration_ms != 60) {
+        ESP_LOGW(TAG, "Unsupported frame duration %d ms", frame_duration_ms);
+        return;
+    }
+    int previous = frame_duration_ms_.exchange(frame_duration_ms);
+    if (previous != frame_duration_ms) {
+        ESP_LOGI(TAG, "Uplink frame duration %d -> %d ms", previous, frame_duration_ms);
+    }
+}
+
+void AudioService::AdaptFrameDuration(int rtt_ms) {
+    /* Downlink loss of the last audio channel, the jitter buffer conceals or skips every missing frame */
+    JitterBufferStatistics jitter = jitter_buffer_.statistics();
+    uint32_t received = jitter.received - adapt_jitter_statistics_.received;
+    uint32_t missing = jitter.concealed - adapt_jitter_statistics_.concealed + jitter.skipped - adapt_jitter_statistics_.skipped;
+    adapt_jitter_statistics_ = jitter;
+    if (received + missing < FRAME_DURATION_MIN_PACKETS) {
+        return;
+    }
+    int loss_percent = missing * 100 / (received + missing);
+
+    int frame_duration = frame_duration_ms_;
+    if (rtt_ms > FRAME_DURATION_LONGER_RTT_MS || loss_percent >= FRAME_DURATION_LONGER_LOSS_PERCENT) {
+        frame_duration = std::min(frame_duration + 20, 60);
+    } else if (rtt_ms > 0 && rtt_ms < FRAME_DURATION_SHORTER_RTT_MS && loss_percent < FRAME_DURATION_SHORTER_LOSS_PERCENT) {
+        frame_duration = std::max(frame_duration - 20, 20);
+    }
+    ESP_LOGI(TAG, "Link rtt %d ms, loss %d%%, frame duration %d ms", rtt_ms, loss_percent, frame_duration);
+    SetFrameDuration(frame_duration);
+}
+
 void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
     callbacks_ = callbacks;
 }
@@ -527,6 +817,15 @@ void AudioService::PlaySound(const std::string_view& ogg) {
         codec_->EnableOutput(true);
     }
 
+    /* Embedded prompts come with a packet table generated at build time */
+    for (auto prompt = Lang::Sounds::PROMPT_SOUNDS; prompt->data != nullptr; prompt++) {
+        if (prompt->data == ogg.data()) {
+            PlayPromptSound(*prompt);
+            return;
+        }
+    }
+
+    /* Raw Ogg data (e.g. from the assets partition), parse the pages at runtime */
     const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
     size_t size = ogg.size();
     size_t offset = 0;
@@ -607,11 +906,10 @@ void AudioService::PlaySound(const std::string_view& ogg) {
             }
 
             // Audio packet (Opus)
-            auto packet = std::make_unique<AudioStreamPacket>();
+            auto packet = AcquireAudioStreamPacket();
             packet->sample_rate = sample_rate;
             packet->frame_duration = 60;
-            packet->payload.resize(pkt_len);
-            std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
+            packet->payload.assign(pkt_ptr, pkt_ptr + pkt_len);
             PushPacketToDecodeQueue(std::move(packet), true);
         }
 
@@ -619,19 +917,32 @@ void AudioService::PlaySound(const std::string_view& ogg) {
     }
 }
 
+void AudioService::PlayPromptSound(const PromptSound& prompt) {
+    auto data = reinterpret_cast<const uint8_t*>(prompt.data);
+    for (uint16_t i = 0; i < prompt.packet_count; i++) {
+        auto packet = AcquireAudioStreamPacket();
+        packet->sample_rate = prompt.sample_rate;
+        packet->frame_duration = 60;
+        packet->static_payload = data + prompt.packets[i].offset;
+        packet->static_payload_size = prompt.packets[i].size;
+        PushPacketToDecodeQueue(std::move(packet), true);
+    }
+}
+
 bool AudioService::IsIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && jitter_buffer_.empty() &&
+        audio_playback_queue_.empty() && audio_testing_queue_.empty() && mixer_.available(kAudioMixerBusVoice) == 0;
 }
 
 void AudioService::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    // The decoder task may be decoding or replacing the decoder, it resets both itself
+    aec_aligner_.Reset();
+    audio_decode_queue_.Clear();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    mixer_.Clear(kAudioMixerBusVoice);
+    decoder_reset_ = true;
+    opus_decoder_waiter_.Signal();
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
@@ -685,6 +996,161 @@ bool AudioService::IsAfeWakeWord() {
 #endif
 }
 
+bool AudioService::PushMusicData(const int16_t* pcm, size_t samples) {
+    while (samples > 0) {
+        size_t written = mixer_.Write(kAudioMixerBusMusic, pcm, samples);
+        if (written > 0) {
+            pcm += written;
+            samples -= written;
+            audio_output_waiter_.Signal();
+            continue;
+        }
+        /* Wait for the speaker to take a frame, with a timeout in case the output is stopped */
+        size_t wanted = std::min<size_t>(samples, AUDIO_CODEC_DMA_FRAME_NUM);
+        music_space_waiter_.WaitFor([this, wanted]() {
+            return service_stopped_ || mixer_.space(kAudioMixerBusMusic) >= wanted;
+        }, 100 * 1000);
+        if (service_stopped_) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void AudioService::UpdateOutputTimestamp() {
     last_output_time_ = std::chrono::steady_clock::now();
-}
\ No newline at end of file
+}
+
+// Latency of the newest sample in the output frame: the samples still inside the processor were read before the last feed.
+// Returns -1 while the counters do not add up (right after a restart).
+int64_t AudioService::RecordProcessorLatency(size_t output_samples) {
+    uint64_t output = processor_output_samples_ += output_samples;
+    uint64_t input = processor_input_samples_;
+    if (input < output) {
+        return -1;
+    }
+    int64_t backlog_us = (input - output) * 1000000 / 16000;
+    int64_t latency_us = esp_timer_get_time() - last_processor_feed_us_ + backlog_us;
+    latency_tracker_.Record(kLatencyStageProcessor, latency_us);
+    return latency_us;
+}
+
+void AudioService::PrintStatistics() {
+    DebugStatistics stats = debug_statistics_;
+    uint32_t decoded = stats.decode_count - last_statistics_.decode_count;
+    uint32_t encoded = stats.encode_count - last_statistics_.encode_count;
+    uint32_t decode_avg_us = decoded > 0 ? (stats.decode_time_us - last_statistics_.decode_time_us) / decoded : 0;
+    uint32_t encode_avg_us = encoded > 0 ? (stats.encode_time_us - last_statistics_.encode_time_us) / encoded : 0;
+    ESP_LOGI(TAG, "decoder: %" PRIu32 " frames avg %" PRIu32 " us max %" PRIu32 " us, dropped %" PRIu32 " errors %" PRIu32 ", stack free %u",
+        decoded, decode_avg_us, stats.decode_max_us, stats.decode_dropped - last_statistics_.decode_dropped,
+        stats.decode_errors - last_statistics_.decode_errors,
+        opus_decoder_task_handle_ ? uxTaskGetStackHighWaterMark(opus_decoder_task_handle_) : 0);
+    ESP_LOGI(TAG, "encoder: %" PRIu32 " frames avg %" PRIu32 " us max %" PRIu32 " us, dropped %" PRIu32 " errors %" PRIu32 ", stack free %u, complexity %d (cpu %d%%)",
+        encoded, encode_avg_us, stats.encode_max_us, stats.encode_dropped - last_statistics_.encode_dropped,
+        stats.encode_errors - last_statistics_.encode_errors,
+        opus_encoder_task_handle_ ? uxTaskGetStackHighWaterMark(opus_encoder_task_handle_) : 0,
+        complexity_governor_.complexity(), complexity_governor_.cpu_load());
+    last_statistics_ = stats;
+
+    JitterBufferStatistics jitter = jitter_buffer_.statistics();
+    ESP_LOGI(TAG, "jitter buffer: jitter %d ms target %d ms, received %" PRIu32 " reordered %" PRIu32 " late %" PRIu32 " concealed %" PRIu32 " rebuffered %" PRIu32 "",
+        jitter_buffer_.jitter_ms(), jitter_buffer_.target_frames() * jitter_buffer_.frame_duration_ms(),
+        jitter.received - last_jitter_statistics_.received, jitter.reordered - last_jitter_statistics_.reordered,
+        jitter.late - last_jitter_statistics_.late, jitter.concealed - last_jitter_statistics_.concealed,
+        jitter.rebuffered - last_jitter_statistics_.rebuffered);
+    last_jitter_statistics_ = jitter;
+
+    auto latency = latency_tracker_.GetSummary();
+    if (!latency.empty()) {
+        ESP_LOGI(TAG, "latency ms (avg/p90/max): %s", latency.c_str());
+    }
+#if CONFIG_USE_SERVER_AEC
+    if (aec_aligner_.drift_known()) {
+        ESP_LOGI(TAG, "server AEC: downlink clock drift %d ppm", aec_aligner_.drift_ppm());
+    } else {
+        ESP_LOGI(TAG, "server AEC: downlink clock drift not known yet");
+    }
+#endif
+
+    uint32_t packet_allocations = GetAudioStreamPacketPool().allocations();
+    uint32_t task_allocations = audio_task_pool_.allocations();
+    ESP_LOGI(TAG, "pool allocations: packets +%" PRIu32 " (%" PRIu32 "), tasks +%" PRIu32 " (%" PRIu32 ")",
+        packet_allocations - last_packet_allocations_, packet_allocations,
+        task_allocations - last_task_allocations_, task_allocations);
+    last_packet_allocations_ = packet_allocations;
+    last_task_allocations_ = task_allocations;
+}
+
+std::string AudioService::GetStatisticsJson() {
+    DebugStatistics stats = debug_statistics_;
+    cJSON* root = cJSON_CreateObject();
+
+    cJSON* frames = cJSON_CreateObject();
+    cJSON_AddNumberToObject(frames, "input", stats.input_count);
+    cJSON_AddNumberToObject(frames, "encode", stats.encode_count);
+    cJSON_AddNumberToObject(frames, "decode", stats.decode_count);
+    cJSON_AddNumberToObject(frames, "playback", stats.playback_count);
+    cJSON_AddItemToObject(root, "frames", frames);
+
+    cJSON* encoder = cJSON_CreateObject();
+    cJSON_AddNumberToObject(encoder, "avg_us", stats.encode_count > 0 ? stats.encode_time_us / stats.encode_count : 0);
+    cJSON_AddNumberToObject(encoder, "max_us", stats.encode_max_us);
+    cJSON_AddNumberToObject(encoder, "errors", stats.encode_errors);
+    cJSON_AddNumberToObject(encoder, "dropped", stats.encode_dropped);
+    cJSON_AddNumberToObject(encoder, "frame_duration_ms", frame_duration_ms_.load());
+    cJSON_AddNumberToObject(encoder, "complexity", complexity_governor_.complexity());
+    cJSON_AddNumberToObject(encoder, "complexity_changes", complexity_governor_.changes());
+    cJSON_AddNumberToObject(encoder, "cpu_load", complexity_governor_.cpu_load());
+    cJSON_AddNumberToObject(encoder, "encode_load", complexity_governor_.encode_load());
+    cJSON_AddNumberToObject(encoder, "stack_free", opus_encoder_task_handle_ ? uxTaskGetStackHighWaterMark(opus_encoder_task_handle_) : 0);
+    cJSON_AddItemToObject(root, "encoder", encoder);
+
+    cJSON* decoder = cJSON_CreateObject();
+    cJSON_AddNumberToObject(decoder, "avg_us", stats.decode_count > 0 ? stats.decode_time_us / stats.decode_count : 0);
+    cJSON_AddNumberToObject(decoder, "max_us", stats.decode_max_us);
+    cJSON_AddNumberToObject(decoder, "errors", stats.decode_errors);
+    cJSON_AddNumberToObject(decoder, "dropped", stats.decode_dropped);
+    cJSON_AddNumberToObject(decoder, "stack_free", opus_decoder_task_handle_ ? uxTaskGetStackHighWaterMark(opus_decoder_task_handle_) : 0);
+    cJSON_AddItemToObject(root, "decoder", decoder);
+
+    cJSON* queue_peaks = cJSON_CreateObject();
+    cJSON_AddNumberToObject(queue_peaks, "encode", audio_encode_queue_.peak());
+    cJSON_AddNumberToObject(queue_peaks, "send", audio_send_queue_.peak());
+    cJSON_AddNumberToObject(queue_peaks, "decode", audio_decode_queue_.peak());
+    cJSON_AddNumberToObject(queue_peaks, "playback", audio_playback_queue_.peak());
+    cJSON_AddNumberToObject(queue_peaks, "testing", audio_testing_queue_.peak());
+    cJSON_AddItemToObject(root, "queue_peaks", queue_peaks);
+
+    cJSON* allocations = cJSON_CreateObject();
+    cJSON_AddNumberToObject(allocations, "packets", GetAudioStreamPacketPool().allocations());
+    cJSON_AddNumberToObject(allocations, "tasks", audio_task_pool_.allocations());
+    cJSON_AddItemToObject(root, "pool_allocations", allocations);
+
+    JitterBufferStatistics jitter = jitter_buffer_.statistics();
+    cJSON* jitter_buffer = cJSON_CreateObject();
+    cJSON_AddNumberToObject(jitter_buffer, "jitter_ms", jitter_buffer_.jitter_ms());
+    cJSON_AddNumberToObject(jitter_buffer, "target_ms", jitter_buffer_.target_frames() * jitter_buffer_.frame_duration_ms());
+    cJSON_AddNumberToObject(jitter_buffer, "received", jitter.received);
+    cJSON_AddNumberToObject(jitter_buffer, "reordered", jitter.reordered);
+    cJSON_AddNumberToObject(jitter_buffer, "late", jitter.late);
+    cJSON_AddNumberToObject(jitter_buffer, "concealed", jitter.concealed);
+    cJSON_AddNumberToObject(jitter_buffer, "skipped", jitter.skipped);
+    cJSON_AddNumberToObject(jitter_buffer, "rebuffered", jitter.rebuffered);
+    cJSON_AddItemToObject(root, "jitter_buffer", jitter_buffer);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void AudioService::ResetStatisticsPeaks() {
+    audio_encode_queue_.ResetPeak();
+    audio_send_queue_.ResetPeak();
+    audio_decode_queue_.ResetPeak();
+    audio_playback_queue_.ResetPeak();
+    audio_testing_queue_.ResetPeak();
+    debug_statistics_.encode_max_us = 0;
+    debug_statistics_.decode_max_us = 0;
+}
@@ -2,10 +2,9 @@
 #define AUDIO_SERVICE_H
 
 #include <memory>
-#include <deque>
-#include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -22,40 +21,83 @@
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
+#include "spsc_queue.h"
+#include "object_pool.h"
+#include "jitter_buffer.h"
+#include "latency_tracker.h"
+#include "prompt_sound.h"
+#include "complexity_governor.h"
+#include "audio_mixer.h"
+#include "input_distributor.h"
+#include "endpointer.h"
+#include "aec_aligner.h"
 
 
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Jitter Buffer] -> [Opus Decoder] -> {Playback Queue} -> [Mixer] -> (Speaker)
+ *    (Music) -> [Mixer], ducked while voice plays
  *
- * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ * We use one task for MIC / Processors, one for Speaker, and separate tasks for the Opus Encoder and
+ * the Opus Decoder, so a slow encode never delays the next decode.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
+ *
+ * Every queue is a fixed-capacity SPSC ring. Each task owns one QueueWaiter, so pushing to a queue
+ * only wakes the task that consumes it. Queues with more than one producer serialize their
+ * producers with a dedicated mutex that the consumer never touches.
  * 
  */
 
-#define OPUS_FRAME_DURATION_MS 60
+// Default uplink frame duration, the active one may change between audio channels (see SetFrameDuration)
+#define OPUS_FRAME_DURATION_MS CONFIG_OPUS_FRAME_DURATION_MS
+#define OPUS_MIN_FRAME_DURATION_MS 20
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
-#define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
-#define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+#define MAX_DECODE_DURATION_IN_QUEUE_MS 2400
+#define MAX_SEND_DURATION_IN_QUEUE_MS 2400
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
-#define MAX_TIMESTAMPS_IN_QUEUE 3
+// Queue capacities fit the shortest frames, the limits in use are derived from the active frame durations
+#define MAX_DECODE_PACKETS_IN_QUEUE (MAX_DECODE_DURATION_IN_QUEUE_MS / OPUS_MIN_FRAME_DURATION_MS)
+#define MAX_SEND_PACKETS_IN_QUEUE (MAX_SEND_DURATION_IN_QUEUE_MS / OPUS_MIN_FRAME_DURATION_MS)
+#define MAX_TESTING_PACKETS_IN_QUEUE (AUDIO_TESTING_MAX_DURATION_MS / OPUS_MIN_FRAME_DURATION_MS)
+// Tasks in the encode / playback queues plus the ones being processed
+#define AUDIO_TASK_POOL_SIZE (MAX_ENCODE_TASKS_IN_QUEUE + MAX_PLAYBACK_TASKS_IN_QUEUE + 2)
+// Packets held outside the queues: by the encoder, the decoder, the protocol and a prompt being queued
+#define AUDIO_STREAM_PACKETS_IN_HAND 4
+// Packets that can be in flight at once: both packet queues at their limits for the shortest frames, a full
+// jitter buffer and the ones in hand. The audio testing recording is not covered, it is a one-off diagnostic.
+#define AUDIO_STREAM_PACKET_POOL_SIZE (MAX_DECODE_PACKETS_IN_QUEUE + MAX_SEND_PACKETS_IN_QUEUE + \
+    JitterBuffer::GetSlotCount(CONFIG_JITTER_BUFFER_MAX_FRAMES) + AUDIO_STREAM_PACKETS_IN_HAND)
+// Packets allocated up front: a full downlink of 60 ms frames (what the servers send), the jitter buffer and
+// the ones in hand. Deeper queues grow the pool on first use and it keeps them from then on.
+#define AUDIO_STREAM_PACKET_POOL_RESERVE (MAX_DECODE_DURATION_IN_QUEUE_MS / 60 + \
+    JitterBuffer::GetSlotCount(CONFIG_JITTER_BUFFER_MAX_FRAMES) + AUDIO_STREAM_PACKETS_IN_HAND)
 
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
+// The voice bus takes a whole decoded frame (120 ms at 48 kHz at most) on top of the frame being played,
+// the music bus a few codec frames so the music producer is paced by the speaker
+#define AUDIO_MIXER_VOICE_SAMPLES 8192
+#define AUDIO_MIXER_MUSIC_SAMPLES (AUDIO_CODEC_DMA_FRAME_NUM * 4)
+// 16 kHz input frames shared by the input consumers, the largest chunk (60 ms testing frames) plus a few reads
+#define AUDIO_INPUT_RING_FRAMES 2048
+#define AUDIO_INPUT_TAP_TIMEOUT_MS 100
 
 
 #define AS_EVENT_AUDIO_TESTING_RUNNING      (1 << 0)
 #define AS_EVENT_WAKE_WORD_RUNNING          (1 << 1)
 #define AS_EVENT_AUDIO_PROCESSOR_RUNNING    (1 << 2)
 #define AS_EVENT_PLAYBACK_NOT_EMPTY         (1 << 3)
+#define AS_EVENT_INPUT_TAP_RUNNING          (1 << 4)
 
 struct AudioServiceCallbacks {
     std::function<void(void)> on_send_queue_available;
     std::function<void(const std::string&)> on_wake_word_detected;
     std::function<void(bool)> on_vad_change;
     std::function<void(void)> on_audio_testing_queue_full;
+    // Early endpointing decided the user has finished speaking, called from the audio processor task
+    std::function<void(void)> on_endpoint;
 };
 
 
@@ -69,13 +111,27 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    int sample_rate = 0;  // Rate of decoded pcm, 0 if it is already at the codec output rate
+    int64_t time_us = 0;  // Monotonic time the frame entered its current stage, for latency statistics
 };
 
+using AudioTaskPool = ObjectPool<AudioTask>;
+using AudioTaskPtr = AudioTaskPool::Handle;
+
 struct DebugStatistics {
     uint32_t input_count = 0;
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    // Per-direction codec cost, written only by the owning codec task
+    uint32_t decode_errors = 0;
+    uint32_t encode_errors = 0;
+    uint32_t decode_dropped = 0;
+    uint32_t encode_dropped = 0;
+    uint64_t decode_time_us = 0;
+    uint64_t encode_time_us = 0;
+    uint32_t decode_max_us = 0;
+    uint32_t encode_max_us = 0;
 };
 
 class AudioService {
@@ -87,7 +143,7 @@ public:
     void Start();
     void Stop();
     void EncodeWakeWord();
-    std::unique_ptr<AudioStreamPacket> PopWakeWordPacket();
+    AudioStreamPacketPtr PopWakeWordPacket();
     const std::string& GetLastWakeWord() const;
     bool IsVoiceDetected() const { return voice_detected_; }
     bool IsIdle();
@@ -102,18 +158,40 @@ public:
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
-    bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
-    std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    bool PushPacketToDecodeQueue(AudioStreamPacketPtr packet, bool wait = false);
+    AudioStreamPacketPtr PopPacketFromSendQueue();
     void PlaySound(const std::string_view& sound);
+    // Reads the codec directly, only for the input task or while it is not running
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
+    // The input tap shares the mic reads of the input task with a consumer in another task
+    void EnableInputTap(bool enable);
+    // Blocks for the next 16 kHz chunk of the tap (all input channels), false on timeout or when disabled
+    bool ReadInputTap(std::vector<int16_t>& data, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
     void UpdateOutputTimestamp();
     void WriteAudioData(std::vector<int16_t>& pcm);
+    // Queues mono music at the codec output rate for mixing, blocks while the music bus is full.
+    // Returns false if the service stopped.
+    bool PushMusicData(const int16_t* pcm, size_t samples);
+    bool IsMusicDucked() const { return mixer_.ducking(); }
     
     // Set the duration for how long ES7210 stays on before entering low power
     void SetAudioPowerTimeout(uint32_t timeout_ms) { audio_power_timeout_ms_ = timeout_ms; }
 
+    // Log codec cost, stage latencies and how many packets / tasks had to be allocated since the last call
+    void PrintStatistics();
+    LatencyTracker& GetLatencyTracker() { return latency_tracker_; }
+    // Counters, codec cost, queue high-water marks and pool allocations as JSON, for regression tracking
+    std::string GetStatisticsJson();
+    void ResetStatisticsPeaks();
+
+    // Uplink frame duration (20, 40 or 60 ms), applied from the next voice processing start
+    void SetFrameDuration(int frame_duration_ms);
+    int frame_duration_ms() const { return frame_duration_ms_; }
+    // Pick the frame duration of the next audio channel from the hello round trip time and the downlink loss
+    void AdaptFrameDuration(int rtt_ms);
+
 private:
     AudioCodec* codec_ = nullptr;
     AudioServiceCallbacks callbacks_;
@@ -125,6 +203,16 @@ private:
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
     OpusResampler output_resampler_;
+    // Scratch buffers of ReadAudioData, only used by the input task
+    std::vector<int16_t> mic_scratch_;
+    std::vector<int16_t> reference_scratch_;
+    std::vector<int16_t> resampled_mic_scratch_;
+    std::vector<int16_t> resampled_reference_scratch_;
+    InputDistributor input_distributor_;
+    // Chunks handed to the input consumers of the input task, they keep their capacity
+    std::vector<int16_t> testing_chunk_;
+    std::vector<int16_t> wake_word_chunk_;
+    std::vector<int16_t> processor_chunk_;
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
 
@@ -133,21 +221,56 @@ private:
     // Audio encode / decode
     TaskHandle_t audio_input_task_handle_ = nullptr;
     TaskHandle_t audio_output_task_handle_ = nullptr;
-    TaskHandle_t opus_codec_task_handle_ = nullptr;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    TaskHandle_t opus_encoder_task_handle_ = nullptr;
+    TaskHandle_t opus_decoder_task_handle_ = nullptr;
+    QueueWaiter opus_encoder_waiter_;
+    QueueWaiter opus_decoder_waiter_;
+    QueueWaiter audio_output_waiter_;
+    QueueWaiter encode_space_waiter_;
+    QueueWaiter decode_space_waiter_;
+    std::mutex encode_producer_mutex_;
+    std::mutex decode_producer_mutex_;
+    SpscQueue<AudioStreamPacketPtr> audio_decode_queue_;
+    SpscQueue<AudioStreamPacketPtr> audio_send_queue_;
+    SpscQueue<AudioStreamPacketPtr> audio_testing_queue_;
+    SpscQueue<AudioTaskPtr> audio_encode_queue_;
+    SpscQueue<AudioTaskPtr> audio_playback_queue_;
+    AudioTaskPool audio_task_pool_;
+    AudioMixer mixer_;
+    QueueWaiter music_space_waiter_;
+    // Owned by the decoder task, other tasks only request a reset
+    JitterBuffer jitter_buffer_;
+    ComplexityGovernor complexity_governor_;
+    // Set by ResetDecoder(), the decoder task then resets the jitter buffer and the Opus decoder
+    std::atomic<bool> decoder_reset_ = false;
+    JitterBufferStatistics last_jitter_statistics_;
+    // Owned by the audio processor task
+    Endpointer endpointer_;
+
+    // Latency statistics
+    LatencyTracker latency_tracker_;
+    std::atomic<uint64_t> processor_input_samples_ = 0;
+    std::atomic<uint64_t> processor_output_samples_ = 0;
+    std::atomic<int64_t> last_processor_feed_us_ = 0;
+    std::atomic<int64_t> speech_end_time_us_ = 0;
+    std::atomic<int64_t> response_speech_end_us_ = 0;
+    // Owned by the output task
+    int resampler_input_rate_ = 0;
+    int resampler_output_rate_ = 0;
+    std::vector<int16_t> voice_scratch_;
+    std::atomic<int> frame_duration_ms_ = OPUS_FRAME_DURATION_MS;
+    std::atomic<int> decode_frame_duration_ms_ = 60;
+    JitterBufferStatistics adapt_jitter_statistics_;
+    uint32_t last_packet_allocations_ = 0;
+    uint32_t last_task_allocations_ = 0;
+    DebugStatistics last_statistics_;
     // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    AecAligner aec_aligner_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
-    bool service_stopped_ = true;
+    std::atomic<bool> service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
     uint32_t audio_power_timeout_ms_ = 15000;
 
@@ -156,11 +279,18 @@ private:
     std::chrono::steady_clock::time_point last_output_time_;
 
     void AudioInputTask();
+    void FeedInputConsumers(EventBits_t bits);
     void AudioOutputTask();
-    void OpusCodecTask();
-    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void OpusEncoderTask();
+    void OpusDecoderTask();
+    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, uint32_t timestamp = 0);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
+    int64_t RecordProcessorLatency(size_t output_samples);
+    void PlayPromptSound(const PromptSound& prompt);
+    size_t GetMaxSendPackets() const { return MAX_SEND_DURATION_IN_QUEUE_MS / frame_duration_ms_; }
+    size_t GetMaxDecodePackets() const { return MAX_DECODE_DURATION_IN_QUEUE_MS / decode_frame_duration_ms_; }
+    size_t GetMaxTestingPackets() const { return AUDIO_TESTING_MAX_DURATION_MS / frame_duration_ms_; }
 };
 
 #endif
\ No newline at end of file
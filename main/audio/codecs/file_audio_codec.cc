@@ -0,0 +1,203 @@
+#include "file_audio_codec.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "FileAudioCodec"
+
+#define WAV_HEADER_SIZE 44
+// Pacing restarts instead of catching up when the pipeline falls this far behind (e.g. input was disabled)
+#define PACING_MAX_LAG_US 200000
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t ReadLe16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static void WriteLe32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static void WriteLe16(uint8_t* p, uint16_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+FileAudioCodec::FileAudioCodec(const std::string& input_path, const std::string& output_path, int output_sample_rate, bool realtime)
+    : output_path_(output_path), realtime_(realtime) {
+    duplex_ = true;
+    input_reference_ = false;
+    input_channels_ = 1;
+    input_sample_rate_ = 16000;
+    output_sample_rate_ = output_sample_rate;
+
+    if (!input_path.empty() && !OpenInput(input_path)) {
+        ESP_LOGE(TAG, "Failed to open input %s, using silence", input_path.c_str());
+    }
+}
+
+FileAudioCodec::~FileAudioCodec() {
+    Shutdown();
+}
+
+bool FileAudioCodec::OpenInput(const std::string& path) {
+    input_file_ = fopen(path.c_str(), "rb");
+    if (input_file_ == nullptr) {
+        return false;
+    }
+
+    uint8_t riff[12];
+    if (fread(riff, 1, sizeof(riff), input_file_) != sizeof(riff) ||
+        memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "%s is not a WAV file", path.c_str());
+        fclose(input_file_);
+        input_file_ = nullptr;
+        return false;
+    }
+
+    /* Walk the chunks until the data chunk, the fmt chunk comes before it */
+    bool has_format = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), input_file_) == sizeof(chunk)) {
+        uint32_t chunk_size = ReadLe32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t format[16];
+            if (chunk_size < sizeof(format) || fread(format, 1, sizeof(format), input_file_) != sizeof(format)) {
+                break;
+            }
+            uint16_t audio_format = ReadLe16(format);
+            uint16_t channels = ReadLe16(format + 2);
+            uint16_t bits_per_sample = ReadLe16(format + 14);
+            if (audio_format != 1 || bits_per_sample != 16 || channels < 1 || channels > 2) {
+                ESP_LOGE(TAG, "Unsupported WAV format %u, %u channels, %u bits", audio_format, channels, bits_per_sample);
+                break;
+            }
+            input_sample_rate_ = ReadLe32(format + 4);
+            input_channels_ = channels;
+            input_reference_ = channels == 2;
+            has_format = true;
+            fseek(input_file_, chunk_size - sizeof(format) + (chunk_size & 1), SEEK_CUR);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!has_format) {
+                break;
+            }
+            input_data_remaining_ = chunk_size;
+            ESP_LOGI(TAG, "Input %s: %d Hz, %d channels, %lu ms", path.c_str(), input_sample_rate_, input_channels_,
+                (unsigned long)((uint64_t)chunk_size * 1000 / (input_sample_rate_ * input_channels_ * sizeof(int16_t))));
+            return true;
+        } else {
+            fseek(input_file_, chunk_size + (chunk_size & 1), SEEK_CUR);
+        }
+    }
+
+    fclose(input_file_);
+    input_file_ = nullptr;
+    input_sample_rate_ = 16000;
+    input_channels_ = 1;
+    input_reference_ = false;
+    return false;
+}
+
+void FileAudioCodec::WriteOutputHeader() {
+    uint8_t header[WAV_HEADER_SIZE];
+    memcpy(header, "RIFF", 4);
+    WriteLe32(header + 4, 36 + output_data_size_);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    WriteLe32(header + 16, 16);
+    WriteLe16(header + 20, 1);
+    WriteLe16(header + 22, output_channels_);
+    WriteLe32(header + 24, output_file_sample_rate_);
+    WriteLe32(header + 28, output_file_sample_rate_ * output_channels_ * sizeof(int16_t));
+    WriteLe16(header + 32, output_channels_ * sizeof(int16_t));
+    WriteLe16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    WriteLe32(header + 40, output_data_size_);
+
+    fseek(output_file_, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), output_file_);
+    fseek(output_file_, 0, SEEK_END);
+}
+
+// Sleep until the frames handed over so far are due, like a real codec blocking on its DMA buffers
+void FileAudioCodec::Pace(int64_t& start_time, uint64_t& frames, int sample_rate, int new_frames) {
+    if (!realtime_) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (frames == 0 || now - (start_time + (int64_t)(frames * 1000000 / sample_rate)) > PACING_MAX_LAG_US) {
+        start_time = now;
+        frames = 0;
+    }
+    frames += new_frames;
+    int64_t due = start_time + (int64_t)(frames * 1000000 / sample_rate);
+    if (due > now) {
+        vTaskDelay(pdMS_TO_TICKS((due - now) / 1000));
+    }
+}
+
+int FileAudioCodec::Read(int16_t* dest, int samples) {
+    size_t bytes = 0;
+    if (input_file_ != nullptr && input_data_remaining_ > 0) {
+        size_t wanted = std::min<size_t>(samples * sizeof(int16_t), input_data_remaining_);
+        bytes = fread(dest, 1, wanted, input_file_);
+        input_data_remaining_ = bytes < wanted ? 0 : input_data_remaining_ - bytes;
+    }
+    if (bytes < samples * sizeof(int16_t)) {
+        if (!input_finished_) {
+            ESP_LOGI(TAG, "End of input reached");
+            input_finished_ = true;
+        }
+        memset((uint8_t*)dest + bytes, 0, samples * sizeof(int16_t) - bytes);
+    }
+
+    Pace(input_start_time_, input_frames_, input_sample_rate_, samples / input_channels_);
+    return samples;
+}
+
+int FileAudioCodec::Write(const int16_t* data, int samples) {
+    if (output_path_.empty()) {
+        Pace(output_start_time_, output_frames_, output_sample_rate_, samples / output_channels_);
+        return samples;
+    }
+
+    if (output_file_ == nullptr) {
+        output_file_ = fopen(output_path_.c_str(), "wb");
+        if (output_file_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to open output %s", output_path_.c_str());
+            output_path_.clear();
+            return samples;
+        }
+        output_file_sample_rate_ = output_sample_rate_;
+        WriteOutputHeader();
+    } else if (output_sample_rate_ != output_file_sample_rate_ && output_sample_rate_ != output_rate_warned_) {
+        ESP_LOGW(TAG, "Output sample rate changed to %d, the WAV file stays at %d", output_sample_rate_, output_file_sample_rate_);
+        output_rate_warned_ = output_sample_rate_;
+    }
+
+    output_data_size_ += fwrite(data, 1, samples * sizeof(int16_t), output_file_);
+    Pace(output_start_time_, output_frames_, output_sample_rate_, samples / output_channels_);
+    return samples;
+}
+
+void FileAudioCodec::Shutdown() {
+    if (input_file_ != nullptr) {
+        fclose(input_file_);
+        input_file_ = nullptr;
+    }
+    if (output_file_ != nullptr) {
+        WriteOutputHeader();
+        fclose(output_file_);
+        output_file_ = nullptr;
+        ESP_LOGI(TAG, "Recorded %lu bytes to %s", (unsigned long)output_data_size_.load(), output_path_.c_str());
+    }
+}
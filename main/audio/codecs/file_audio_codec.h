@@ -0,0 +1,52 @@
+#ifndef _FILE_AUDIO_CODEC_H
+#define _FILE_AUDIO_CODEC_H
+
+#include "audio_codec.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+/*
+ * Replays the microphone from a 16-bit PCM WAV file and records the speaker to another.
+ *
+ * A mono input file behaves like a codec without reference, a stereo one like a codec
+ * with the reference on the second channel (input_channels 2, input_reference true).
+ * Input and output are paced at real time, or run as fast as the pipeline can go when
+ * realtime is false. After the end of the input file, Read() returns silence.
+ */
+class FileAudioCodec : public AudioCodec {
+private:
+    FILE* input_file_ = nullptr;
+    FILE* output_file_ = nullptr;
+    std::string output_path_;
+    bool realtime_;
+    bool input_finished_ = false;
+    uint32_t input_data_remaining_ = 0;
+    std::atomic<uint32_t> output_data_size_{0};    // Bytes, also read by recorded_samples()
+    int output_file_sample_rate_ = 0;
+    int output_rate_warned_ = 0;
+
+    int64_t input_start_time_ = 0;
+    uint64_t input_frames_ = 0;
+    int64_t output_start_time_ = 0;
+    uint64_t output_frames_ = 0;
+
+    bool OpenInput(const std::string& path);
+    void WriteOutputHeader();
+    void Pace(int64_t& start_time, uint64_t& frames, int sample_rate, int new_frames);
+
+    virtual int Read(int16_t* dest, int samples) override;
+    virtual int Write(const int16_t* data, int samples) override;
+
+public:
+    FileAudioCodec(const std::string& input_path, const std::string& output_path, int output_sample_rate, bool realtime = true);
+    virtual ~FileAudioCodec();
+
+    virtual void Shutdown() override;
+    inline bool input_finished() const { return input_finished_; }
+    // Samples written to the output file so far, safe to poll from another task
+    inline size_t recorded_samples() const { return output_data_size_ / sizeof(int16_t); }
+};
+
+#endif // _FILE_AUDIO_CODEC_H
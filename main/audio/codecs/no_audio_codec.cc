@@ -1,8 +1,10 @@
 #include "no_audio_codec.h"
+#include "audio_kernels.h"
 
 #include <esp_log.h>
 #include <cmath>
 #include <cstring>
+#include <algorithm>
 
 #define TAG "NoAudioCodec"
 
@@ -214,43 +216,57 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
     ESP_LOGI(TAG, "Simplex channels created");
 }
 
-int NoAudioCodec::Write(const int16_t* data, int samples) {
-    std::lock_guard<std::mutex> lock(data_if_mutex_);
-    std::vector<int32_t> buffer(samples);
-
+void NoAudioCodec::UpdateVolumeFactor() {
     // output_volume_: 0-100
     // volume_factor_: 0-65536
-    int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
-    for (int i = 0; i < samples; i++) {
-        int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
-        if (temp > INT32_MAX) {
-            buffer[i] = INT32_MAX;
-        } else if (temp < INT32_MIN) {
-            buffer[i] = INT32_MIN;
-        } else {
-            buffer[i] = static_cast<int32_t>(temp);
-        }
+    int volume = std::clamp(output_volume_, 0, 100);
+    volume_factor_ = pow(double(volume) / 100.0, 2) * AUDIO_VOLUME_FACTOR_ONE;
+}
+
+void NoAudioCodec::SetOutputVolume(int volume) {
+    AudioCodec::SetOutputVolume(volume);
+    UpdateVolumeFactor();
+}
+
+void NoAudioCodec::Start() {
+    AudioCodec::Start();
+    UpdateVolumeFactor();
+}
+
+int NoAudioCodec::Write(const int16_t* data, int samples) {
+    std::lock_guard<std::mutex> lock(data_if_mutex_);
+    // Scale into a buffer of one DMA frame at a time instead of allocating one for the whole write
+    if (write_buffer_.empty()) {
+        write_buffer_.resize(AUDIO_CODEC_DMA_FRAME_NUM * output_channels_);
     }
 
-    size_t bytes_written;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
-    return bytes_written / sizeof(int32_t);
+    int32_t volume_factor = volume_factor_;
+    size_t total_written = 0;
+    for (int offset = 0; offset < samples; offset += write_buffer_.size()) {
+        int count = std::min<int>(samples - offset, write_buffer_.size());
+        ScaleToInt32(data + offset, write_buffer_.data(), count, volume_factor);
+
+        size_t bytes_written;
+        ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, write_buffer_.data(), count * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+        total_written += bytes_written;
+    }
+    return total_written / sizeof(int32_t);
 }
 
 int NoAudioCodec::Read(int16_t* dest, int samples) {
     size_t bytes_read;
 
-    std::vector<int32_t> bit32_buffer(samples);
-    if (i2s_channel_read(rx_handle_, bit32_buffer.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+    // The input task reads the same frame size every time, so the buffer only grows once
+    if (read_buffer_.size() < (size_t)samples) {
+        read_buffer_.resize(samples);
+    }
+    if (i2s_channel_read(rx_handle_, read_buffer_.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
         ESP_LOGE(TAG, "Read Failed!");
         return 0;
     }
 
     samples = bytes_read / sizeof(int32_t);
-    for (int i = 0; i < samples; i++) {
-        int32_t value = bit32_buffer[i] >> 12;
-        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
-    }
+    ShiftToInt16(read_buffer_.data(), dest, samples, 12);
     return samples;
 }
 
@@ -5,17 +5,26 @@
 
 #include <driver/gpio.h>
 #include <driver/i2s_pdm.h>
+#include <atomic>
 #include <mutex>
 
 class NoAudioCodec : public AudioCodec {
 protected:
     std::mutex data_if_mutex_;
+    std::vector<int32_t> write_buffer_;
+    std::vector<int32_t> read_buffer_;
+    // Q16 gain of the output volume, recomputed only when the volume changes
+    std::atomic<int32_t> volume_factor_ = 0;
 
+    void UpdateVolumeFactor();
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
 
 public:
     virtual ~NoAudioCodec();
+
+    virtual void SetOutputVolume(int volume) override;
+    virtual void Start() override;
 };
 
 class NoAudioCodecDuplex : public NoAudioCodec {
@@ -0,0 +1,89 @@
+#include "complexity_governor.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+
+#define TAG "ComplexityGovernor"
+
+#define GOVERNOR_WINDOW_US 1000000
+// A window much longer than this means the encoder was idle, its load says nothing about now
+#define GOVERNOR_STALE_WINDOW_US (3 * GOVERNOR_WINDOW_US)
+#define GOVERNOR_HIGH_CPU_LOAD 85
+#define GOVERNOR_HIGH_ENCODE_LOAD 35
+#define GOVERNOR_LOW_CPU_LOAD 60
+#define GOVERNOR_LOW_ENCODE_LOAD 15
+// Quiet windows in a row before stepping up, and windows a new level is kept at least
+#define GOVERNOR_QUIET_WINDOWS 5
+#define GOVERNOR_HOLD_WINDOWS 3
+
+ComplexityGovernor::ComplexityGovernor(int min_complexity, int max_complexity)
+    : min_complexity_(std::clamp(min_complexity, 0, 10)),
+      max_complexity_(std::clamp(max_complexity, min_complexity_, 10)),
+      complexity_(min_complexity_) {
+}
+
+// Idle task run time of all cores since the last call, the run time counters tick in microseconds (esp_timer)
+uint64_t ComplexityGovernor::UpdateIdleTime() {
+    uint64_t idle_us = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        configRUN_TIME_COUNTER_TYPE counter = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        idle_us += (configRUN_TIME_COUNTER_TYPE)(counter - idle_start_[core]);
+        idle_start_[core] = counter;
+    }
+    return idle_us;
+}
+
+void ComplexityGovernor::RecordEncode(int64_t encode_us, int frame_duration_ms) {
+    encode_us_ += encode_us;
+    frame_us_ += frame_duration_ms * 1000;
+}
+
+bool ComplexityGovernor::Update(int64_t now_us) {
+    int64_t elapsed_us = now_us - window_start_us_;
+    if (elapsed_us < GOVERNOR_WINDOW_US) {
+        return false;
+    }
+
+    uint64_t idle_us = UpdateIdleTime();
+    bool stale = window_start_us_ == 0 || elapsed_us > GOVERNOR_STALE_WINDOW_US || frame_us_ == 0;
+    int cpu_load = 100 - (int)(idle_us * 100 / (elapsed_us * portNUM_PROCESSORS));
+    int encode_load = frame_us_ > 0 ? encode_us_ * 100 / frame_us_ : 0;
+    window_start_us_ = now_us;
+    encode_us_ = 0;
+    frame_us_ = 0;
+    if (stale) {
+        return false;
+    }
+
+    cpu_load = std::clamp(cpu_load, 0, 100);
+    cpu_load_ = cpu_load;
+    encode_load_ = encode_load;
+
+    if (hold_windows_ > 0) {
+        hold_windows_--;
+    }
+    int complexity = complexity_;
+    int next = complexity;
+    if (cpu_load > GOVERNOR_HIGH_CPU_LOAD || encode_load > GOVERNOR_HIGH_ENCODE_LOAD) {
+        quiet_windows_ = 0;
+        next = std::max(complexity - 1, min_complexity_);
+    } else if (cpu_load < GOVERNOR_LOW_CPU_LOAD && encode_load < GOVERNOR_LOW_ENCODE_LOAD) {
+        if (++quiet_windows_ >= GOVERNOR_QUIET_WINDOWS && hold_windows_ == 0) {
+            quiet_windows_ = 0;
+            next = std::min(complexity + 1, max_complexity_);
+        }
+    } else {
+        quiet_windows_ = 0;
+    }
+
+    if (next == complexity) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Encoder complexity %d -> %d (cpu %d%%, encode %d%% of frame time)", complexity, next, cpu_load, encode_load);
+    complexity_ = next;
+    changes_++;
+    hold_windows_ = GOVERNOR_HOLD_WINDOWS;
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef COMPLEXITY_GOVERNOR_H
+#define COMPLEXITY_GOVERNOR_H
+
+#include <freertos/FreeRTOS.h>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Picks the uplink Opus encoder complexity from the encode time per frame and the CPU load.
+ *
+ * Every second of encoding, the governor compares the share of the frame time spent in the
+ * encoder and the load of all cores (from the idle task run time counters) with two sets of
+ * thresholds. Above the high ones it steps the complexity down at once. It only steps up after
+ * several quiet windows in a row below the low ones, and holds every new level for a while,
+ * so the complexity does not oscillate.
+ *
+ * Called from the encoder task only; the getters may be read from any task.
+ */
+class ComplexityGovernor {
+public:
+    ComplexityGovernor(int min_complexity, int max_complexity);
+
+    void RecordEncode(int64_t encode_us, int frame_duration_ms);
+    // Returns true when the complexity changed
+    bool Update(int64_t now_us);
+
+    inline int complexity() const { return complexity_.load(); }
+    // Percent of all cores busy, and percent of the frame time spent encoding, in the last window
+    inline int cpu_load() const { return cpu_load_.load(); }
+    inline int encode_load() const { return encode_load_.load(); }
+    inline uint32_t changes() const { return changes_.load(); }
+
+private:
+    int min_complexity_;
+    int max_complexity_;
+    std::atomic<int> complexity_;
+    std::atomic<int> cpu_load_ = 0;
+    std::atomic<int> encode_load_ = 0;
+    std::atomic<uint32_t> changes_ = 0;
+
+    int64_t window_start_us_ = 0;
+    configRUN_TIME_COUNTER_TYPE idle_start_[portNUM_PROCESSORS] = {};
+    int64_t encode_us_ = 0;
+    int64_t frame_us_ = 0;
+    int quiet_windows_ = 0;
+    int hold_windows_ = 0;
+
+    uint64_t UpdateIdleTime();
+};
+
+#endif // COMPLEXITY_GOVERNOR_H
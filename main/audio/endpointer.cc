@@ -0,0 +1,74 @@
+#include "endpointer.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <algorithm>
+
+#define TAG "Endpointer"
+
+#define ENDPOINTER_SAMPLE_RATE 16000
+
+void Endpointer::Configure(const EndpointerConfig& config) {
+    config_ = config;
+    config_.max_hangover_ms = std::max(config_.max_hangover_ms, config_.hangover_ms);
+    decay_ratio_ = std::pow(10.0f, -config_.decay_db / 10.0f);
+    configured_ = true;
+    ESP_LOGI(TAG, "Early endpointing: min speech %d ms, hangover %d-%d ms, decay %d dB, VAD min noise %d ms",
+        config_.min_speech_ms, config_.hangover_ms, config_.max_hangover_ms, config_.decay_db, config_.vad_min_noise_ms);
+    Reset();
+}
+
+void Endpointer::Reset() {
+    fired_ = false;
+    speech_ms_ = 0;
+    silence_ms_ = 0;
+    quiet_ms_ = 0;
+    loud_since_silence_ = false;
+    peak_energy_ = 0.0f;
+}
+
+bool Endpointer::Process(const int16_t* pcm, size_t samples, bool speaking) {
+    if (!configured_ || fired_ || samples == 0) {
+        return false;
+    }
+
+    int frame_ms = samples * 1000 / ENDPOINTER_SAMPLE_RATE;
+    int64_t sum = 0;
+    for (size_t i = 0; i < samples; i++) {
+        sum += int32_t(pcm[i]) * pcm[i];
+    }
+    float energy = float(sum) / samples;
+
+    if (speaking) {
+        speech_ms_ += frame_ms;
+        silence_ms_ = 0;
+        quiet_ms_ = 0;
+        loud_since_silence_ = false;
+        peak_energy_ = std::max(peak_energy_, energy);
+        return false;
+    }
+    if (speech_ms_ < config_.min_speech_ms) {
+        return false;
+    }
+
+    silence_ms_ += frame_ms;
+    if (energy > peak_energy_ * decay_ratio_) {
+        quiet_ms_ = 0;
+        loud_since_silence_ = true;
+    } else {
+        quiet_ms_ += frame_ms;
+    }
+
+    /* The VAD reported silence only after vad_min_noise_ms of it, credited until a loud frame breaks the decay */
+    int trailing_ms = silence_ms_ + config_.vad_min_noise_ms;
+    int quiet_trailing_ms = quiet_ms_ + (loud_since_silence_ ? 0 : config_.vad_min_noise_ms);
+    bool decayed = quiet_trailing_ms >= config_.hangover_ms;
+    if (!decayed && trailing_ms < config_.max_hangover_ms) {
+        return false;
+    }
+
+    fired_ = true;
+    ESP_LOGI(TAG, "End of utterance after %d ms of speech, %d ms trailing silence (%s)", speech_ms_, trailing_ms,
+        decayed ? "energy decayed" : "max hangover");
+    return true;
+}
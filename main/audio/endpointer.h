@@ -0,0 +1,47 @@
+#ifndef ENDPOINTER_H
+#define ENDPOINTER_H
+
+#include <cstdint>
+#include <cstddef>
+
+struct EndpointerConfig {
+    int min_speech_ms;      // Speech needed before an end is looked for, so clicks and coughs do not end the turn
+    int hangover_ms;        // Trailing silence that ends the utterance once the energy has decayed
+    int max_hangover_ms;    // Trailing silence that ends it regardless of the energy
+    int decay_db;           // How far below the loudest speech frame counts as decayed
+    int vad_min_noise_ms;   // Noise the VAD needs before it reports silence, already part of the trailing silence
+};
+
+/*
+ * Decides on the device when the user has finished speaking, ahead of the server.
+ *
+ * It runs on the processed 16 kHz frames together with the VAD state of the audio processor.
+ * After enough speech, the trailing silence is counted from the VAD silence event, plus the
+ * vad_min_noise_ms the VAD waited before reporting it. The utterance ends after the short
+ * hangover if every frame since has decayed decay_db below the loudest speech frame, or after
+ * the long hangover otherwise (weak speech, steady noise). A frame the VAD reports as speech
+ * starts over. It fires once until Reset().
+ */
+class Endpointer {
+public:
+    Endpointer() = default;
+
+    // Until configured, Process() never fires
+    void Configure(const EndpointerConfig& config);
+    void Reset();
+    // Feeds one frame with the current VAD state, returns true once when the utterance has ended
+    bool Process(const int16_t* pcm, size_t samples, bool speaking);
+
+private:
+    bool configured_ = false;
+    EndpointerConfig config_ = {};
+    float decay_ratio_ = 0.0f;
+    bool fired_ = false;
+    int speech_ms_ = 0;
+    int silence_ms_ = 0;
+    int quiet_ms_ = 0;
+    bool loud_since_silence_ = false;
+    float peak_energy_ = 0.0f;
+};
+
+#endif // ENDPOINTER_H
@@ -0,0 +1,100 @@
+#include "input_distributor.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "InputDistributor"
+
+static const char* const kConsumerNames[kInputConsumerCount] = { "testing", "wake word", "processor", "tap" };
+
+InputDistributor::InputDistributor(size_t capacity_frames)
+    : capacity_frames_(capacity_frames) {
+    samples_.resize(capacity_frames_ * channels_);
+}
+
+void InputDistributor::SetChannels(int channels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    channels_ = std::max(channels, 1);
+    samples_.assign(capacity_frames_ * channels_, 0);
+    write_ = 0;
+    for (auto& consumer : consumers_) {
+        consumer.read = 0;
+    }
+}
+
+void InputDistributor::Enable(InputConsumer consumer, bool enable) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Consumer& c = consumers_[consumer];
+        if (enable && !c.enabled) {
+            c.read = write_;
+            c.overruns = 0;
+        }
+        c.enabled = enable;
+    }
+    waiter_.Signal();
+}
+
+bool InputDistributor::enabled(InputConsumer consumer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return consumers_[consumer].enabled;
+}
+
+size_t InputDistributor::available(InputConsumer consumer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return write_ - consumers_[consumer].read;
+}
+
+void InputDistributor::Write(const int16_t* data, size_t frames) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (frames > capacity_frames_) {
+            data += (frames - capacity_frames_) * channels_;
+            write_ += frames - capacity_frames_;
+            frames = capacity_frames_;
+        }
+
+        uint32_t oldest = write_ + frames - capacity_frames_;
+        for (int i = 0; i < kInputConsumerCount; i++) {
+            Consumer& c = consumers_[i];
+            if (c.enabled && (int32_t)(oldest - c.read) > 0) {
+                if (c.overruns++ == 0) {
+                    ESP_LOGW(TAG, "The %s consumer fell behind, skipped %lu frames", kConsumerNames[i], (unsigned long)(oldest - c.read));
+                }
+                c.read = oldest;
+            }
+        }
+
+        /* At most two copies, before and after the end of the ring */
+        size_t offset = write_ % capacity_frames_;
+        size_t first = std::min(frames, capacity_frames_ - offset);
+        memcpy(samples_.data() + offset * channels_, data, first * channels_ * sizeof(int16_t));
+        memcpy(samples_.data(), data + first * channels_, (frames - first) * channels_ * sizeof(int16_t));
+        write_ += frames;
+    }
+    waiter_.Signal();
+}
+
+bool InputDistributor::Read(InputConsumer consumer, std::vector<int16_t>& data, size_t frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Consumer& c = consumers_[consumer];
+    if (!c.enabled || frames == 0 || frames > capacity_frames_ || write_ - c.read < frames) {
+        return false;
+    }
+
+    data.resize(frames * channels_);
+    size_t offset = c.read % capacity_frames_;
+    size_t first = std::min(frames, capacity_frames_ - offset);
+    memcpy(data.data(), samples_.data() + offset * channels_, first * channels_ * sizeof(int16_t));
+    memcpy(data.data() + first * channels_, samples_.data(), (frames - first) * channels_ * sizeof(int16_t));
+    c.read += frames;
+    return true;
+}
+
+bool InputDistributor::WaitRead(InputConsumer consumer, std::vector<int16_t>& data, size_t frames, int64_t timeout_us) {
+    waiter_.WaitFor([this, consumer, frames]() {
+        return !enabled(consumer) || available(consumer) >= frames;
+    }, timeout_us);
+    return Read(consumer, data, frames);
+}
@@ -0,0 +1,65 @@
+#ifndef INPUT_DISTRIBUTOR_H
+#define INPUT_DISTRIBUTOR_H
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include "spsc_queue.h"
+
+enum InputConsumer {
+    kInputConsumerTesting,
+    kInputConsumerWakeWord,
+    kInputConsumerProcessor,
+    kInputConsumerTap,          // Pulled from outside the input task, e.g. the AFSK Wi-Fi config demodulator
+    kInputConsumerCount,
+};
+
+/*
+ * Shares every mic read between the input consumers.
+ *
+ * The input task reads the codec once per DMA period and writes the 16 kHz frames (all input
+ * channels, interleaved) into one ring. Each consumer keeps its own read position and pulls
+ * chunks of its own size, so the wake word and the audio processor can run at the same time
+ * on the same audio. A consumer starts at the newest frame when it is enabled. One that falls
+ * behind by more than the ring skips ahead to the oldest frame still stored.
+ */
+class InputDistributor {
+public:
+    explicit InputDistributor(size_t capacity_frames);
+
+    InputDistributor(const InputDistributor&) = delete;
+    InputDistributor& operator=(const InputDistributor&) = delete;
+
+    // Drops everything stored, the ring keeps its capacity in frames
+    void SetChannels(int channels);
+    void Enable(InputConsumer consumer, bool enable);
+    bool enabled(InputConsumer consumer);
+    size_t available(InputConsumer consumer);
+
+    void Write(const int16_t* data, size_t frames);
+    // Copies the next chunk of the consumer into data, false while fewer frames are stored
+    bool Read(InputConsumer consumer, std::vector<int16_t>& data, size_t frames);
+    // Same as Read, but waits up to timeout_us for the chunk, for consumers outside the input task
+    bool WaitRead(InputConsumer consumer, std::vector<int16_t>& data, size_t frames, int64_t timeout_us);
+
+    inline int channels() const { return channels_; }
+
+private:
+    struct Consumer {
+        bool enabled = false;
+        uint32_t read = 0;          // Frames
+        uint32_t overruns = 0;
+    };
+
+    std::mutex mutex_;
+    QueueWaiter waiter_;
+    std::vector<int16_t> samples_;
+    size_t capacity_frames_;
+    int channels_ = 1;
+    uint32_t write_ = 0;            // Frames
+    Consumer consumers_[kInputConsumerCount];
+};
+
+#endif // INPUT_DISTRIBUTOR_H
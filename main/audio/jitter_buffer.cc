@@ -0,0 +1,199 @@
+#include "jitter_buffer.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdlib>
+
+#define TAG "JitterBuffer"
+
+// A sequence number this far away from the playout position starts a new stream
+#define MAX_SEQUENCE_DISTANCE 1000
+
+
+JitterBuffer::JitterBuffer(int min_frames, int max_frames, int jitter_multiplier)
+    : slots_(GetSlotCount(max_frames)),
+      min_frames_(min_frames),
+      max_frames_(std::max(min_frames, max_frames)),
+      jitter_multiplier_(jitter_multiplier),
+      target_frames_(min_frames) {
+}
+
+void JitterBuffer::Put(AudioStreamPacketPtr packet, int64_t now_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    statistics_.received++;
+    if (packet->frame_duration > 0) {
+        frame_duration_us_ = packet->frame_duration * 1000;
+    }
+
+    bool sequenced = packet->sequence != 0;
+    uint32_t sequence = sequenced ? packet->sequence : last_sequence_ + 1;
+    if (sequence == 0) {
+        sequence = 1;
+    }
+    if (!has_sequence_) {
+        has_sequence_ = true;
+        next_sequence_ = sequence;
+        last_sequence_ = sequence - 1;
+    }
+
+    int32_t distance = static_cast<int32_t>(sequence - next_sequence_);
+    if (std::abs(distance) > MAX_SEQUENCE_DISTANCE) {
+        ESP_LOGI(TAG, "Sequence jumped from %" PRIu32 " to %" PRIu32 ", starting a new stream", next_sequence_, sequence);
+        Clear();
+        statistics_.resynced++;
+        has_sequence_ = true;
+        next_sequence_ = sequence;
+        last_sequence_ = sequence - 1;
+        distance = 0;
+    }
+
+    if (distance < 0) {
+        // Before playout starts an early reordered packet can still move the start back
+        if (!playing_ && static_cast<int32_t>(last_sequence_ - sequence) < static_cast<int32_t>(slots_.size())) {
+            next_sequence_ = sequence;
+        } else {
+            statistics_.late++;
+            return;
+        }
+    } else if (distance >= static_cast<int32_t>(slots_.size())) {
+        // Too far ahead for the window, give up on the oldest frames
+        DropBefore(sequence - slots_.size() + 1);
+    }
+
+    Slot& slot = slots_[sequence % slots_.size()];
+    if (slot.packet && slot.sequence == sequence) {
+        statistics_.duplicated++;
+        return;
+    }
+
+    if (sequenced) {
+        if (static_cast<int32_t>(sequence - last_sequence_) < 0) {
+            statistics_.reordered++;
+        }
+        UpdateJitter(sequence, now_us);
+    }
+    if (static_cast<int32_t>(sequence - last_sequence_) > 0) {
+        last_sequence_ = sequence;
+    }
+
+    if (count_ == 0) {
+        if (playing_) {
+            // Ran dry, build up the target delay again
+            playing_ = false;
+            statistics_.rebuffered++;
+        }
+        buffering_since_us_ = now_us;
+    }
+    slot.packet = std::move(packet);
+    slot.sequence = sequence;
+    count_++;
+}
+
+JitterBuffer::Result JitterBuffer::Get(AudioStreamPacketPtr& packet) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == 0) {
+        return kJitterBufferEmpty;
+    }
+    if (!playing_) {
+        SkipToOldest();
+        playing_ = true;
+    }
+
+    Slot& slot = slots_[next_sequence_ % slots_.size()];
+    if (slot.packet && slot.sequence == next_sequence_) {
+        packet = std::move(slot.packet);
+        count_--;
+        next_sequence_++;
+        concealed_in_row_ = 0;
+        return kJitterBufferPacket;
+    }
+
+    /* The next frame is missing but later ones are here */
+    next_sequence_++;
+    statistics_.concealed++;
+    if (++concealed_in_row_ > max_frames_) {
+        // Stop concealing a long gap, jump to the oldest buffered packet
+        SkipToOldest();
+        concealed_in_row_ = 0;
+        statistics_.resynced++;
+    }
+    return kJitterBufferConceal;
+}
+
+bool JitterBuffer::IsReady(int64_t now_us) const {
+    if (count_ == 0) {
+        return false;
+    }
+    if (playing_ || count_ >= static_cast<size_t>(target_frames_)) {
+        return true;
+    }
+    return now_us - buffering_since_us_ >= static_cast<int64_t>(target_frames_) * frame_duration_us_;
+}
+
+int64_t JitterBuffer::GetWaitTime(int64_t now_us) const {
+    if (count_ == 0 || playing_) {
+        return -1;
+    }
+    if (IsReady(now_us)) {
+        return 0;
+    }
+    return buffering_since_us_ + static_cast<int64_t>(target_frames_) * frame_duration_us_ - now_us;
+}
+
+JitterBufferStatistics JitterBuffer::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+}
+
+void JitterBuffer::Reset() {
+    Clear();
+    last_sequence_ = 0;
+}
+
+void JitterBuffer::UpdateJitter(uint32_t sequence, int64_t now_us) {
+    int64_t transit = now_us - static_cast<int64_t>(sequence) * frame_duration_us_;
+    if (has_transit_) {
+        int64_t delta = std::abs(transit - last_transit_us_);
+        jitter_us_ += (delta - jitter_us_) / 16;
+    }
+    last_transit_us_ = transit;
+    has_transit_ = true;
+
+    int frames = (jitter_us_ * jitter_multiplier_ + frame_duration_us_ - 1) / frame_duration_us_;
+    target_frames_ = std::clamp(frames, min_frames_, max_frames_);
+}
+
+void JitterBuffer::DropBefore(uint32_t sequence) {
+    while (static_cast<int32_t>(sequence - next_sequence_) > 0) {
+        Slot& slot = slots_[next_sequence_ % slots_.size()];
+        if (slot.packet && slot.sequence == next_sequence_) {
+            slot.packet.reset();
+            count_--;
+            statistics_.late++;
+        }
+        next_sequence_++;
+    }
+}
+
+void JitterBuffer::SkipToOldest() {
+    for (uint32_t i = 0; i < slots_.size(); i++) {
+        auto& candidate = slots_[(next_sequence_ + i) % slots_.size()];
+        if (candidate.packet && candidate.sequence == next_sequence_ + i) {
+            next_sequence_ += i;
+            statistics_.skipped += i;
+            return;
+        }
+    }
+}
+
+void JitterBuffer::Clear() {
+    for (auto& slot : slots_) {
+        slot.packet.reset();
+    }
+    count_ = 0;
+    playing_ = false;
+    has_sequence_ = false;
+    has_transit_ = false;
+    concealed_in_row_ = 0;
+}
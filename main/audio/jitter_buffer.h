@@ -0,0 +1,101 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "protocol.h"
+
+struct JitterBufferStatistics {
+    uint32_t received = 0;
+    uint32_t reordered = 0;
+    uint32_t late = 0;
+    uint32_t duplicated = 0;
+    uint32_t concealed = 0;
+    uint32_t skipped = 0;   // Missing frames given up without concealment
+    uint32_t rebuffered = 0;
+    uint32_t resynced = 0;
+};
+
+/*
+ * Puts downlink packets back in sequence order and paces them to the decoder.
+ *
+ * Packets without a sequence number (WebSocket, local sounds) are numbered on arrival and
+ * pass straight through. Playout starts once target_frames() packets are buffered or the
+ * oldest one has waited for the target delay, and restarts the same way after the buffer
+ * ran dry. The target follows the arrival jitter (RFC 3550 estimator) times a multiplier,
+ * clamped to [min_frames, max_frames]. A hole in front of later packets is returned as
+ * kJitterBufferConceal so the decoder can run packet loss concealment instead of skipping.
+ * When playout (re)starts, the frames missing in front of the oldest packet have had the
+ * target delay to arrive; they are skipped, so a loss burst does not add to the latency.
+ *
+ * Owned by the decoder task; only empty() and statistics() may be called from other tasks.
+ */
+class JitterBuffer {
+public:
+    enum Result {
+        kJitterBufferEmpty,
+        kJitterBufferPacket,
+        kJitterBufferConceal,
+    };
+
+    JitterBuffer(int min_frames, int max_frames, int jitter_multiplier);
+
+    // Packets a buffer built with max_frames can hold
+    static constexpr size_t GetSlotCount(int max_frames) { return std::max(2 * max_frames, 8); }
+
+    void Put(AudioStreamPacketPtr packet, int64_t now_us);
+    Result Get(AudioStreamPacketPtr& packet);
+    bool IsReady(int64_t now_us) const;
+    // Time until IsReady() turns true without further packets, or -1 if it only changes when a packet arrives
+    int64_t GetWaitTime(int64_t now_us) const;
+    void Reset();
+
+    inline bool full() const { return count_.load() >= slots_.size(); }
+    inline bool empty() const { return count_.load() == 0; }
+    inline size_t count() const { return count_.load(); }
+    inline int target_frames() const { return target_frames_; }
+    inline int jitter_ms() const { return jitter_us_ / 1000; }
+    inline int frame_duration_ms() const { return frame_duration_us_ / 1000; }
+    // A consistent snapshot, the counters keep changing in the decoder task
+    JitterBufferStatistics statistics() const;
+
+private:
+    struct Slot {
+        AudioStreamPacketPtr packet;
+        uint32_t sequence = 0;
+    };
+
+    std::vector<Slot> slots_;
+    std::atomic<size_t> count_ = 0;
+    int min_frames_;
+    int max_frames_;
+    int jitter_multiplier_;
+    int target_frames_;
+    int frame_duration_us_ = 60 * 1000;
+
+    bool playing_ = false;
+    bool has_sequence_ = false;
+    uint32_t next_sequence_ = 0;
+    uint32_t last_sequence_ = 0;
+    int concealed_in_row_ = 0;
+    int64_t buffering_since_us_ = 0;
+
+    bool has_transit_ = false;
+    int64_t last_transit_us_ = 0;
+    int64_t jitter_us_ = 0;
+    // Guards the statistics, taken by Put() and Get() which update them
+    mutable std::mutex mutex_;
+    JitterBufferStatistics statistics_;
+
+    void UpdateJitter(uint32_t sequence, int64_t now_us);
+    void DropBefore(uint32_t sequence);
+    void SkipToOldest();
+    void Clear();
+};
+
+#endif // JITTER_BUFFER_H
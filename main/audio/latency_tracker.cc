@@ -0,0 +1,121 @@
+#include "latency_tracker.h"
+
+#include <cJSON.h>
+#include <cstdio>
+
+static const char* const kStageNames[kLatencyStageCount] = {
+    "processor",
+    "encode",
+    "send",
+    "response",
+    "decode",
+    "playback",
+    "end_to_end",
+};
+
+const char* LatencyTracker::GetStageName(LatencyStage stage) {
+    return kStageNames[stage];
+}
+
+int LatencyTracker::GetBucketLimitMs(int bucket) {
+    return 5 << bucket;
+}
+
+void LatencyTracker::Record(LatencyStage stage, int64_t latency_us) {
+    if (latency_us < 0) {
+        return;
+    }
+    auto& histogram = histograms_[stage];
+    int bucket = 0;
+    while (bucket < kBucketCount - 1 && latency_us >= GetBucketLimitMs(bucket) * 1000) {
+        bucket++;
+    }
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.total_us += latency_us;
+
+    uint32_t latency = latency_us > UINT32_MAX ? UINT32_MAX : latency_us;
+    uint32_t max_us = histogram.max_us.load();
+    while (latency > max_us && !histogram.max_us.compare_exchange_weak(max_us, latency)) {
+    }
+}
+
+void LatencyTracker::Reset() {
+    for (auto& histogram : histograms_) {
+        for (auto& bucket : histogram.buckets) {
+            bucket = 0;
+        }
+        histogram.count = 0;
+        histogram.total_us = 0;
+        histogram.max_us = 0;
+    }
+}
+
+// Upper limit of the bucket that holds the percentile, the last bucket reports the maximum
+int LatencyTracker::GetPercentileMs(const Histogram& histogram, int percent) {
+    uint32_t count = histogram.count;
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t rank = (count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < kBucketCount - 1; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            return GetBucketLimitMs(i);
+        }
+    }
+    return histogram.max_us / 1000;
+}
+
+std::string LatencyTracker::GetSummary() const {
+    std::string summary;
+    char buffer[64];
+    for (int i = 0; i < kLatencyStageCount; i++) {
+        auto& histogram = histograms_[i];
+        uint32_t count = histogram.count;
+        if (count == 0) {
+            continue;
+        }
+        snprintf(buffer, sizeof(buffer), "%s%s %lu/%d/%lu", summary.empty() ? "" : ", ", kStageNames[i],
+            (unsigned long)(histogram.total_us / count / 1000), GetPercentileMs(histogram, 90),
+            (unsigned long)(histogram.max_us / 1000));
+        summary += buffer;
+    }
+    return summary;
+}
+
+std::string LatencyTracker::GetJson() const {
+    cJSON* root = cJSON_CreateObject();
+    for (int i = 0; i < kLatencyStageCount; i++) {
+        auto& histogram = histograms_[i];
+        uint32_t count = histogram.count;
+        cJSON* stage = cJSON_CreateObject();
+        cJSON_AddNumberToObject(stage, "count", count);
+        cJSON_AddNumberToObject(stage, "avg_ms", count > 0 ? histogram.total_us / count / 1000 : 0);
+        cJSON_AddNumberToObject(stage, "p50_ms", GetPercentileMs(histogram, 50));
+        cJSON_AddNumberToObject(stage, "p90_ms", GetPercentileMs(histogram, 90));
+        cJSON_AddNumberToObject(stage, "p99_ms", GetPercentileMs(histogram, 99));
+        cJSON_AddNumberToObject(stage, "max_ms", histogram.max_us / 1000);
+
+        // "<limit in ms>": count, the last bucket is ">2560"
+        cJSON* buckets = cJSON_CreateObject();
+        for (int j = 0; j < kBucketCount; j++) {
+            char name[16];
+            if (j < kBucketCount - 1) {
+                snprintf(name, sizeof(name), "<%d", GetBucketLimitMs(j));
+            } else {
+                snprintf(name, sizeof(name), ">=%d", GetBucketLimitMs(j - 1));
+            }
+            cJSON_AddNumberToObject(buckets, name, histogram.buckets[j]);
+        }
+        cJSON_AddItemToObject(stage, "histogram", buckets);
+        cJSON_AddItemToObject(root, kStageNames[i], stage);
+    }
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
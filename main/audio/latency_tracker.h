@@ -0,0 +1,53 @@
+#ifndef LATENCY_TRACKER_H
+#define LATENCY_TRACKER_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+enum LatencyStage {
+    kLatencyStageProcessor,   // Mic read -> audio processor output
+    kLatencyStageEncode,      // Audio processor output -> Opus packet encoded
+    kLatencyStageSend,        // Opus packet encoded -> handed to the protocol
+    kLatencyStageResponse,    // End of speech (VAD) -> first downlink packet received
+    kLatencyStageDecode,      // Downlink packet received -> decoded, including the jitter buffer delay
+    kLatencyStagePlayback,    // Decoded -> written to the codec
+    kLatencyStageEndToEnd,    // End of speech (VAD) -> first response sample written to the codec
+    kLatencyStageCount,
+};
+
+/*
+ * Per-stage latency histograms of the voice pipeline.
+ *
+ * Buckets double from 5 ms up to 2.56 s, the last one takes everything above.
+ * Record() is lock-free and may be called from any audio task.
+ */
+class LatencyTracker {
+public:
+    static constexpr int kBucketCount = 11;
+
+    void Record(LatencyStage stage, int64_t latency_us);
+    void Reset();
+
+    // One line with the average / 90th percentile / maximum of every stage, in milliseconds
+    std::string GetSummary() const;
+    // Counts, averages, percentiles and histogram buckets of every stage
+    std::string GetJson() const;
+
+    static const char* GetStageName(LatencyStage stage);
+
+private:
+    struct Histogram {
+        std::atomic<uint32_t> buckets[kBucketCount] = {};
+        std::atomic<uint32_t> count = 0;
+        std::atomic<uint64_t> total_us = 0;
+        std::atomic<uint32_t> max_us = 0;
+    };
+
+    Histogram histograms_[kLatencyStageCount];
+
+    static int GetBucketLimitMs(int bucket);
+    static int GetPercentileMs(const Histogram& histogram, int percent);
+};
+
+#endif // LATENCY_TRACKER_H
@@ -0,0 +1,121 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * A recycling pool for objects that are created on every audio frame.
+ *
+ * Acquire() hands out a Handle (a unique_ptr with a recycling deleter). When the
+ * handle is destroyed the object is reset and kept for the next Acquire(), so the
+ * buffers it owns keep their capacity and the steady state does not touch the heap.
+ * A default-constructed Recycler deletes the object, which keeps handles built
+ * from plain `new` working.
+ */
+template <typename T>
+class ObjectPool {
+public:
+    class Recycler {
+    public:
+        Recycler() = default;
+        explicit Recycler(ObjectPool* pool) : pool_(pool) {}
+
+        void operator()(T* object) const {
+            if (pool_ != nullptr) {
+                pool_->Release(object);
+            } else {
+                delete object;
+            }
+        }
+
+    private:
+        ObjectPool* pool_ = nullptr;
+    };
+
+    using Handle = std::unique_ptr<T, Recycler>;
+
+    ObjectPool(size_t max_cached, std::function<void(T&)> on_create, std::function<void(T&)> on_recycle)
+        : max_cached_(max_cached), on_create_(on_create), on_recycle_(on_recycle) {
+        free_.reserve(max_cached_);
+    }
+
+    ~ObjectPool() {
+        for (auto object : free_) {
+            delete object;
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    Handle Acquire() {
+        T* object = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                object = free_.back();
+                free_.pop_back();
+            }
+        }
+        if (object == nullptr) {
+            object = new T();
+            if (on_create_) {
+                on_create_(*object);
+            }
+            allocations_++;
+        }
+        return Handle(object, Recycler(this));
+    }
+
+    // Allocate objects up front so that the first frames do not hit the heap either
+    void Reserve(size_t count) {
+        std::vector<Handle> handles;
+        handles.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            handles.push_back(Acquire());
+        }
+    }
+
+    // Number of released objects kept for reuse, the ones released beyond it are deleted
+    void SetMaxCached(size_t max_cached) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        max_cached_ = max_cached;
+        free_.reserve(max_cached_);
+        while (free_.size() > max_cached_) {
+            delete free_.back();
+            free_.pop_back();
+        }
+    }
+
+    inline uint32_t allocations() const { return allocations_.load(); }
+
+private:
+    size_t max_cached_;
+    std::function<void(T&)> on_create_;
+    std::function<void(T&)> on_recycle_;
+    std::mutex mutex_;
+    std::vector<T*> free_;
+    std::atomic<uint32_t> allocations_ = 0;
+
+    void Release(T* object) {
+        if (on_recycle_) {
+            on_recycle_(*object);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (free_.size() < max_cached_) {
+                free_.push_back(object);
+                return;
+            }
+        }
+        delete object;
+    }
+};
+
+#endif // OBJECT_POOL_H
@@ -0,0 +1,131 @@
+#include "polyphase_resampler.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+#define TAG "PolyphaseResampler"
+
+// Taps per phase at unity or higher ratios, scaled by M/L when decimating
+#define POLYPHASE_TAPS 24
+// Bounds the coefficient table to 32 KB; 11.025 kHz -> 16 kHz needs 640 x 24, 44.1 kHz -> 16 kHz 160 x 67
+#define POLYPHASE_MAX_COEFFICIENTS 16384
+#define POLYPHASE_COEFFICIENT_BITS 14
+// Pass band edge relative to the lower Nyquist frequency, and the Kaiser window shape (about 70 dB stop band)
+#define POLYPHASE_CUTOFF 0.91
+#define POLYPHASE_KAISER_BETA 7.0
+
+// Zeroth order modified Bessel function of the first kind
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+bool PolyphaseResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    if (input_sample_rate <= 0 || output_sample_rate <= 0) {
+        ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", input_sample_rate, output_sample_rate);
+        return false;
+    }
+    int divisor = std::gcd(input_sample_rate, output_sample_rate);
+    int interpolation = output_sample_rate / divisor;
+    int decimation = input_sample_rate / divisor;
+    int taps = POLYPHASE_TAPS * std::max(interpolation, decimation) / interpolation + 1;
+    if (interpolation * taps > POLYPHASE_MAX_COEFFICIENTS) {
+        ESP_LOGE(TAG, "Unsupported ratio %d -> %d (%d phases x %d taps)", input_sample_rate, output_sample_rate, interpolation, taps);
+        return false;
+    }
+
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    interpolation_ = interpolation;
+    decimation_ = decimation;
+    taps_ = taps;
+
+    /* Prototype low-pass at the upsampled rate, with a gain of L to make up for the inserted zeros */
+    int length = interpolation * taps;
+    double cutoff = POLYPHASE_CUTOFF * 0.5 / std::max(interpolation, decimation);
+    double center = (length - 1) / 2.0;
+    double window_scale = 1.0 / BesselI0(POLYPHASE_KAISER_BETA);
+    std::vector<double> prototype(length);
+    double sum = 0;
+    for (int n = 0; n < length; n++) {
+        double t = n - center;
+        double x = 2.0 * cutoff * t;
+        double sinc = x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+        double r = t / (center + 0.5);
+        prototype[n] = 2.0 * cutoff * sinc * BesselI0(POLYPHASE_KAISER_BETA * sqrt(std::max(0.0, 1.0 - r * r))) * window_scale;
+        sum += prototype[n];
+    }
+
+    /* Phase p tap k multiplies the input k samples before the current one */
+    coefficients_.resize(length);
+    double scale = interpolation * (1 << POLYPHASE_COEFFICIENT_BITS) / sum;
+    for (int p = 0; p < interpolation; p++) {
+        for (int k = 0; k < taps; k++) {
+            long value = lround(prototype[p + k * interpolation] * scale);
+            coefficients_[p * taps + k] = std::clamp<long>(value, INT16_MIN, INT16_MAX);
+        }
+    }
+
+    Reset();
+    ESP_LOGI(TAG, "Configured %d -> %d Hz, %d/%d, %d phases x %d taps", input_sample_rate, output_sample_rate,
+        interpolation, decimation, interpolation, taps);
+    return true;
+}
+
+void PolyphaseResampler::Reset() {
+    buffer_.assign(std::max(taps_ - 1, 0), 0);
+    phase_ = 0;
+    position_ = 0;
+}
+
+size_t PolyphaseResampler::GetOutputSamples(size_t samples) const {
+    return ((uint64_t)samples * interpolation_ + decimation_ - 1) / decimation_ + 1;
+}
+
+size_t PolyphaseResampler::Process(const int16_t* input, size_t samples, int16_t* output) {
+    if (coefficients_.empty()) {
+        return 0;
+    }
+
+    const size_t history = taps_ - 1;
+    buffer_.resize(history + samples);
+    memcpy(buffer_.data() + history, input, samples * sizeof(int16_t));
+
+    const int step = decimation_ / interpolation_;
+    const int step_phase = decimation_ % interpolation_;
+    size_t count = 0;
+    while (position_ < samples) {
+        const int16_t* x = buffer_.data() + history + position_;
+        const int16_t* c = coefficients_.data() + phase_ * taps_;
+        int32_t acc = 1 << (POLYPHASE_COEFFICIENT_BITS - 1);
+        for (int k = 0; k < taps_; k++) {
+            acc += int32_t(c[k]) * x[-k];
+        }
+        acc >>= POLYPHASE_COEFFICIENT_BITS;
+        output[count++] = std::clamp<int32_t>(acc, INT16_MIN, INT16_MAX);
+
+        position_ += step;
+        phase_ += step_phase;
+        if (phase_ >= interpolation_) {
+            phase_ -= interpolation_;
+            position_++;
+        }
+    }
+    position_ -= samples;
+
+    /* Keep the newest input as history for the next call, the capacity stays for the next packet */
+    memmove(buffer_.data(), buffer_.data() + samples, history * sizeof(int16_t));
+    buffer_.resize(history);
+    return count;
+}
@@ -0,0 +1,46 @@
+#ifndef POLYPHASE_RESAMPLER_H
+#define POLYPHASE_RESAMPLER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Mono resampler between arbitrary integer rates, for local music on the way to the codec.
+ *
+ * The rate ratio is reduced to L/M, and a Kaiser windowed sinc low-pass (cut off below the
+ * lower of the two Nyquist frequencies) is split into L phases of Q14 taps. When decimating,
+ * the phases get M/L times more taps so the filter keeps the same length in output samples.
+ * Every output sample is one phase dotted with the latest input samples. The last taps - 1
+ * input samples and the fractional position are kept between calls, so packets can be fed
+ * one by one without clicks at their boundaries.
+ *
+ * Not thread safe; owned by the caller feeding the samples.
+ */
+class PolyphaseResampler {
+public:
+    bool Configure(int input_sample_rate, int output_sample_rate);
+    // Forgets the filter history, e.g. before an unrelated stream
+    void Reset();
+
+    // Upper bound of the samples the next Process() call produces for `samples` input samples
+    size_t GetOutputSamples(size_t samples) const;
+    // Returns the number of samples written to output
+    size_t Process(const int16_t* input, size_t samples, int16_t* output);
+
+    inline int input_sample_rate() const { return input_sample_rate_; }
+    inline int output_sample_rate() const { return output_sample_rate_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int interpolation_ = 1;    // L
+    int decimation_ = 1;       // M
+    int taps_ = 0;             // Per phase
+    std::vector<int16_t> coefficients_;    // phase-major, taps per phase
+    std::vector<int16_t> buffer_;          // taps - 1 history samples, then the current input
+    int phase_ = 0;
+    size_t position_ = 0;                  // Input sample of the next output, relative to the current input
+};
+
+#endif // POLYPHASE_RESAMPLER_H
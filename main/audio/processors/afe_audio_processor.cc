@@ -1,5 +1,7 @@
 #include "afe_audio_processor.h"
 #include <esp_log.h>
+#include <cstring>
+#include <algorithm>
 
 #define PROCESSOR_RUNNING 0x01
 
@@ -14,9 +16,6 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
     codec_ = codec;
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 
-    // Pre-allocate output buffer capacity
-    output_buffer_.reserve(frame_samples_);
-
     int ref_num = codec_->input_reference() ? 1 : 0;
 
     std::string input_format;
@@ -40,7 +39,7 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
     afe_config_t* afe_config = afe_config_init(input_format.c_str(), NULL, AFE_TYPE_VC, AFE_MODE_HIGH_PERF);
     afe_config->aec_mode = AEC_MODE_VOIP_HIGH_PERF;
     afe_config->vad_mode = VAD_MODE_0;
-    afe_config->vad_min_noise_ms = 100;
+    afe_config->vad_min_noise_ms = CONFIG_VAD_MIN_NOISE_MS;
     if (vad_model_name != nullptr) {
         afe_config->vad_model_name = vad_model_name;
     }
@@ -66,6 +65,8 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms, srm
 
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
+    fetch_samples_ = afe_iface_->get_fetch_chunksize(afe_data_);
+    ResizeOutputRing();
     
     xTaskCreate([](void* arg) {
         auto this_ = (AfeAudioProcessor*)arg;
@@ -88,6 +89,49 @@ size_t AfeAudioProcessor::GetFeedSize() {
     return afe_iface_->get_feed_chunksize(afe_data_);
 }
 
+void AfeAudioProcessor::SetFrameDuration(int frame_duration_ms) {
+    int frame_samples = frame_duration_ms * 16000 / 1000;
+    if (frame_samples == frame_samples_) {
+        return;
+    }
+    frame_samples_ = frame_samples;
+    // Samples left over from the last session were cut for the old frame size
+    ResizeOutputRing();
+}
+
+// One frame plus one fetch always fits, so a fetch never waits for a frame to be taken out
+void AfeAudioProcessor::ResizeOutputRing() {
+    output_ring_.assign(frame_samples_ + fetch_samples_, 0);
+    ring_read_ = 0;
+    ring_write_ = 0;
+    frame_buffer_.reserve(frame_samples_);
+}
+
+void AfeAudioProcessor::WriteOutput(const int16_t* data, size_t samples) {
+    const size_t capacity = output_ring_.size();
+    while (samples > 0) {
+        /* At most two copies, before and after the end of the ring */
+        size_t count = std::min(samples, capacity - (ring_write_ - ring_read_));
+        size_t offset = ring_write_ % capacity;
+        size_t first = std::min(count, capacity - offset);
+        memcpy(output_ring_.data() + offset, data, first * sizeof(int16_t));
+        memcpy(output_ring_.data(), data + first, (count - first) * sizeof(int16_t));
+        ring_write_ += count;
+        data += count;
+        samples -= count;
+
+        while (ring_write_ - ring_read_ >= (uint32_t)frame_samples_) {
+            frame_buffer_.resize(frame_samples_);
+            offset = ring_read_ % capacity;
+            first = std::min<size_t>(frame_samples_, capacity - offset);
+            memcpy(frame_buffer_.data(), output_ring_.data() + offset, first * sizeof(int16_t));
+            memcpy(frame_buffer_.data() + first, output_ring_.data(), (frame_samples_ - first) * sizeof(int16_t));
+            ring_read_ += frame_samples_;
+            output_callback_(std::move(frame_buffer_));
+        }
+    }
+}
+
 void AfeAudioProcessor::Feed(std::vector<int16_t>&& data) {
     if (afe_data_ == nullptr) {
         return;
@@ -150,24 +194,7 @@ void AfeAudioProcessor::AudioProcessorTask() {
         }
 
         if (output_callback_) {
-            size_t samples = res->data_size / sizeof(int16_t);
-            
-            // Add data to buffer
-            output_buffer_.insert(output_buffer_.end(), res->data, res->data + samples);
-            
-            // Output complete frames when buffer has enough data
-            while (output_buffer_.size() >= frame_samples_) {
-                if (output_buffer_.size() == frame_samples_) {
-                    // If buffer size equals frame size, move the entire buffer
-                    output_callback_(std::move(output_buffer_));
-                    output_buffer_.clear();
-                    output_buffer_.reserve(frame_samples_);
-                } else {
-                    // If buffer size exceeds frame size, copy one frame and remove it
-                    output_callback_(std::vector<int16_t>(output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-                    output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
-                }
-            }
+            WriteOutput(res->data, res->data_size / sizeof(int16_t));
         }
     }
 }
@@ -19,6 +19,7 @@ public:
     ~AfeAudioProcessor();
 
     void Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) override;
+    void SetFrameDuration(int frame_duration_ms) override;
     void Feed(std::vector<int16_t>&& data) override;
     void Start() override;
     void Stop() override;
@@ -36,9 +37,17 @@ private:
     std::function<void(bool speaking)> vad_state_change_callback_;
     AudioCodec* codec_ = nullptr;
     int frame_samples_ = 0;
+    size_t fetch_samples_ = 0;
     bool is_speaking_ = false;
-    std::vector<int16_t> output_buffer_;
-
+    // Fixed-capacity ring of AFE output not yet cut into frames, positions count samples
+    std::vector<int16_t> output_ring_;
+    uint32_t ring_read_ = 0;
+    uint32_t ring_write_ = 0;
+    // Frame handed to the output callback, which may swap a recycled buffer back in
+    std::vector<int16_t> frame_buffer_;
+
+    void ResizeOutputRing();
+    void WriteOutput(const int16_t* data, size_t samples);
     void AudioProcessorTask();
 };
 
@@ -3,33 +3,69 @@
 
 #if CONFIG_USE_AUDIO_DEBUGGER
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
 #include <cstring>
 #include <string>
+#include <algorithm>
 #endif
 
 #define TAG "AudioDebugger"
 
+// Below the Ethernet MTU with the IP and UDP headers, so datagrams are never fragmented
+#define AUDIO_DEBUG_MAX_PAYLOAD 1400
+// Log one failed send out of this many
+#define AUDIO_DEBUG_DROP_LOG_INTERVAL 100
+
+#if CONFIG_USE_AUDIO_DEBUGGER
+static const int16_t kImaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t kImaIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const char* const kTapNames[kAudioDebugTapCount] = { "mic", "reference", "processed", "downlink" };
+#endif
+
 
 AudioDebugger::AudioDebugger() {
+}
+
+AudioDebugger::~AudioDebugger() {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (udp_sockfd_ >= 0) {
+        close(udp_sockfd_);
+        ESP_LOGI(TAG, "Closed UDP socket");
+    }
+#endif
+}
+
+void AudioDebugger::Open() {
 #if CONFIG_USE_AUDIO_DEBUGGER
     udp_sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
     if (udp_sockfd_ >= 0) {
         // 解析配置的服务器地址 "IP:PORT"
         std::string server_addr = CONFIG_AUDIO_DEBUG_UDP_SERVER;
         size_t colon_pos = server_addr.find(':');
-        
+
         if (colon_pos != std::string::npos) {
             std::string ip = server_addr.substr(0, colon_pos);
             int port = std::stoi(server_addr.substr(colon_pos + 1));
-            
+
             memset(&udp_server_addr_, 0, sizeof(udp_server_addr_));
             udp_server_addr_.sin_family = AF_INET;
             udp_server_addr_.sin_port = htons(port);
             inet_pton(AF_INET, ip.c_str(), &udp_server_addr_.sin_addr);
-            
+
             ESP_LOGI(TAG, "Initialized server address: %s", CONFIG_AUDIO_DEBUG_UDP_SERVER);
         } else {
             ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_AUDIO_DEBUG_UDP_SERVER);
@@ -42,27 +78,142 @@ AudioDebugger::AudioDebugger() {
 #endif
 }
 
-AudioDebugger::~AudioDebugger() {
+bool AudioDebugger::IsTapEnabled(AudioDebugTap tap) const {
 #if CONFIG_USE_AUDIO_DEBUGGER
-    if (udp_sockfd_ >= 0) {
-        close(udp_sockfd_);
-        ESP_LOGI(TAG, "Closed UDP socket");
+    switch (tap) {
+#if CONFIG_AUDIO_DEBUG_TAP_MIC
+        case kAudioDebugTapMic:
+#endif
+#if CONFIG_AUDIO_DEBUG_TAP_REFERENCE
+        case kAudioDebugTapReference:
+#endif
+#if CONFIG_AUDIO_DEBUG_TAP_PROCESSED
+        case kAudioDebugTapProcessed:
+#endif
+#if CONFIG_AUDIO_DEBUG_TAP_DOWNLINK
+        case kAudioDebugTapDownlink:
+#endif
+            return true;
+        default:
+            return false;
     }
+#else
+    return false;
 #endif
 }
 
-void AudioDebugger::Feed(const std::vector<int16_t>& data) {
+// Standard IMA-ADPCM, two samples per byte with the first one in the low nibble
+size_t AudioDebugger::EncodeAdpcm(TapState& state, const int16_t* data, size_t frames, int stride, uint8_t* output) {
+    size_t bytes = 0;
 #if CONFIG_USE_AUDIO_DEBUGGER
-    if (udp_sockfd_ >= 0) {
-        ssize_t sent = sendto(udp_sockfd_, data.data(), data.size() * sizeof(int16_t), 0,
-                             (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
-        if (sent < 0) {
-            ESP_LOGW(TAG, "Failed to send audio data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
+    int32_t predictor = state.predictor;
+    int step_index = state.step_index;
+    for (size_t i = 0; i < frames; i++) {
+        int step = kImaStepTable[step_index];
+        int diff = data[i * stride] - predictor;
+        uint8_t code = 0;
+        if (diff < 0) {
+            code = 8;
+            diff = -diff;
+        }
+
+        /* Quantize the difference and track the value the decoder will reconstruct */
+        int delta = step >> 3;
+        if (diff >= step) {
+            code |= 4;
+            diff -= step;
+            delta += step;
+        }
+        if (diff >= (step >> 1)) {
+            code |= 2;
+            diff -= step >> 1;
+            delta += step >> 1;
+        }
+        if (diff >= (step >> 2)) {
+            code |= 1;
+            delta += step >> 2;
+        }
+        predictor += (code & 8) ? -delta : delta;
+        predictor = std::clamp<int32_t>(predictor, INT16_MIN, INT16_MAX);
+        step_index = std::clamp(step_index + kImaIndexTable[code], 0, 88);
+
+        if (i & 1) {
+            output[bytes++] |= code << 4;
         } else {
-            ESP_LOGD(TAG, "Sent %d bytes audio data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
+            output[bytes] = code;
         }
     }
+    if (frames & 1) {
+        bytes++;
+    }
+    state.predictor = predictor;
+    state.step_index = step_index;
 #endif
+    return bytes;
 }
 
- 
\ No newline at end of file
+void AudioDebugger::Feed(AudioDebugTap tap, const int16_t* data, size_t frames, int sample_rate, int stride) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (!IsTapEnabled(tap) || frames == 0) {
+        return;
+    }
+    std::call_once(open_flag_, [this]() { Open(); });
+    if (udp_sockfd_ < 0) {
+        return;
+    }
+
+    TapState& state = taps_[tap];
+    int64_t time_us = esp_timer_get_time() - (int64_t)frames * 1000000 / sample_rate;
+#if CONFIG_AUDIO_DEBUG_ADPCM
+    const uint8_t format = AUDIO_DEBUG_FORMAT_IMA_ADPCM;
+    const size_t max_frames = (AUDIO_DEBUG_MAX_PAYLOAD - 4) * 2;
+#else
+    const uint8_t format = AUDIO_DEBUG_FORMAT_PCM16;
+    const size_t max_frames = AUDIO_DEBUG_MAX_PAYLOAD / sizeof(int16_t);
+#endif
+    state.packet.resize(sizeof(AudioDebugHeader) + AUDIO_DEBUG_MAX_PAYLOAD);
+
+    size_t offset = 0;
+    while (offset < frames) {
+        size_t count = std::min(frames - offset, max_frames);
+        const int16_t* samples = data + offset * stride;
+
+        AudioDebugHeader header = {
+            .magic = AUDIO_DEBUG_MAGIC,
+            .version = AUDIO_DEBUG_VERSION,
+            .tap = (uint8_t)tap,
+            .format = format,
+            .channels = 1,
+            .sample_rate = (uint16_t)sample_rate,
+            .sequence = state.sequence++,
+            .samples = (uint32_t)count,
+            .time_us = time_us + (int64_t)offset * 1000000 / sample_rate,
+        };
+        memcpy(state.packet.data(), &header, sizeof(header));
+        uint8_t* payload = state.packet.data() + sizeof(header);
+        size_t payload_size;
+        if (format == AUDIO_DEBUG_FORMAT_IMA_ADPCM) {
+            /* The coder state this datagram starts from */
+            int16_t predictor = state.predictor;
+            memcpy(payload, &predictor, sizeof(predictor));
+            payload[2] = state.step_index;
+            payload[3] = 0;
+            payload_size = 4 + EncodeAdpcm(state, samples, count, stride, payload + 4);
+        } else {
+            int16_t* pcm = (int16_t*)payload;
+            for (size_t i = 0; i < count; i++) {
+                pcm[i] = samples[i * stride];
+            }
+            payload_size = count * sizeof(int16_t);
+        }
+
+        ssize_t sent = sendto(udp_sockfd_, state.packet.data(), sizeof(header) + payload_size, MSG_DONTWAIT,
+                             (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
+        if (sent < 0 && state.dropped++ % AUDIO_DEBUG_DROP_LOG_INTERVAL == 0) {
+            ESP_LOGW(TAG, "Failed to send the %s tap to %s: %d, %lu datagrams dropped", kTapNames[tap],
+                CONFIG_AUDIO_DEBUG_UDP_SERVER, errno, (unsigned long)state.dropped);
+        }
+        offset += count;
+    }
+#endif
+}
@@ -2,21 +2,74 @@
 #define AUDIO_DEBUGGER_H
 
 #include <vector>
+#include <mutex>
 #include <cstdint>
+#include <cstddef>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+enum AudioDebugTap {
+    kAudioDebugTapMic,
+    kAudioDebugTapReference,    // AEC reference channel of the codec input
+    kAudioDebugTapProcessed,    // Audio processor output, as sent to the encoder
+    kAudioDebugTapDownlink,     // Decoded downlink voice at the decoder rate
+    kAudioDebugTapCount,
+};
+
+#define AUDIO_DEBUG_MAGIC 0x4441        // "AD"
+#define AUDIO_DEBUG_VERSION 1
+#define AUDIO_DEBUG_FORMAT_PCM16 0
+#define AUDIO_DEBUG_FORMAT_IMA_ADPCM 1
+
+// Every datagram starts with this header, little-endian. Mirrored by scripts/audio_debug_server.py.
+struct __attribute__((packed)) AudioDebugHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t tap;
+    uint8_t format;
+    uint8_t channels;
+    uint16_t sample_rate;
+    uint32_t sequence;          // Per tap, also counts the datagrams that could not be sent
+    uint32_t samples;
+    int64_t time_us;            // Monotonic time of the first sample
+};
+
+/*
+ * Streams named audio taps to a host over UDP.
+ *
+ * Every tap is mono and has its own sequence number, so the host can demux the taps, align them
+ * by time and count dropped datagrams. With CONFIG_AUDIO_DEBUG_ADPCM the samples are IMA-ADPCM
+ * coded (4:1); every datagram carries the coder state it starts from, so a lost one does not
+ * corrupt the next. Datagrams are sent without blocking and kept below the Ethernet MTU.
+ *
+ * Each tap must be fed from a single task. The socket is opened on the first Feed().
+ */
 class AudioDebugger {
 public:
     AudioDebugger();
     ~AudioDebugger();
 
-    void Feed(const std::vector<int16_t>& data);
+    // Feeds frames of one channel, stride is the distance between its samples (the channel count when interleaved)
+    void Feed(AudioDebugTap tap, const int16_t* data, size_t frames, int sample_rate, int stride = 1);
 
 private:
+    struct TapState {
+        uint32_t sequence = 0;
+        uint32_t dropped = 0;
+        int32_t predictor = 0;
+        int step_index = 0;
+        std::vector<uint8_t> packet;
+    };
+
+    std::once_flag open_flag_;
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+    TapState taps_[kAudioDebugTapCount];
+
+    void Open();
+    bool IsTapEnabled(AudioDebugTap tap) const;
+    size_t EncodeAdpcm(TapState& state, const int16_t* data, size_t frames, int stride, uint8_t* output);
 };
 
-#endif 
\ No newline at end of file
+#endif
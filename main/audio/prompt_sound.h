@@ -0,0 +1,25 @@
+#ifndef PROMPT_SOUND_H
+#define PROMPT_SOUND_H
+
+#include <cstdint>
+
+/*
+ * Prompt sounds pre-indexed at build time by scripts/gen_lang.py.
+ *
+ * The Ogg container of every embedded prompt is parsed once on the host, and the Opus
+ * packets are described by their offset and size inside the embedded file, so playing
+ * a prompt queues packets that point straight into flash.
+ */
+struct PromptPacket {
+    uint32_t offset;
+    uint16_t size;
+};
+
+struct PromptSound {
+    const char* data;               // Start of the embedded Ogg file
+    const PromptPacket* packets;
+    uint16_t packet_count;
+    uint32_t sample_rate;
+};
+
+#endif // PROMPT_SOUND_H
@@ -0,0 +1,158 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * QueueWaiter is the wakeup of one task. A task that blocks on several queues
+ * (e.g. the opus codec task) attaches the same waiter to all of them, so a push
+ * only wakes the task that actually consumes the data, and Signal() costs a
+ * single atomic load when the task is not sleeping.
+ */
+class QueueWaiter {
+public:
+    template <typename Predicate>
+    void Wait(Predicate predicate) {
+        if (predicate()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.fetch_add(1);
+        cv_.wait(lock, predicate);
+        waiters_.fetch_sub(1);
+    }
+
+    template <typename Predicate>
+    void WaitFor(Predicate predicate, int64_t timeout_us) {
+        if (predicate()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.fetch_add(1);
+        cv_.wait_for(lock, std::chrono::microseconds(timeout_us), predicate);
+        waiters_.fetch_sub(1);
+    }
+
+    void Signal() {
+        if (waiters_.load() == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<int> waiters_ = 0;
+};
+
+/*
+ * Fixed-capacity single-producer / single-consumer ring.
+ *
+ * TryPush() must only be called by the producer and TryPop() only by the consumer.
+ * Clear() may be called from any thread: it marks everything queued so far as
+ * discarded, and the consumer releases those entries on its next TryPop().
+ * size() / empty() exclude discarded entries, full() / pending() do not.
+ * peak() is the highest number of entries seen right after a push.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots_(capacity) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    void SetConsumerWaiter(QueueWaiter* waiter) { consumer_waiter_ = waiter; }
+    void SetProducerWaiter(QueueWaiter* waiter) { producer_waiter_ = waiter; }
+
+    inline size_t capacity() const { return slots_.size(); }
+
+    size_t size() const {
+        uint32_t tail = tail_.load();
+        uint32_t discard = discard_.load();
+        uint32_t head = head_.load();
+        if (static_cast<int32_t>(discard - tail) > 0) {
+            tail = discard;
+        }
+        return static_cast<int32_t>(head - tail) > 0 ? head - tail : 0;
+    }
+
+    inline bool empty() const { return size() == 0; }
+    inline bool full() const { return head_.load() - tail_.load() >= slots_.size(); }
+    inline bool pending() const { return head_.load() != tail_.load(); }
+    inline size_t peak() const { return peak_.load(); }
+    void ResetPeak() { peak_ = 0; }
+
+    bool TryPush(T&& item) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load() >= slots_.size()) {
+            return false;
+        }
+        slots_[head % slots_.size()] = std::move(item);
+        head_.store(head + 1);
+        uint32_t depth = head + 1 - tail_.load();
+        if (depth > peak_.load(std::memory_order_relaxed)) {
+            peak_.store(depth, std::memory_order_relaxed);
+        }
+        if (consumer_waiter_ != nullptr) {
+            consumer_waiter_->Signal();
+        }
+        return true;
+    }
+
+    bool TryPop(T& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load();
+        uint32_t discard = discard_.load();
+        bool released = false;
+        while (static_cast<int32_t>(discard - tail) > 0 && tail != head) {
+            slots_[tail % slots_.size()] = T();
+            tail_.store(++tail);
+            released = true;
+        }
+        if (discard != tail) {
+            // Keep the discard mark close to the tail so the wrapping comparison stays valid
+            discard_.compare_exchange_strong(discard, tail);
+        }
+
+        bool popped = false;
+        if (tail != head) {
+            item = std::move(slots_[tail % slots_.size()]);
+            tail_.store(tail + 1);
+            popped = true;
+        }
+        if ((popped || released) && producer_waiter_ != nullptr) {
+            producer_waiter_->Signal();
+        }
+        return popped;
+    }
+
+    void Clear() {
+        discard_.store(head_.load());
+        if (consumer_waiter_ != nullptr) {
+            consumer_waiter_->Signal();
+        }
+        if (producer_waiter_ != nullptr) {
+            producer_waiter_->Signal();
+        }
+    }
+
+private:
+    std::vector<T> slots_;
+    std::atomic<uint32_t> head_ = 0;
+    std::atomic<uint32_t> tail_ = 0;
+    std::atomic<uint32_t> discard_ = 0;
+    std::atomic<uint32_t> peak_ = 0;
+    QueueWaiter* consumer_waiter_ = nullptr;
+    QueueWaiter* producer_waiter_ = nullptr;
+};
+
+#endif // SPSC_QUEUE_H
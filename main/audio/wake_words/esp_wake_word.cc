@@ -79,7 +79,7 @@ size_t EspWakeWord::GetFeedSize() {
     return wakenet_iface_->get_samp_chunksize(wakenet_data_);
 }
 
-void EspWakeWord::EncodeWakeWordData() {
+void EspWakeWord::EncodeWakeWordData(int frame_duration_ms) {
 }
 
 bool EspWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
@@ -0,0 +1,216 @@
+#include "wake_word_preroll.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <opus_encoder.h>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+
+#define TAG "WakeWordPreroll"
+
+#define PREROLL_SAMPLE_RATE 16000
+#define PREROLL_DURATION_MS 2000
+#define PREROLL_SAMPLES (PREROLL_SAMPLE_RATE * PREROLL_DURATION_MS / 1000)
+// Enough packets for two seconds of the shortest uplink frames
+#define PREROLL_MAX_PACKETS (PREROLL_DURATION_MS / 20)
+#define PREROLL_TASK_STACK_SIZE (4096 * 7)
+
+WakeWordPreroll::~WakeWordPreroll() {
+    if (encode_task_ != nullptr) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+        cv_.notify_all();
+        cv_.wait(lock, [this]() { return encode_task_ == nullptr; });
+    }
+    if (encode_task_stack_ != nullptr) {
+        heap_caps_free(encode_task_stack_);
+    }
+    if (encode_task_buffer_ != nullptr) {
+        heap_caps_free(encode_task_buffer_);
+    }
+    if (pcm_ != nullptr) {
+        heap_caps_free(pcm_);
+    }
+}
+
+bool WakeWordPreroll::Initialize() {
+    if (pcm_ != nullptr) {
+        return true;
+    }
+    pcm_ = (int16_t*)heap_caps_malloc(PREROLL_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    encode_task_stack_ = (StackType_t*)heap_caps_malloc(PREROLL_TASK_STACK_SIZE, MALLOC_CAP_SPIRAM);
+    encode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+    if (pcm_ == nullptr || encode_task_stack_ == nullptr || encode_task_buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the wake word pre-roll");
+        return false;
+    }
+    packets_.resize(PREROLL_MAX_PACKETS);
+#if CONFIG_SEND_WAKE_WORD_DATA
+    incremental_ = true;
+#endif
+
+    encode_task_ = xTaskCreateStatic([](void* arg) {
+        auto this_ = (WakeWordPreroll*)arg;
+        this_->EncodeTask();
+        vTaskDelete(NULL);
+    }, "encode_wake_word", PREROLL_TASK_STACK_SIZE, this, 2, encode_task_stack_, encode_task_buffer_);
+    return true;
+}
+
+void WakeWordPreroll::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_position_ = 0;
+    encode_position_ = 0;
+    packet_head_ = 0;
+    packet_count_ = 0;
+    rebuild_ = false;
+    flushing_ = false;
+    finished_ = false;
+    generation_++;
+}
+
+size_t WakeWordPreroll::GetFrameSamples() const {
+    return PREROLL_SAMPLE_RATE * frame_duration_ms_ / 1000;
+}
+
+void WakeWordPreroll::Store(const int16_t* data, size_t samples) {
+    if (pcm_ == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (samples > PREROLL_SAMPLES) {
+        data += samples - PREROLL_SAMPLES;
+        write_position_ += samples - PREROLL_SAMPLES;
+        samples = PREROLL_SAMPLES;
+    }
+    size_t offset = write_position_ % PREROLL_SAMPLES;
+    size_t first = std::min<size_t>(samples, PREROLL_SAMPLES - offset);
+    memcpy(pcm_ + offset, data, first * sizeof(int16_t));
+    memcpy(pcm_, data + first, (samples - first) * sizeof(int16_t));
+    write_position_ += samples;
+
+    if (incremental_ && write_position_ - encode_position_ >= GetFrameSamples()) {
+        cv_.notify_all();
+    }
+}
+
+void WakeWordPreroll::Encode(int frame_duration_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    detected_time_us_ = esp_timer_get_time();
+    packets_sent_ = 0;
+    flushing_ = true;
+    finished_ = false;
+    if (frame_duration_ms != frame_duration_ms_ || !incremental_) {
+        /* Packets of the old frame duration, and the one being encoded, must not be sent */
+        frame_duration_ms_ = frame_duration_ms;
+        packet_count_ = 0;
+        generation_++;
+        rebuild_ = true;
+    }
+    ESP_LOGI(TAG, "Wake word detected, %u packets ready, %u ms left to encode%s", (unsigned)packet_count_,
+        (unsigned)((write_position_ - encode_position_) * 1000 / PREROLL_SAMPLE_RATE), rebuild_ ? " (re-encoding all)" : "");
+    cv_.notify_all();
+}
+
+bool WakeWordPreroll::GetOpus(std::vector<uint8_t>& opus) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() {
+        return packet_count_ > 0 || finished_ || !flushing_;
+    });
+    if (packet_count_ == 0) {
+        opus.clear();
+        return false;
+    }
+    std::swap(opus, packets_[packet_head_]);
+    packet_head_ = (packet_head_ + 1) % packets_.size();
+    packet_count_--;
+    if (packets_sent_++ == 0) {
+        ESP_LOGI(TAG, "First wake word packet ready %ld ms after detection", (long)((esp_timer_get_time() - detected_time_us_) / 1000));
+    }
+    return true;
+}
+
+// Keeps the packets of the last two seconds, the oldest is dropped when the ring is full
+void WakeWordPreroll::PushPacket(std::vector<uint8_t>& opus) {
+    size_t max_packets = std::min<size_t>(packets_.size(), PREROLL_DURATION_MS / frame_duration_ms_);
+    while (packet_count_ >= max_packets) {
+        packet_head_ = (packet_head_ + 1) % packets_.size();
+        packet_count_--;
+    }
+    std::swap(packets_[(packet_head_ + packet_count_) % packets_.size()], opus);
+    packet_count_++;
+}
+
+void WakeWordPreroll::EncodeTask() {
+    std::unique_ptr<OpusEncoderWrapper> encoder;
+    uint32_t encoder_generation = 0;
+    std::vector<int16_t> frame;
+    std::vector<uint8_t> opus;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this]() {
+            return stopping_ || rebuild_ || (flushing_ && !finished_) ||
+                (incremental_ && write_position_ - encode_position_ >= GetFrameSamples());
+        });
+        if (stopping_) {
+            break;
+        }
+
+        if (rebuild_) {
+            /* Start over from the oldest stored sample with the new frame duration */
+            rebuild_ = false;
+            encoder.reset();
+            encode_position_ = write_position_ - std::min<uint32_t>(write_position_, PREROLL_SAMPLES);
+        }
+        if (!encoder || encoder->duration_ms() != frame_duration_ms_) {
+            encoder = std::make_unique<OpusEncoderWrapper>(PREROLL_SAMPLE_RATE, 1, frame_duration_ms_);
+            encoder->SetComplexity(0); // 0 is the fastest
+            encoder_generation = generation_;
+        } else if (encoder_generation != generation_) {
+            encoder->ResetState();
+            encoder_generation = generation_;
+        }
+
+        /* The encoder fell behind by more than the ring, continue from the oldest sample left */
+        if (write_position_ - encode_position_ > PREROLL_SAMPLES) {
+            ESP_LOGW(TAG, "Encoder fell behind, skipped %u samples", (unsigned)(write_position_ - encode_position_ - PREROLL_SAMPLES));
+            encode_position_ = write_position_ - PREROLL_SAMPLES;
+            encoder->ResetState();
+        }
+
+        size_t frame_samples = GetFrameSamples();
+        if (write_position_ - encode_position_ < frame_samples) {
+            /* Nothing more to encode, a last partial frame is dropped */
+            if (flushing_ && !finished_) {
+                finished_ = true;
+                ESP_LOGI(TAG, "Wake word pre-roll encoded, %u packets %ld ms after detection", (unsigned)(packets_sent_ + packet_count_),
+                    (long)((esp_timer_get_time() - detected_time_us_) / 1000));
+                cv_.notify_all();
+            }
+            continue;
+        }
+
+        frame.resize(frame_samples);
+        size_t offset = encode_position_ % PREROLL_SAMPLES;
+        size_t first = std::min<size_t>(frame_samples, PREROLL_SAMPLES - offset);
+        memcpy(frame.data(), pcm_ + offset, first * sizeof(int16_t));
+        memcpy(frame.data() + first, pcm_, (frame_samples - first) * sizeof(int16_t));
+        encode_position_ += frame_samples;
+        uint32_t generation = generation_;
+
+        lock.unlock();
+        bool encoded = encoder->Encode(std::move(frame), opus);
+        lock.lock();
+
+        if (encoded && generation == generation_) {
+            PushPacket(opus);
+            cv_.notify_all();
+        }
+    }
+
+    encode_task_ = nullptr;
+    cv_.notify_all();
+}
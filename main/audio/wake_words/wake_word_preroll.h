@@ -0,0 +1,66 @@
+#ifndef WAKE_WORD_PREROLL_H
+#define WAKE_WORD_PREROLL_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+/*
+ * The last two seconds of 16 kHz audio before a wake word, as Opus packets for the server.
+ *
+ * The detection task stores every chunk in a preallocated PSRAM ring. With
+ * CONFIG_SEND_WAKE_WORD_DATA, a background task encodes the ring frame by frame while
+ * detection runs and keeps the packets of the last two seconds, so after a detection only
+ * the last partial frames are left to encode. If the uplink frame duration changed since,
+ * or nothing was encoded ahead, Encode() re-encodes the whole ring like before.
+ */
+class WakeWordPreroll {
+public:
+    WakeWordPreroll() = default;
+    ~WakeWordPreroll();
+
+    WakeWordPreroll(const WakeWordPreroll&) = delete;
+    WakeWordPreroll& operator=(const WakeWordPreroll&) = delete;
+
+    bool Initialize();
+    // Drops the stored audio and packets, when detection (re)starts
+    void Reset();
+    void Store(const int16_t* data, size_t samples);
+    // After a detection: encode what is left at this frame duration, then end the packet stream
+    void Encode(int frame_duration_ms);
+    // Blocks for the next packet, returns false after the last one
+    bool GetOpus(std::vector<uint8_t>& opus);
+
+private:
+    int16_t* pcm_ = nullptr;
+    uint32_t write_position_ = 0;      // Samples stored since the last reset
+    uint32_t encode_position_ = 0;     // Samples encoded since the last reset
+    std::vector<std::vector<uint8_t>> packets_;
+    size_t packet_head_ = 0;
+    size_t packet_count_ = 0;
+    bool incremental_ = false;
+    int frame_duration_ms_ = 60;
+    bool rebuild_ = false;
+    bool flushing_ = false;
+    bool finished_ = false;
+    bool stopping_ = false;
+    uint32_t generation_ = 0;
+    int64_t detected_time_us_ = 0;
+    int packets_sent_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    TaskHandle_t encode_task_ = nullptr;
+    StaticTask_t* encode_task_buffer_ = nullptr;
+    StackType_t* encode_task_stack_ = nullptr;
+
+    void EncodeTask();
+    size_t GetFrameSamples() const;
+    void PushPacket(std::vector<uint8_t>& opus);
+};
+
+#endif // WAKE_WORD_PREROLL_H
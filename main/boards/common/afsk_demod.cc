@@ -23,17 +23,28 @@ namespace audio_wifi_config
         std::vector<int16_t> audio_data;
         AudioSignalProcessor signal_processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize);
         AudioDataBuffer data_buffer;
+        auto& audio_service = app->GetAudioService();
+        bool tap_enabled = false;
 
         while (true)
         {
             // 检查Application状态，只有在WiFi配置模式下才处理音频
             if (app->GetDeviceState() != kDeviceStateWifiConfiguring) {
+                if (tap_enabled) {
+                    audio_service.EnableInputTap(false);
+                    tap_enabled = false;
+                }
                 // 不在WiFi配置状态，休眠100ms后再检查
                 vTaskDelay(pdMS_TO_TICKS(100));
                 continue;
             }
+            if (!tap_enabled) {
+                // Share the mic reads of the audio input task instead of reading the codec in parallel
+                audio_service.EnableInputTap(true);
+                tap_enabled = true;
+            }
             
-            if (!app->GetAudioService().ReadAudioData(audio_data, 16000, 480)) { // 16kHz, 480 samples corresponds to 30ms data
+            if (!audio_service.ReadInputTap(audio_data, 480)) { // 16kHz, 480 samples corresponds to 30ms data
                 // 读取音频失败，短暂延迟后重试
                 ESP_LOGI(kLogTag, "Failed to read audio data, retrying.");
                 vTaskDelay(pdMS_TO_TICKS(10));
@@ -23,6 +23,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include "settings.h"
+#include "music_playback_policy.h"
 #include <queue>
 #include <unordered_map>
 #include <mutex>
@@ -32,6 +33,8 @@
 // 全局 counting semaphore，用于取代 std::condition_variable (避免动态分配多个)
 static SemaphoreHandle_t g_buffer_sema = nullptr;
 static constexpr int kBufferSemaphoreMax = 16;
+// 后台扫描每解析这么多首歌发布一次
+static constexpr size_t kScanBatchSize = 32;
 // 夜灯模式下要扫描的两个文件夹名
 constexpr const char* FOLDER_SOOTHING_LIGHT = "【41-50】Soothing Light Music";
 constexpr const char* FOLDER_NATURAL_SOUNDS = "【51-60】Natural Sounds";
@@ -79,6 +82,11 @@ Esp32Music::Esp32Music() : current_song_name_(),
         ((Esp32Music*)arg)->NextPlayTask(NULL);
         vTaskDelete(NULL);
     }, "next_play_task", 2048*3, this, 3, &NextPlay_task_handle_);
+    // 扫描 SD 卡耗时较长，放在最低的应用优先级，不影响播放与对话
+    xTaskCreate([](void* arg) {
+        ((Esp32Music*)arg)->LibraryScanTask();
+        vTaskDelete(NULL);
+    }, "library_scan", 4096*2, this, 1, &library_scan_task_handle_);
 
 }
 // 初始化 chunk 池，返回是否成功
@@ -321,6 +329,7 @@ bool Esp32Music::StopStreaming() {
     is_downloading_ = false;
     is_playing_ = false;
     is_paused_ = false;
+    Application::GetInstance().ResetMusicResampler();
     
     // 清空歌名显示
     auto& board = Board::GetInstance();
@@ -485,6 +494,8 @@ void Esp32Music::PlayAudioStream() {
     total_frames_decoded_ = 0;
     ManualNextPlay_ = false;
     display_flag = 0;
+    // 新曲目开始，重采样器不能带着上一首的历史
+    Application::GetInstance().ResetMusicResampler();
     auto codec = Board::GetInstance().GetAudioCodec();
     // codec->output_enabled();
     if (!codec || !codec->output_enabled()) {
@@ -547,6 +558,8 @@ void Esp32Music::PlayAudioStream() {
     is_first_play_ = true;
     using namespace std::chrono;
     steady_clock::time_point listening_start = steady_clock::time_point::min();
+    steady_clock::time_point state_listening_start = steady_clock::time_point::min();
+    bool idle_requested = false;
     int consecutive_decode_failures = 0;
     const int kMaxConsecutiveDecodeFailures = 20;
     int resume_fail_count = 0;
@@ -563,32 +576,11 @@ void Esp32Music::PlayAudioStream() {
         // 检查设备状态，只有在空闲状态才播放音乐
         DeviceState previous_state = current_state;
         current_state = app.GetDeviceState();
-        if(is_first_play_)
-        {
-            // 状态转换：说话中-》聆听中-》待机状态-》播放音乐
-            if (current_state == kDeviceStateListening || current_state == kDeviceStateSpeaking) {
-                if (current_state == kDeviceStateSpeaking) {
-                    ESP_LOGI(TAG, "Device is in speaking state, switching to listening state for music playback");
-                }
-                if (current_state == kDeviceStateListening) {
-                    ESP_LOGI(TAG, "Device is in listening state, switching to idle state for music playback");
-                }
-                // 切换状态
-                app.ToggleChatState(); // 变成待机状态
-                vTaskDelay(pdMS_TO_TICKS(300));
-                continue;
-            } else if (current_state != kDeviceStateIdle) { // 不是待机状态，就一直卡在这里，不让播放音乐
-                ESP_LOGD(TAG, "Device state is %d, pausing music playback", current_state);
-                // 如果不是空闲状态，暂停播放
-                vTaskDelay(pdMS_TO_TICKS(50));
-                continue;
-            }
-            
-            is_first_play_ = false;
-        }
+        bool was_paused = false;
         {
             std::unique_lock<std::mutex> lk(buffer_mutex_);
             if (is_paused_) {
+                was_paused = true;
                 ESP_LOGI(TAG, "Playback paused, entering timed wait (2s)");
                 // 带超时循环等待，周期性检查聆听超时（10s）以自动恢复
                 while (is_paused_) {
@@ -599,14 +591,20 @@ void Esp32Music::PlayAudioStream() {
                     }
 
                     // 检查当前设备状态并维护聆听计时器
+                    DeviceState pause_previous_state = current_state;
                     current_state = app.GetDeviceState();
                     
-                    // 优化：如果设备变为 IDLE，立即恢复播放（无需等待超时）
-                    if (current_state == kDeviceStateIdle && manual_pause_==false) {
-                        ESP_LOGI(TAG, "Device state is IDLE, auto-resuming playback immediately");
+                    // 设备变为 IDLE，或回复正常说完进入聆听，立即恢复播放（无需等待超时）
+                    if (manual_pause_ == false &&
+                        ShouldResumeMusic(pause_previous_state, current_state, app.IsSpeakingAborted())) {
+                        ESP_LOGI(TAG, "Device state %d -> %d, auto-resuming playback immediately", pause_previous_state, current_state);
                         // 先解锁再调用 ResumePlayback()（ResumePlayback 内部会加锁并 notify）
                         lk.unlock();
                         ResumePlayback();
+                        if (current_state == kDeviceStateListening) {
+                            RequestIdleForMusic();
+                            idle_requested = true;
+                        }
                         lk.lock();
                         listening_start = steady_clock::time_point::min();
                         break;
@@ -671,30 +669,45 @@ void Esp32Music::PlayAudioStream() {
             }
         }
 
-        if (previous_state == kDeviceStateIdle && current_state != kDeviceStateIdle) {
-            ESP_LOGI(TAG, "Device state changed from IDLE to %d, pausing playback", current_state);
-            ESP_LOGE(TAG, "676");
-            PausePlayback();
-            manual_pause_ = false; // 非手动暂停
-            vTaskDelay(pdMS_TO_TICKS(200));
-            continue;
+        // 暂停期间状态已更新，不再当作一次状态切换
+        if (was_paused) {
+            previous_state = current_state;
         }
-
-        // 状态转换：说话中-》聆听中-》待机状态-》播放音乐
-        if (current_state == kDeviceStateListening || current_state == kDeviceStateSpeaking) {
-            if (current_state == kDeviceStateSpeaking) {
-                ESP_LOGI(TAG, "Device is in speaking state, switching to listening state for music playback");
+        if (current_state == kDeviceStateListening) {
+            if (state_listening_start == steady_clock::time_point::min()) {
+                state_listening_start = steady_clock::now();
             }
-            if (current_state == kDeviceStateListening) {
-                ESP_LOGI(TAG, "Device is in listening state, switching to idle state for music playback");
+        } else {
+            state_listening_start = steady_clock::time_point::min();
+            idle_requested = false;
+        }
+        int64_t listening_ms = state_listening_start == steady_clock::time_point::min() ? 0 :
+            duration_cast<milliseconds>(steady_clock::now() - state_listening_start).count();
+
+        // 说话时不暂停，音乐在语音下方继续播放；回复正常说完后结束对话回到待机继续播放；
+        // 被唤醒词打断或从待机唤醒时自动暂停，回到待机后自动恢复
+        switch (DecideMusicPlayback(previous_state, current_state, listening_ms, is_first_play_,
+                                    app.IsSpeakingAborted())) {
+        case kMusicPlaybackPlay:
+            is_first_play_ = false;
+            break;
+        case kMusicPlaybackRequestIdle:
+            if (!idle_requested) {
+                ESP_LOGI(TAG, "Device state changed from %d to %d, returning to idle for playback", previous_state, current_state);
+                RequestIdleForMusic();
+                idle_requested = true;
             }
-            // 切换状态
-            app.ToggleChatState(); // 变成待机状态
             vTaskDelay(pdMS_TO_TICKS(300));
             continue;
-        } else if (current_state != kDeviceStateIdle) { // 不是待机状态，就一直卡在这里，不让播放音乐
+        case kMusicPlaybackPause:
+            ESP_LOGI(TAG, "Device state changed from %d to %d, pausing playback", previous_state, current_state);
+            PausePlayback();
+            manual_pause_ = false; // 非手动暂停
+            vTaskDelay(pdMS_TO_TICKS(200));
+            continue;
+        case kMusicPlaybackWait:
+            // 聆听、连接等状态等待状态回到待机或说话
             ESP_LOGD(TAG, "Device state is %d, pausing music playback", current_state);
-            // 如果不是空闲状态，暂停播放
             vTaskDelay(pdMS_TO_TICKS(50));
             continue;
         }
@@ -1208,6 +1221,7 @@ void Esp32Music::PlayAudioStream() {
     ESP_LOGI(TAG, "Performing basic cleanup from play thread");
     // 停止播放标志
     is_playing_ = false;
+    Application::GetInstance().ResetMusicResampler();
 
     ESP_LOGW(TAG,"Save playback position after finishing playback");
     // 保存断点（按类型）
@@ -1679,6 +1693,16 @@ void Esp32Music::PausePlayback() {
 
 }
 
+// 结束本轮对话回到待机以便播放音乐；在主线程上再检查一次状态，期间已离开聆听则不切换
+void Esp32Music::RequestIdleForMusic() {
+    auto &app = Application::GetInstance();
+    app.Schedule([&app]() {
+        if (app.GetDeviceState() == kDeviceStateListening) {
+            app.ToggleChatState();
+        }
+    });
+}
+
 /**
  * @brief 开始SD卡流式播放
  * @param file_path SD卡文件路径
@@ -1852,6 +1876,8 @@ void Esp32Music::ReadFromSDCard(const std::string& file_path) {
                             current_play_file_offset_ = 0;
                             current_play_file_ = file;
                         }
+                        // 回绕到文件头相当于一次跳转，重采样器重新开始
+                        Application::GetInstance().ResetMusicResampler();
                         total_read = 0;
                         // 继续循环从文件头读取
                         continue;
@@ -1995,30 +2021,24 @@ void Esp32Music::ps_free_str(char *p) {
 }
 
 // 释放 PSRAM 中的音乐库（调用时需持有 music_library_mutex_）
+// 字符串都在 music_strings_ 或已加载的索引中，整体释放，不再逐条释放
 void Esp32Music::free_ps_music_library_locked() {
-    if (!ps_music_library_) return;
-    for (size_t i = 0; i < ps_music_count_; ++i) {
-        auto &e = ps_music_library_[i];
-        ps_free_str(e.file_path); e.file_path = nullptr;
-        ps_free_str(e.file_name); e.file_name = nullptr;
-        ps_free_str(e.song_name); e.song_name = nullptr;
-        ps_free_str(e.artist); e.artist = nullptr;
-        ps_free_str(e.artist_norm); e.artist_norm = nullptr;
-        ps_free_str(e.token_norm); e.token_norm = nullptr;
-        ps_free_str(e.category); e.category = nullptr;
-        ps_free_str(e.index_id); e.index_id = nullptr;
+    if (music_view_) {
+        heap_caps_free(music_view_);
+        music_view_ = nullptr;
     }
     heap_caps_free(ps_music_library_);
     ps_music_library_ = nullptr;
     ps_music_count_ = 0;
     ps_music_capacity_ = 0;
+    music_strings_.Reset();
+    music_index_.Release();
+    music_ngrams_.Clear();
 }
 
-// 在 PSRAM 数组中追加一条（调用时需持有 music_library_mutex_）
-// 返回 true 表示追加成功
-bool Esp32Music::ps_add_music_info_locked(const MusicFileInfo &info) {
+// 保证数组能容纳 need 条（调用时需持有 music_library_mutex_）
+bool Esp32Music::ps_reserve_music_locked(size_t need) {
     // 1.5x 或最少初始容量 64
-    size_t need = ps_music_count_ + 1;
     if (need > ps_music_capacity_) {
         size_t new_cap = ps_music_capacity_ ? (ps_music_capacity_ * 3) / 2 : 64;
         if (new_cap < need) new_cap = need;
@@ -2030,36 +2050,39 @@ bool Esp32Music::ps_add_music_info_locked(const MusicFileInfo &info) {
         // 复制旧条目结构（指针值拷贝）
         if (ps_music_library_ && ps_music_count_ > 0) {
             memcpy(new_arr, ps_music_library_, ps_music_count_ * sizeof(PSMusicInfo));
-            heap_caps_free(ps_music_library_);
         }
+        heap_caps_free(ps_music_library_);
         ps_music_library_ = new_arr;
         ps_music_capacity_ = new_cap;
     }
+    return true;
+}
+
+// 在 PSRAM 数组中追加一条（调用时需持有 music_library_mutex_）
+// 返回 true 表示追加成功
+bool Esp32Music::ps_add_music_info_locked(const MusicFileInfo &info) {
+    if (!ps_reserve_music_locked(ps_music_count_ + 1)) return false;
 
-    // 填充新条目（逐字段在 PSRAM 分配字符串副本）
+    // 填充新条目：字符串放入 PSRAM 字符串池，歌手与分类在多首歌之间重复，只存一份
     PSMusicInfo &dst = ps_music_library_[ps_music_count_];
-    dst.file_path = ps_strdup(info.file_path);
-    dst.file_name = ps_strdup(info.file_name);
-    dst.song_name = ps_strdup(info.song_name);
-    dst.artist = ps_strdup(info.artist);
-    dst.artist_norm = ps_strdup(info.artist_norm);
-    dst.category = ps_strdup(info.category);
-    dst.index_id = ps_strdup(info.index_id);
+    dst.file_path = music_strings_.Add(info.file_path);
+    dst.file_name = music_strings_.Add(info.file_name);
+    dst.song_name = music_strings_.Add(info.song_name);
+    dst.artist = music_strings_.Intern(info.artist);
+    dst.artist_norm = music_strings_.Intern(info.artist_norm);
+    dst.category = music_strings_.Intern(info.category);
+    dst.index_id = music_strings_.Add(info.index_id);
 
     // 生成 token-normalized 字符串并存到 PSRAM（避免查询时重复分配）
     std::string token = NormalizeForToken(info.file_name);
-    dst.token_norm = ps_strdup(token);
+    dst.token_norm = music_strings_.Add(token);
 
     dst.file_size = info.file_size;
 
-    // 检查是否有字符串分配失败，若失败则释放刚分配字段并返回 false（保留已存在条目）
-    if ((!dst.file_path) || (!dst.file_name) || (!dst.song_name) || (!dst.artist) || (!dst.artist_norm) || (!dst.token_norm)) {
-        ps_free_str(dst.file_path); dst.file_path = nullptr;
-        ps_free_str(dst.file_name); dst.file_name = nullptr;
-        ps_free_str(dst.song_name); dst.song_name = nullptr;
-        ps_free_str(dst.artist); dst.artist = nullptr;
-        ps_free_str(dst.artist_norm); dst.artist_norm = nullptr;
-        ps_free_str(dst.token_norm); dst.token_norm = nullptr;
+    // 字符串池分配失败时不追加该条目（已写入池中的部分随池一起释放）
+    if ((!dst.file_path) || (!dst.file_name) || (!dst.song_name) || (!dst.artist) || (!dst.artist_norm) ||
+        (!dst.category) || (!dst.index_id) || (!dst.token_norm)) {
+        dst = PSMusicInfo();
         return false;
     }
 
@@ -2067,28 +2090,70 @@ bool Esp32Music::ps_add_music_info_locked(const MusicFileInfo &info) {
     return true;
 }
 
+// 追加索引中未变化的一条，字符串直接指向已加载的索引，不再分配（调用时需持有 music_library_mutex_）
+bool Esp32Music::ps_add_indexed_music_locked(const MusicIndexRecord &record) {
+    if (!ps_reserve_music_locked(ps_music_count_ + 1)) return false;
 
-void Esp32Music::ScanDirectoryRecursive(const std::string& path, bool LightModeScan) {
-    static int recursion_depth = 0;
-    recursion_depth++;
-    bool is_top_level = (recursion_depth == 1);
+    PSMusicInfo &dst = ps_music_library_[ps_music_count_];
+    dst.file_path = const_cast<char*>(music_index_.string(record.file_path));
+    dst.file_name = const_cast<char*>(music_index_.string(record.file_name));
+    dst.song_name = const_cast<char*>(music_index_.string(record.song_name));
+    dst.artist = const_cast<char*>(music_index_.string(record.artist));
+    dst.artist_norm = const_cast<char*>(music_index_.string(record.artist_norm));
+    dst.token_norm = const_cast<char*>(music_index_.string(record.token_norm));
+    dst.category = const_cast<char*>(music_index_.string(record.category));
+    dst.index_id = const_cast<char*>(music_index_.string(record.index_id));
+    dst.file_size = record.file_size;
+
+    ps_music_count_++;
+    return true;
+}
 
+// 影响扫描结果的设置，变化后索引作废
+uint32_t Esp32Music::LibraryConfigHash() const {
+    uint32_t hash = MusicLibraryIndex::kSignatureSeed;
+    for (const auto& song : excluded_songs_) {
+        hash = MusicLibraryIndex::Hash(hash, song.c_str(), song.size() + 1);
+    }
+    return hash;
+}
+
+
+// 一次加锁追加一批解析好的歌曲，查询线程在两批之间即可看到新结果
+void Esp32Music::PublishMusicBatch(std::vector<MusicFileInfo>& batch) {
+    if (batch.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        for (const auto& music_info : batch) {
+            if (!ps_add_music_info_locked(music_info)) {
+                ESP_LOGW(TAG, "Failed to add music info into PSRAM for %s", music_info.file_path.c_str());
+            }
+        }
+    }
+    scan_files_ += batch.size();
+    batch.clear();
+}
+
+// 先读完目录项再处理：同一目录的歌曲在库中连续，可以整体从索引复用；子目录交给调用者，不在打开目录时递归
+void Esp32Music::ScanMusicDirectory(const std::string& path, bool LightModeScan, bool is_top_level,
+                                    std::vector<std::string>& subdirs, LibraryScanState& state) {
     DIR* dir = opendir(path.c_str());
     if (!dir) {
         ESP_LOGE(TAG, "Failed to open directory: %s", path.c_str());
-        recursion_depth--;
         return;
     }
 
     struct dirent* entry;
-    int file_count = 0;
-    int dir_count = 0;
+    std::vector<std::string> files;
+    uint32_t signature = MusicLibraryIndex::kSignatureSeed;
 
     while ((entry = readdir(dir)) != nullptr) {
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
             continue;
 
-        std::string full_path = path + "/" + entry->d_name;
+        // 名称与类型都计入签名，文件的增删改名都会使它变化
+        signature = MusicLibraryIndex::Hash(signature, entry->d_name, strlen(entry->d_name) + 1);
+        signature = MusicLibraryIndex::Hash(signature, (const char*)&entry->d_type, 1);
 
         if (entry->d_type == DT_DIR) {
             bool should_enter = true;
@@ -2100,8 +2165,7 @@ void Esp32Music::ScanDirectoryRecursive(const std::string& path, bool LightModeS
                 }
             }
             if (should_enter) {
-                ScanDirectoryRecursive(full_path, LightModeScan);
-                dir_count++;
+                subdirs.push_back(path + "/" + entry->d_name);
             }
         }
         else if (entry->d_type == DT_REG) {
@@ -2111,34 +2175,83 @@ void Esp32Music::ScanDirectoryRecursive(const std::string& path, bool LightModeS
                     should_process = false;
                 }
             }
-            if (should_process && IsMusicFile(full_path)) {
-                MusicFileInfo music_info = ExtractMusicInfo(full_path);
-                // 排除列表检查（不变）
-                bool excluded = false;
-                for (const auto& excluded_song : excluded_songs_) {
-                    if (music_info.song_name == excluded_song) {
-                        excluded = true;
-                        break;
-                    }
-                }
-                if (excluded) {
-                    ESP_LOGI(TAG, "Skipping excluded music: %s", music_info.song_name.c_str());
-                    continue;
-                }
-                {
-                    std::lock_guard<std::mutex> lock(music_library_mutex_);
-                    if (!ps_add_music_info_locked(music_info)) {
-                        ESP_LOGW(TAG, "Failed to add music info into PSRAM for %s", full_path.c_str());
-                    }
+            if (should_process) {
+                files.push_back(path + "/" + entry->d_name);
+            }
+        }
+    }
+    closedir(dir);
+
+    struct stat st;
+    int64_t mtime = stat(path.c_str(), &st) == 0 ? (int64_t)st.st_mtime : 0;
+    // 夜灯模式下顶层目录只取部分文件，与索引中的内容不同
+    const MusicIndexDir* cached = nullptr;
+    if (!(LightModeScan && is_top_level)) {
+        cached = music_index_.FindDir(path, signature, mtime);
+    }
+
+    size_t first = ps_music_count_;
+    if (cached) {
+        // 复用的条目不需要解析，整个目录一次发布
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        if (cached->first_record != first) {
+            state.in_index_order = false;
+        }
+        for (uint32_t i = 0; i < cached->record_count; ++i) {
+            if (!ps_add_indexed_music_locked(music_index_.record(cached->first_record + i))) {
+                ESP_LOGW(TAG, "Failed to add indexed music into PSRAM for %s", path.c_str());
+                break;
+            }
+        }
+        scan_files_ += ps_music_count_ - first;
+        scan_dirs_indexed_++;
+        state.reused_dirs++;
+    } else {
+        std::vector<MusicFileInfo> batch;
+        batch.reserve(kScanBatchSize);
+        for (const auto& full_path : files) {
+            if (!IsMusicFile(full_path)) continue;
+            MusicFileInfo music_info = ExtractMusicInfo(full_path);
+            // 排除列表检查（不变）
+            bool excluded = false;
+            for (const auto& excluded_song : excluded_songs_) {
+                if (music_info.song_name == excluded_song) {
+                    excluded = true;
+                    break;
                 }
-                file_count++;
+            }
+            if (excluded) {
+                ESP_LOGI(TAG, "Skipping excluded music: %s", music_info.song_name.c_str());
+                continue;
+            }
+            batch.push_back(std::move(music_info));
+            if (batch.size() >= kScanBatchSize) {
+                PublishMusicBatch(batch);
             }
         }
+        PublishMusicBatch(batch);
+        state.parsed_dirs++;
     }
+    scan_dirs_++;
+    state.dirs.push_back({path, signature, mtime, (uint32_t)first, (uint32_t)(ps_music_count_ - first)});
+    ESP_LOGI(TAG, "Scanned directory %s: %u files%s", path.c_str(), (unsigned)(ps_music_count_ - first),
+             cached ? " (indexed)" : "");
+}
 
-    closedir(dir);
-    ESP_LOGI(TAG, "Scanned directory %s: %d files, %d subdirectories", path.c_str(), file_count, dir_count);
-    recursion_depth--;
+// 显式栈代替递归，按与递归相同的先序遍历目录，保证与索引中的目录顺序一致
+void Esp32Music::ScanMusicDirectories(const std::string& music_folder, bool LightModeScan, LibraryScanState& state) {
+    std::vector<std::string> pending;
+    std::vector<std::string> subdirs;
+    pending.push_back(music_folder);
+    bool is_top_level = true;
+    while (!pending.empty()) {
+        std::string path = std::move(pending.back());
+        pending.pop_back();
+        subdirs.clear();
+        ScanMusicDirectory(path, LightModeScan, is_top_level, subdirs, state);
+        is_top_level = false;
+        pending.insert(pending.end(), std::make_move_iterator(subdirs.rbegin()), std::make_move_iterator(subdirs.rend()));
+    }
 }
 
 
@@ -2148,24 +2261,44 @@ bool Esp32Music::ScanMusicLibrary(const std::string& music_folder,bool LightMode
         ESP_LOGE(TAG, "Music folder invalid: %s", music_folder.c_str());
         return false;
     }
+    int64_t start_time = esp_timer_get_time();
     {
         std::lock_guard<std::mutex> lock(music_library_mutex_);
         free_ps_music_library_locked();
         music_library_scanned_ = false;
     }
-    ScanDirectoryRecursive(music_folder,LightModeScan);
+    // 索引放在音乐目录之外，写索引不会改变被扫描目录的签名
+    const std::string index_path = music_folder + ".idx";
+    const uint32_t config_hash = LibraryConfigHash();
+    music_index_.Load(index_path, config_hash);
+
+    if (music_index_.loaded()) {
+        // 预留索引中的条数，发布时不再扩容数组
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        ps_reserve_music_locked(music_index_.record_count());
+    }
+
+    LibraryScanState state;
+    ScanMusicDirectories(music_folder, LightModeScan, state);
+    // 所有目录都未变化且顺序相同，库与索引逐条一致
+    bool unchanged = music_index_.loaded() && state.parsed_dirs == 0 && state.in_index_order &&
+                     state.dirs.size() == music_index_.dir_count() && ps_music_count_ == music_index_.record_count();
     {
+        // 视图发布前搜索走模糊匹配，加锁后一次建好
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
         /* 1. 申请两套视图 */
         size_t n = ps_music_count_;
-        music_view_        = (MusicView *)heap_caps_malloc(n * sizeof(MusicView), MALLOC_CAP_SPIRAM);
+        music_view_        = (MusicView *)heap_caps_malloc((n ? n : 1) * sizeof(MusicView), MALLOC_CAP_SPIRAM);
         // music_view_art_song_ = (MusicView *)heap_caps_malloc(n * sizeof(MusicView), MALLOC_CAP_SPIRAM);
         // music_view_singer_ = (MusicView *)heap_caps_malloc(n * sizeof(MusicView), MALLOC_CAP_SPIRAM);
         
-        /* 2. 填指针（零拷贝）*/
+        /* 2. 填指针（零拷贝）；库未变化时按索引中保存的顺序填，省去排序 */
+        const uint32_t *saved_view = unchanged ? music_index_.view() : nullptr;
         for (size_t i = 0; i < n; ++i) {
-            music_view_[i].song_name   = ps_music_library_[i].song_name;
-            music_view_[i].artist_norm = ps_music_library_[i].artist_norm;
-            music_view_[i].idx         = i;
+            size_t idx = saved_view ? saved_view[i] : i;
+            music_view_[i].song_name   = ps_music_library_[idx].song_name;
+            music_view_[i].artist_norm = ps_music_library_[idx].artist_norm;
+            music_view_[i].idx         = idx;
 
             // music_view_art_song_[i]    = music_view_[i];   // 先复拷一份
             // music_view_singer_[i]      = music_view_[i];   // 先复拷一份
@@ -2176,7 +2309,9 @@ bool Esp32Music::ScanMusicLibrary(const std::string& music_folder,bool LightMode
             return strcmp(((const MusicView*)a)->song_name,
                           ((const MusicView*)b)->song_name);
         };
-        qsort(music_view_, n, sizeof(MusicView), cmpSong);
+        if (!saved_view) {
+            qsort(music_view_, n, sizeof(MusicView), cmpSong);
+        }
 
         // /* 4. artist-song 视图排序 */
         // auto cmpArtSong = [](const void *a, const void *b){
@@ -2197,20 +2332,111 @@ bool Esp32Music::ScanMusicLibrary(const std::string& music_folder,bool LightMode
         //                 ((const MusicView*)b)->artist_norm);
         // };
         // qsort(music_view_singer_, n, sizeof(MusicView), cmpSinger);
+
+        /* 6. 模糊搜索用的二元组索引，歌曲超过 65536 首时不建，搜索退回逐条打分 */
+        for (size_t i = 0; i < n && n <= NgramIndex::kMaxEntries; ++i) {
+            music_ngrams_.Add(i, ps_music_library_[i].song_name);
+            music_ngrams_.Add(i, ps_music_library_[i].token_norm);
+        }
+        music_ngrams_.Build(n);
+        music_library_scanned_ = true;
+    }
+
+    // 夜灯模式只扫描部分目录，保存会丢掉其余目录的缓存
+    if (!unchanged && !LightModeScan) {
+        std::vector<uint32_t> view(ps_music_count_);
+        for (size_t i = 0; i < ps_music_count_; ++i) {
+            view[i] = music_view_[i].idx;
+        }
+        MusicLibraryIndex::Save(index_path, config_hash, state.dirs, ps_music_library_, ps_music_count_, view.data());
+    }
+    ESP_LOGI(TAG, "Music library scan completed, found %u music files in %u ms (%u directories indexed, %u parsed)",
+             (unsigned)ps_music_count_, (unsigned)((esp_timer_get_time() - start_time) / 1000),
+             (unsigned)state.reused_dirs, (unsigned)state.parsed_dirs);
+    {
+        // 记录、排序视图、字符串池、已加载的索引与二元组索引
+        size_t bytes = ps_music_capacity_ * sizeof(PSMusicInfo) + ps_music_count_ * sizeof(MusicView) +
+                       music_strings_.bytes_reserved() + music_index_.size() + music_ngrams_.memory_bytes();
+        size_t blocks = (ps_music_library_ ? 1 : 0) + (music_view_ ? 1 : 0) + music_strings_.block_count() +
+                        (music_index_.loaded() ? 1 : 0) + (music_ngrams_.ready() ? 2 : 0);
+        ESP_LOGI(TAG, "Music library memory: %u bytes, %u per track, %u heap blocks", (unsigned)bytes,
+                 (unsigned)(ps_music_count_ ? bytes / ps_music_count_ : 0), (unsigned)blocks);
     }
-    ESP_LOGI(TAG, "Music library scan completed, found %u music files", (unsigned)ps_music_count_);
     return ps_music_count_ > 0;
 }
 
+// 交给后台扫描任务，立即返回；扫描期间查询使用已发布的部分
 void Esp32Music::ScanAndLoadMusic(bool LightModeScan) {
     ESP_LOGI(TAG, "Initializing default playlists from SD card music library");
+    scan_light_mode_ = LightModeScan;
+    music_scanning_ = true;
+    xEventGroupSetBits(event_group_, SCAN_EVENT_MUSIC);
+}
+
+void Esp32Music::ResetScanProgress() {
+    scan_files_ = 0;
+    scan_dirs_ = 0;
+    scan_dirs_indexed_ = 0;
+    scan_start_us_ = esp_timer_get_time();
+    scan_end_us_ = 0;
+}
+
+void Esp32Music::LibraryScanTask() {
+    while (true) {
+        EventBits_t bits = xEventGroupWaitBits(event_group_, SCAN_EVENT_MUSIC | SCAN_EVENT_STORY, pdTRUE, pdFALSE, portMAX_DELAY);
+        // 故事库较小，先扫描
+        if (bits & SCAN_EVENT_STORY) {
+            ResetScanProgress();
+            if (!ScanStoryLibrary("/sdcard/story")) {
+                ESP_LOGW(TAG, "ScanStoryLibrary failed or SD not ready");
+            }
+            LoadStoryPlaybackPosition();
+            scan_end_us_ = esp_timer_get_time();
+            story_scanning_ = false;
+        }
+        if (bits & SCAN_EVENT_MUSIC) {
+            ResetScanProgress();
+            if (!ScanMusicLibrary("/sdcard/music", scan_light_mode_)) {
+                ESP_LOGW(TAG, "ScanMusicLibrary failed or SD not ready");
+            }
+            LoadPlaybackPosition();
+            scan_end_us_ = esp_timer_get_time();
+            music_scanning_ = false;
+        }
+        BuildUnifiedMediaLibrary();
+
+        int64_t elapsed_us = scan_end_us_ - scan_start_us_;
+        ESP_LOGI(TAG, "Library scan finished: %u files in %u directories (%u indexed), %u ms, %u files/s",
+                 (unsigned)scan_files_, (unsigned)scan_dirs_, (unsigned)scan_dirs_indexed_, (unsigned)(elapsed_us / 1000),
+                 (unsigned)(elapsed_us > 0 ? (uint64_t)scan_files_ * 1000000 / elapsed_us : 0));
+    }
+}
+
+LibraryScanStatus Esp32Music::GetLibraryScanStatus() const {
+    LibraryScanStatus status;
+    status.music_scanning = music_scanning_;
+    status.story_scanning = story_scanning_;
+    {
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        status.music_count = ps_music_count_;
+    }
     {
-        // 清理并扫描
-        if (!ScanMusicLibrary("/sdcard/music",LightModeScan)) {
-            ESP_LOGW(TAG, "ScanMusicLibrary failed or SD not ready");
+        std::lock_guard<std::mutex> lock(story_index_mutex_);
+        status.story_count = ps_story_count_;
+    }
+    status.files_scanned = scan_files_;
+    status.dirs_scanned = scan_dirs_;
+    status.dirs_indexed = scan_dirs_indexed_;
+    int64_t start_us = scan_start_us_;
+    if (start_us > 0) {
+        int64_t end_us = scan_end_us_;
+        int64_t elapsed_us = (end_us > 0 ? end_us : esp_timer_get_time()) - start_us;
+        status.elapsed_ms = elapsed_us / 1000;
+        if (elapsed_us > 0) {
+            status.files_per_second = (uint64_t)status.files_scanned * 1000000 / elapsed_us;
         }
     }
-    LoadPlaybackPosition();
+    return status;
 }
 
 
@@ -2416,61 +2642,6 @@ MusicFileInfo Esp32Music::ExtractMusicInfo(const std::string& file_path) const {
 }
 
 
-std::string Esp32Music::NormalizeForToken(const std::string &s) const {
-    std::string out;
-    out.reserve(s.size());
-    for (size_t i = 0; i < s.size(); ++i) {
-        unsigned char c = static_cast<unsigned char>(s[i]);
-        if (c < 0x80) {
-            if (std::isalnum(c) || c == '-') out.push_back(static_cast<char>(std::tolower(c)));
-            else if (out.empty() || out.back() != ' ') out.push_back(' ');
-        } else {
-            size_t seq_len = 1;
-            if ((c & 0xE0) == 0xC0) seq_len = 2;
-            else if ((c & 0xF0) == 0xE0) seq_len = 3;
-            else if ((c & 0xF8) == 0xF0) seq_len = 4;
-            if (i + seq_len <= s.size()) {
-                out.append(s.substr(i, seq_len));
-                i += seq_len - 1;
-            }
-        }
-    }
-    // trim
-    while (!out.empty() && out.front() == ' ') out.erase(out.begin());
-    while (!out.empty() && out.back() == ' ') out.pop_back();
-    return out;
-}
-
-std::string NormalizeForSearch(std::string s) {
-    std::string out;
-    out.reserve(s.size());
-    for (size_t i = 0; i < s.size(); ++i) {
-        unsigned char c = static_cast<unsigned char>(s[i]);
-        if (c < 0x80) {
-            // ASCII：保留字母数字与连字符 '-'（字母转小写），丢弃空白与其它标点
-            if (std::isalnum(c) || c == '-' || c == '.' || c == '#') {
-                out.push_back(static_cast<char>(std::tolower(c)));
-            }
-        } else {
-            // 非 ASCII：保留完整的 UTF-8 多字节序列
-            size_t seq_len = 1;
-            if ((c & 0xE0) == 0xC0) seq_len = 2;
-            else if ((c & 0xF0) == 0xE0) seq_len = 3;
-            else if ((c & 0xF8) == 0xF0) seq_len = 4;
-            // 安全拷贝，避免越界
-            if (i + seq_len <= s.size()) {
-                out.append(s.substr(i, seq_len));
-                i += seq_len - 1;
-            } else {
-                // 不完整序列时把剩余都追加并结束
-                out.append(s.substr(i));
-                break;
-            }
-        }
-    }
-    return out;
-}
-
 //提取曲名的规范化信息（用于搜索匹配）
 SongMeta ParseSongMeta(const std::string& filename) {
     SongMeta meta;
@@ -2581,9 +2752,19 @@ void Esp32Music::NextPlayIndexOrder(std::string& playlist_name) {
 
 
 std::string Esp32Music::SearchMusicFromlistByIndex(std::string list) const {
-    if(list != default_musiclist_)
+    // 后台扫描会扩容数组，持锁复制出歌曲名
+    std::lock_guard<std::mutex> lock(music_library_mutex_);
+    if(list != default_musiclist_) {
+        if (playlist_.play_index < 0 || static_cast<size_t>(playlist_.play_index) >= playlist_.file_paths.size()) {
+            return std::string();
+        }
         return playlist_.file_paths[playlist_.play_index];
+    }
 
+    if (play_index_ < 0 || static_cast<size_t>(play_index_) >= ps_music_count_ ||
+        !ps_music_library_[play_index_].song_name) {
+        return std::string();
+    }
     return ps_music_library_[play_index_].song_name;
 }
 std::string Esp32Music::GetCurrentPlayList(void) {
@@ -2620,150 +2801,68 @@ void Esp32Music::SetCurrentPlayList(const std::string& playlist_name) {
 }
 
 bool Esp32Music::PlayPlaylist(const std::string& playlist_name) {
-    
+    // PlayFromSD 会更新播放记录并查找曲库，两者都要加锁，这里只在锁内复制出路径与歌曲名
+    std::string file_path;
+    std::string song_name;
 
     if (playlist_name == default_musiclist_) {
         ESP_LOGW(TAG, "Playing default music library");
         std::lock_guard<std::mutex> lock(music_library_mutex_);
-        bool result = PlayFromSD(ps_music_library_[play_index_].file_path, ps_music_library_[play_index_].song_name);
-        return result;
+        if (play_index_ < 0 || static_cast<size_t>(play_index_) >= ps_music_count_ ||
+            !ps_music_library_[play_index_].file_path) {
+            ESP_LOGW(TAG, "Play index out of range: %d", play_index_);
+            return false;
+        }
+        file_path = ps_music_library_[play_index_].file_path;
+        song_name = ps_music_library_[play_index_].song_name ? ps_music_library_[play_index_].song_name : "";
     }
     else
     {
         ESP_LOGW(TAG, "Playing playlist: %s", playlist_name.c_str());
-        auto file = GetMusicInfo(playlist_.file_paths[playlist_.play_index]);
-        std::lock_guard<std::mutex> lock(music_library_mutex_);
-        bool result = PlayFromSD(file.file_path, file.song_name);
-        return result;
-    }
-}
-
-
-
-bool Esp32Music:: IsSubsequence(const char* q, const char* t)const {
-    if (!q || !t) return false;
-    size_t iq = 0, it = 0;
-    const unsigned char *pq = (const unsigned char*)q;
-    const unsigned char *pt = (const unsigned char*)t;
-    while (pq[iq] && pt[it]) {
-        if (pq[iq] == pt[it]) { ++iq; ++it; if (!pq[iq]) return true; }
-        else ++it;
-    }
-    return pq[iq] == 0;
-}
-
-std::vector<std::string> Esp32Music:: SplitTokensNoAlloc(const std::string &token_norm)const {
-    std::vector<std::string> t;
-    size_t i = 0;
-    while (i < token_norm.size()) {
-        while (i < token_norm.size() && token_norm[i] == ' ') ++i;
-        size_t j = i;
-        while (j < token_norm.size() && token_norm[j] != ' ') ++j;
-        if (j > i) t.emplace_back(token_norm.substr(i, j - i));
-        i = j;
-    }
-    return t;
-}
-
-bool Esp32Music::TokenSeqMatchUsingTokenNormNoAlloc(const char* tgt_token_norm, const std::vector<std::string>& qtokens) const{
-    if (!tgt_token_norm) return false;
-    const char* p = tgt_token_norm;
-    for (const auto &qt : qtokens) {
-        if (qt.empty()) continue;
-        const char* found = strstr(p, qt.c_str());
-        if (!found) return false;
-        p = found + qt.size();
+        {
+            std::lock_guard<std::mutex> lock(music_library_mutex_);
+            if (playlist_.play_index < 0 || static_cast<size_t>(playlist_.play_index) >= playlist_.file_paths.size()) {
+                ESP_LOGW(TAG, "Playlist index out of range: %d", playlist_.play_index);
+                return false;
+            }
+            file_path = playlist_.file_paths[playlist_.play_index];
+        }
+        auto file = GetMusicInfo(file_path);
+        if (!file.file_path.empty()) {
+            song_name = file.song_name;
+        }
     }
-    return true;
+    return PlayFromSD(file_path, song_name);
 }
 
-void Esp32Music:: ComputeFreqVector(const char* s, std::vector<int>& freq) const{
-    std::fill(freq.begin(), freq.end(), 0);
-    if (!s) return;
-    const unsigned char* ps = (const unsigned char*)s;
-    for (size_t k = 0; ps[k]; ++k) ++freq[ps[k]];
-}
 
-int Esp32Music::OverlapScoreFromFreq(const std::vector<int>& freq_q, const std::vector<int>& freq_t, int qlen)const {
-    int common = 0;
-    for (int b = 0; b < 256; ++b) common += std::min(freq_q[b], freq_t[b]);
-    double overlap = (qlen > 0) ? (double)common / (double)qlen : 0.0;
-    return static_cast<int>(overlap * 100.0);
-}
 
 int Esp32Music::SearchMusicIndexFromlist(std::string name) const
 {
-    if (!music_view_) return -1;
-
     std::string orig_query = name;
     name = NormalizeForSearch(name);
     if (name.empty()) return -1;
 
-    /* 精确二分 */
+    // 后台扫描会在两批之间扩容数组，查询期间持锁
+    std::lock_guard<std::mutex> lock(music_library_mutex_);
+
+    /* 精确二分；扫描未完成时还没有有序视图，直接走模糊匹配 */
     auto cmp = [](const void *k, const void *e){
         return strcmp((const char*)k, ((const MusicView*)e)->song_name);
     };
-    void *found = bsearch(name.c_str(), music_view_,
-                          ps_music_count_, sizeof(MusicView), cmp);
+    void *found = music_view_ ? bsearch(name.c_str(), music_view_,
+                                        ps_music_count_, sizeof(MusicView), cmp) : nullptr;
     if (found) {
         return ((MusicView*)found)->idx;
     }
 
-    // 预处理 token 查询
-    std::string q_token_norm = NormalizeForToken(orig_query);
-    auto q_tokens = SplitTokensNoAlloc(q_token_norm);
-    const char* q_c = name.c_str();
-
-    // 预计算 query 的字节频率（堆上）
-    std::vector<int> freq_q(256, 0);
-    {
-        const unsigned char* pq = (const unsigned char*)q_c;
-        for (size_t k = 0; pq[k]; ++k) ++freq_q[pq[k]];
-    }
-
-    int best_idx = -1;
-    int best_score = INT_MIN;
-    int best_len_diff = INT_MAX;
-    std::vector<int> freq_t(256);
-
-    // std::lock_guard<std::mutex> lock(music_library_mutex_);
-    for (size_t i = 0; i < ps_music_count_; ++i) {
-        const PSMusicInfo &m = ps_music_library_[i];
-        if (!m.song_name) continue;
-        const char* tgt = m.song_name;
-        if (!tgt) continue;
-
-        int score = 0;
-
-        if (strstr(tgt, q_c) != nullptr) score += 400;
-        if (strncmp(tgt, q_c, strlen(q_c)) == 0) score += 120;
-        if (IsSubsequence(q_c, tgt)) score += 150;
-
-        const char* targ_token = m.token_norm ? m.token_norm : (m.file_name ? m.file_name : m.song_name);
-        if (!q_tokens.empty() && targ_token && TokenSeqMatchUsingTokenNormNoAlloc(targ_token, q_tokens)) score += 200;
-
-        ComputeFreqVector(tgt, freq_t);
-        int qlen = (int)strlen(q_c);
-        int tgtlen = (int)strlen(tgt);
-        score += OverlapScoreFromFreq(freq_q, freq_t, qlen);
-
-        int len_diff = std::abs(qlen - tgtlen);
-        score += std::max(0, 30 - len_diff);
-
-        bool replace = false;
-        if (score > best_score) replace = true;
-        else if (score == best_score && len_diff < best_len_diff) replace = true;
-
-        if (replace) {
-            best_score = score;
-            best_idx = static_cast<int>(i);
-            best_len_diff = len_diff;
-            if (best_score >= 700) break;
-        }
-    }
+    // 模糊匹配：二元组索引只决定给哪些歌曲打分，结果与逐条打分相同
+    MediaSearchResult result;
+    int best_idx = SearchMusicFuzzy(ps_music_library_, ps_music_count_, &music_ngrams_, orig_query, &result);
+    int best_score = result.score;
 
     if (best_idx < 0) {
-        ESP_LOGW(TAG, "no fuzzy match for: %s", orig_query.c_str());
+        ESP_LOGW(TAG, "no fuzzy match for: %s%s", orig_query.c_str(), music_scanning_ ? " (library scan in progress)" : "");
         return -1;
     }
 
@@ -3045,9 +3144,12 @@ bool Esp32Music::TestiftResume() const {
         ESP_LOGI(TAG, "No saved playback position to resume");
         return false;
     }
-    if (saved_play_index_ < 0 || saved_play_index_ >= ps_music_count_) {
-        ESP_LOGW(TAG, "Saved play index out of range: %d", saved_play_index_);
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        if (saved_play_index_ < 0 || saved_play_index_ >= ps_music_count_) {
+            ESP_LOGW(TAG, "Saved play index out of range: %d", saved_play_index_);
+            return false;
+        }
     }
 
     ESP_LOGW(TAG, "Saved playback position is valid: index=%d", saved_play_index_);
@@ -3056,30 +3158,43 @@ bool Esp32Music::TestiftResume() const {
 bool Esp32Music::ResumeSavedPlayback() {
 
     size_t index;
-    auto info = FindMusicByIndexId(saved_music_number_,&index);
-    if(info != nullptr)
-    {
-        ESP_LOGI(TAG, "Found music by index_id: %s -> %s", saved_music_number_.c_str(), info->song_name);
+    if (FindMusicByIndexId(saved_music_number_, &index) != nullptr) {
         saved_play_index_ = static_cast<int>(index);
     }
 
+    // 持锁复制出路径与歌曲名，扫描期间数组可能被扩容，PlayFromSD 不能在锁内访问数组
+    std::string file_path;
+    std::string song_name;
+    {
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        if (saved_play_index_ < 0 || static_cast<size_t>(saved_play_index_) >= ps_music_count_ ||
+            !ps_music_library_[saved_play_index_].file_path) {
+            ESP_LOGW(TAG, "Saved play index out of range: %d", saved_play_index_);
+            return false;
+        }
+        const PSMusicInfo& info = ps_music_library_[saved_play_index_];
+        file_path = info.file_path;
+        song_name = info.song_name ? info.song_name : "";
+    }
+    ESP_LOGI(TAG, "Found music by index_id: %s -> %s", saved_music_number_.c_str(), song_name.c_str());
+
     if(current_play_file_offset_ == 0)
     {    
         // 优先按字节偏移恢复
         if (saved_file_offset_ > 0) {
-            ESP_LOGI(TAG, "Resuming '%s' at offset %d", ps_music_library_[saved_play_index_].file_path, saved_file_offset_);
-            return PlayFromSD(ps_music_library_[saved_play_index_].file_path, ps_music_library_[saved_play_index_].song_name, saved_file_offset_);
+            ESP_LOGI(TAG, "Resuming '%s' at offset %d", file_path.c_str(), saved_file_offset_);
+            return PlayFromSD(file_path, song_name, saved_file_offset_);
         }
     }
     else
     {
-        ESP_LOGI(TAG, "Resuming '%s' at current offset %d", ps_music_library_[saved_play_index_].file_path, current_play_file_offset_);
-        return PlayFromSD(ps_music_library_[saved_play_index_].file_path, ps_music_library_[saved_play_index_].song_name, current_play_file_offset_);
+        ESP_LOGI(TAG, "Resuming '%s' at current offset %d", file_path.c_str(), current_play_file_offset_);
+        return PlayFromSD(file_path, song_name, current_play_file_offset_);
     }
     // 否则从头开始播放
-    ESP_LOGI(TAG, "Resume fallback: start from beginning of %s", ps_music_library_[saved_play_index_].file_path);
+    ESP_LOGI(TAG, "Resume fallback: start from beginning of %s", file_path.c_str());
 
-    return PlayFromSD(ps_music_library_[saved_play_index_].file_path, ps_music_library_[saved_play_index_].song_name, 0);
+    return PlayFromSD(file_path, song_name, 0);
 }
 
 // 新增：带 start_offset 参数的 PlayFromSD（设置 start_play_offset_ 后调用现有 StartSDCardStreaming）
@@ -3194,9 +3309,9 @@ void Esp32Music::UpdateMusicRecordList(const std::string& Index, const std::stri
     int idx = play_index_;
     if (current_playlist_name_ != default_musiclist_) {
         if (!Index.empty()) {
-            const PSMusicInfo* info = FindMusicByIndexId(Index);
-            if (info) {
-                idx = static_cast<int>(info - ps_music_library_);
+            size_t found = 0;
+            if (FindMusicByIndexId(Index, &found)) {
+                idx = static_cast<int>(found);
             } else {
                 ESP_LOGW(TAG, "No music found with index_id: %s", Index.c_str());
             }
@@ -3206,20 +3321,19 @@ void Esp32Music::UpdateMusicRecordList(const std::string& Index, const std::stri
         }
     }
 
-    // 新节点（尾插），不复制字符串，仅保存指针到已有 ps_music_library_ 字符串
+    // 新节点（尾插）。重新扫描会释放曲库字符串，记录里保存副本，持锁复制
     Music_Record_Info* node = new Music_Record_Info();
     node->index = idx;
     node->next = nullptr;
     node->last = nullptr;
 
-    if (idx >= 0 && ps_music_library_ && static_cast<size_t>(idx) < ps_music_count_) {
-        node->song_name = ps_music_library_[idx].song_name;   // 指向 PSRAM 内的 char*
-        node->M_Index = ps_music_library_[idx].index_id;
-        // node->artist = ps_music_library_[idx].artist;
-    } else {
-        node->song_name = nullptr;
-        node->M_Index = nullptr;
-        // node->artist = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        if (idx >= 0 && ps_music_library_ && static_cast<size_t>(idx) < ps_music_count_) {
+            const PSMusicInfo& info = ps_music_library_[idx];
+            node->song_name = info.song_name ? info.song_name : "";
+            node->M_Index = info.index_id ? info.index_id : "";
+        }
     }
 
     if (!music_record_) {
@@ -3260,13 +3374,8 @@ void Esp32Music::UpdateMusicRecordList(const std::string& Index, const std::stri
 
 void Esp32Music::ScanAndLoadStory() {
     ESP_LOGI(TAG, "Initializing default playlists from SD card story library");
-    {
-        // 清理并扫描
-        if (!ScanStoryLibrary("/sdcard/story")) {
-            ESP_LOGW(TAG, "ScanStoryLibrary failed or SD not ready");
-        }
-    }
-    LoadStoryPlaybackPosition();
+    story_scanning_ = true;
+    xEventGroupSetBits(event_group_, SCAN_EVENT_STORY);
 }
 
 
@@ -3274,8 +3383,6 @@ static std::string NormalizeForSearch_local(const std::string &s) {
     return NormalizeForSearch(s);
 }
 
-
-
 // 释放 PSRAM 中的故事索引
 void Esp32Music::free_ps_story_index_locked() {
     if (!ps_story_index_) return;
@@ -3304,6 +3411,7 @@ void Esp32Music::free_ps_story_index_locked() {
     }
     ps_story_count_ = 0;
     ps_story_capacity_ = 0;
+    story_ngrams_.Clear();
 }
 
 bool Esp32Music::ps_add_story_locked(const StoryEntry &e) {
@@ -3466,6 +3574,8 @@ bool Esp32Music::ScanStoryLibrary(const std::string& story_folder) {
         DIR* d_story = opendir(cat_path.c_str());
         if (!d_story) continue;
         struct dirent* ent_story;
+        // 一个类别的故事解析完后一次加锁发布
+        std::vector<StoryEntry> batch;
 
         while ((ent_story = readdir(d_story)) != nullptr) {
             const char* sname = ent_story->d_name;
@@ -3540,22 +3650,43 @@ bool Esp32Music::ScanStoryLibrary(const std::string& story_folder) {
             se.chapters = std::move(chapters);
             se.norm_category = NormalizeForSearch_local(se.category);
             se.norm_story = NormalizeForSearch_local(se.story);
+            batch.push_back(std::move(se));
+        }
+        closedir(d_story);
 
-            {
-                std::lock_guard<std::mutex> lock(story_index_mutex_);
+        {
+            std::lock_guard<std::mutex> lock(story_index_mutex_);
+            for (const auto& se : batch) {
                 if (ps_add_story_locked(se)) {
                     added++;
+                    scan_files_ += se.chapters.size();
                 } else {
                     ESP_LOGW(TAG, "Failed to add story to PSRAM: %s / %s", se.category.c_str(), se.story.c_str());
                     // 继续扫描其它故事
                 }
             }
         }
-        closedir(d_story);
+        scan_dirs_++;
     }
 
     closedir(d_cat);
 
+    {
+        // 模糊搜索用的二元组索引，与 FindStoryIndexFuzzy 的子串匹配对象一致
+        std::lock_guard<std::mutex> lock(story_index_mutex_);
+        for (size_t i = 0; i < ps_story_count_ && ps_story_count_ <= NgramIndex::kMaxEntries; ++i) {
+            const PSStoryEntry &e = ps_story_index_[i];
+            story_ngrams_.Add(i, e.norm_story);
+            story_ngrams_.Add(i, e.token_norm);
+            for (size_t j = 0; j < e.chapter_count; ++j) {
+                if (e.chapters && e.chapters[j]) {
+                    story_ngrams_.Add(i, NormalizeChapterName(e.chapters[j]).c_str());
+                }
+            }
+        }
+        story_ngrams_.Build(ps_story_count_);
+    }
+
     ESP_LOGI(TAG, "Story library scan completed, entries=%u", (unsigned)ps_story_count_);
 
     return ps_story_count_ > 0;
@@ -3710,91 +3841,16 @@ std::vector<std::string> Esp32Music::GetChaptersForStory(const std::string& cate
 
 
 size_t Esp32Music::FindStoryIndexFuzzy(const std::string& story_name) const {
-    std::string q_norm = NormalizeForSearch_local(story_name);
-    if (q_norm.empty()) return SIZE_MAX;
-
-    // 先快速精确匹配（规范化后）
-    {
-        std::lock_guard<std::mutex> lock(story_index_mutex_);
-        for (size_t i = 0; i < ps_story_count_; ++i) {
-            const PSStoryEntry &e = ps_story_index_[i];
-            if (e.norm_story == q_norm) return i;
-        }
-    }
-
-    // 预处理 token 与频率向量
-    std::string q_token_norm = NormalizeForToken(story_name);
-    auto q_tokens = SplitTokensNoAlloc(q_token_norm);
-
-    std::vector<int> freq_q(256, 0);
-    {
-        const unsigned char* pq = (const unsigned char*)q_norm.c_str();
-        for (size_t k = 0; pq[k]; ++k) ++freq_q[pq[k]];
-    }
-
-    int best_score = INT_MIN;
-    size_t best_idx = SIZE_MAX;
-
+    // 先精确匹配（规范化后），再模糊匹配；二元组索引只决定给哪些故事打分
     std::lock_guard<std::mutex> lock(story_index_mutex_);
-    for (size_t i = 0; i < ps_story_count_; ++i) {
-        const PSStoryEntry &e = ps_story_index_[i];
-        if (!e.story_name) continue;
-
-        const std::string &norm_story = e.norm_story;
-        const char* story_c = norm_story.c_str();
-
-        int score = 0;
-
-        // 直接子串与子序列匹配
-        if (story_c && strstr(story_c, q_norm.c_str())) score += 400;
-        if (IsSubsequence(q_norm.c_str(), story_c)) score += 200;
-
-        // token 顺序匹配（利用 PSRAM 中的 token_norm）
-        const char* targ_token = e.token_norm;
-        if (targ_token && !q_tokens.empty() && TokenSeqMatchUsingTokenNormNoAlloc(targ_token, q_tokens)) score += 300;
-
-        // 字符重合度
-        std::vector<int> freq_t(256, 0);
-        ComputeFreqVector(story_c, freq_t);
-        int qlen = (int)strlen(q_norm.c_str());
-        score += OverlapScoreFromFreq(freq_q, freq_t, qlen);
-
-        // 编辑距离保守加分
-        int d = levenshtein_threshold(q_norm.c_str(), story_c, 6);
-        if (d >= 0 && d <= 3) score += std::max(0, 80 - d * 20);
-
-        // 章节名匹配也加分
-        for (size_t j = 0; j < e.chapter_count; ++j) {
-            const char* chap = e.chapters && e.chapters[j] ? e.chapters[j] : nullptr;
-            if (!chap) continue;
-            std::string chapname = chap;
-            size_t p = chapname.find_last_of("/\\");
-            if (p != std::string::npos) chapname = chapname.substr(p + 1);
-            size_t dot = chapname.find_last_of('.');
-            if (dot != std::string::npos) chapname = chapname.substr(0, dot);
-            std::string norm_ch = NormalizeForSearch_local(chapname);
-            if (!norm_ch.empty() && strstr(norm_ch.c_str(), q_norm.c_str())) score += 180;
-            if (IsSubsequence(q_norm.c_str(), norm_ch.c_str())) score += 80;
-        }
-
-        // 记录最佳（平分时倾向于更短的故事名）
-        bool replace = false;
-        if (score > best_score) replace = true;
-        else if (score == best_score && best_idx != SIZE_MAX) {
-            if (norm_story.size() < (ps_story_index_[best_idx].norm_story ? strlen(ps_story_index_[best_idx].norm_story) : 0)) replace = true;
-        } else if (best_idx == SIZE_MAX && score > INT_MIN) replace = true;
-
-        if (replace) {
-            best_score = score;
-            best_idx = i;
-        }
-    }
-
-    if (best_idx != SIZE_MAX && best_score > 0) {
-        ESP_LOGI(TAG, "FindStoryIndexFuzzy: best hit idx=%u score=%d (%s)", (unsigned)best_idx, best_score,
+    MediaSearchResult result;
+    size_t best_idx = SearchStoryFuzzy(ps_story_index_, ps_story_count_, &story_ngrams_, story_name, &result);
+    if (best_idx != SIZE_MAX) {
+        ESP_LOGI(TAG, "FindStoryIndexFuzzy: best hit idx=%u score=%d (%s)", (unsigned)best_idx, result.score,
                  ps_story_index_[best_idx].story_name ? ps_story_index_[best_idx].story_name : "<nil>");
         return best_idx;
     }
+    ESP_LOGW(TAG, "FindStoryIndexFuzzy: no match for %s%s", story_name.c_str(), story_scanning_ ? " (library scan in progress)" : "");
     return SIZE_MAX;
 }
 
@@ -4296,13 +4352,34 @@ void Esp32Music::BuildUnifiedMediaLibrary() {
         std::sort(view.begin(), view.end(),
                   [](const PSMediaInfo* a, const PSMediaInfo* b) { return a->norm_name < b->norm_name; });
         media_view_.swap(view);
+        // 标题部分是 norm_name 的后缀，只索引 norm_name 即可覆盖前两轮的子串匹配
+        media_ngrams_.Clear();
+        for (size_t i = 0; i < media_view_.size() && media_view_.size() <= NgramIndex::kMaxEntries; ++i) {
+            media_ngrams_.Add(i, media_view_[i]->norm_name.c_str());
+        }
+        media_ngrams_.Build(media_view_.size());
     }
 
     ESP_LOGI(TAG, "Unified media library built, total=%d", media_library_.size());
 }
 
-std::vector<const PSMediaInfo*> Esp32Music::FuzzySearchMedia(const std::string& query, size_t limit) const {
-    std::vector<const PSMediaInfo*> results;
+std::vector<PSMediaInfo> Esp32Music::GetUnifiedMediaLibrary() const {
+    std::lock_guard<std::mutex> guard(media_library_mutex_);
+    return media_library_;
+}
+
+std::vector<PSMediaInfo> Esp32Music::GetUnifiedMediaView() const {
+    std::lock_guard<std::mutex> guard(media_library_mutex_);
+    std::vector<PSMediaInfo> view;
+    view.reserve(media_view_.size());
+    for (const auto* item : media_view_) {
+        view.push_back(*item);
+    }
+    return view;
+}
+
+std::vector<PSMediaInfo> Esp32Music::FuzzySearchMedia(const std::string& query, size_t limit) const {
+    std::vector<PSMediaInfo> results;
     if (query.empty() || limit == 0) return results;
 
     std::string norm_query = NormalizeForSearch(query);
@@ -4311,15 +4388,34 @@ std::vector<const PSMediaInfo*> Esp32Music::FuzzySearchMedia(const std::string&
     std::lock_guard<std::mutex> guard(media_library_mutex_);
     if (media_view_.empty()) return results;
 
+    // 先收集指针，返回前在锁内复制出结果
+    std::vector<const PSMediaInfo*> hits;
     auto push_unique = [&](const PSMediaInfo* item) {
-        if (results.size() >= limit) return;
-        if (std::find(results.begin(), results.end(), item) == results.end()) {
-            results.push_back(item);
+        if (hits.size() >= limit) return;
+        if (std::find(hits.begin(), hits.end(), item) == hits.end()) {
+            hits.push_back(item);
+        }
+    };
+    auto copy_hits = [&]() {
+        results.reserve(hits.size());
+        for (const auto* item : hits) {
+            results.push_back(*item);
         }
+        return std::move(results);
     };
 
+    // 前两轮只匹配子串，只需检查二元组索引给出的条目（按视图顺序）；查询只有一个字时逐条检查
+    std::vector<uint16_t> candidates;
+    bool filtered = media_ngrams_.FindContaining(norm_query.c_str(), candidates);
+    std::vector<const PSMediaInfo*> substring_view;
+    substring_view.reserve(candidates.size());
+    for (uint16_t i : candidates) {
+        substring_view.push_back(media_view_[i]);
+    }
+    const std::vector<const PSMediaInfo*> &substring_items = filtered ? substring_view : media_view_;
+
     // 1) 最优先匹配：独立的音乐名称或故事名称（连字符后面的部分）包含查询词
-    for (const auto* item : media_view_) {
+    for (const auto* item : substring_items) {
         std::string title = item->display_name;
         size_t dash = title.find('-');
         if (dash != std::string::npos) {
@@ -4329,28 +4425,28 @@ std::vector<const PSMediaInfo*> Esp32Music::FuzzySearchMedia(const std::string&
         
         if (norm_title.find(norm_query) != std::string::npos) {
             push_unique(item);
-            if (results.size() >= limit) return results;
+            if (hits.size() >= limit) return copy_hits();
         }
     }
 
     // 2) 其次匹配：整体名称子串匹配（可能包含艺术家/分类的信息）
-    for (const auto* item : media_view_) {
+    for (const auto* item : substring_items) {
         if (item->norm_name.find(norm_query) != std::string::npos) {
             push_unique(item);
-            if (results.size() >= limit) return results;
+            if (hits.size() >= limit) return copy_hits();
         }
     }
 
     // 3) 最后匹配：不连续的子序列匹配
     for (const auto* item : media_view_) {
-        if (results.size() >= limit) break;
+        if (hits.size() >= limit) break;
         if (item->norm_name.find(norm_query) != std::string::npos) continue;
         if (IsSubsequence(norm_query.c_str(), item->norm_name.c_str())) {
             push_unique(item);
         }
     }
 
-    return results;
+    return copy_hits();
 }
 void Esp32Music::SetExcludedSongs(const std::vector<std::string>& songs) { excluded_songs_ = songs; }
 
@@ -12,9 +12,14 @@
 #include <map>
 #include "lvgl.h"
 #include "music.h"
+#include "media_search.h"
+#include "music_library_index.h"
+#include "ngram_index.h"
+#include "string_arena.h"
 #include <esp_lvgl_port.h>
 #include "cstring"
 #include "esp_log.h"
+#include <esp_heap_caps.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <freertos/task.h>
@@ -24,12 +29,11 @@ extern "C" {
 #include "mp3dec.h"
 }
 
-#define MIN3(a, b, c)  ((a) < (b) ? ((a) < (c) ? (a) : (c)) \
-                                    : ((b) < (c) ? (b) : (c)))
-
 #define STORY 1
 #define MUSIC 0
 #define PLAY_EVENT_NEXT (1 << 0)
+#define SCAN_EVENT_MUSIC (1 << 1)
+#define SCAN_EVENT_STORY (1 << 2)
 
 // 音频数据块结构
 struct AudioChunk {
@@ -42,9 +46,8 @@ struct AudioChunk {
 
 struct Music_Record_Info {
     int index;
-    const char* song_name;   // 指向 ps_music_library_ 中的 char*（不复制）
-    // const char* artist;      // 指向 ps_music_library_ 中的 char*（不复制）
-    const char* M_Index; // 歌曲索引编号（例如 M001）
+    std::string song_name;   // 歌曲名副本，重新扫描后曲库字符串会被释放
+    std::string M_Index;     // 歌曲索引编号（例如 M001）
     Music_Record_Info *next;
     Music_Record_Info *last;
 };
@@ -124,35 +127,6 @@ private:
 
 
     int kMaxRecent = 5;
-    // 返回 str1 与 str2 的编辑距离；max 为提前剪枝阈值
-    int levenshtein_threshold(const char *str1, const char *str2, int max)const
-    {
-        int len1 = strlen(str1);
-        int len2 = strlen(str2);
-        if (len1 < len2) { const char *t=str1; str1=str2; str2=t; int l=len1; len1=len2; len2=l; }
-        if (len1 - len2 > max) return max + 1;
-
-        static uint16_t col[128];          // 仅保留前一列，最大歌名长度 128
-        for (int i = 0; i <= len2; ++i) col[i] = i;
-
-        for (int x = 1; x <= len1; ++x) {
-            col[0] = x;
-            int lastDiag = x - 1;
-            int minCol = x;
-            for (int y = 1; y <= len2; ++y) {
-                int oldDiag = col[y];
-                col[y] = MIN3(
-                    col[y] + 1,                 // del
-                    col[y-1] + 1,               // ins
-                    lastDiag + (str1[x-1]!=str2[y-1]) // sub
-                );
-                lastDiag = oldDiag;
-                if (col[y] < minCol) minCol = col[y];
-            }
-            if (minCol > max) return max + 1;   // 提前剪枝
-        }
-        return col[len2];
-    }
 
 
     struct MusicView {
@@ -219,6 +193,17 @@ private:
 
     mutable std::mutex music_library_mutex_;
     std::atomic<bool> music_library_scanned_;
+    // 音乐库的字符串：新解析的放在字符串池，从索引复用的直接指向已加载的索引
+    StringArena music_strings_{MALLOC_CAP_SPIRAM};
+    MusicLibraryIndex music_index_;
+    // 歌名与 token 的二元组倒排索引，扫描完成后建立，模糊搜索只对可能包含查询的歌曲打分
+    NgramIndex music_ngrams_{MALLOC_CAP_SPIRAM};
+    struct LibraryScanState {
+        std::vector<MusicLibraryIndex::ScannedDir> dirs;
+        size_t reused_dirs = 0;
+        size_t parsed_dirs = 0;
+        bool in_index_order = true;     // 库的顺序与索引相同，可直接使用索引中的排序视图
+    };
     const std::string default_musiclist_ = "DefaultMusicList";
     Playlist playlist_;  // 使用简单的容器数组存储歌单
     std::string current_playlist_name_;
@@ -227,24 +212,25 @@ private:
     void ReadFromSDCard(const std::string& file_path);
     bool StartSDCardStreaming(const std::string& file_path);
 
-    void ScanDirectoryRecursive(const std::string& path,bool LightModeScan);
+    void ScanMusicDirectories(const std::string& music_folder, bool LightModeScan, LibraryScanState& state);
+    void ScanMusicDirectory(const std::string& path, bool LightModeScan, bool is_top_level,
+                            std::vector<std::string>& subdirs, LibraryScanState& state);
+    void PublishMusicBatch(std::vector<MusicFileInfo>& batch);
+    uint32_t LibraryConfigHash() const;
     bool IsMusicFile(const std::string& file_path) const;
     MusicFileInfo ExtractMusicInfo(const std::string& file_path) const;
+    bool ps_reserve_music_locked(size_t need);
     bool ps_add_music_info_locked(const MusicFileInfo &info);
+    bool ps_add_indexed_music_locked(const MusicIndexRecord &record);
     bool ps_add_story_locked(const StoryEntry &e);
     void free_ps_music_library_locked();
     void free_ps_story_index_locked();
-    std::string NormalizeForToken(const std::string &s)const;
-    bool IsSubsequence(const char* q, const char* t) const;
-    std::vector<std::string> SplitTokensNoAlloc(const std::string &token_norm)const;
-    bool TokenSeqMatchUsingTokenNormNoAlloc(const char* tgt_token_norm, const std::vector<std::string>& qtokens)const;
-    void ComputeFreqVector(const char* s, std::vector<int>& freq)const; 
-    int OverlapScoreFromFreq(const std::vector<int>& freq_q, const std::vector<int>& freq_t, int qlen)const;
     char* ps_strdup(const std::string &s);
     void ps_free_str(char *p);
     void NextPlayTask(void* arg);
     void PausePlayback();
     void ResumePlayback();
+    void RequestIdleForMusic();
     bool IsActualPaused() const { return actual_pause_; };
     void SetEventNextPlay(void);
     bool is_paused(void){return is_paused_;};
@@ -254,6 +240,7 @@ private:
 
     std::vector<PSMediaInfo> media_library_;
     std::vector<const PSMediaInfo*> media_view_;
+    NgramIndex media_ngrams_{MALLOC_CAP_SPIRAM};   // 按 media_view_ 的位置索引 norm_name
     mutable std::mutex media_library_mutex_;
     void BuildUnifiedMediaLibrary();
 
@@ -261,6 +248,7 @@ private:
     PSStoryEntry *ps_story_index_ = nullptr; // PSRAM 分配的数组
     size_t ps_story_count_ = 0;
     size_t ps_story_capacity_ = 0;
+    NgramIndex story_ngrams_{MALLOC_CAP_SPIRAM};   // 故事名、token 与章节名
     mutable std::mutex story_index_mutex_;
     std::string current_story_name_;
     std::string current_category_name_;
@@ -296,6 +284,18 @@ private:
     bool SaveStoryRecord_ = true;
 
     TaskHandle_t NextPlay_task_handle_ = nullptr;
+    // 低优先级后台扫描任务，结果分批发布，扫描期间可以查询已发布的部分
+    TaskHandle_t library_scan_task_handle_ = nullptr;
+    std::atomic<bool> scan_light_mode_{false};
+    std::atomic<bool> music_scanning_{false};
+    std::atomic<bool> story_scanning_{false};
+    std::atomic<uint32_t> scan_files_{0};
+    std::atomic<uint32_t> scan_dirs_{0};
+    std::atomic<uint32_t> scan_dirs_indexed_{0};
+    std::atomic<int64_t> scan_start_us_{0};
+    std::atomic<int64_t> scan_end_us_{0};
+    void LibraryScanTask();
+    void ResetScanProgress();
     EventGroupHandle_t event_group_ = nullptr;
 public:
     Esp32Music();
@@ -327,7 +327,12 @@ public:
 
     virtual bool TestiftResume() const override;
     virtual bool ScanMusicLibrary(const std::string& music_folder,bool LightModeScan)override;
-    virtual size_t GetMusicCount() const override{ return ps_music_count_; };
+    virtual size_t GetMusicCount() const override {
+        std::lock_guard<std::mutex> lock(music_library_mutex_);
+        return ps_music_count_;
+    };
+    virtual bool IsLibraryScanning() const override { return music_scanning_ || story_scanning_; }
+    virtual LibraryScanStatus GetLibraryScanStatus() const override;
     virtual MusicFileInfo GetMusicInfo(const std::string& file_path) const override;
     virtual const PSMusicInfo* GetMusicLibrary(size_t &out_count) const override;
     virtual bool CreatePlaylist(const std::string& playlist_name, const std::vector<std::string>& file_paths) override;
@@ -485,13 +490,13 @@ public:
     virtual void UpdateStoryRecordList(const std::string& category, const std::string& story, const std::string& chapter)override;
     
     void RebuildUnifiedMediaLibrary() { BuildUnifiedMediaLibrary(); }
-    const std::vector<PSMediaInfo>& GetUnifiedMediaLibrary() const { return media_library_; }
-    const std::vector<const PSMediaInfo*>& GetUnifiedMediaView() const { return media_view_; }
-    std::vector<const PSMediaInfo*> FuzzySearchMedia(const std::string& query, size_t limit = 10) const;};
+    // 以下均返回副本：后台扫描完成后会重建统一媒体库，指针会失效
+    std::vector<PSMediaInfo> GetUnifiedMediaLibrary() const;
+    std::vector<PSMediaInfo> GetUnifiedMediaView() const;
+    std::vector<PSMediaInfo> FuzzySearchMedia(const std::string& query, size_t limit = 10) const;};
 
 
 // 全局辅助函数：从文件名或输入中解析出 SongMeta
 SongMeta ParseSongMeta(const std::string& filename);
-std::string NormalizeForSearch(std::string s) ;
 
 #endif // ESP32_MUSIC_H
\ No newline at end of file
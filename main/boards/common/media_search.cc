@@ -0,0 +1,309 @@
+#include "media_search.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Length of the UTF-8 sequence starting with c, 1 for ASCII and stray bytes
+static size_t Utf8SequenceLength(unsigned char c) {
+    if ((c & 0xE0) == 0xC0) return 2;
+    if ((c & 0xF0) == 0xE0) return 3;
+    if ((c & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+std::string NormalizeForSearch(std::string s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x80) {
+            if (std::isalnum(c) || c == '-' || c == '.' || c == '#') {
+                out.push_back(static_cast<char>(std::tolower(c)));
+            }
+            continue;
+        }
+        // Keep whole UTF-8 sequences, a truncated one ends the string
+        size_t seq_len = Utf8SequenceLength(c);
+        if (i + seq_len > s.size()) {
+            out.append(s, i, std::string::npos);
+            break;
+        }
+        out.append(s, i, seq_len);
+        i += seq_len - 1;
+    }
+    return out;
+}
+
+std::string NormalizeForToken(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x80) {
+            if (std::isalnum(c) || c == '-') out.push_back(static_cast<char>(std::tolower(c)));
+            else if (out.empty() || out.back() != ' ') out.push_back(' ');
+            continue;
+        }
+        size_t seq_len = Utf8SequenceLength(c);
+        if (i + seq_len <= s.size()) {
+            out.append(s, i, seq_len);
+            i += seq_len - 1;
+        }
+    }
+    while (!out.empty() && out.front() == ' ') out.erase(out.begin());
+    while (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+std::string NormalizeChapterName(const char* chapter_path) {
+    std::string name = chapter_path;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos) name = name.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos) name = name.substr(0, dot);
+    return NormalizeForSearch(name);
+}
+
+std::vector<std::string> SplitTokensNoAlloc(const std::string& token_norm) {
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < token_norm.size()) {
+        while (i < token_norm.size() && token_norm[i] == ' ') ++i;
+        size_t j = i;
+        while (j < token_norm.size() && token_norm[j] != ' ') ++j;
+        if (j > i) tokens.emplace_back(token_norm.substr(i, j - i));
+        i = j;
+    }
+    return tokens;
+}
+
+bool IsSubsequence(const char* q, const char* t) {
+    if (!q || !t) return false;
+    size_t iq = 0, it = 0;
+    const unsigned char* pq = (const unsigned char*)q;
+    const unsigned char* pt = (const unsigned char*)t;
+    while (pq[iq] && pt[it]) {
+        if (pq[iq] == pt[it]) {
+            ++iq;
+            ++it;
+            if (!pq[iq]) return true;
+        } else {
+            ++it;
+        }
+    }
+    return pq[iq] == 0;
+}
+
+bool TokenSeqMatchUsingTokenNormNoAlloc(const char* tgt_token_norm, const std::vector<std::string>& qtokens) {
+    if (!tgt_token_norm) return false;
+    const char* p = tgt_token_norm;
+    for (const auto& qt : qtokens) {
+        if (qt.empty()) continue;
+        const char* found = strstr(p, qt.c_str());
+        if (!found) return false;
+        p = found + qt.size();
+    }
+    return true;
+}
+
+void ComputeFreqVector(const char* s, std::vector<int>& freq) {
+    std::fill(freq.begin(), freq.end(), 0);
+    if (!s) return;
+    for (const unsigned char* p = (const unsigned char*)s; *p; ++p) ++freq[*p];
+}
+
+int OverlapScoreFromFreq(const std::vector<int>& freq_q, const std::vector<int>& freq_t, int qlen) {
+    int common = 0;
+    for (int b = 0; b < 256; ++b) common += std::min(freq_q[b], freq_t[b]);
+    double overlap = qlen > 0 ? (double)common / (double)qlen : 0.0;
+    return static_cast<int>(overlap * 100.0);
+}
+
+int levenshtein_threshold(const char* str1, const char* str2, int max) {
+    int len1 = strlen(str1);
+    int len2 = strlen(str2);
+    if (len1 < len2) {
+        std::swap(str1, str2);
+        std::swap(len1, len2);
+    }
+    if (len1 - len2 > max) return max + 1;
+
+    // One column of the matrix; titles fit the stack buffer, longer ones use the heap
+    uint16_t stack_col[128];
+    std::vector<uint16_t> heap_col;
+    uint16_t* col = stack_col;
+    if (len2 >= 128) {
+        heap_col.resize(len2 + 1);
+        col = heap_col.data();
+    }
+    for (int i = 0; i <= len2; ++i) col[i] = i;
+
+    for (int x = 1; x <= len1; ++x) {
+        col[0] = x;
+        int last_diag = x - 1;
+        int min_col = x;
+        for (int y = 1; y <= len2; ++y) {
+            int old_diag = col[y];
+            col[y] = std::min({ col[y] + 1, col[y - 1] + 1, last_diag + (str1[x - 1] != str2[y - 1]) });
+            last_diag = old_diag;
+            min_col = std::min<int>(min_col, col[y]);
+        }
+        if (min_col > max) return max + 1;   // Prune early
+    }
+    return col[len2];
+}
+
+int SearchMusicFuzzy(const PSMusicInfo* songs, size_t count, const NgramIndex* ngrams, const std::string& query,
+                     MediaSearchResult* result) {
+    std::string name = NormalizeForSearch(query);
+    if (result) *result = { INT_MIN, true };
+    if (name.empty()) return -1;
+
+    auto q_tokens = SplitTokensNoAlloc(NormalizeForToken(query));
+    const char* q_c = name.c_str();
+    int qlen = (int)name.size();
+    std::vector<int> freq_q(256, 0);
+    ComputeFreqVector(q_c, freq_q);
+
+    /* The index gives every song that may contain the query. The others get no substring and prefix
+       score, at most 150 + 200 + 100 + 30 = 480: a best candidate above it is the best of all songs,
+       otherwise every song is scored */
+    const int kScoreWithoutSubstring = 480;
+    std::vector<uint16_t> candidates;
+    bool filtered = ngrams && ngrams->FindContaining(q_c, candidates);
+
+    int best_idx = -1;
+    int best_score = INT_MIN;
+    int best_len_diff = INT_MAX;
+    std::vector<int> freq_t(256);
+    for (int pass = filtered ? 0 : 1; pass < 2; ++pass) {
+        if (result) result->fell_back = pass == 1;
+        size_t total = pass == 0 ? candidates.size() : count;
+        best_idx = -1;
+        best_score = INT_MIN;
+        best_len_diff = INT_MAX;
+        for (size_t n = 0; n < total; ++n) {
+            size_t i = pass == 0 ? candidates[n] : n;
+            const PSMusicInfo& m = songs[i];
+            const char* tgt = m.song_name;
+            if (!tgt) continue;
+
+            int score = 0;
+            if (strstr(tgt, q_c) != nullptr) score += 400;
+            if (strncmp(tgt, q_c, qlen) == 0) score += 120;
+            if (IsSubsequence(q_c, tgt)) score += 150;
+
+            const char* targ_token = m.token_norm ? m.token_norm : (m.file_name ? m.file_name : m.song_name);
+            if (!q_tokens.empty() && TokenSeqMatchUsingTokenNormNoAlloc(targ_token, q_tokens)) score += 200;
+
+            ComputeFreqVector(tgt, freq_t);
+            score += OverlapScoreFromFreq(freq_q, freq_t, qlen);
+            int len_diff = std::abs(qlen - (int)strlen(tgt));
+            score += std::max(0, 30 - len_diff);
+
+            // Ties go to the closest length, then to the first song
+            if (score > best_score || (score == best_score && len_diff < best_len_diff)) {
+                best_score = score;
+                best_idx = (int)i;
+                best_len_diff = len_diff;
+                if (best_score >= 700) break;
+            }
+        }
+        if (best_score > kScoreWithoutSubstring) break;
+    }
+    if (result) result->score = best_score;
+    return best_idx;
+}
+
+static int ScoreStory(const PSStoryEntry& e, const std::string& q_norm, const std::vector<std::string>& q_tokens,
+                      const std::vector<int>& freq_q, std::vector<int>& freq_t) {
+    const char* story_c = e.norm_story ? e.norm_story : "";
+    const char* q_c = q_norm.c_str();
+
+    int score = 0;
+    if (strstr(story_c, q_c)) score += 400;
+    if (IsSubsequence(q_c, story_c)) score += 200;
+    if (e.token_norm && !q_tokens.empty() && TokenSeqMatchUsingTokenNormNoAlloc(e.token_norm, q_tokens)) score += 300;
+
+    ComputeFreqVector(story_c, freq_t);
+    score += OverlapScoreFromFreq(freq_q, freq_t, (int)q_norm.size());
+
+    // Conservative bonus for a close edit distance
+    int d = levenshtein_threshold(q_c, story_c, 6);
+    if (d >= 0 && d <= 3) score += std::max(0, 80 - d * 20);
+
+    for (size_t j = 0; j < e.chapter_count; ++j) {
+        const char* chapter = e.chapters ? e.chapters[j] : nullptr;
+        if (!chapter) continue;
+        std::string norm_ch = NormalizeChapterName(chapter);
+        if (!norm_ch.empty() && strstr(norm_ch.c_str(), q_c)) score += 180;
+        if (IsSubsequence(q_c, norm_ch.c_str())) score += 80;
+    }
+    return score;
+}
+
+size_t SearchStoryFuzzy(const PSStoryEntry* stories, size_t count, const NgramIndex* ngrams,
+                        const std::string& query, MediaSearchResult* result) {
+    std::string q_norm = NormalizeForSearch(query);
+    if (result) *result = { INT_MIN, false };
+    if (q_norm.empty()) return SIZE_MAX;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (stories[i].norm_story && q_norm == stories[i].norm_story) {
+            if (result) result->score = INT_MAX;
+            return i;
+        }
+    }
+
+    auto q_tokens = SplitTokensNoAlloc(NormalizeForToken(query));
+    std::vector<int> freq_q(256, 0);
+    ComputeFreqVector(q_norm.c_str(), freq_q);
+    std::vector<int> freq_t(256);
+
+    int best_score = INT_MIN;
+    size_t best_idx = SIZE_MAX;
+    size_t best_len = SIZE_MAX;
+    // Ties go to the shorter story name, then to the lower index, whatever the scoring order
+    auto consider = [&](size_t i) {
+        const PSStoryEntry& e = stories[i];
+        if (!e.story_name) return;
+        int score = ScoreStory(e, q_norm, q_tokens, freq_q, freq_t);
+        size_t len = e.norm_story ? strlen(e.norm_story) : 0;
+        if (score > best_score || (score == best_score && (len < best_len || (len == best_len && i < best_idx)))) {
+            best_score = score;
+            best_idx = i;
+            best_len = len;
+        }
+    };
+
+    /* The index gives the stories whose name, tokens or chapter names may contain the query, they are
+       scored first. The others get no substring score, at most 200 + 300 + 100 + 80 + 80 per chapter,
+       and need no scoring when that cannot reach the best score so far */
+    std::vector<uint16_t> candidates;
+    bool filtered = ngrams && ngrams->FindContaining(q_norm.c_str(), candidates);
+    for (uint16_t i : candidates) {
+        consider(i);
+    }
+    size_t next = 0;
+    size_t skipped = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (next < candidates.size() && candidates[next] == i) {
+            ++next;
+            continue;
+        }
+        if (filtered && 680 + 80 * (long long)stories[i].chapter_count < best_score) {
+            skipped++;
+            continue;
+        }
+        consider(i);
+    }
+    if (result) {
+        result->score = best_score;
+        result->fell_back = !filtered || skipped + candidates.size() < count;
+    }
+    return best_idx != SIZE_MAX && best_score > 0 ? best_idx : SIZE_MAX;
+}
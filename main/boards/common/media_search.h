@@ -0,0 +1,53 @@
+#ifndef MEDIA_SEARCH_H
+#define MEDIA_SEARCH_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "music.h"
+#include "ngram_index.h"
+
+/*
+ * Fuzzy search of the music and story libraries by a spoken title. Every entry gets a score from
+ * substring, prefix, subsequence and token order matches, byte overlap and, for stories, edit distance
+ * and chapter names; the best score wins.
+ *
+ * The bigram index only decides which entries need scoring: an entry not among the candidates cannot
+ * contain the query and its score is bounded, so the result is always the one of scoring every entry.
+ * Callers hold the lock of the library and of its index.
+ */
+
+// Lowercase ASCII letters and digits, '-', '.', '#' and all non-ASCII, for comparing titles
+std::string NormalizeForSearch(std::string s);
+// As above, but other ASCII separates tokens with one space
+std::string NormalizeForToken(const std::string& s);
+// File name of a chapter path without the extension, normalized for search
+std::string NormalizeChapterName(const char* chapter_path);
+
+std::vector<std::string> SplitTokensNoAlloc(const std::string& token_norm);
+bool IsSubsequence(const char* q, const char* t);
+// Whether the tokens appear in this order in tgt_token_norm
+bool TokenSeqMatchUsingTokenNormNoAlloc(const char* tgt_token_norm, const std::vector<std::string>& qtokens);
+void ComputeFreqVector(const char* s, std::vector<int>& freq);
+// Percentage of the query bytes also in the target
+int OverlapScoreFromFreq(const std::vector<int>& freq_q, const std::vector<int>& freq_t, int qlen);
+// Edit distance of str1 and str2, or max + 1 once it exceeds max
+int levenshtein_threshold(const char* str1, const char* str2, int max);
+
+struct MediaSearchResult {
+    int score;
+    bool fell_back;     // Every entry was scored, the candidates of the index did not decide
+};
+
+// Best of songs[0, count) for query, -1 if none. ngrams is the index of the song names and tokens,
+// nullptr scores every song. The caller handles an exact title match first.
+int SearchMusicFuzzy(const PSMusicInfo* songs, size_t count, const NgramIndex* ngrams, const std::string& query,
+                     MediaSearchResult* result = nullptr);
+
+// Index of the story with the normalized name of query, else the best one of stories[0, count), SIZE_MAX
+// if none. ngrams also indexes the chapter names, nullptr scores every story.
+size_t SearchStoryFuzzy(const PSStoryEntry* stories, size_t count, const NgramIndex* ngrams,
+                        const std::string& query, MediaSearchResult* result = nullptr);
+
+#endif // MEDIA_SEARCH_H
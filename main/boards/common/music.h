@@ -17,6 +17,7 @@ struct MusicFileInfo {
     std::string index_id;     // 例如 "M001"
 };
 
+// 字符串由音乐库的字符串池或已加载的索引持有，不能单独释放
 struct PSMusicInfo {
     char *file_path = nullptr;  
     char *file_name = nullptr;
@@ -40,6 +41,19 @@ struct PSStoryEntry {
     char *token_norm = nullptr;  // 保留空格的小写 token-normalized 字符串（存放于 SPIRAM）
     uint32_t idx = 0;              // 故事索引编号
 };
+// 后台扫描进度（音乐与故事共用一个扫描任务，计数针对当前或最近一次扫描）
+struct LibraryScanStatus {
+    bool music_scanning = false;
+    bool story_scanning = false;
+    size_t music_count = 0;
+    size_t story_count = 0;
+    uint32_t files_scanned = 0;      // 已发布的歌曲与故事章节数
+    uint32_t dirs_scanned = 0;
+    uint32_t dirs_indexed = 0;       // 直接从持久化索引复用的目录数
+    uint32_t elapsed_ms = 0;
+    uint32_t files_per_second = 0;
+};
+
 enum PlaybackMode {
     PLAYBACK_MODE_ONCE = 0,     // 播放一次
     PLAYBACK_MODE_LOOP = 1,      // 循环播放
@@ -69,6 +83,9 @@ public:
     virtual void SetMode(bool a) =0;
     virtual void SetExcludedSongs(const std::vector<std::string>& songs) = 0;
     virtual bool ScanMusicLibrary(const std::string& music_folder,bool LightModeScan) = 0;
+    // 扫描在后台进行时，搜索只覆盖已发布的部分曲库
+    virtual bool IsLibraryScanning() const = 0;
+    virtual LibraryScanStatus GetLibraryScanStatus() const = 0;
     virtual size_t GetMusicCount() const = 0;
     virtual MusicFileInfo GetMusicInfo(const std::string& file_path) const =0;
 
@@ -0,0 +1,328 @@
+#include "music_library_index.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#define TAG "MusicLibraryIndex"
+
+namespace {
+
+// Growing string table in PSRAM. Artists and categories repeat over many songs and are stored once.
+class StringTableWriter {
+public:
+    ~StringTableWriter() { heap_caps_free(data_); }
+
+    bool Init() {
+        // Offset 0 is the empty string, shared by every missing field
+        return Append("", 0) == 0;
+    }
+
+    uint32_t Add(const char* s) {
+        if (!s || *s == '\0') {
+            return 0;
+        }
+        return Append(s, strlen(s));
+    }
+
+    uint32_t AddInterned(const char* s) {
+        if (!s || *s == '\0') {
+            return 0;
+        }
+        auto it = interned_.find(s);
+        if (it != interned_.end()) {
+            return it->second;
+        }
+        uint32_t offset = Append(s, strlen(s));
+        if (offset != kFailed) {
+            interned_.emplace(s, offset);
+        }
+        return offset;
+    }
+
+    bool failed() const { return failed_; }
+    const uint8_t* data() const { return data_; }
+    // Padded with NULs to keep the file size a multiple of 4
+    uint32_t size() const { return (size_ + 3) & ~3u; }
+
+    static constexpr uint32_t kFailed = UINT32_MAX;
+
+private:
+    uint8_t* data_ = nullptr;
+    uint32_t size_ = 0;
+    uint32_t capacity_ = 0;
+    bool failed_ = false;
+    std::unordered_map<std::string, uint32_t> interned_;
+
+    uint32_t Append(const char* s, size_t length) {
+        if (size_ + length + 4 > capacity_) {
+            uint32_t new_capacity = capacity_ ? capacity_ * 2 : 64 * 1024;
+            while (size_ + length + 4 > new_capacity) {
+                new_capacity *= 2;
+            }
+            uint8_t* grown = (uint8_t*)heap_caps_realloc(data_, new_capacity, MALLOC_CAP_SPIRAM);
+            if (!grown) {
+                failed_ = true;
+                return kFailed;
+            }
+            data_ = grown;
+            capacity_ = new_capacity;
+        }
+        uint32_t offset = size_;
+        memcpy(data_ + size_, s, length);
+        size_ += length;
+        data_[size_++] = '\0';
+        memset(data_ + size_, 0, 3);
+        return offset;
+    }
+};
+
+} // namespace
+
+MusicLibraryIndex::~MusicLibraryIndex() {
+    Release();
+}
+
+void MusicLibraryIndex::Release() {
+    heap_caps_free(blob_);
+    blob_ = nullptr;
+    blob_size_ = 0;
+    header_ = nullptr;
+    dirs_ = nullptr;
+    records_ = nullptr;
+    view_ = nullptr;
+    strings_ = nullptr;
+    next_dir_ = 0;
+}
+
+uint32_t MusicLibraryIndex::Hash(uint32_t hash, const char* data, size_t size) {
+    // FNV-1a
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool MusicLibraryIndex::Load(const std::string& file_path, uint32_t config_hash) {
+    Release();
+
+    struct stat st;
+    if (stat(file_path.c_str(), &st) != 0) {
+        ESP_LOGI(TAG, "No library index at %s", file_path.c_str());
+        return false;
+    }
+    if (st.st_size < (off_t)sizeof(MusicIndexHeader)) {
+        ESP_LOGW(TAG, "Library index %s is truncated", file_path.c_str());
+        return false;
+    }
+
+    FILE* file = fopen(file_path.c_str(), "rb");
+    if (!file) {
+        ESP_LOGW(TAG, "Failed to open library index %s", file_path.c_str());
+        return false;
+    }
+    blob_size_ = st.st_size;
+    blob_ = (uint8_t*)heap_caps_malloc(blob_size_, MALLOC_CAP_SPIRAM);
+    if (!blob_) {
+        ESP_LOGW(TAG, "Failed to allocate %u bytes for the library index", (unsigned)blob_size_);
+        fclose(file);
+        blob_size_ = 0;
+        return false;
+    }
+    size_t read = fread(blob_, 1, blob_size_, file);
+    fclose(file);
+    if (read != blob_size_) {
+        ESP_LOGW(TAG, "Short read of library index: %u of %u bytes", (unsigned)read, (unsigned)blob_size_);
+        Release();
+        return false;
+    }
+
+    header_ = (const MusicIndexHeader*)blob_;
+    if (header_->magic != MUSIC_INDEX_MAGIC || header_->version != MUSIC_INDEX_VERSION ||
+        header_->header_size != sizeof(MusicIndexHeader)) {
+        ESP_LOGW(TAG, "Library index has an unknown format, version %u", header_->version);
+        Release();
+        return false;
+    }
+    if (header_->config_hash != config_hash) {
+        ESP_LOGI(TAG, "Library index was built with other scan settings");
+        Release();
+        return false;
+    }
+
+    /* Section sizes in 64 bits, a corrupted count must not wrap around */
+    uint64_t expected = sizeof(MusicIndexHeader)
+        + (uint64_t)header_->dir_count * sizeof(MusicIndexDir)
+        + (uint64_t)header_->record_count * (sizeof(MusicIndexRecord) + sizeof(uint32_t))
+        + header_->string_bytes;
+    if (expected != blob_size_) {
+        ESP_LOGW(TAG, "Library index size %u does not match its header", (unsigned)blob_size_);
+        Release();
+        return false;
+    }
+    const uint8_t* body = blob_ + sizeof(MusicIndexHeader);
+    uint32_t checksum = esp_rom_crc32_le(0, body, blob_size_ - sizeof(MusicIndexHeader));
+    if (checksum != header_->checksum) {
+        ESP_LOGW(TAG, "Library index checksum mismatch");
+        Release();
+        return false;
+    }
+
+    dirs_ = (const MusicIndexDir*)body;
+    records_ = (const MusicIndexRecord*)(dirs_ + header_->dir_count);
+    view_ = (const uint32_t*)(records_ + header_->record_count);
+    strings_ = (const char*)(view_ + header_->record_count);
+    if (!Validate()) {
+        ESP_LOGW(TAG, "Library index has invalid offsets");
+        Release();
+        return false;
+    }
+    ESP_LOGI(TAG, "Loaded library index: %u songs in %u directories, %u bytes",
+             (unsigned)header_->record_count, (unsigned)header_->dir_count, (unsigned)blob_size_);
+    return true;
+}
+
+// The checksum does not protect against a buggy writer, every offset is checked once so lookups need not be
+bool MusicLibraryIndex::Validate() const {
+    uint32_t string_bytes = header_->string_bytes;
+    if (string_bytes == 0 || strings_[string_bytes - 1] != '\0') {
+        return false;
+    }
+    for (uint32_t i = 0; i < header_->dir_count; i++) {
+        const MusicIndexDir& dir = dirs_[i];
+        if (dir.path >= string_bytes || dir.first_record > header_->record_count ||
+            dir.record_count > header_->record_count - dir.first_record) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header_->record_count; i++) {
+        const MusicIndexRecord& r = records_[i];
+        if (r.file_path >= string_bytes || r.file_name >= string_bytes || r.song_name >= string_bytes ||
+            r.artist >= string_bytes || r.artist_norm >= string_bytes || r.token_norm >= string_bytes ||
+            r.category >= string_bytes || r.index_id >= string_bytes || view_[i] >= header_->record_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const MusicIndexDir* MusicLibraryIndex::FindDir(const std::string& path, uint32_t signature, int64_t mtime) {
+    if (!header_) {
+        return nullptr;
+    }
+    /* Directories are usually walked in the order they were saved, try the one after the last match first */
+    const MusicIndexDir* found = nullptr;
+    size_t count = header_->dir_count;
+    for (size_t n = 0; n < count; n++) {
+        size_t i = (next_dir_ + n) % count;
+        if (path == strings_ + dirs_[i].path) {
+            found = &dirs_[i];
+            next_dir_ = i + 1;
+            break;
+        }
+    }
+    if (!found || found->signature != signature || found->mtime != mtime) {
+        return nullptr;
+    }
+    return found;
+}
+
+bool MusicLibraryIndex::Save(const std::string& file_path, uint32_t config_hash, const std::vector<ScannedDir>& dirs,
+                             const PSMusicInfo* library, size_t count, const uint32_t* view) {
+    StringTableWriter strings;
+    if (!strings.Init()) {
+        return false;
+    }
+
+    std::vector<MusicIndexDir> dir_table(dirs.size());
+    for (size_t i = 0; i < dirs.size(); i++) {
+        dir_table[i] = {
+            .path = strings.Add(dirs[i].path.c_str()),
+            .signature = dirs[i].signature,
+            .mtime = dirs[i].mtime,
+            .first_record = dirs[i].first_record,
+            .record_count = dirs[i].record_count,
+        };
+    }
+
+    size_t records_size = count * sizeof(MusicIndexRecord);
+    MusicIndexRecord* records = (MusicIndexRecord*)heap_caps_malloc(records_size ? records_size : 1, MALLOC_CAP_SPIRAM);
+    if (!records) {
+        ESP_LOGW(TAG, "Failed to allocate %u records for the library index", (unsigned)count);
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const PSMusicInfo& m = library[i];
+        records[i] = {
+            .file_path = strings.Add(m.file_path),
+            .file_name = strings.Add(m.file_name),
+            .song_name = strings.Add(m.song_name),
+            .artist = strings.AddInterned(m.artist),
+            .artist_norm = strings.AddInterned(m.artist_norm),
+            .token_norm = strings.Add(m.token_norm),
+            .category = strings.AddInterned(m.category),
+            .index_id = strings.Add(m.index_id),
+            .file_size = (uint32_t)m.file_size,
+        };
+    }
+    if (strings.failed()) {
+        ESP_LOGW(TAG, "Out of memory while building the library index");
+        heap_caps_free(records);
+        return false;
+    }
+
+    MusicIndexHeader header = {
+        .magic = MUSIC_INDEX_MAGIC,
+        .version = MUSIC_INDEX_VERSION,
+        .header_size = sizeof(MusicIndexHeader),
+        .config_hash = config_hash,
+        .dir_count = (uint32_t)dir_table.size(),
+        .record_count = (uint32_t)count,
+        .string_bytes = strings.size(),
+        .checksum = 0,
+        .reserved = 0,
+    };
+    uint32_t checksum = 0;
+    checksum = esp_rom_crc32_le(checksum, (const uint8_t*)dir_table.data(), dir_table.size() * sizeof(MusicIndexDir));
+    checksum = esp_rom_crc32_le(checksum, (const uint8_t*)records, records_size);
+    checksum = esp_rom_crc32_le(checksum, (const uint8_t*)view, count * sizeof(uint32_t));
+    checksum = esp_rom_crc32_le(checksum, strings.data(), strings.size());
+    header.checksum = checksum;
+
+    /* Written next to the index and renamed over it, a power cut never leaves a half written index */
+    std::string temp_path = file_path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        ESP_LOGW(TAG, "Failed to create %s", temp_path.c_str());
+        heap_caps_free(records);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (dir_table.empty() || fwrite(dir_table.data(), sizeof(MusicIndexDir), dir_table.size(), file) == dir_table.size());
+    ok = ok && (count == 0 || fwrite(records, sizeof(MusicIndexRecord), count, file) == count);
+    ok = ok && (count == 0 || fwrite(view, sizeof(uint32_t), count, file) == count);
+    ok = ok && fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+    ok = (fclose(file) == 0) && ok;
+    heap_caps_free(records);
+    if (!ok) {
+        ESP_LOGW(TAG, "Failed to write %s", temp_path.c_str());
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    // FAT does not rename over an existing file
+    unlink(file_path.c_str());
+    if (rename(temp_path.c_str(), file_path.c_str()) != 0) {
+        ESP_LOGW(TAG, "Failed to rename %s", temp_path.c_str());
+        unlink(temp_path.c_str());
+        return false;
+    }
+    ESP_LOGI(TAG, "Saved library index: %u songs in %u directories", (unsigned)count, (unsigned)dir_table.size());
+    return true;
+}
@@ -0,0 +1,103 @@
+#ifndef MUSIC_LIBRARY_INDEX_H
+#define MUSIC_LIBRARY_INDEX_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "music.h"
+
+#define MUSIC_INDEX_MAGIC 0x42494C4D    // "MLIB"
+#define MUSIC_INDEX_VERSION 1
+
+// File layout, little-endian: header, dirs, records, view, strings. Every section is 4-byte aligned.
+struct MusicIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t config_hash;       // Scan settings the library was built with (excluded songs)
+    uint32_t dir_count;
+    uint32_t record_count;
+    uint32_t string_bytes;
+    uint32_t checksum;          // CRC32 of everything after the header
+    uint32_t reserved;
+};
+
+struct MusicIndexDir {
+    uint32_t path;              // Offsets into the string table
+    uint32_t signature;         // Hash of the names and types of the entries
+    int64_t mtime;
+    uint32_t first_record;      // The records of a directory are contiguous
+    uint32_t record_count;
+};
+
+struct MusicIndexRecord {
+    uint32_t file_path;
+    uint32_t file_name;
+    uint32_t song_name;
+    uint32_t artist;
+    uint32_t artist_norm;
+    uint32_t token_norm;
+    uint32_t category;
+    uint32_t index_id;
+    uint32_t file_size;
+};
+
+/*
+ * Persistent copy of the music library on the SD card.
+ *
+ * Load() reads the whole file into PSRAM with a single read and keeps it, so the library can point
+ * straight into its string table instead of copying every string. A directory whose mtime and entry
+ * signature match the index does not need to be parsed again; the signature catches what FAT does not
+ * report in the directory mtime (files added, removed or renamed), a file rewritten in place with the
+ * same name is not noticed. The view holds the record indices sorted by song name.
+ */
+class MusicLibraryIndex {
+public:
+    struct ScannedDir {
+        std::string path;
+        uint32_t signature;
+        int64_t mtime;
+        uint32_t first_record;
+        uint32_t record_count;
+    };
+
+    MusicLibraryIndex() = default;
+    ~MusicLibraryIndex();
+    MusicLibraryIndex(const MusicLibraryIndex&) = delete;
+    MusicLibraryIndex& operator=(const MusicLibraryIndex&) = delete;
+
+    bool Load(const std::string& file_path, uint32_t config_hash);
+    void Release();
+    static bool Save(const std::string& file_path, uint32_t config_hash, const std::vector<ScannedDir>& dirs,
+                     const PSMusicInfo* library, size_t count, const uint32_t* view);
+
+    bool loaded() const { return blob_ != nullptr; }
+    size_t dir_count() const { return header_ ? header_->dir_count : 0; }
+    size_t record_count() const { return header_ ? header_->record_count : 0; }
+    const MusicIndexRecord& record(size_t index) const { return records_[index]; }
+    const char* string(uint32_t offset) const { return strings_ + offset; }
+    const uint32_t* view() const { return view_; }
+    size_t size() const { return blob_size_; }
+    // The cached directory if it has not changed, nullptr otherwise
+    const MusicIndexDir* FindDir(const std::string& path, uint32_t signature, int64_t mtime);
+
+    // Directory entry signature, fed one entry at a time starting from kSignatureSeed
+    static constexpr uint32_t kSignatureSeed = 2166136261u;
+    static uint32_t Hash(uint32_t hash, const char* data, size_t size);
+
+private:
+    uint8_t* blob_ = nullptr;
+    size_t blob_size_ = 0;
+    const MusicIndexHeader* header_ = nullptr;
+    const MusicIndexDir* dirs_ = nullptr;
+    const MusicIndexRecord* records_ = nullptr;
+    const uint32_t* view_ = nullptr;
+    const char* strings_ = nullptr;
+    size_t next_dir_ = 0;
+
+    bool Validate() const;
+};
+
+#endif // MUSIC_LIBRARY_INDEX_H
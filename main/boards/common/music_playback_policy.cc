@@ -0,0 +1,35 @@
+#include "music_playback_policy.h"
+
+static bool IsPlayingState(DeviceState state) {
+    return state == kDeviceStateIdle || state == kDeviceStateSpeaking;
+}
+
+static bool ReplyEnded(DeviceState previous, DeviceState current, bool reply_aborted) {
+    return previous == kDeviceStateSpeaking && current == kDeviceStateListening && !reply_aborted;
+}
+
+MusicPlaybackAction DecideMusicPlayback(DeviceState previous, DeviceState current, int64_t listening_ms,
+                                        bool first_play, bool reply_aborted) {
+    if (IsPlayingState(current)) {
+        return kMusicPlaybackPlay;
+    }
+    if (ReplyEnded(previous, current, reply_aborted)) {
+        return kMusicPlaybackRequestIdle;
+    }
+    if (first_play) {
+        // Requested by voice, the reply usually follows: wait for it, but not forever
+        if (current == kDeviceStateListening && listening_ms >= MUSIC_FIRST_PLAY_LISTEN_TIMEOUT_MS) {
+            return kMusicPlaybackRequestIdle;
+        }
+        return kMusicPlaybackWait;
+    }
+    if (IsPlayingState(previous)) {
+        return kMusicPlaybackPause;
+    }
+    // Still listening after asking for idle, connecting, upgrading...
+    return kMusicPlaybackWait;
+}
+
+bool ShouldResumeMusic(DeviceState previous, DeviceState current, bool reply_aborted) {
+    return current == kDeviceStateIdle || ReplyEnded(previous, current, reply_aborted);
+}
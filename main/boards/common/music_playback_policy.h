@@ -0,0 +1,38 @@
+#ifndef MUSIC_PLAYBACK_POLICY_H
+#define MUSIC_PLAYBACK_POLICY_H
+
+#include "device_state.h"
+
+#include <cstdint>
+
+#define MUSIC_FIRST_PLAY_LISTEN_TIMEOUT_MS 4000
+
+/*
+ * What the music playback thread does as the device state changes. Music plays while the device is
+ * idle or speaking (ducked under the reply by the mixer) and pauses while the user talks.
+ *
+ * A reply that ends normally leaves the device listening in the auto listening modes. While music
+ * was requested or is playing that ends the conversation: the thread asks for idle and plays on, so
+ * "play X" starts X once the reply is spoken. Music requested while listening with no reply coming
+ * starts after MUSIC_FIRST_PLAY_LISTEN_TIMEOUT_MS the same way. A reply cut short by the wake word
+ * (barge-in) or the wake word from idle means the user is talking, so the music pauses and resumes
+ * once the device is idle again.
+ */
+enum MusicPlaybackAction {
+    kMusicPlaybackPlay,          // Play, or keep playing
+    kMusicPlaybackWait,          // Do not play yet and wait for the state to change
+    kMusicPlaybackPause,         // Pause automatically until ShouldResumeMusic()
+    kMusicPlaybackRequestIdle,   // End the conversation, then play
+};
+
+// previous and current are the states seen by the last and this iteration of the playback loop,
+// listening_ms how long the device has been listening. reply_aborted tells whether the last reply
+// was aborted (Application::IsSpeakingAborted()).
+MusicPlaybackAction DecideMusicPlayback(DeviceState previous, DeviceState current, int64_t listening_ms,
+                                        bool first_play, bool reply_aborted);
+
+// For automatically paused music: resume once idle, or when a reply ended normally in listening (the
+// caller then asks for idle as for kMusicPlaybackRequestIdle)
+bool ShouldResumeMusic(DeviceState previous, DeviceState current, bool reply_aborted);
+
+#endif // MUSIC_PLAYBACK_POLICY_H
@@ -0,0 +1,199 @@
+#include "ngram_index.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+
+#define TAG "NgramIndex"
+
+NgramIndex::NgramIndex(uint32_t caps) : caps_(caps) {
+}
+
+NgramIndex::~NgramIndex() {
+    Clear();
+}
+
+void NgramIndex::Clear() {
+    heap_caps_free(pairs_);
+    pairs_ = nullptr;
+    pair_count_ = 0;
+    pair_capacity_ = 0;
+    heap_caps_free(block_);
+    block_ = nullptr;
+    block_size_ = 0;
+    keys_ = nullptr;
+    offsets_ = nullptr;
+    postings_ = nullptr;
+    key_count_ = 0;
+    heap_caps_free(counts_);
+    counts_ = nullptr;
+    entry_count_ = 0;
+}
+
+// Hashed codepoint pairs of text, malformed UTF-8 bytes count as one codepoint each
+void NgramIndex::Bigrams(const char* text, std::vector<uint32_t>& grams) {
+    grams.clear();
+    if (!text) {
+        return;
+    }
+    const uint8_t* p = (const uint8_t*)text;
+    uint32_t previous = 0;
+    bool has_previous = false;
+    while (*p) {
+        uint32_t cp = *p;
+        size_t length = 1;
+        if ((cp & 0xE0) == 0xC0) {
+            cp &= 0x1F;
+            length = 2;
+        } else if ((cp & 0xF0) == 0xE0) {
+            cp &= 0x0F;
+            length = 3;
+        } else if ((cp & 0xF8) == 0xF0) {
+            cp &= 0x07;
+            length = 4;
+        }
+        size_t i = 1;
+        for (; i < length && (p[i] & 0xC0) == 0x80; i++) {
+            cp = (cp << 6) | (p[i] & 0x3F);
+        }
+        if (i < length) {
+            cp = *p;
+            i = 1;
+        }
+        p += i;
+
+        if (has_previous) {
+            grams.push_back(previous * 0x9E3779B1u ^ cp);
+        }
+        previous = cp;
+        has_previous = true;
+    }
+}
+
+void NgramIndex::Add(uint16_t id, const char* text) {
+    std::vector<uint32_t> grams;
+    Bigrams(text, grams);
+    if (grams.empty()) {
+        return;
+    }
+    if (pair_count_ + grams.size() > pair_capacity_) {
+        size_t capacity = pair_capacity_ ? pair_capacity_ * 2 : 4096;
+        while (capacity < pair_count_ + grams.size()) {
+            capacity *= 2;
+        }
+        uint64_t* pairs = (uint64_t*)heap_caps_realloc(pairs_, capacity * sizeof(uint64_t), caps_);
+        if (!pairs) {
+            ESP_LOGW(TAG, "Failed to grow the bigram list to %u", (unsigned)capacity);
+            return;
+        }
+        pairs_ = pairs;
+        pair_capacity_ = capacity;
+    }
+    for (uint32_t gram : grams) {
+        pairs_[pair_count_++] = (uint64_t)gram << 16 | id;
+    }
+}
+
+bool NgramIndex::Build(size_t entry_count) {
+    if (entry_count > kMaxEntries) {
+        ESP_LOGW(TAG, "Too many entries to index: %u", (unsigned)entry_count);
+        Clear();
+        return false;
+    }
+
+    /* Sorted pairs group the ids of a bigram, an id holding a bigram twice is posted once */
+    std::sort(pairs_, pairs_ + pair_count_);
+    size_t unique = std::unique(pairs_, pairs_ + pair_count_) - pairs_;
+    size_t keys = 0;
+    for (size_t i = 0; i < unique; i++) {
+        if (i == 0 || (pairs_[i] >> 16) != (pairs_[i - 1] >> 16)) {
+            keys++;
+        }
+    }
+
+    size_t size = keys * sizeof(uint32_t) + (keys + 1) * sizeof(uint32_t) + unique * sizeof(uint16_t);
+    uint8_t* block = (uint8_t*)heap_caps_malloc(size ? size : 1, caps_);
+    uint16_t* counts = (uint16_t*)heap_caps_calloc(entry_count ? entry_count : 1, sizeof(uint16_t), caps_);
+    if (!block || !counts) {
+        ESP_LOGW(TAG, "Failed to allocate %u bytes for the bigram index", (unsigned)size);
+        heap_caps_free(block);
+        heap_caps_free(counts);
+        Clear();
+        return false;
+    }
+    uint32_t* key_table = (uint32_t*)block;
+    uint32_t* offset_table = key_table + keys;
+    uint16_t* posting_table = (uint16_t*)(offset_table + keys + 1);
+    size_t k = 0;
+    for (size_t i = 0; i < unique; i++) {
+        uint32_t gram = pairs_[i] >> 16;
+        if (i == 0 || gram != (uint32_t)(pairs_[i - 1] >> 16)) {
+            key_table[k] = gram;
+            offset_table[k] = i;
+            k++;
+        }
+        posting_table[i] = pairs_[i] & 0xFFFF;
+    }
+    offset_table[keys] = unique;
+
+    heap_caps_free(pairs_);
+    pairs_ = nullptr;
+    pair_count_ = 0;
+    pair_capacity_ = 0;
+    heap_caps_free(block_);
+    heap_caps_free(counts_);
+    block_ = block;
+    block_size_ = size;
+    keys_ = key_table;
+    offsets_ = offset_table;
+    postings_ = posting_table;
+    key_count_ = keys;
+    counts_ = counts;
+    entry_count_ = entry_count;
+    ESP_LOGI(TAG, "Indexed %u entries: %u bigrams, %u postings, %u bytes", (unsigned)entry_count,
+             (unsigned)keys, (unsigned)unique, (unsigned)memory_bytes());
+    return true;
+}
+
+bool NgramIndex::FindContaining(const char* query, std::vector<uint16_t>& ids) const {
+    ids.clear();
+    if (!ready()) {
+        return false;
+    }
+    std::vector<uint32_t> grams;
+    Bigrams(query, grams);
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    if (grams.empty()) {
+        return false;
+    }
+
+    std::vector<uint16_t> touched;
+    for (uint32_t gram : grams) {
+        const uint32_t* key = std::lower_bound(keys_, keys_ + key_count_, gram);
+        if (key == keys_ + key_count_ || *key != gram) {
+            break;
+        }
+        size_t k = key - keys_;
+        for (uint32_t i = offsets_[k]; i < offsets_[k + 1]; i++) {
+            uint16_t id = postings_[i];
+            if (id < entry_count_ && counts_[id]++ == 0) {
+                touched.push_back(id);
+            }
+        }
+    }
+
+    /* Postings are deduplicated per entry, so holding every bigram means a count of grams.size() */
+    for (uint16_t id : touched) {
+        if (counts_[id] == grams.size()) {
+            ids.push_back(id);
+        }
+        counts_[id] = 0;
+    }
+    std::sort(ids.begin(), ids.end());
+    return true;
+}
+
+size_t NgramIndex::memory_bytes() const {
+    return block_size_ + entry_count_ * sizeof(uint16_t);
+}
@@ -0,0 +1,61 @@
+#ifndef NGRAM_INDEX_H
+#define NGRAM_INDEX_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Inverted index of the character bigrams of search strings, to find the entries that may contain a
+ * query without comparing against every entry.
+ *
+ * Bigrams are pairs of UTF-8 codepoints, so a Chinese title is indexed per character pair the same way
+ * as an English one per letter pair. Bigrams are hashed to 32 bits: a collision can only add a
+ * candidate, never lose one. An entry that contains the query as a substring always holds all of its
+ * bigrams, so it is always found; an entry that is not found does not contain the query.
+ *
+ * Add() every string of every entry, then Build(). FindContaining() uses a scratch buffer, callers
+ * serialize it with the lock that protects the indexed library.
+ */
+class NgramIndex {
+public:
+    explicit NgramIndex(uint32_t caps);
+    ~NgramIndex();
+    NgramIndex(const NgramIndex&) = delete;
+    NgramIndex& operator=(const NgramIndex&) = delete;
+
+    void Clear();
+    // An entry may be added with several strings, they are searched as one
+    void Add(uint16_t id, const char* text);
+    bool Build(size_t entry_count);
+    bool ready() const { return keys_ != nullptr; }
+
+    // Entries holding all bigrams of query in ascending id order, a superset of those containing it.
+    // False when the index is not built or query has a single character, the caller scans everything.
+    bool FindContaining(const char* query, std::vector<uint16_t>& ids) const;
+
+    size_t memory_bytes() const;
+
+    static constexpr size_t kMaxEntries = UINT16_MAX + 1;
+
+private:
+    uint32_t caps_;
+    // Build input, (bigram << 16 | id)
+    uint64_t* pairs_ = nullptr;
+    size_t pair_count_ = 0;
+    size_t pair_capacity_ = 0;
+    // Posting lists: postings_[offsets_[k] .. offsets_[k + 1]) are the ids holding keys_[k], one block
+    uint8_t* block_ = nullptr;
+    size_t block_size_ = 0;
+    const uint32_t* keys_ = nullptr;
+    const uint32_t* offsets_ = nullptr;
+    const uint16_t* postings_ = nullptr;
+    size_t key_count_ = 0;
+    // Per entry matched bigram counts of the current query, zero between queries
+    uint16_t* counts_ = nullptr;
+    size_t entry_count_ = 0;
+
+    static void Bigrams(const char* text, std::vector<uint32_t>& grams);
+};
+
+#endif // NGRAM_INDEX_H
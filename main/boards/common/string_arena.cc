@@ -0,0 +1,122 @@
+#include "string_arena.h"
+
+#include <esp_heap_caps.h>
+#include <cstring>
+
+// Shared by every empty string, callers never write through the returned pointers
+static char kEmptyString[1] = "";
+
+static uint32_t HashString(const char* s, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)s[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+StringArena::StringArena(uint32_t caps, size_t chunk_size) : caps_(caps), chunk_size_(chunk_size) {
+}
+
+StringArena::~StringArena() {
+    Reset();
+}
+
+void StringArena::Reset() {
+    while (chunks_) {
+        Chunk* next = chunks_->next;
+        heap_caps_free(chunks_);
+        chunks_ = next;
+    }
+    chunk_count_ = 0;
+    chunk_bytes_ = 0;
+    bytes_used_ = 0;
+    heap_caps_free(intern_slots_);
+    intern_slots_ = nullptr;
+    intern_capacity_ = 0;
+    intern_count_ = 0;
+}
+
+char* StringArena::Add(const char* s, size_t length) {
+    if (length == 0) {
+        return kEmptyString;
+    }
+    size_t need = length + 1;
+    if (!chunks_ || chunks_->size - chunks_->used < need) {
+        /* A string longer than a chunk gets a chunk of its own, the rest of the current chunk is abandoned */
+        size_t size = need > chunk_size_ ? need : chunk_size_;
+        Chunk* chunk = (Chunk*)heap_caps_malloc(sizeof(Chunk) + size, caps_);
+        if (!chunk) {
+            return nullptr;
+        }
+        chunk->next = chunks_;
+        chunk->size = size;
+        chunk->used = 0;
+        chunks_ = chunk;
+        chunk_count_++;
+        chunk_bytes_ += sizeof(Chunk) + size;
+    }
+    char* p = chunks_->data + chunks_->used;
+    memcpy(p, s, length);
+    p[length] = '\0';
+    chunks_->used += need;
+    bytes_used_ += need;
+    return p;
+}
+
+bool StringArena::GrowInternTable() {
+    size_t capacity = intern_capacity_ ? intern_capacity_ * 2 : 64;
+    InternSlot* slots = (InternSlot*)heap_caps_calloc(capacity, sizeof(InternSlot), caps_);
+    if (!slots) {
+        return false;
+    }
+    for (size_t i = 0; i < intern_capacity_; i++) {
+        const InternSlot& slot = intern_slots_[i];
+        if (!slot.str) {
+            continue;
+        }
+        size_t j = slot.hash & (capacity - 1);
+        while (slots[j].str) {
+            j = (j + 1) & (capacity - 1);
+        }
+        slots[j] = slot;
+    }
+    heap_caps_free(intern_slots_);
+    intern_slots_ = slots;
+    intern_capacity_ = capacity;
+    return true;
+}
+
+char* StringArena::Intern(const char* s, size_t length) {
+    if (length == 0) {
+        return kEmptyString;
+    }
+    // Keep the load factor below 3/4 so probes stay short
+    if ((intern_count_ + 1) * 4 > intern_capacity_ * 3 && !GrowInternTable()) {
+        return Add(s, length);
+    }
+    uint32_t hash = HashString(s, length);
+    size_t i = hash & (intern_capacity_ - 1);
+    while (intern_slots_[i].str) {
+        const InternSlot& slot = intern_slots_[i];
+        if (slot.hash == hash && slot.length == length && memcmp(slot.str, s, length) == 0) {
+            return slot.str;
+        }
+        i = (i + 1) & (intern_capacity_ - 1);
+    }
+    char* p = Add(s, length);
+    if (p) {
+        intern_slots_[i] = { hash, (uint32_t)length, p };
+        intern_count_++;
+    }
+    return p;
+}
+
+size_t StringArena::bytes_reserved() const {
+    return chunk_bytes_ + intern_capacity_ * sizeof(InternSlot);
+}
+
+size_t StringArena::block_count() const {
+    return chunk_count_ + (intern_slots_ ? 1 : 0);
+}
@@ -0,0 +1,63 @@
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/*
+ * Bump allocator for NUL-terminated strings that live and die together.
+ *
+ * Strings are packed into large heap blocks (chunks) instead of one block each, which saves the
+ * per-block heap overhead and keeps the heap from fragmenting. Nothing is freed on its own, Reset()
+ * releases every chunk at once. Intern() returns the copy stored before for an equal string, for
+ * values that repeat over many entries (artists, categories).
+ *
+ * Not thread-safe, callers serialize access.
+ */
+class StringArena {
+public:
+    explicit StringArena(uint32_t caps, size_t chunk_size = 64 * 1024);
+    ~StringArena();
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    // nullptr when out of memory. The empty string is never copied.
+    char* Add(const char* s, size_t length);
+    char* Add(const std::string& s) { return Add(s.data(), s.size()); }
+    char* Intern(const char* s, size_t length);
+    char* Intern(const std::string& s) { return Intern(s.data(), s.size()); }
+    void Reset();
+
+    size_t bytes_used() const { return bytes_used_; }
+    // Chunks and the intern table, as allocated from the heap
+    size_t bytes_reserved() const;
+    size_t block_count() const;
+
+private:
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+        size_t used;
+        char data[];
+    };
+    struct InternSlot {
+        uint32_t hash;
+        uint32_t length;
+        char* str;
+    };
+
+    uint32_t caps_;
+    size_t chunk_size_;
+    Chunk* chunks_ = nullptr;       // Newest first, only the newest one is bumped
+    size_t chunk_count_ = 0;
+    size_t chunk_bytes_ = 0;
+    size_t bytes_used_ = 0;
+    InternSlot* intern_slots_ = nullptr;
+    size_t intern_capacity_ = 0;    // Power of two
+    size_t intern_count_ = 0;
+
+    bool GrowInternTable();
+};
+
+#endif // STRING_ARENA_H
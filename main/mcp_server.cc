@@ -95,6 +95,14 @@ static std::string BuildNowPlayingResult(const char* call_tool, const std::strin
     cJSON_Delete(root);
     return ret;
 }
+// 故事库仍在后台扫描时，搜索不到可能只是还没扫描到
+static std::string StoryNotFoundResult(Music* music) {
+    if (music->IsLibraryScanning()) {
+        return "{\"success\": false, \"scan_in_progress\": true, \"message\": \"故事库仍在扫描中，暂未找到该故事，请稍后再试\"}";
+    }
+    return "{\"success\": false, \"message\": \"未找到该故事\"}";
+}
+
 bool NotResumePlayback = 0;
 
 void McpServer::AddCommonTools() {
@@ -352,7 +360,7 @@ void McpServer::AddCommonTools() {
                             } else if (!style.empty() && name.empty() && index_id.empty()) {
                                 // style 有可能是音乐也有可能是故事，我们这里做模糊判断
                                 auto hits = music_impl->FuzzySearchMedia(style, 1);
-                                if (!hits.empty() && hits.front()->type == PSMediaType::kStory) {
+                                if (!hits.empty() && hits.front().type == PSMediaType::kStory) {
                                     force_story = true;
                                 } else {
                                     force_music = true;
@@ -365,7 +373,7 @@ void McpServer::AddCommonTools() {
 
                                 auto hits = music_impl->FuzzySearchMedia(query, 1);
                                 if (!hits.empty()) {
-                                    if (hits.front()->type == PSMediaType::kMusic) force_music = true;
+                                    if (hits.front().type == PSMediaType::kMusic) force_music = true;
                                     else force_story = true;
                                 } else {
                                     force_music = true; // 无法分辨时暂时回退到音乐统一报错
@@ -512,7 +520,7 @@ void McpServer::AddCommonTools() {
                                 } else {
                                     index = music->FindStoryIndexInCategory(cat, story_name);
                                 }
-                                if (index == -1) return "{\"success\": false, \"message\": \"未找到该故事\"}";
+                                if (index == -1) return StoryNotFoundResult(music);
                                 size_t count = 0;
                                 auto storys = music->GetStoryLibrary(count);
                                 music->SetCurrentStoryIndex(index);
@@ -707,6 +715,9 @@ void McpServer::AddCommonTools() {
                                     if(app->GetDeviceFunction() == Function_Light) {
                                         return "{\"success\": false, \"message\": \"夜灯模式下，只能播放舒缓音乐(Soothing Light Music)或自然声音(Natural Sounds)，请尝试指定类别的音乐\"}";
                                     }
+                                    if (music->IsLibraryScanning()) {
+                                        return "{\"success\": false, \"scan_in_progress\": true, \"message\": \"曲库仍在扫描中，暂未找到匹配的歌曲，请稍后再试\"}";
+                                    }
                                     return "{\"success\": false, \"message\": \"未找到匹配的歌曲: \" + song_name}";
                                 }
                             }
@@ -834,7 +845,8 @@ void McpServer::AddCommonTools() {
                                 return g_mcp_scratch;
                         }                    
                         size_t max_pick = 5;
-                        size_t total = music->GetMusicCount();
+                        // 与上面取到的曲库指针用同一次快照的数量，扫描期间数量会增长
+                        size_t total = out_count;
                         size_t pick = std::min(max_pick, total);
                         
                         // 列出随机歌曲
@@ -857,6 +869,28 @@ void McpServer::AddCommonTools() {
                         return g_mcp_scratch;
                     }
                     );
+
+            AddTool("self.music.get_scan_status",
+                    "查询本地音乐库和故事库的扫描进度。开机后曲库在后台扫描，扫描完成前搜索只覆盖已扫描到的部分，\n"
+                    "当搜索不到歌曲或故事、或用户询问曲库是否加载完成时调用。\n"
+                    "返回:\n"
+                    "  是否仍在扫描、已扫描的歌曲与故事数量、扫描耗时和每秒扫描的文件数。",
+                    PropertyList(),
+                    [music](const PropertyList& properties) -> ReturnValue {
+                        auto status = music->GetLibraryScanStatus();
+                        cJSON *root = cJSON_CreateObject();
+                        cJSON_AddBoolToObject(root, "scan_in_progress", status.music_scanning || status.story_scanning);
+                        cJSON_AddBoolToObject(root, "music_scanning", status.music_scanning);
+                        cJSON_AddBoolToObject(root, "story_scanning", status.story_scanning);
+                        cJSON_AddNumberToObject(root, "music_count", status.music_count);
+                        cJSON_AddNumberToObject(root, "story_count", status.story_count);
+                        cJSON_AddNumberToObject(root, "files_scanned", status.files_scanned);
+                        cJSON_AddNumberToObject(root, "dirs_scanned", status.dirs_scanned);
+                        cJSON_AddNumberToObject(root, "dirs_indexed", status.dirs_indexed);
+                        cJSON_AddNumberToObject(root, "elapsed_ms", status.elapsed_ms);
+                        cJSON_AddNumberToObject(root, "files_per_second", status.files_per_second);
+                        return root;
+                    });
                         
             AddTool("next",
                     "当用户说要播放下一首歌或者下一章节故事或者下一个故事的时候调用，你需要读出来要播放的内容，然后调用完之后根据返回值，返回actually.1或者actually.3来播放下一首歌或者下一章节故事或者下一个故事\n"
@@ -1094,7 +1128,7 @@ void McpServer::AddCommonTools() {
                                 }
                                 else
                                 {
-                                    return "{\"success\": false, \"message\": \"未找到该故事\"}";
+                                    return StoryNotFoundResult(music);
                                 }
                                 auto chapters = music->GetChaptersForStory(found_cat, final_name);
                                 if (chapters.empty()) {
@@ -1253,6 +1287,36 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+    AddUserOnlyTool("self.audio.latency_stats",
+        "Get the latency histograms (in milliseconds) of every stage of the voice pipeline, "
+        "from mic read to speaker output. Set `reset` to true to clear them after reading.",
+        PropertyList({
+            Property("reset", kPropertyTypeBoolean, false)
+        }),
+        [this](const PropertyList& properties) -> ReturnValue {
+            auto& tracker = Application::GetInstance().GetAudioService().GetLatencyTracker();
+            auto json = tracker.GetJson();
+            if (properties["reset"].value<bool>()) {
+                tracker.Reset();
+            }
+            return json;
+        });
+
+    AddUserOnlyTool("self.audio.pipeline_stats",
+        "Get the audio pipeline statistics: frame counters, encode / decode time per frame, queue high-water marks, "
+        "pool allocations and jitter buffer counters. Set `reset` to true to clear the peaks after reading.",
+        PropertyList({
+            Property("reset", kPropertyTypeBoolean, false)
+        }),
+        [this](const PropertyList& properties) -> ReturnValue {
+            auto& audio_service = Application::GetInstance().GetAudioService();
+            auto json = audio_service.GetStatisticsJson();
+            if (properties["reset"].value<bool>()) {
+                audio_service.ResetStatisticsPeaks();
+            }
+            return json;
+        });
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
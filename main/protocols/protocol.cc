@@ -4,11 +4,33 @@
 
 #define TAG "Protocol"
 
+AudioStreamPacketPool& GetAudioStreamPacketPool() {
+    static AudioStreamPacketPool pool(0,
+        [](AudioStreamPacket& packet) {
+            packet.payload.reserve(AUDIO_STREAM_PACKET_PAYLOAD_RESERVE);
+        },
+        [](AudioStreamPacket& packet) {
+            packet.sample_rate = 0;
+            packet.frame_duration = 0;
+            packet.timestamp = 0;
+            packet.sequence = 0;
+            packet.time_us = 0;
+            packet.payload.clear();
+            packet.static_payload = nullptr;
+            packet.static_payload_size = 0;
+        });
+    return pool;
+}
+
+AudioStreamPacketPtr AcquireAudioStreamPacket() {
+    return GetAudioStreamPacketPool().Acquire();
+}
+
 void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
-void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
+void Protocol::OnIncomingAudio(std::function<void(AudioStreamPacketPtr packet)> callback) {
     on_incoming_audio_ = callback;
 }
 
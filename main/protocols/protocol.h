@@ -7,13 +7,31 @@
 #include <chrono>
 #include <vector>
 
+#include "object_pool.h"
+
+// Payload capacity reserved for pooled packets, enough for a typical 60ms Opus frame
+#define AUDIO_STREAM_PACKET_PAYLOAD_RESERVE 256
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // 0 if the transport has no sequence numbers
+    int64_t time_us = 0;    // Monotonic time the packet entered its current stage, for latency statistics
     std::vector<uint8_t> payload;
+    // Read-only payload in flash (pre-indexed prompt sounds), used instead of payload when set
+    const uint8_t* static_payload = nullptr;
+    size_t static_payload_size = 0;
 };
 
+using AudioStreamPacketPool = ObjectPool<AudioStreamPacket>;
+using AudioStreamPacketPtr = AudioStreamPacketPool::Handle;
+
+// All audio packets on the uplink and downlink are recycled through this pool. It keeps nothing until
+// the audio service sizes it from the depth of its queues (see AUDIO_STREAM_PACKET_POOL_SIZE).
+AudioStreamPacketPool& GetAudioStreamPacketPool();
+AudioStreamPacketPtr AcquireAudioStreamPacket();
+
 struct BinaryProtocol2 {
     uint16_t version;
     uint16_t type;          // Message type (0: OPUS, 1: JSON)
@@ -54,8 +72,16 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    // Round trip time of the last hello exchange, 0 before the first audio channel
+    inline int rtt_ms() const {
+        return rtt_ms_;
+    }
+    // Uplink frame duration announced in the hello message of the next audio channel
+    inline void SetFrameDuration(int frame_duration_ms) {
+        frame_duration_ = frame_duration_ms;
+    }
 
-    void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
+    void OnIncomingAudio(std::function<void(AudioStreamPacketPtr packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
@@ -67,7 +93,7 @@ public:
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
-    virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    virtual bool SendAudio(AudioStreamPacketPtr packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
@@ -76,7 +102,7 @@ public:
     virtual void Deinit()=0;
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
-    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
+    std::function<void(AudioStreamPacketPtr packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
     std::function<void(const std::string& message)> on_network_error_;
@@ -85,6 +111,8 @@ protected:
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    int frame_duration_ = 60;
+    int rtt_ms_ = 0;
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
@@ -1,54 +1,156 @@
 import socket
+import struct
 import wave
 import argparse
 
 
 '''
   Create a UDP socket and bind it to the server's IP:8000.
-  Listen for incoming messages and print them to the console.
-  Save the audio to a WAV file.
+  Receive the audio debugger taps (main/audio/processors/audio_debugger.h), decode them and
+  save every tap to its own WAV file. All files start at the same time, gaps left by dropped
+  datagrams are filled with silence, so the taps stay aligned sample by sample.
+  Dropped datagrams are reported per tap.
 '''
-def main(samplerate, channels):
+
+# magic, version, tap, format, channels, sample_rate, sequence, samples, time_us
+HEADER = struct.Struct("<HBBBBHIIq")
+MAGIC = 0x4441
+VERSION = 1
+FORMAT_PCM16 = 0
+FORMAT_IMA_ADPCM = 1
+TAP_NAMES = ["mic", "reference", "processed", "downlink"]
+
+IMA_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+]
+IMA_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def decode_ima_adpcm(payload, samples):
+    predictor, step_index = struct.unpack_from("<hB", payload, 0)
+    output = []
+    for i in range(samples):
+        byte = payload[4 + i // 2]
+        code = (byte >> 4) if i & 1 else (byte & 0x0F)
+        step = IMA_STEP_TABLE[step_index]
+        delta = step >> 3
+        if code & 4:
+            delta += step
+        if code & 2:
+            delta += step >> 1
+        if code & 1:
+            delta += step >> 2
+        predictor += -delta if code & 8 else delta
+        predictor = max(-32768, min(32767, predictor))
+        step_index = max(0, min(88, step_index + IMA_INDEX_TABLE[code]))
+        output.append(predictor)
+    return output
+
+
+class TapWriter:
+    def __init__(self, tap, sample_rate, prefix):
+        self.name = TAP_NAMES[tap] if tap < len(TAP_NAMES) else f"tap{tap}"
+        self.sample_rate = sample_rate
+        self.filename = f"{prefix}{self.name}_{sample_rate}.wav"
+        self.wav_file = wave.open(self.filename, "wb")
+        self.wav_file.setnchannels(1)
+        self.wav_file.setsampwidth(2)
+        self.wav_file.setframerate(sample_rate)
+        self.next_sequence = None
+        self.written = 0            # Samples written, including the padding
+        self.received = 0
+        self.dropped = 0
+        self.reordered = 0
+
+    def write(self, start_us, sequence, time_us, pcm):
+        gap = 0
+        if self.next_sequence is not None:
+            gap = (sequence - self.next_sequence) & 0xFFFFFFFF
+            if gap >= 0x80000000:
+                # Older than one already written, UDP reordered it
+                self.reordered += 1
+                return
+            self.dropped += gap
+        self.next_sequence = (sequence + 1) & 0xFFFFFFFF
+        self.received += 1
+
+        # Consecutive datagrams are contiguous, the device time places the first one and the ones after a drop
+        position = (time_us - start_us) * self.sample_rate // 1000000
+        if (self.received == 1 or gap > 0) and position > self.written:
+            self.wav_file.writeframes(b"\x00\x00" * (position - self.written))
+            self.written = position
+        self.wav_file.writeframes(struct.pack(f"<{len(pcm)}h", *pcm))
+        self.written += len(pcm)
+
+    def close(self):
+        self.wav_file.close()
+        total = self.received + self.dropped
+        loss = self.dropped * 100 / total if total > 0 else 0
+        print(f"{self.filename}: {self.received} datagrams, {self.dropped} dropped ({loss:.1f}%), "
+              f"{self.reordered} reordered, {self.written / self.sample_rate:.1f} s")
+
+
+def main(port, prefix):
     # Create a UDP socket
     server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    server_socket.bind(('0.0.0.0', 8000))
+    server_socket.bind(('0.0.0.0', port))
 
-    # Create WAV file with parameters
-    filename = f"{samplerate}_{channels}.wav"
-    wav_file = wave.open(filename, "wb")
-    wav_file.setnchannels(channels)     # channels parameter
-    wav_file.setsampwidth(2)            # 2 bytes per sample (16-bit)
-    wav_file.setframerate(samplerate)   # samplerate parameter
-
-    print(f"Start saving audio from 0.0.0.0:8000 to {filename}...")
+    writers = {}
+    start_us = None
+    print(f"Start saving audio taps from 0.0.0.0:{port}...")
 
     try:
         while True:
             # Receive a message from the client
-            message, address = server_socket.recvfrom(8000)
-            
-            # Write PCM data to WAV file
-            wav_file.writeframes(message)
-
-            # Print length of the message
-            print(f"Received {len(message)} bytes from {address}")
-    
+            message, address = server_socket.recvfrom(2048)
+            if len(message) < HEADER.size:
+                continue
+            magic, version, tap, fmt, channels, sample_rate, sequence, samples, time_us = HEADER.unpack_from(message)
+            if magic != MAGIC or version != VERSION or channels != 1:
+                print(f"Ignoring {len(message)} bytes from {address}, not an audio debugger datagram")
+                continue
+
+            payload = message[HEADER.size:]
+            if fmt == FORMAT_IMA_ADPCM:
+                pcm = decode_ima_adpcm(payload, samples)
+            elif fmt == FORMAT_PCM16:
+                pcm = list(struct.unpack(f"<{samples}h", payload[:samples * 2]))
+            else:
+                print(f"Unknown format {fmt} of tap {tap}")
+                continue
+
+            if start_us is None:
+                # The first datagram may come late from one tap, leave some room for the others
+                start_us = time_us - 100000
+            if time_us < start_us:
+                continue
+            writer = writers.get(tap)
+            if writer is None:
+                writer = TapWriter(tap, sample_rate, prefix)
+                writers[tap] = writer
+                print(f"New tap '{writer.name}' at {sample_rate} Hz from {address}")
+            writer.write(start_us, sequence, time_us, pcm)
+
     except KeyboardInterrupt:
         print("\nStopping recording...")
-    
+
     finally:
         # Close files and socket
-        wav_file.close()
+        for writer in writers.values():
+            writer.close()
         server_socket.close()
-        print(f"WAV file '{filename}' saved successfully")
 
 
 if __name__ == "__main__":
-    parser = argparse.ArgumentParser(description='UDP音频数据接收器，保存为WAV文件')
-    parser.add_argument('--samplerate', '-s', type=int, default=16000, 
-                        help='采样率 (默认: 16000)')
-    parser.add_argument('--channels', '-c', type=int, default=2, 
-                        help='声道数 (默认: 2)')
-    
+    parser = argparse.ArgumentParser(description='UDP音频调试数据接收器，每个采集点保存为一个WAV文件')
+    parser.add_argument('--port', '-p', type=int, default=8000,
+                        help='UDP端口 (默认: 8000)')
+    parser.add_argument('--prefix', type=str, default='',
+                        help='WAV文件名前缀')
+
     args = parser.parse_args()
-    main(args.samplerate, args.channels)
+    main(args.port, args.prefix)
@@ -0,0 +1,98 @@
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+
+'''
+  Offline evaluation of the early endpointing (main/audio/endpointer.cc).
+
+  The decision itself runs in the endpoint_eval host tool (tests/host/endpoint_eval.cc), which
+  feeds recorded 16 kHz WAV files (e.g. captured with audio_debug_server.py) to the real Endpointer
+  in frames of the uplink frame duration, with an energy VAD standing in for the AFE VAD. Build it
+  with the host tests:
+
+    cmake -S tests/host -B build-host && cmake --build build-host --target endpoint_eval
+
+  This script runs the tool and reports, for every file, when the endpoint fired, how much earlier
+  that was than a fixed server-side silence timeout, and whether speech came back after it (a cut-off).
+'''
+
+DEFAULT_TOOL = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "build-host", "endpoint_eval")
+
+# Options passed through to the tool
+TOOL_OPTIONS = ["frame_ms", "min_speech_ms", "hangover_ms", "max_hangover_ms", "decay_db",
+                "vad_min_noise_ms", "vad_threshold_db", "baseline_ms"]
+
+
+def run_tool(args):
+    command = [args.tool]
+    for name in TOOL_OPTIONS:
+        command += ["--" + name.replace("_", "-"), str(getattr(args, name))]
+    command += args.wav
+    try:
+        output = subprocess.run(command, check=True, capture_output=True, text=True).stdout
+    except FileNotFoundError:
+        sys.exit(f"{args.tool} not found, build it with the host tests or pass --tool")
+    except subprocess.CalledProcessError as e:
+        sys.exit(f"{args.tool} failed: {e.stderr.strip()}")
+    return [json.loads(line) for line in output.splitlines() if line.startswith("{")]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Evaluate the early endpointing on recorded WAV files")
+    parser.add_argument("wav", nargs="+", help="16 kHz 16-bit WAV files, one utterance each")
+    parser.add_argument("--tool", default=DEFAULT_TOOL, help="path of the endpoint_eval host tool")
+    parser.add_argument("--frame-ms", type=int, default=60, choices=[20, 40, 60])
+    parser.add_argument("--min-speech-ms", type=int, default=300)
+    parser.add_argument("--hangover-ms", type=int, default=600)
+    parser.add_argument("--max-hangover-ms", type=int, default=1200)
+    parser.add_argument("--decay-db", type=int, default=15)
+    parser.add_argument("--vad-min-noise-ms", type=int, default=100)
+    parser.add_argument("--vad-threshold-db", type=float, default=9.0,
+                        help="energy above the noise floor that the stand-in VAD treats as speech")
+    parser.add_argument("--baseline-ms", type=int, default=1500,
+                        help="trailing silence after which the server ends the turn without early endpointing")
+    args = parser.parse_args()
+
+    fired = 0
+    cut_off = 0
+    gains = []
+    for result in run_tool(args):
+        path = result["file"]
+        if "error" in result:
+            print(f"{path}: skipped, {result['error']}")
+            continue
+
+        fired_ms = result["endpoint_ms"]
+        speech_end_ms = result["speech_end_ms"]
+        baseline_ms = result["baseline_ms"]
+        resumed_ms = result["resumed_ms"]
+        if fired_ms is None:
+            print(f"{path}: no endpoint")
+            continue
+        fired += 1
+        line = f"{path}: endpoint at {fired_ms} ms"
+        if resumed_ms is not None:
+            cut_off += 1
+            line += f", CUT OFF: speech resumed at {resumed_ms} ms"
+        elif speech_end_ms is not None:
+            line += f", {fired_ms - speech_end_ms} ms after speech"
+            if baseline_ms is not None:
+                gains.append(baseline_ms - fired_ms)
+                line += f", {baseline_ms - fired_ms} ms before the server timeout"
+        print(line)
+
+    print()
+    print(f"Files: {len(args.wav)}, endpoints: {fired}, cut off: {cut_off}")
+    if fired > 0:
+        print(f"Cut-off rate: {cut_off * 100 / fired:.1f}%")
+    if gains:
+        gains.sort()
+        print(f"Earlier than the server timeout: mean {sum(gains) / len(gains):.0f} ms, "
+              f"median {gains[len(gains) // 2]} ms, min {gains[0]} ms")
+
+
+if __name__ == "__main__":
+    main()
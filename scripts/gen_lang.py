@@ -9,6 +9,8 @@ HEADER_TEMPLATE = """// Auto-generated language config
 
 #include <string_view>
 
+#include "prompt_sound.h"
+
 #ifndef {lang_code_for_font}
     #define {lang_code_for_font}  // 預設語言
 #endif
@@ -25,6 +27,12 @@ namespace Lang {{
     // 音效资源 (en-US as fallback for missing audio files)
     namespace Sounds {{
 {sounds}
+
+        // 预解析的提示音数据包表, 以 nullptr 结尾
+        inline constexpr PromptSound PROMPT_SOUNDS[] = {{
+{prompt_sounds}
+            {{ nullptr, nullptr, 0, 0 }}
+        }};
     }}
 }}
 """
@@ -50,6 +58,62 @@ def get_sound_files(directory):
         return []
     return [f for f in os.listdir(directory) if f.endswith('.ogg')]
 
+def parse_ogg_opus(path):
+    """解析 Ogg Opus 文件, 返回 (sample_rate, [(offset, size), ...]); 数据包跨页等无法直接索引时返回 None"""
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    packets = []
+    offset = 0
+    while True:
+        pos = data.find(b'OggS', offset)
+        if pos < 0 or pos + 27 > len(data):
+            break
+        page_segments = data[pos + 26]
+        body_offset = pos + 27 + page_segments
+        lacing = data[pos + 27:body_offset]
+        if body_offset + sum(lacing) > len(data):
+            break
+
+        cur = body_offset
+        packet_start = cur
+        packet_size = 0
+        for l in lacing:
+            packet_size += l
+            cur += l
+            if l < 255:
+                if packet_size > 0:
+                    packets.append((packet_start, packet_size))
+                packet_start = cur
+                packet_size = 0
+        if packet_size > 0:
+            # 数据包延续到下一页, 在 flash 中不连续
+            return None
+        offset = cur
+
+    if len(packets) < 2:
+        return None
+    head_offset, head_size = packets[0]
+    head = data[head_offset:head_offset + head_size]
+    tags_offset, _ = packets[1]
+    if head_size < 19 or head[:8] != b'OpusHead' or data[tags_offset:tags_offset + 8] != b'OpusTags':
+        return None
+    sample_rate = int.from_bytes(head[12:16], 'little')
+    return sample_rate, packets[2:]
+
+def generate_prompt_sound(name, path):
+    """生成提示音的数据包表, 返回 PROMPT_SOUNDS 的条目; 无法索引时返回 None, 运行时退回 Ogg 解析"""
+    parsed = parse_ogg_opus(path)
+    if parsed is None:
+        print(f"Warning: {path} can not be pre-indexed, it will be parsed at runtime")
+        return None, None
+    sample_rate, packets = parsed
+    table = ", ".join(f"{{ {offset}, {size} }}" for offset, size in packets)
+    packet_table = f'''
+        inline constexpr PromptPacket OGG_{name.upper()}_PACKETS[] = {{ {table} }};'''
+    entry = f"            {{ ogg_{name}_start, OGG_{name.upper()}_PACKETS, {len(packets)}, {sample_rate} }},"
+    return packet_table, entry
+
 def generate_header(lang_code, output_path):
     # 从输出路径推导项目结构
     # output_path 通常是 main/assets/lang_config.h
@@ -101,6 +165,7 @@ def generate_header(lang_code, output_path):
     # 生成字符串常量
     strings = []
     sounds = []
+    prompt_sounds = []
     for key, value in merged_strings.items():
         value = value.replace('"', '\\"')
         strings.append(f'        constexpr const char* {key.upper()} = "{value}";')
@@ -141,31 +206,44 @@ def generate_header(lang_code, output_path):
         else:
             sound_lang = 'en_us'
             
-        sounds.append(f'''
+        sound = f'''
         extern const char ogg_{base_name}_start[] asm("_binary_{base_name}_ogg_start");
         extern const char ogg_{base_name}_end[] asm("_binary_{base_name}_ogg_end");
         static const std::string_view OGG_{base_name.upper()} {{
         static_cast<const char*>(ogg_{base_name}_start),
         static_cast<size_t>(ogg_{base_name}_end - ogg_{base_name}_start)
-        }};''')
+        }};'''
+        # 只有当前语言目录下的音效会被嵌入固件, 回退到 en-US 的音效不生成数据包表
+        if file in current_sounds:
+            packet_table, entry = generate_prompt_sound(base_name, os.path.join(current_lang_dir, file))
+            if entry is not None:
+                sound += packet_table
+                prompt_sounds.append(entry)
+        sounds.append(sound)
     
     # 生成公共音效常量
     for file in sorted(common_sounds):
         base_name = os.path.splitext(file)[0]
-        sounds.append(f'''
+        sound = f'''
         extern const char ogg_{base_name}_start[] asm("_binary_{base_name}_ogg_start");
         extern const char ogg_{base_name}_end[] asm("_binary_{base_name}_ogg_end");
         static const std::string_view OGG_{base_name.upper()} {{
         static_cast<const char*>(ogg_{base_name}_start),
         static_cast<size_t>(ogg_{base_name}_end - ogg_{base_name}_start)
-        }};''')
+        }};'''
+        packet_table, entry = generate_prompt_sound(base_name, os.path.join(common_dir, file))
+        if entry is not None:
+            sound += packet_table
+            prompt_sounds.append(entry)
+        sounds.append(sound)
 
     # 填充模板
     content = HEADER_TEMPLATE.format(
         lang_code=lang_code,
         lang_code_for_font=lang_code.replace('-', '_').lower(),
         strings="\n".join(sorted(strings)),
-        sounds="\n".join(sorted(sounds))
+        sounds="\n".join(sorted(sounds)),
+        prompt_sounds="\n".join(sorted(prompt_sounds))
     )
 
     # 写入文件
@@ -0,0 +1,131 @@
+// Replays downlink playback reports (60 ms frames, 3 ms of playback jitter, a server clock off by
+// 0, +300 and -1000 ppm) through the AEC aligner while 20 ms uplink frames ask for references.
+// The references must stay within a few ms of the audio that really played, and the drift estimate
+// must find the clock offset, for one long stream and for many short responses with a Reset() in
+// between as the audio service does. One JSON line per run.
+
+#include "aec_aligner.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+#define DOWNLINK_FRAME_MS 60
+#define UPLINK_FRAME_US 20000
+#define PLAYBACK_JITTER_US 3000
+// Responses are this far apart, and the server starts every one at a new timestamp
+#define RESPONSE_GAP_US 2000000
+#define RESPONSE_TIMESTAMP_JUMP 100000
+
+struct ReplayResult {
+    double mean_error_ms = 0;
+    double max_error_ms = 0;
+    uint32_t references = 0;
+    uint32_t missing = 0;
+    bool drift_known = false;
+    int drift_ppm = 0;
+};
+
+/*
+ * Plays responses of frames_per_response frames each. The server clock runs drift_ppm fast: a
+ * timestamp advances (1 + drift) ms per ms of ours, so frame k of a response plays at
+ * k * 60 / (1 + drift) ms after its start, give or take the jitter.
+ */
+static ReplayResult Replay(int drift_ppm, int responses, int frames_per_response, unsigned seed) {
+    AecAligner aligner;
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> jitter(0, PLAYBACK_JITTER_US);
+    const double rate = 1.0 + drift_ppm * 1e-6;
+    ReplayResult result;
+    double total_error = 0;
+    int64_t start_us = 1000000;
+    uint32_t start_timestamp = 50000;
+
+    for (int response = 0; response < responses; response++) {
+        aligner.Reset();
+        int64_t capture_us = start_us;
+        for (int k = 0; k < frames_per_response; k++) {
+            int64_t play_us = start_us + std::llround(k * DOWNLINK_FRAME_MS * 1000 / rate + jitter(rng));
+            aligner.OnPlayback(start_timestamp + k * DOWNLINK_FRAME_MS, play_us, DOWNLINK_FRAME_MS * 1000);
+
+            // Uplink frames captured while this frame plays, skipping the first frames of a response
+            // (the aligner only knows the first report's jitter there)
+            int64_t end_us = start_us + std::llround((k + 1) * DOWNLINK_FRAME_MS * 1000 / rate);
+            for (; capture_us < end_us; capture_us += UPLINK_FRAME_US) {
+                if (k < 5) {
+                    continue;
+                }
+                uint32_t reference = aligner.GetReference(capture_us);
+                if (reference == 0) {
+                    result.missing++;
+                    continue;
+                }
+                double truth = start_timestamp + (capture_us - start_us) * rate / 1000.0;
+                double error = std::fabs((double)reference - truth);
+                total_error += error;
+                result.max_error_ms = std::max(result.max_error_ms, error);
+                result.references++;
+            }
+        }
+        // Nothing is referenced before the response started or long after it ended
+        CHECK_EQ(aligner.GetReference(start_us - 5 * PLAYBACK_JITTER_US), 0u);
+        CHECK_EQ(aligner.GetReference(capture_us + 1000000), 0u);
+
+        start_us = capture_us + RESPONSE_GAP_US;
+        start_timestamp += frames_per_response * DOWNLINK_FRAME_MS + RESPONSE_TIMESTAMP_JUMP;
+        result.drift_known = aligner.drift_known();
+        result.drift_ppm = aligner.drift_ppm();
+    }
+    result.mean_error_ms = result.references > 0 ? total_error / result.references : 0;
+    return result;
+}
+
+static void Report(const char* trace, int drift_ppm, const ReplayResult& result) {
+    printf("{\"test\":\"aec_aligner\",\"trace\":\"%s\",\"drift_ppm\":%d,\"references\":%u,\"missing\":%u,"
+           "\"error_ms\":{\"mean\":%.2f,\"max\":%.2f},\"drift_known\":%s,\"estimated_drift_ppm\":%d}\n",
+           trace, drift_ppm, result.references, result.missing, result.mean_error_ms, result.max_error_ms,
+           result.drift_known ? "true" : "false", result.drift_ppm);
+}
+
+static void TestLongStream(int drift_ppm) {
+    // Two minutes of one response
+    ReplayResult result = Replay(drift_ppm, 1, 2000, 2);
+    CHECK_EQ(result.missing, 0u);
+    CHECK(result.mean_error_ms < 2.0);
+    CHECK(result.max_error_ms < 8.0);
+    CHECK(result.drift_known);
+    CHECK(std::abs(result.drift_ppm - drift_ppm) < 60);
+    Report("long_stream", drift_ppm, result);
+}
+
+static void TestShortResponses(int drift_ppm) {
+    // Thirty 9 s responses: none is long enough alone, together they are
+    ReplayResult result = Replay(drift_ppm, 30, 150, 3);
+    CHECK_EQ(result.missing, 0u);
+    CHECK(result.mean_error_ms < 2.0);
+    CHECK(result.max_error_ms < 8.0);
+    CHECK(result.drift_known);
+    CHECK(std::abs(result.drift_ppm - drift_ppm) < 100);
+    Report("short_responses", drift_ppm, result);
+}
+
+static void TestDriftUnknownAtFirst() {
+    // Three seconds of playback do not tell 300 ppm from jitter, nothing is claimed yet
+    ReplayResult result = Replay(300, 1, 50, 4);
+    CHECK(!result.drift_known);
+    CHECK_EQ(result.drift_ppm, 0);
+    CHECK(result.mean_error_ms < 2.0);
+}
+
+int main() {
+    const int drifts[] = { 0, 300, -1000 };
+    for (int drift_ppm : drifts) {
+        TestLongStream(drift_ppm);
+    }
+    for (int drift_ppm : drifts) {
+        TestShortResponses(drift_ppm);
+    }
+    TestDriftUnknownAtFirst();
+    return TestResult("aec_aligner_test");
+}
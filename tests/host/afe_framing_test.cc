@@ -0,0 +1,162 @@
+// Cutting AFE output into frames: fetch sizes that divide the frame, are a multiple of it or do
+// neither, for 20 and 60 ms frames. Every frame must have the exact frame size and continue the
+// input where the previous one stopped, and once running the framing must not allocate.
+
+#include "processors/afe_audio_processor.h"
+#include "test_util.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+#define FEED_SAMPLES 256
+
+static std::atomic<uint64_t> heap_allocations{0};
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+class FakeAudioCodec : public AudioCodec {
+public:
+    FakeAudioCodec() {
+        duplex_ = true;
+        input_sample_rate_ = 16000;
+        input_channels_ = 1;
+        output_sample_rate_ = 16000;
+    }
+
+    void Shutdown() override {}
+
+private:
+    int Read(int16_t* dest, int samples) override { return samples; }
+    int Write(const int16_t* data, int samples) override { return samples; }
+};
+
+// A sample value that tells the position in the stream, with a period no frame size divides
+static int16_t Ramp(uint64_t index) {
+    return (int16_t)(index % 30011);
+}
+
+// The processing task never returns, so the processors live in storage that is never destroyed
+#define MAX_PROCESSORS 16
+alignas(AfeAudioProcessor) static unsigned char processor_storage[MAX_PROCESSORS][sizeof(AfeAudioProcessor)];
+static int processor_count = 0;
+
+struct Session {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bad_frames{0};
+    uint64_t next_index = 0;
+    size_t frame_samples = 0;
+};
+
+// Feeds feeds chunks of ramp and waits for every complete frame of what the AFE hands out
+static void RunSession(AfeAudioProcessor* processor, Session& session, int fetch_samples, int feeds,
+                       uint64_t& steady_allocations) {
+    std::vector<int16_t> chunk(FEED_SAMPLES);
+    uint64_t fed = 0;
+    uint64_t steady_start = 0;
+    processor->Start();
+    for (int i = 0; i < feeds; i++) {
+        if (i == feeds / 2) {
+            steady_start = heap_allocations;
+        }
+        for (int j = 0; j < FEED_SAMPLES; j++) {
+            chunk[j] = Ramp(fed++);
+        }
+        processor->Feed(std::move(chunk));
+    }
+
+    uint64_t fetched = fed / fetch_samples * fetch_samples;
+    uint64_t expected = fetched / session.frame_samples;
+    double deadline = NowMs() + 5000;
+    while (session.frames < expected && NowMs() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Nothing beyond the complete frames comes out
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    steady_allocations = heap_allocations - steady_start;
+    processor->Stop();
+
+    CHECK_EQ(session.frames.load(), expected);
+    CHECK_EQ(session.bad_frames.load(), 0u);
+}
+
+static void TestFraming(int frame_duration_ms, int fetch_samples) {
+    HostAfeSetChunkSizes(FEED_SAMPLES, fetch_samples);
+    static FakeAudioCodec codec;
+    CHECK(processor_count < MAX_PROCESSORS);
+    auto processor = new (processor_storage[processor_count++]) AfeAudioProcessor();
+    processor->Initialize(&codec, frame_duration_ms, nullptr);
+    CHECK_EQ(processor->GetFeedSize(), (size_t)FEED_SAMPLES);
+
+    Session session;
+    session.frame_samples = frame_duration_ms * 16;
+    processor->OnOutput([&session](std::vector<int16_t>&& data) {
+        bool good = data.size() == session.frame_samples;
+        for (size_t i = 0; good && i < data.size(); i++) {
+            good = data[i] == Ramp(session.next_index + i);
+        }
+        session.next_index += data.size();
+        session.bad_frames += good ? 0 : 1;
+        session.frames++;
+    });
+
+    uint64_t steady_allocations = 0;
+    RunSession(processor, session, fetch_samples, 1000, steady_allocations);
+    CHECK_EQ(steady_allocations, 0u);
+
+    // A new frame duration between sessions starts the framing over at the new size
+    int next_duration_ms = frame_duration_ms == 60 ? 20 : 60;
+    processor->SetFrameDuration(next_duration_ms);
+    Session next;
+    next.frame_samples = next_duration_ms * 16;
+    processor->OnOutput([&next](std::vector<int16_t>&& data) {
+        bool good = data.size() == next.frame_samples;
+        for (size_t i = 0; good && i < data.size(); i++) {
+            good = data[i] == Ramp(next.next_index + i);
+        }
+        next.next_index += data.size();
+        next.bad_frames += good ? 0 : 1;
+        next.frames++;
+    });
+    uint64_t next_steady_allocations = 0;
+    RunSession(processor, next, fetch_samples, 400, next_steady_allocations);
+    CHECK_EQ(next_steady_allocations, 0u);
+    // The callbacks capture the sessions on this stack
+    processor->OnOutput(nullptr);
+
+    printf("{\"test\":\"afe_framing\",\"frame_ms\":%d,\"fetch_samples\":%d,\"frames\":%llu,"
+           "\"steady_heap_allocations\":%llu,\"resized_frame_ms\":%d,\"resized_frames\":%llu}\n",
+           frame_duration_ms, fetch_samples, (unsigned long long)session.frames.load(),
+           (unsigned long long)steady_allocations, next_duration_ms, (unsigned long long)next.frames.load());
+}
+
+int main() {
+    // The device AFE fetches 512 samples; the others divide a frame, are a multiple of one or neither
+    TestFraming(60, 512);
+    TestFraming(20, 512);
+    TestFraming(60, 960);
+    TestFraming(20, 320);
+    TestFraming(60, 320);
+    TestFraming(20, 960);
+    TestFraming(60, 1920);
+    TestFraming(60, 1000);
+    TestFraming(20, 333);
+    TestFraming(60, 7);
+    return TestResult("afe_framing_test");
+}
@@ -0,0 +1,240 @@
+// Cycles per 60 ms frame of the audio_kernels.h fast paths and of AudioService::ReadAudioData(),
+// each against the code it replaced: the plain per-sample loops, and the ReadAudioData() that
+// allocated four vectors per stereo read (copied below from before the kernels).
+//
+// The input is a 48 kHz codec, the rate the boards with an input reference run at, resampled to
+// 16 kHz; the mic read is a memcpy so the numbers are those of the shuffling and resampling. One
+// JSON line per case reports the median cycles per frame of the old and new code. For the stereo
+// read it also reports how the new cycles split between the shuffling kernels and the two
+// resamplers. Cycles are TSC ticks on x86, nanoseconds elsewhere ("counter").
+//
+// Usage: audio_kernels_bench [--quick]
+
+#include "audio_kernels.h"
+#include "audio_service.h"
+#include "opus_resampler.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define COUNTER_NAME "tsc"
+static inline uint64_t Cycles() { return __rdtsc(); }
+#else
+#define COUNTER_NAME "ns"
+static inline uint64_t Cycles() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define CODEC_SAMPLE_RATE 48000
+#define FRAME_MS 60
+#define CODEC_FRAMES (CODEC_SAMPLE_RATE / 1000 * FRAME_MS)
+
+static volatile int64_t sink;
+// Read at run time, so the compiler sees buffer sizes as in the firmware and not as constants
+static volatile size_t codec_frames = CODEC_FRAMES;
+
+// Runs fn iterations times and returns the median cycles of one run
+template <typename Fn>
+static uint64_t MedianCycles(int iterations, Fn fn) {
+    std::vector<uint64_t> samples(iterations);
+    for (int i = 0; i < iterations; i++) {
+        uint64_t start = Cycles();
+        fn();
+        samples[i] = Cycles() - start;
+    }
+    std::nth_element(samples.begin(), samples.begin() + iterations / 2, samples.end());
+    return samples[iterations / 2];
+}
+
+static void Report(const char* name, uint64_t old_cycles, uint64_t new_cycles) {
+    printf("{\"bench\":\"audio_kernels\",\"case\":\"%s\",\"counter\":\"%s\",\"frame_ms\":%d,"
+           "\"old_per_frame\":%llu,\"new_per_frame\":%llu,\"speedup\":%.2f}\n",
+           name, COUNTER_NAME, FRAME_MS, (unsigned long long)old_cycles, (unsigned long long)new_cycles,
+           new_cycles ? (double)old_cycles / new_cycles : 0.0);
+    fflush(stdout);
+}
+
+static std::vector<int16_t> Tone(size_t samples) {
+    std::vector<int16_t> tone(samples);
+    for (size_t i = 0; i < samples; i++) {
+        tone[i] = (int16_t)(8000 * std::sin(2 * M_PI * 440 * i / CODEC_SAMPLE_RATE));
+    }
+    return tone;
+}
+
+// The loops the kernels replaced
+static void PlainDeinterleave(const int16_t* input, int16_t* left, int16_t* right, size_t frames) {
+    for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
+        left[i] = input[j];
+        right[i] = input[j + 1];
+    }
+}
+
+static void PlainInterleave(const int16_t* left, const int16_t* right, int16_t* output, size_t frames) {
+    for (size_t i = 0, j = 0; i < frames; ++i, j += 2) {
+        output[j] = left[i];
+        output[j + 1] = right[i];
+    }
+}
+
+static void PlainExtractLeft(const int16_t* input, int16_t* output, size_t frames) {
+    for (size_t i = 0; i < frames; ++i) {
+        output[i] = input[2 * i];
+    }
+}
+
+static void BenchKernels(int iterations) {
+    auto stereo = Tone(2 * CODEC_FRAMES);
+    std::vector<int16_t> left(CODEC_FRAMES), right(CODEC_FRAMES), merged(2 * CODEC_FRAMES);
+    std::vector<int32_t> wide(2 * CODEC_FRAMES);
+    std::vector<int16_t> narrow(2 * CODEC_FRAMES);
+    size_t frames = codec_frames;
+
+    Report("deinterleave_stereo",
+        MedianCycles(iterations, [&]() { PlainDeinterleave(stereo.data(), left.data(), right.data(), frames); sink += left[7]; }),
+        MedianCycles(iterations, [&]() { DeinterleaveStereo(stereo.data(), left.data(), right.data(), frames); sink += left[7]; }));
+    Report("interleave_stereo",
+        MedianCycles(iterations, [&]() { PlainInterleave(left.data(), right.data(), merged.data(), frames); sink += merged[7]; }),
+        MedianCycles(iterations, [&]() { InterleaveStereo(left.data(), right.data(), merged.data(), frames); sink += merged[7]; }));
+    Report("extract_left_channel",
+        MedianCycles(iterations, [&]() { PlainExtractLeft(stereo.data(), left.data(), frames); sink += left[7]; }),
+        MedianCycles(iterations, [&]() { ExtractLeftChannel(stereo.data(), left.data(), frames); sink += left[7]; }));
+    // NoAudioCodec output: 70 % volume to the 32-bit I2S slots and back for the reference
+    int32_t factor = AUDIO_VOLUME_FACTOR_ONE * 7 / 10;
+    Report("scale_to_int32",
+        MedianCycles(iterations, [&]() { ScaleToInt32Reference(stereo.data(), wide.data(), 2 * frames, factor); sink += wide[7]; }),
+        MedianCycles(iterations, [&]() { ScaleToInt32(stereo.data(), wide.data(), 2 * frames, factor); sink += wide[7]; }));
+    Report("shift_to_int16",
+        MedianCycles(iterations, [&]() { ShiftToInt16Reference(wide.data(), narrow.data(), 2 * frames, 12); sink += narrow[7]; }),
+        MedianCycles(iterations, [&]() { ShiftToInt16(wide.data(), narrow.data(), 2 * frames, 12); sink += narrow[7]; }));
+}
+
+// A codec whose reads copy a prepared tone, so the read costs only a memcpy
+class ToneAudioCodec : public AudioCodec {
+public:
+    explicit ToneAudioCodec(int input_channels) : tone_(Tone(2 * CODEC_FRAMES)) {
+        duplex_ = true;
+        input_reference_ = input_channels == 2;
+        input_sample_rate_ = CODEC_SAMPLE_RATE;
+        input_channels_ = input_channels;
+        output_sample_rate_ = 16000;
+    }
+
+    void Shutdown() override {}
+
+private:
+    std::vector<int16_t> tone_;
+
+    int Read(int16_t* dest, int samples) override {
+        samples = std::min<int>(samples, tone_.size());
+        memcpy(dest, tone_.data(), samples * sizeof(int16_t));
+        return samples;
+    }
+
+    int Write(const int16_t* data, int samples) override { return samples; }
+};
+
+// ReadAudioData() before the kernels and scratch buffers
+static bool OldReadAudioData(AudioCodec* codec, OpusResampler& input_resampler, OpusResampler& reference_resampler,
+                             std::vector<int16_t>& data, int sample_rate, int samples) {
+    data.resize(samples * codec->input_sample_rate() / sample_rate * codec->input_channels());
+    if (!codec->InputData(data)) {
+        return false;
+    }
+    if (codec->input_channels() == 2) {
+        auto mic_channel = std::vector<int16_t>(data.size() / 2);
+        auto reference_channel = std::vector<int16_t>(data.size() / 2);
+        for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
+            mic_channel[i] = data[j];
+            reference_channel[i] = data[j + 1];
+        }
+        auto resampled_mic = std::vector<int16_t>(input_resampler.GetOutputSamples(mic_channel.size()));
+        auto resampled_reference = std::vector<int16_t>(reference_resampler.GetOutputSamples(reference_channel.size()));
+        input_resampler.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
+        reference_resampler.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
+        data.resize(resampled_mic.size() + resampled_reference.size());
+        for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
+            data[j] = resampled_mic[i];
+            data[j + 1] = resampled_reference[i];
+        }
+    } else {
+        auto resampled = std::vector<int16_t>(input_resampler.GetOutputSamples(data.size()));
+        input_resampler.Process(data.data(), data.size(), resampled.data());
+        data = std::move(resampled);
+    }
+    return true;
+}
+
+static void BenchReadAudioData(int channels, int iterations) {
+    const int samples = 16000 / 1000 * FRAME_MS;
+    ToneAudioCodec codec(channels);
+    AudioService service;
+    service.Initialize(&codec);
+
+    OpusResampler input_resampler;
+    OpusResampler reference_resampler;
+    input_resampler.Configure(CODEC_SAMPLE_RATE, 16000);
+    reference_resampler.Configure(CODEC_SAMPLE_RATE, 16000);
+
+    std::vector<int16_t> old_data;
+    std::vector<int16_t> new_data;
+    // Warm up: enable the input, grow the scratch buffers and prime the filters
+    OldReadAudioData(&codec, input_resampler, reference_resampler, old_data, 16000, samples);
+    service.ReadAudioData(new_data, 16000, samples);
+    CHECK_EQ(new_data.size(), old_data.size());
+
+    uint64_t old_cycles = MedianCycles(iterations, [&]() {
+        OldReadAudioData(&codec, input_resampler, reference_resampler, old_data, 16000, samples);
+        sink += old_data[7];
+    });
+    uint64_t new_cycles = MedianCycles(iterations, [&]() {
+        service.ReadAudioData(new_data, 16000, samples);
+        sink += new_data[7];
+    });
+    // Both resample the same tone with filters in the same state
+    CHECK(old_data == new_data);
+    Report(channels == 2 ? "read_audio_data_stereo" : "read_audio_data_mono", old_cycles, new_cycles);
+
+    if (channels == 2) {
+        // Where the new stereo read spends its cycles
+        auto stereo = Tone(2 * CODEC_FRAMES);
+        std::vector<int16_t> left(CODEC_FRAMES), right(CODEC_FRAMES);
+        std::vector<int16_t> resampled_left(input_resampler.GetOutputSamples(CODEC_FRAMES));
+        std::vector<int16_t> resampled_right(resampled_left.size()), merged(2 * resampled_left.size());
+        size_t frames = codec_frames;
+        size_t output_frames = resampled_left.size();
+        uint64_t shuffle = MedianCycles(iterations, [&]() {
+            DeinterleaveStereo(stereo.data(), left.data(), right.data(), frames);
+            InterleaveStereo(resampled_left.data(), resampled_right.data(), merged.data(), output_frames);
+            sink += merged[7];
+        });
+        uint64_t resample = MedianCycles(iterations, [&]() {
+            input_resampler.Process(left.data(), frames, resampled_left.data());
+            reference_resampler.Process(right.data(), frames, resampled_right.data());
+            sink += resampled_left[7];
+        });
+        printf("{\"bench\":\"audio_kernels\",\"case\":\"read_audio_data_stereo_stages\",\"counter\":\"%s\","
+               "\"shuffle_per_frame\":%llu,\"resample_per_frame\":%llu,\"shuffle_share\":%.3f}\n",
+               COUNTER_NAME, (unsigned long long)shuffle, (unsigned long long)resample,
+               (double)shuffle / (shuffle + resample));
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int iterations = quick ? 50 : 2000;
+
+    BenchKernels(iterations);
+    BenchReadAudioData(2, iterations);
+    BenchReadAudioData(1, iterations);
+    return TestResult("audio_kernels_bench");
+}
@@ -0,0 +1,98 @@
+// Bit-exactness of the audio_kernels.h fast paths against plain per-sample loops
+
+#include "audio_kernels.h"
+#include "test_util.h"
+
+#include <random>
+#include <vector>
+
+static std::mt19937 rng(1234);
+
+static std::vector<int16_t> RandomSamples(size_t count) {
+    std::uniform_int_distribution<int> dist(INT16_MIN, INT16_MAX);
+    std::vector<int16_t> samples(count);
+    for (auto& s : samples) {
+        s = dist(rng);
+    }
+    // Always cover the extremes
+    if (count > 0) samples[0] = INT16_MIN;
+    if (count > 1) samples[1] = INT16_MAX;
+    if (count > 2) samples[2] = 0;
+    return samples;
+}
+
+static void TestShuffling() {
+    // Odd lengths and an offset of one sample exercise the tails and unaligned word accesses
+    for (size_t frames = 0; frames < 67; frames++) {
+        for (size_t offset = 0; offset < 2; offset++) {
+            auto input = RandomSamples(2 * frames + offset);
+            const int16_t* in = input.data() + offset;
+
+            std::vector<int16_t> left(frames + offset), right(frames + offset);
+            DeinterleaveStereo(in, left.data() + offset, right.data() + offset, frames);
+            for (size_t i = 0; i < frames; i++) {
+                CHECK_EQ(left[offset + i], in[2 * i]);
+                CHECK_EQ(right[offset + i], in[2 * i + 1]);
+            }
+
+            std::vector<int16_t> output(2 * frames + offset);
+            InterleaveStereo(left.data() + offset, right.data() + offset, output.data() + offset, frames);
+            for (size_t i = 0; i < 2 * frames; i++) {
+                CHECK_EQ(output[offset + i], in[i]);
+            }
+
+            std::vector<int16_t> mono(frames + offset);
+            ExtractLeftChannel(in, mono.data() + offset, frames);
+            for (size_t i = 0; i < frames; i++) {
+                CHECK_EQ(mono[offset + i], in[2 * i]);
+            }
+
+            // In place, output aliasing input
+            std::vector<int16_t> inplace(input);
+            ExtractLeftChannel(inplace.data() + offset, inplace.data() + offset, frames);
+            for (size_t i = 0; i < frames; i++) {
+                CHECK_EQ(inplace[offset + i], in[2 * i]);
+            }
+        }
+    }
+}
+
+static void TestScale() {
+    const int32_t factors[] = { 0, 1, 655, 32768, 65535, AUDIO_VOLUME_FACTOR_ONE, AUDIO_VOLUME_FACTOR_ONE + 1,
+                                200000, INT32_MAX, -1, -AUDIO_VOLUME_FACTOR_ONE, INT32_MIN };
+    for (int32_t factor : factors) {
+        for (size_t samples = 0; samples < 37; samples++) {
+            auto input = RandomSamples(samples);
+            std::vector<int32_t> fast(samples), reference(samples);
+            ScaleToInt32(input.data(), fast.data(), samples, factor);
+            ScaleToInt32Reference(input.data(), reference.data(), samples, factor);
+            CHECK(fast == reference);
+        }
+    }
+}
+
+static void TestShift() {
+    std::uniform_int_distribution<int32_t> dist(INT32_MIN, INT32_MAX);
+    for (int shift = 0; shift < 32; shift++) {
+        for (size_t samples = 0; samples < 37; samples++) {
+            std::vector<int32_t> input(samples);
+            for (auto& s : input) {
+                s = dist(rng);
+            }
+            if (samples > 0) input[0] = INT32_MIN;
+            if (samples > 1) input[1] = INT32_MAX;
+            if (samples > 2) input[2] = -INT16_MAX - 1;
+            std::vector<int16_t> fast(samples), reference(samples);
+            ShiftToInt16(input.data(), fast.data(), samples, shift);
+            ShiftToInt16Reference(input.data(), reference.data(), samples, shift);
+            CHECK(fast == reference);
+        }
+    }
+}
+
+int main() {
+    TestShuffling();
+    TestScale();
+    TestShift();
+    return TestResult("audio_kernels_test");
+}
@@ -0,0 +1,279 @@
+// Runs the audio service (queues, pools, jitter buffer, mixer, resamplers) on the host with stub
+// Opus codecs and a fake audio codec, through the four workloads of the device:
+//
+//   wake_word       mic reads fed to the wake word engine
+//   realtime_chat   mic frames encoded to the send queue while 24 kHz replies play (realtime listening)
+//   tts_playback    24 kHz downlink sentences decoded and resampled to the 48 kHz codec
+//   prompt_burst    back to back PlaySound() prompts
+//
+// Producers use the blocking paths and consumers drain as fast as they can, so every queue runs
+// at the depth its limits allow: the peaks are the worst case the pools have to cover. Each
+// scenario prints one JSON line with the throughput (audio ms per wall ms), process CPU time per
+// frame, heap allocations over the whole run and over its second half (steady state), the packet
+// pool growth and the statistics JSON of the service (queue peaks, codec cost, pool allocations).
+//
+// Usage: audio_pipeline_bench [--quick]
+
+#include "audio_service.h"
+#include "assets/lang_config.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <thread>
+
+static std::atomic<uint64_t> heap_allocations{0};
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+class FakeAudioCodec : public AudioCodec {
+public:
+    FakeAudioCodec(int input_sample_rate, int input_channels, int output_sample_rate) {
+        duplex_ = true;
+        input_reference_ = input_channels == 2;
+        input_sample_rate_ = input_sample_rate;
+        input_channels_ = input_channels;
+        output_sample_rate_ = output_sample_rate;
+    }
+
+    void Shutdown() override {}
+
+    uint64_t read_frames() const { return read_frames_; }
+    uint64_t written_samples() const { return written_samples_; }
+
+private:
+    std::atomic<uint64_t> read_frames_{0};
+    std::atomic<uint64_t> written_samples_{0};
+    uint32_t phase_ = 0;
+
+    // A 440 Hz tone on the mic, the reference channel (if any) carries the same tone attenuated
+    int Read(int16_t* dest, int samples) override {
+        int frames = samples / input_channels_;
+        for (int i = 0; i < frames; i++) {
+            int16_t value = (int16_t)(8000 * std::sin(2 * M_PI * 440 * phase_++ / input_sample_rate_));
+            for (int c = 0; c < input_channels_; c++) {
+                dest[i * input_channels_ + c] = c == 0 ? value : value / 4;
+            }
+        }
+        read_frames_ += frames;
+        return samples;
+    }
+
+    int Write(const int16_t* data, int samples) override {
+        written_samples_ += samples;
+        return samples;
+    }
+};
+
+struct ScenarioResult {
+    const char* name;
+    uint64_t frames = 0;
+    int frame_duration_ms = 0;
+    double wall_ms = 0;
+    double cpu_ms = 0;
+    uint64_t allocations = 0;
+    uint64_t steady_allocations = 0;
+    uint32_t packet_pool_allocations = 0;
+    std::string service_json;
+};
+
+static double CpuMs() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static double WallMs() {
+    return esp_timer_get_time() / 1000.0;
+}
+
+template <typename Predicate>
+static void WaitUntil(Predicate predicate) {
+    while (!predicate()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+static AudioStreamPacketPtr MakeDownlinkPacket(int sample_rate, uint32_t index) {
+    auto packet = AcquireAudioStreamPacket();
+    packet->sample_rate = sample_rate;
+    packet->frame_duration = 60;
+    packet->time_us = esp_timer_get_time();
+    packet->payload.assign(120, (uint8_t)index);
+    return packet;
+}
+
+/*
+ * Runs one scenario on a fresh service. body() gets the service and a callback to call once,
+ * half way through, to start the steady-state allocation count; it returns the number of frames.
+ */
+template <typename Body>
+static ScenarioResult RunScenario(const char* name, int frame_duration_ms, FakeAudioCodec& codec,
+                                  srmodel_list_t* models, Body body) {
+    ScenarioResult result;
+    result.name = name;
+    result.frame_duration_ms = frame_duration_ms;
+
+    uint32_t pool_allocations = GetAudioStreamPacketPool().allocations();
+    uint64_t allocations = heap_allocations;
+    uint64_t steady_start = 0;
+    auto mark_steady = [&]() { steady_start = heap_allocations; };
+
+    double wall_start = WallMs();
+    double cpu_start = CpuMs();
+    {
+        AudioService service;
+        service.Initialize(&codec);
+        if (models != nullptr) {
+            service.SetModelsList(models);
+        }
+        service.Start();
+        result.frames = body(service, mark_steady);
+
+        uint64_t end = heap_allocations;
+        result.allocations = end - allocations;
+        result.steady_allocations = steady_start > 0 ? end - steady_start : 0;
+        result.wall_ms = WallMs() - wall_start;
+        result.cpu_ms = CpuMs() - cpu_start;
+        result.packet_pool_allocations = GetAudioStreamPacketPool().allocations() - pool_allocations;
+        result.service_json = service.GetStatisticsJson();
+
+        service.Stop();
+        HostJoinTasks();
+    }
+    return result;
+}
+
+static void PrintResult(const ScenarioResult& result) {
+    double audio_ms = (double)result.frames * result.frame_duration_ms;
+    printf("{\"bench\":\"audio_pipeline\",\"scenario\":\"%s\",\"frames\":%llu,\"frame_ms\":%d,"
+           "\"wall_ms\":%.1f,\"realtime_factor\":%.1f,\"cpu_us_per_frame\":%.1f,"
+           "\"heap_allocations\":%llu,\"steady_heap_allocations\":%llu,\"packet_pool_allocations\":%u,"
+           "\"service\":%s}\n",
+           result.name, (unsigned long long)result.frames, result.frame_duration_ms,
+           result.wall_ms, result.wall_ms > 0 ? audio_ms / result.wall_ms : 0,
+           result.frames > 0 ? result.cpu_ms * 1000 / result.frames : 0,
+           (unsigned long long)result.allocations, (unsigned long long)result.steady_allocations,
+           result.packet_pool_allocations, result.service_json.c_str());
+    fflush(stdout);
+}
+
+// Wake word chunks (30 ms) fed from 16 kHz mono mic reads
+static ScenarioResult RunWakeWord(uint64_t chunks) {
+    FakeAudioCodec codec(16000, 1, 24000);
+    char model_name[] = "wn9_host";
+    char* model_names[] = { model_name };
+    srmodel_list_t models = { model_names, nullptr, 1 };
+    const uint64_t chunk_samples = 480;
+
+    return RunScenario("wake_word", 30, codec, &models, [&](AudioService& service, auto mark_steady) {
+        service.EnableWakeWordDetection(true);
+        WaitUntil([&]() { return codec.read_frames() >= chunks / 2 * chunk_samples; });
+        mark_steady();
+        WaitUntil([&]() { return codec.read_frames() >= chunks * chunk_samples; });
+        service.EnableWakeWordDetection(false);
+        return codec.read_frames() / chunk_samples;
+    });
+}
+
+// Realtime listening: 60 ms uplink frames from a 16 kHz mic with an AEC reference channel, encoded
+// and popped by the "network", while 24 kHz replies are decoded for the 24 kHz codec
+static ScenarioResult RunRealtimeChat(uint64_t packets) {
+    FakeAudioCodec codec(16000, 2, 24000);
+
+    return RunScenario("realtime_chat", 60, codec, nullptr, [&](AudioService& service, auto mark_steady) {
+        std::atomic<uint64_t> sent{0};
+        std::atomic<bool> done{false};
+        std::thread uplink([&]() {
+            while (!done) {
+                if (service.PopPacketFromSendQueue()) {
+                    sent++;
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            }
+        });
+
+        service.EnableVoiceProcessing(true);
+        for (uint32_t i = 0; i < packets; i++) {
+            if (i == packets / 2) {
+                mark_steady();
+            }
+            service.PushPacketToDecodeQueue(MakeDownlinkPacket(24000, i), true);
+        }
+        WaitUntil([&]() { return sent >= packets; });
+        service.EnableVoiceProcessing(false);
+        WaitUntil([&]() { return service.IsIdle(); });
+        done = true;
+        uplink.join();
+        return (uint64_t)sent;
+    });
+}
+
+// Downlink TTS: 24 kHz, 60 ms packets resampled to a 48 kHz codec. The server sends every sentence
+// as a burst, so the decode queue fills up and runs dry once per sentence.
+#define TTS_SENTENCE_PACKETS 50
+
+static ScenarioResult RunTtsPlayback(uint64_t packets) {
+    FakeAudioCodec codec(16000, 1, 48000);
+
+    return RunScenario("tts_playback", 60, codec, nullptr, [&](AudioService& service, auto mark_steady) {
+        for (uint32_t i = 0; i < packets; i++) {
+            if (i == packets / 2) {
+                mark_steady();
+            }
+            service.PushPacketToDecodeQueue(MakeDownlinkPacket(24000, i), true);
+            if ((i + 1) % TTS_SENTENCE_PACKETS == 0) {
+                WaitUntil([&]() { return service.IsIdle(); });
+            }
+        }
+        WaitUntil([&]() { return service.IsIdle(); });
+        return packets;
+    });
+}
+
+// Prompt sounds queued back to back, e.g. a notification repeated while nothing else plays
+static ScenarioResult RunPromptBurst(int prompts) {
+    FakeAudioCodec codec(16000, 1, 24000);
+
+    return RunScenario("prompt_burst", 60, codec, nullptr, [&](AudioService& service, auto mark_steady) {
+        for (int i = 0; i < prompts; i++) {
+            if (i == prompts / 2) {
+                mark_steady();
+            }
+            service.PlaySound(Lang::Sounds::OGG_HOST_PROMPT);
+        }
+        WaitUntil([&]() { return service.IsIdle(); });
+        return (uint64_t)prompts * Lang::Sounds::HOST_PROMPT_PACKET_COUNT;
+    });
+}
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int scale = quick ? 1 : 10;
+
+    PrintResult(RunWakeWord(1000 * scale));
+    PrintResult(RunRealtimeChat(500 * scale));
+    PrintResult(RunTtsPlayback(500 * scale));
+    PrintResult(RunPromptBurst(20 * scale));
+    return 0;
+}
@@ -0,0 +1,205 @@
+// Runs recorded WAV files through the real Endpointer, for scripts/endpoint_eval.py to report on.
+//
+// The files are read with FileAudioCodec in frames of the uplink frame duration, and the mic
+// channel is fed to Endpointer::Process() as the audio service does. The AFE VAD is not available
+// on the host, so an energy VAD with the same minimum noise duration stands in for it.
+//
+// One JSON line per file gives, in ms from the start, when the endpoint fired, when the last
+// speech ended, when a fixed server-side silence timeout would have ended the turn, and when
+// speech came back after the endpoint (a cut-off). Missing events are null.
+//
+// Usage: endpoint_eval [--frame-ms N] [--min-speech-ms N] [--hangover-ms N] [--max-hangover-ms N]
+//                      [--decay-db N] [--vad-min-noise-ms N] [--vad-threshold-db X] [--baseline-ms N]
+//                      file.wav...
+
+#include "codecs/file_audio_codec.h"
+#include "endpointer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define SAMPLE_RATE 16000
+
+struct EvalConfig {
+    int frame_ms = 60;
+    EndpointerConfig endpointer = {
+        .min_speech_ms = CONFIG_ENDPOINT_MIN_SPEECH_MS,
+        .hangover_ms = CONFIG_ENDPOINT_HANGOVER_MS,
+        .max_hangover_ms = CONFIG_ENDPOINT_MAX_HANGOVER_MS,
+        .decay_db = CONFIG_ENDPOINT_DECAY_DB,
+        .vad_min_noise_ms = CONFIG_VAD_MIN_NOISE_MS,
+    };
+    double vad_threshold_db = 9.0;  // Energy above the noise floor that the stand-in VAD treats as speech
+    int baseline_ms = 1500;         // Trailing silence after which the server ends the turn without early endpointing
+};
+
+// Speech above the noise floor by threshold_db, silence after min_noise_ms below it
+class EnergyVad {
+public:
+    EnergyVad(double threshold_db, int min_noise_ms)
+        : ratio_(std::pow(10.0, threshold_db / 10)), min_noise_ms_(min_noise_ms) {}
+
+    bool Process(double energy, int frame_ms) {
+        energy = std::max(energy, 1.0);
+        if (noise_floor_ < 0) {
+            noise_floor_ = energy;
+        }
+        if (energy > noise_floor_ * ratio_) {
+            speaking_ = true;
+            noise_ms_ = 0;
+        } else {
+            // The floor follows quiet frames quickly and loud ones slowly
+            noise_floor_ = 0.9 * noise_floor_ + 0.1 * energy;
+            noise_ms_ += frame_ms;
+            if (noise_ms_ >= min_noise_ms_) {
+                speaking_ = false;
+            }
+        }
+        return speaking_;
+    }
+
+private:
+    double ratio_;
+    int min_noise_ms_;
+    double noise_floor_ = -1;
+    bool speaking_ = false;
+    int noise_ms_ = 0;
+};
+
+static void PrintFile(const char* path) {
+    printf("{\"file\":\"");
+    for (const char* c = path; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            putchar('\\');
+        }
+        putchar(*c);
+    }
+    putchar('"');
+}
+
+static void PrintMs(const char* name, int64_t ms) {
+    if (ms < 0) {
+        printf(",\"%s\":null", name);
+    } else {
+        printf(",\"%s\":%lld", name, (long long)ms);
+    }
+}
+
+static void Evaluate(const char* path, const EvalConfig& config) {
+    FileAudioCodec codec(path, "", SAMPLE_RATE, false);
+    if (codec.input_sample_rate() != SAMPLE_RATE) {
+        PrintFile(path);
+        printf(",\"error\":\"expected 16-bit %d Hz audio\"}\n", SAMPLE_RATE);
+        return;
+    }
+    int channels = codec.input_channels();
+    size_t frame_samples = SAMPLE_RATE * config.frame_ms / 1000;
+    std::vector<int16_t> data(frame_samples * channels);
+    std::vector<int16_t> mic(frame_samples);
+
+    EnergyVad vad(config.vad_threshold_db, config.endpointer.vad_min_noise_ms);
+    Endpointer endpointer;
+    endpointer.Configure(config.endpointer);
+
+    int64_t fired_ms = -1;
+    int64_t speech_end_ms = -1;
+    int64_t baseline_ms = -1;
+    int64_t resumed_ms = -1;
+    int silence_ms = 0;
+    int frames = 0;
+    // The last partial frame, like FileAudioCodec's silence after the end, is not evaluated
+    while (codec.InputData(data) && !codec.input_finished()) {
+        int64_t now_ms = (int64_t)frames++ * config.frame_ms;
+        /* The mic channel only, like the audio processor output */
+        int64_t sum = 0;
+        for (size_t i = 0; i < frame_samples; i++) {
+            mic[i] = data[i * channels];
+            sum += int32_t(mic[i]) * mic[i];
+        }
+        bool speaking = vad.Process((double)sum / frame_samples, config.frame_ms);
+
+        if (speaking) {
+            silence_ms = 0;
+            speech_end_ms = now_ms + config.frame_ms;
+            if (fired_ms >= 0 && resumed_ms < 0) {
+                resumed_ms = now_ms;
+            }
+        } else if (speech_end_ms >= 0) {
+            silence_ms += config.frame_ms;
+            if (baseline_ms < 0 && silence_ms + config.endpointer.vad_min_noise_ms >= config.baseline_ms) {
+                baseline_ms = now_ms + config.frame_ms;
+            }
+        }
+
+        if (fired_ms < 0 && endpointer.Process(mic.data(), mic.size(), speaking)) {
+            fired_ms = now_ms + config.frame_ms;
+        }
+    }
+
+    if (frames == 0) {
+        PrintFile(path);
+        printf(",\"error\":\"no audio\"}\n");
+        return;
+    }
+    PrintFile(path);
+    printf(",\"frames\":%d,\"frame_ms\":%d", frames, config.frame_ms);
+    PrintMs("endpoint_ms", fired_ms);
+    PrintMs("speech_end_ms", speech_end_ms);
+    PrintMs("baseline_ms", baseline_ms);
+    PrintMs("resumed_ms", resumed_ms);
+    printf("}\n");
+}
+
+int main(int argc, char** argv) {
+    EvalConfig config;
+    struct {
+        const char* name;
+        int* value;
+    } options[] = {
+        { "--frame-ms", &config.frame_ms },
+        { "--min-speech-ms", &config.endpointer.min_speech_ms },
+        { "--hangover-ms", &config.endpointer.hangover_ms },
+        { "--max-hangover-ms", &config.endpointer.max_hangover_ms },
+        { "--decay-db", &config.endpointer.decay_db },
+        { "--vad-min-noise-ms", &config.endpointer.vad_min_noise_ms },
+        { "--baseline-ms", &config.baseline_ms },
+    };
+
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        bool matched = false;
+        if (strcmp(argv[i], "--vad-threshold-db") == 0 && i + 1 < argc) {
+            config.vad_threshold_db = atof(argv[++i]);
+            continue;
+        }
+        for (auto& option : options) {
+            if (strcmp(argv[i], option.name) == 0 && i + 1 < argc) {
+                *option.value = atoi(argv[++i]);
+                matched = true;
+                break;
+            }
+        }
+        if (!matched) {
+            if (strncmp(argv[i], "--", 2) == 0) {
+                fprintf(stderr, "Unknown option %s\n", argv[i]);
+                return 2;
+            }
+            files.push_back(argv[i]);
+        }
+    }
+    if (files.empty() || (config.frame_ms != 20 && config.frame_ms != 40 && config.frame_ms != 60)) {
+        fprintf(stderr, "Usage: %s [--frame-ms 20|40|60] [options] file.wav...\n", argv[0]);
+        return 2;
+    }
+
+    for (const char* path : files) {
+        Evaluate(path, config);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Round-trips WAV files through AudioService on a FileAudioCodec: a mono file, a stereo file with the
+// reference on the second channel, and the same at 48 kHz so the input resamplers run. The mic comes
+// back through the input tap and is played again as music, and the recorded WAV must be the samples
+// pushed. At 16 kHz the tap must also return the file itself.
+
+#include "codecs/file_audio_codec.h"
+#include "audio_service.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define FILE_MS 600
+#define TAP_CHUNK_FRAMES 320
+#define DRAIN_TIMEOUT_MS 3000
+
+static void PutLe32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back(value >> (8 * i));
+}
+
+static void PutLe16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value);
+    out.push_back(value >> 8);
+}
+
+static void WriteWav(const std::string& path, int sample_rate, int channels, const std::vector<int16_t>& samples) {
+    uint32_t data_size = samples.size() * sizeof(int16_t);
+    std::vector<uint8_t> header;
+    header.insert(header.end(), { 'R', 'I', 'F', 'F' });
+    PutLe32(header, 36 + data_size);
+    header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+    PutLe32(header, 16);
+    PutLe16(header, 1);
+    PutLe16(header, channels);
+    PutLe32(header, sample_rate);
+    PutLe32(header, sample_rate * channels * sizeof(int16_t));
+    PutLe16(header, channels * sizeof(int16_t));
+    PutLe16(header, 16);
+    header.insert(header.end(), { 'd', 'a', 't', 'a' });
+    PutLe32(header, data_size);
+
+    FILE* file = fopen(path.c_str(), "wb");
+    CHECK(file != nullptr);
+    fwrite(header.data(), 1, header.size(), file);
+    fwrite(samples.data(), sizeof(int16_t), samples.size(), file);
+    fclose(file);
+}
+
+// The samples of a WAV file as FileAudioCodec writes it (44-byte header), checking the header
+static std::vector<int16_t> ReadWav(const std::string& path, int sample_rate, int channels) {
+    std::vector<int16_t> samples;
+    FILE* file = fopen(path.c_str(), "rb");
+    CHECK(file != nullptr);
+    if (file == nullptr) {
+        return samples;
+    }
+    uint8_t header[44];
+    CHECK_EQ(fread(header, 1, sizeof(header), file), sizeof(header));
+    CHECK(memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVEfmt ", 8) == 0 && memcmp(header + 36, "data", 4) == 0);
+    CHECK_EQ(header[22] | (header[23] << 8), channels);
+    CHECK_EQ((uint32_t)(header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24)), (uint32_t)sample_rate);
+    uint32_t data_size = header[40] | (header[41] << 8) | (header[42] << 16) | ((uint32_t)header[43] << 24);
+    samples.resize(data_size / sizeof(int16_t));
+    CHECK_EQ(fread(samples.data(), sizeof(int16_t), samples.size(), file), samples.size());
+    fclose(file);
+    return samples;
+}
+
+// A chirp for the mic, the reference is the mic at a quarter of the level
+static std::vector<int16_t> MakeInput(int sample_rate, int channels) {
+    size_t frames = (size_t)sample_rate * FILE_MS / 1000;
+    std::vector<int16_t> samples(frames * channels);
+    for (size_t i = 0; i < frames; i++) {
+        double t = (double)i / sample_rate;
+        int16_t mic = (int16_t)(4 * (int)(2000 * std::sin(2 * M_PI * (200 + 1500 * t) * t)));
+        samples[i * channels] = mic;
+        if (channels == 2) {
+            samples[i * channels + 1] = mic / 4;
+        }
+    }
+    return samples;
+}
+
+static void RoundTrip(const std::filesystem::path& dir, const char* name, int sample_rate, int channels) {
+    std::string input_path = (dir / (std::string(name) + "_in.wav")).string();
+    std::string output_path = (dir / (std::string(name) + "_out.wav")).string();
+    auto input = MakeInput(sample_rate, channels);
+    WriteWav(input_path, sample_rate, channels, input);
+
+    FileAudioCodec codec(input_path, output_path, 16000);
+    CHECK_EQ(codec.input_channels(), channels);
+    CHECK_EQ(codec.input_reference(), channels == 2);
+    CHECK_EQ(codec.input_sample_rate(), sample_rate);
+
+    AudioService service;
+    service.Initialize(&codec);
+    service.EnableInputTap(true);
+    service.Start();
+
+    // Input: the whole file at 16 kHz from the tap, all channels interleaved
+    size_t frames = input.size() / channels * 16000 / sample_rate;
+    std::vector<int16_t> tapped;
+    std::vector<int16_t> chunk;
+    while (tapped.size() < frames * channels) {
+        if (!service.ReadInputTap(chunk, TAP_CHUNK_FRAMES)) {
+            CHECK(!"input tap timed out");
+            break;
+        }
+        tapped.insert(tapped.end(), chunk.begin(), chunk.end());
+    }
+    tapped.resize(frames * channels);
+    service.EnableInputTap(false);
+
+    std::vector<int16_t> mic(frames);
+    int max_reference_error = 0;
+    int64_t mic_energy = 0;
+    for (size_t i = 0; i < frames; i++) {
+        mic[i] = tapped[i * channels];
+        mic_energy += std::abs(mic[i]);
+        if (channels == 2) {
+            max_reference_error = std::max(max_reference_error, std::abs(mic[i] - 4 * tapped[i * channels + 1]));
+        }
+    }
+    CHECK(mic_energy > 0);
+    if (sample_rate == 16000) {
+        CHECK(tapped == input);
+    }
+    // The resamplers are linear, so the reference stays a quarter of the mic up to their rounding
+    CHECK(max_reference_error <= 3);
+
+    // Output: the mic as music, unity gain without voice, so the recording is the same samples
+    CHECK(service.PushMusicData(mic.data(), mic.size()));
+    double deadline = NowMs() + DRAIN_TIMEOUT_MS;
+    while (codec.recorded_samples() < mic.size() && NowMs() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    service.Stop();
+    HostJoinTasks();
+    codec.Shutdown();
+
+    auto recorded = ReadWav(output_path, 16000, 1);
+    CHECK_EQ(recorded.size(), mic.size());
+    CHECK(recorded == mic);
+
+    printf("{\"test\":\"file_audio_codec\",\"case\":\"%s\",\"sample_rate\":%d,\"channels\":%d,\"frames_16k\":%zu,"
+           "\"max_reference_error\":%d,\"recorded\":%zu}\n",
+           name, sample_rate, channels, frames, max_reference_error, recorded.size());
+    fflush(stdout);
+}
+
+int main() {
+    auto dir = std::filesystem::temp_directory_path() / ("file_audio_codec_test_" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+
+    RoundTrip(dir, "mono_16k", 16000, 1);
+    RoundTrip(dir, "reference_16k", 16000, 2);
+    RoundTrip(dir, "reference_48k", 48000, 2);
+
+    std::filesystem::remove_all(dir);
+    return TestResult("file_audio_codec_test");
+}
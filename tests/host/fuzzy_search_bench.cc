@@ -0,0 +1,411 @@
+// Fuzzy music and story search with and without the bigram index: the media_search scorers and
+// NgramIndex that Esp32Music::SearchMusicIndexFromlist() and FindStoryIndexFuzzy() call. Three checks:
+//
+//   superset   every entry that contains a query holds all of its bigrams and is a candidate
+//   golden     hand written queries on a small library of real titles find the expected entry
+//   generated  on synthetic libraries, every query ranks the same best entry with the index as
+//              with the linear scan: substrings, prefixes, misspellings and unrelated titles
+//
+// For every library size one JSON line reports the mean and p95 query latency of both searches, how
+// many queries the index answered without falling back to the linear scan and their mean latency
+// both ways, and the index size.
+//
+// Usage: fuzzy_search_bench [--quick]
+
+#include "media_search.h"
+#include "ngram_index.h"
+#include "test_util.h"
+
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#define GENERATED_QUERIES 400
+
+// Entries own their strings, the PSMusicInfo and PSStoryEntry the search reads point into them
+struct MusicLibrary {
+    std::deque<std::string> strings;
+    std::vector<PSMusicInfo> songs;
+    NgramIndex ngrams{MALLOC_CAP_SPIRAM};
+
+    char* Store(const std::string& s) {
+        strings.push_back(s);
+        return &strings.back()[0];
+    }
+
+    void Add(const std::string& title) {
+        PSMusicInfo song;
+        song.song_name = Store(NormalizeForSearch(title));
+        song.token_norm = Store(NormalizeForToken(title));
+        songs.push_back(song);
+    }
+
+    // As at the end of ScanMusicDirectories()
+    void Build() {
+        ngrams.Clear();
+        for (size_t i = 0; i < songs.size(); ++i) {
+            ngrams.Add(i, songs[i].song_name);
+            ngrams.Add(i, songs[i].token_norm);
+        }
+        ngrams.Build(songs.size());
+    }
+
+    int Search(const std::string& query, bool use_index, bool* fell_back) const {
+        MediaSearchResult result;
+        int found = SearchMusicFuzzy(songs.data(), songs.size(), use_index ? &ngrams : nullptr, query, &result);
+        if (fell_back) *fell_back = result.fell_back;
+        return found;
+    }
+};
+
+struct StoryLibrary {
+    std::deque<std::string> strings;
+    std::deque<std::vector<char*>> chapter_lists;
+    std::vector<PSStoryEntry> stories;
+    NgramIndex ngrams{MALLOC_CAP_SPIRAM};
+
+    char* Store(const std::string& s) {
+        strings.push_back(s);
+        return &strings.back()[0];
+    }
+
+    void Add(const std::string& name, const std::vector<std::string>& chapters) {
+        PSStoryEntry story;
+        story.story_name = Store(name);
+        story.norm_story = Store(NormalizeForSearch(name));
+        story.token_norm = Store(NormalizeForToken(name));
+        chapter_lists.emplace_back();
+        for (const auto& chapter : chapters) {
+            chapter_lists.back().push_back(Store("/sdcard/story/" + name + "/" + chapter + ".mp3"));
+        }
+        story.chapters = chapter_lists.back().data();
+        story.chapter_count = chapters.size();
+        stories.push_back(story);
+    }
+
+    // As at the end of the story scan
+    void Build() {
+        ngrams.Clear();
+        for (size_t i = 0; i < stories.size(); ++i) {
+            ngrams.Add(i, stories[i].norm_story);
+            ngrams.Add(i, stories[i].token_norm);
+            for (size_t j = 0; j < stories[i].chapter_count; ++j) {
+                ngrams.Add(i, NormalizeChapterName(stories[i].chapters[j]).c_str());
+            }
+        }
+        ngrams.Build(stories.size());
+    }
+
+    size_t Search(const std::string& query, bool use_index, bool* fell_back) const {
+        MediaSearchResult result;
+        size_t found = SearchStoryFuzzy(stories.data(), stories.size(), use_index ? &ngrams : nullptr, query, &result);
+        if (fell_back) *fell_back = result.fell_back;
+        return found;
+    }
+};
+
+// Every entry containing the query must be among the candidates
+static void CheckSuperset(const MusicLibrary& library, const std::vector<std::string>& queries) {
+    std::vector<uint16_t> candidates;
+    for (const auto& query : queries) {
+        std::string q = NormalizeForSearch(query);
+        if (!library.ngrams.FindContaining(q.c_str(), candidates)) {
+            continue;
+        }
+        for (size_t i = 0; i < library.songs.size(); ++i) {
+            if (strstr(library.songs[i].song_name, q.c_str()) || strstr(library.songs[i].token_norm, q.c_str())) {
+                CHECK(std::binary_search(candidates.begin(), candidates.end(), (uint16_t)i));
+            }
+        }
+    }
+}
+
+struct GoldenQuery {
+    const char* query;
+    const char* expected;  // Title of the expected best entry
+};
+
+static void TestGoldenMusic() {
+    const char* titles[] = {
+        "稻香", "晴天", "七里香", "青花瓷", "夜曲", "告白气球", "小幸运", "平凡之路", "演员", "光年之外",
+        "Let It Go", "Yesterday", "Hey Jude", "Shape of You", "See You Again", "Twinkle Twinkle Little Star",
+        "Baby Shark", "Happy Birthday", "小星星", "两只老虎", "世上只有妈妈好", "虫儿飞",
+    };
+    const GoldenQuery queries[] = {
+        { "稻香", "稻香" },
+        { "七里", "七里香" },
+        { "花瓷", "青花瓷" },
+        { "告白", "告白气球" },
+        { "光年", "光年之外" },
+        { "平凡路", "平凡之路" },
+        { "小星", "小星星" },
+        { "老虎", "两只老虎" },
+        { "妈妈好", "世上只有妈妈好" },
+        { "虫儿", "虫儿飞" },
+        { "let it go", "Let It Go" },
+        { "Shape Of You", "Shape of You" },
+        { "hey jude", "Hey Jude" },
+        { "twinkle star", "Twinkle Twinkle Little Star" },
+        { "see you", "See You Again" },
+        { "baby", "Baby Shark" },
+        { "birthday", "Happy Birthday" },
+        { "yesterdy", "Yesterday" },
+    };
+    MusicLibrary library;
+    for (const char* title : titles) {
+        library.Add(title);
+    }
+    library.Build();
+
+    for (const auto& golden : queries) {
+        int expected = -1;
+        for (size_t i = 0; i < library.songs.size(); ++i) {
+            if (strcmp(titles[i], golden.expected) == 0) expected = (int)i;
+        }
+        int linear = library.Search(golden.query, false, nullptr);
+        int indexed = library.Search(golden.query, true, nullptr);
+        if (linear != expected || indexed != expected) {
+            fprintf(stderr, "music query '%s': expected '%s', linear %d, indexed %d\n", golden.query,
+                    golden.expected, linear, indexed);
+        }
+        CHECK_EQ(linear, expected);
+        CHECK_EQ(indexed, expected);
+    }
+}
+
+static void TestGoldenStories() {
+    StoryLibrary library;
+    library.Add("小红帽", { "01 出门去外婆家", "02 遇见大灰狼", "03 猎人来了" });
+    library.Add("三只小猪", { "01 草房子", "02 木房子", "03 砖房子" });
+    library.Add("白雪公主", { "01 魔镜", "02 七个小矮人", "03 毒苹果" });
+    library.Add("西游记", { "01 石猴出世", "02 大闹天宫", "03 三打白骨精", "04 火焰山" });
+    library.Add("丑小鸭", { "01 丑小鸭" });
+    library.Add("The Little Prince", { "01 The Rose", "02 The Fox" });
+    library.Add("龟兔赛跑", { "01 龟兔赛跑" });
+    library.Build();
+
+    const GoldenQuery queries[] = {
+        { "小红帽", "小红帽" },
+        { "大灰狼", "小红帽" },
+        { "小猪", "三只小猪" },
+        { "白雪", "白雪公主" },
+        { "三打白骨精", "西游记" },
+        { "大闹天宫", "西游记" },
+        { "丑小鸭", "丑小鸭" },
+        { "little prince", "The Little Prince" },
+        { "兔子赛跑", "龟兔赛跑" },
+        { "七个小矮人", "白雪公主" },
+    };
+    const char* names[] = { "小红帽", "三只小猪", "白雪公主", "西游记", "丑小鸭", "The Little Prince", "龟兔赛跑" };
+    for (const auto& golden : queries) {
+        size_t expected = SIZE_MAX;
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+            if (strcmp(names[i], golden.expected) == 0) expected = i;
+        }
+        size_t linear = library.Search(golden.query, false, nullptr);
+        size_t indexed = library.Search(golden.query, true, nullptr);
+        if (linear != expected || indexed != expected) {
+            fprintf(stderr, "story query '%s': expected '%s', linear %zu, indexed %zu\n", golden.query,
+                    golden.expected, linear, indexed);
+        }
+        CHECK_EQ(linear, expected);
+        CHECK_EQ(indexed, expected);
+    }
+}
+
+// Titles of two to eight Chinese characters or one to four English words from small vocabularies,
+// so that many titles share characters, words and bigrams
+class TitleGenerator {
+public:
+    explicit TitleGenerator(unsigned seed) : rng_(seed) {
+        const char* chars = "我你他爱情的心梦天空海风花雪月夜光星雨春秋山水歌唱人生路远方故乡青春时间回忆美丽小城故事";
+        for (const char* p = chars; *p; p += 3) {
+            characters_.emplace_back(p, 3);
+        }
+    }
+
+    std::string Title() {
+        static const char* words[] = { "love", "you", "my", "heart", "night", "sky", "dream", "the",
+                                       "girl", "blue", "rain", "song", "sun", "home", "way", "time" };
+        std::string title;
+        if (rng_() % 2) {
+            int count = 2 + rng_() % 7;
+            for (int i = 0; i < count; i++) title += characters_[rng_() % characters_.size()];
+        } else {
+            int count = 1 + rng_() % 4;
+            for (int i = 0; i < count; i++) {
+                if (i) title += " ";
+                title += words[rng_() % 16];
+            }
+        }
+        return title;
+    }
+
+    // A query for title: a suffix, a prefix, a misspelling (one byte dropped) or another title.
+    // Suffixes and prefixes cut at character boundaries, as a spoken query would.
+    std::string Query(const std::string& title, int kind) {
+        std::string query = NormalizeForSearch(title);
+        size_t step = (unsigned char)query[0] >= 0x80 ? 3 : 1;
+        size_t chars = query.size() / step;
+        switch (kind) {
+        case 0:
+            return query.substr(rng_() % chars * step);
+        case 1:
+            return query.substr(0, std::min<size_t>(chars, 2 + rng_() % 3) * step);
+        case 2:
+            if (query.size() > 3) query.erase(query.size() / 2, 1);
+            return query;
+        default:
+            return NormalizeForSearch(Title());
+        }
+    }
+
+    uint32_t Next() { return rng_(); }
+
+private:
+    std::mt19937 rng_;
+    std::vector<std::string> characters_;
+};
+
+struct Latency {
+    std::vector<double> samples;
+
+    void Add(double ms) { samples.push_back(ms); }
+    double Mean() const {
+        double total = 0;
+        for (double ms : samples) total += ms;
+        return samples.empty() ? 0 : total / samples.size();
+    }
+    double P95() {
+        if (samples.empty()) return 0;
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() * 95 / 100];
+    }
+};
+
+// Latencies over all queries, and over those the index decided without a linear scan
+struct QueryStats {
+    Latency linear;
+    Latency indexed;
+    Latency decided_linear;
+    Latency decided_indexed;
+    size_t queries = 0;
+    int mismatches = 0;
+
+    void Add(double linear_ms, double indexed_ms, bool fell_back) {
+        queries++;
+        linear.Add(linear_ms);
+        indexed.Add(indexed_ms);
+        if (!fell_back) {
+            decided_linear.Add(linear_ms);
+            decided_indexed.Add(indexed_ms);
+        }
+    }
+};
+
+static void Report(const char* library, size_t entries, QueryStats& stats, size_t index_bytes) {
+    printf("{\"bench\":\"fuzzy_search\",\"library\":\"%s\",\"entries\":%zu,\"queries\":%zu,\"mismatches\":%d,"
+           "\"linear_ms\":{\"mean\":%.3f,\"p95\":%.3f},\"indexed_ms\":{\"mean\":%.3f,\"p95\":%.3f},"
+           "\"decided_by_index\":%zu,\"decided_linear_ms\":%.3f,\"decided_indexed_ms\":%.3f,\"index_bytes\":%zu}\n",
+           library, entries, stats.queries, stats.mismatches, stats.linear.Mean(), stats.linear.P95(),
+           stats.indexed.Mean(), stats.indexed.P95(), stats.decided_indexed.samples.size(),
+           stats.decided_linear.Mean(), stats.decided_indexed.Mean(), index_bytes);
+    fflush(stdout);
+}
+
+static void BenchMusic(size_t songs) {
+    TitleGenerator generator(songs);
+    MusicLibrary library;
+    for (size_t i = 0; i < songs; i++) {
+        library.Add(generator.Title());
+    }
+    library.Build();
+
+    std::vector<std::string> queries;
+    for (int k = 0; k < GENERATED_QUERIES; k++) {
+        const PSMusicInfo& song = library.songs[generator.Next() % songs];
+        std::string query = generator.Query(song.token_norm, k % 4);
+        if (!query.empty()) queries.push_back(query);
+    }
+    CheckSuperset(library, queries);
+
+    QueryStats stats;
+    for (const auto& query : queries) {
+        double start = NowMs();
+        int expected = library.Search(query, false, nullptr);
+        double middle = NowMs();
+        bool fell_back = true;
+        int found = library.Search(query, true, &fell_back);
+        stats.Add(middle - start, NowMs() - middle, fell_back);
+        if (found != expected) {
+            fprintf(stderr, "music query '%s' on %zu songs: linear %d, indexed %d\n", query.c_str(), songs, expected,
+                    found);
+            stats.mismatches++;
+        }
+    }
+    CHECK_EQ(stats.mismatches, 0);
+    Report("music", songs, stats, library.ngrams.memory_bytes());
+}
+
+static void BenchStories(size_t count) {
+    TitleGenerator generator(count + 1);
+    StoryLibrary library;
+    for (size_t i = 0; i < count; i++) {
+        std::string name = generator.Title();
+        // A third of the stories are a single track, the others have up to 30 chapters
+        int chapters = generator.Next() % 3 == 0 ? 1 : 1 + generator.Next() % 30;
+        std::vector<std::string> chapter_names;
+        for (int j = 0; j < chapters; j++) {
+            chapter_names.push_back(std::to_string(j + 1) + generator.Title());
+        }
+        library.Add(name, chapter_names);
+    }
+    library.Build();
+
+    std::vector<std::string> queries;
+    for (int k = 0; k < GENERATED_QUERIES / 2; k++) {
+        const PSStoryEntry& story = library.stories[generator.Next() % count];
+        std::string query = generator.Query(story.token_norm, k % 4);
+        if (!query.empty()) queries.push_back(query);
+    }
+
+    QueryStats stats;
+    for (const auto& query : queries) {
+        double start = NowMs();
+        size_t expected = library.Search(query, false, nullptr);
+        double middle = NowMs();
+        bool fell_back = true;
+        size_t found = library.Search(query, true, &fell_back);
+        stats.Add(middle - start, NowMs() - middle, fell_back);
+        if (found != expected) {
+            fprintf(stderr, "story query '%s' on %zu stories: linear %zu, indexed %zu\n", query.c_str(), count,
+                    expected, found);
+            stats.mismatches++;
+        }
+    }
+    CHECK_EQ(stats.mismatches, 0);
+    Report("story", count, stats, library.ngrams.memory_bytes());
+}
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+
+    TestGoldenMusic();
+    TestGoldenStories();
+
+    std::vector<size_t> song_counts = quick ? std::vector<size_t>{ 1000, 5000 }
+                                            : std::vector<size_t>{ 1000, 5000, 20000, 60000 };
+    for (size_t songs : song_counts) {
+        BenchMusic(songs);
+    }
+    std::vector<size_t> story_counts = quick ? std::vector<size_t>{ 200 } : std::vector<size_t>{ 200, 1000 };
+    for (size_t count : story_counts) {
+        BenchStories(count);
+    }
+    return TestResult("fuzzy_search_bench");
+}
@@ -0,0 +1,219 @@
+// Replays downlink packet traces through the jitter buffer on a virtual clock, with a speaker taking
+// one frame every frame duration, and reports the concealed frames and the latency the buffer adds
+// (playout time minus arrival time) as one JSON line per trace.
+
+#include "jitter_buffer.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#define FRAME_US 60000
+#define NETWORK_DELAY_US 40000
+
+struct TracePacket {
+    uint32_t sequence;
+    int64_t arrival_us;
+};
+
+struct Trace {
+    const char* name;
+    std::vector<TracePacket> packets;   // In arrival order
+    uint32_t sent = 0;
+    uint32_t lost = 0;
+};
+
+// Packets sent every frame, delayed by the network plus up to jitter_us, some of them lost;
+// a jitter above the frame duration reorders them
+static Trace BuildTrace(const char* name, uint32_t count, int loss_percent, int64_t jitter_us,
+                        uint32_t burst_loss_at = 0, uint32_t burst_loss_length = 0) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int64_t> jitter(0, jitter_us);
+    Trace trace;
+    trace.name = name;
+    trace.sent = count;
+    for (uint32_t sequence = 1; sequence <= count; sequence++) {
+        bool burst = sequence >= burst_loss_at && sequence < burst_loss_at + burst_loss_length;
+        if (burst || percent(rng) < loss_percent) {
+            trace.lost++;
+            continue;
+        }
+        trace.packets.push_back({ sequence, sequence * FRAME_US + NETWORK_DELAY_US + jitter(rng) });
+    }
+    std::stable_sort(trace.packets.begin(), trace.packets.end(),
+        [](const TracePacket& a, const TracePacket& b) { return a.arrival_us < b.arrival_us; });
+    return trace;
+}
+
+struct ReplayResult {
+    uint32_t played = 0;
+    uint32_t concealed = 0;
+    uint32_t underruns = 0;
+    bool in_order = true;
+    std::vector<int64_t> added_latency_us;
+    JitterBufferStatistics statistics;
+};
+
+static ReplayResult Replay(const Trace& trace) {
+    JitterBuffer buffer(1, 6, 3);
+    ReplayResult result;
+    size_t next = 0;
+    int64_t next_playout_us = -1;
+    uint32_t last_played = 0;
+    std::vector<int64_t> arrival(trace.sent + 1, 0);
+
+    for (int64_t now = 0; next < trace.packets.size() || !buffer.empty(); now += 1000) {
+        while (next < trace.packets.size() && trace.packets[next].arrival_us <= now) {
+            auto packet = AcquireAudioStreamPacket();
+            packet->sequence = trace.packets[next].sequence;
+            packet->frame_duration = FRAME_US / 1000;
+            arrival[packet->sequence] = now;
+            buffer.Put(std::move(packet), now);
+            next++;
+        }
+
+        // The speaker takes a frame every FRAME_US once playout has started
+        if (next_playout_us < 0) {
+            if (!buffer.IsReady(now)) {
+                continue;
+            }
+            next_playout_us = now;
+        }
+        if (now < next_playout_us) {
+            continue;
+        }
+        next_playout_us += FRAME_US;
+        if (!buffer.IsReady(now)) {
+            result.underruns++;
+            continue;
+        }
+
+        AudioStreamPacketPtr packet;
+        switch (buffer.Get(packet)) {
+        case JitterBuffer::kJitterBufferPacket:
+            result.played++;
+            result.in_order = result.in_order && packet->sequence > last_played;
+            last_played = packet->sequence;
+            result.added_latency_us.push_back(now - arrival[packet->sequence]);
+            break;
+        case JitterBuffer::kJitterBufferConceal:
+            result.concealed++;
+            break;
+        case JitterBuffer::kJitterBufferEmpty:
+            result.underruns++;
+            break;
+        }
+    }
+    result.statistics = buffer.statistics();
+    return result;
+}
+
+static void Report(const Trace& trace, ReplayResult& result) {
+    auto& latency = result.added_latency_us;
+    std::sort(latency.begin(), latency.end());
+    int64_t total = 0;
+    for (int64_t value : latency) {
+        total += value;
+    }
+    int64_t mean = latency.empty() ? 0 : total / (int64_t)latency.size();
+    int64_t p95 = latency.empty() ? 0 : latency[latency.size() * 95 / 100];
+    printf("{\"test\":\"jitter_buffer\",\"trace\":\"%s\",\"sent\":%u,\"lost\":%u,\"played\":%u,\"reordered\":%u,"
+           "\"late\":%u,\"concealed\":%u,\"skipped\":%u,\"resynced\":%u,\"underruns\":%u,"
+           "\"added_latency_ms\":{\"mean\":%.1f,\"p95\":%.1f,\"max\":%.1f}}\n",
+           trace.name, trace.sent, trace.lost, result.played, result.statistics.reordered,
+           result.statistics.late, result.concealed, result.statistics.skipped, result.statistics.resynced,
+           result.underruns,
+           mean / 1000.0, p95 / 1000.0, latency.empty() ? 0 : latency.back() / 1000.0);
+}
+
+// Invariants of every trace: order restored, every packet played or counted late, concealment counted
+static void CheckReplay(const Trace& trace, const ReplayResult& result) {
+    CHECK(result.in_order);
+    CHECK_EQ(result.played + result.statistics.late, trace.sent - trace.lost);
+    CHECK_EQ(result.statistics.received, trace.sent - trace.lost);
+    CHECK_EQ(result.statistics.concealed, result.concealed);
+    // Only frames that never arrived in time can be concealed or skipped
+    CHECK(result.concealed + result.statistics.skipped <= trace.lost + result.statistics.late);
+    // A played packet waits at most the largest target delay plus the frame it arrived in
+    for (int64_t latency : result.added_latency_us) {
+        CHECK(latency <= 7 * FRAME_US);
+    }
+}
+
+static void TestCleanTrace() {
+    Trace trace = BuildTrace("clean", 500, 0, 0);
+    ReplayResult result = Replay(trace);
+    CheckReplay(trace, result);
+    CHECK_EQ(result.played, 500u);
+    CHECK_EQ(result.concealed, 0u);
+    CHECK_EQ(result.statistics.reordered, 0u);
+    CHECK_EQ(result.statistics.late, 0u);
+    CHECK_EQ(result.underruns, 0u);
+    // Without jitter the target stays at the minimum, a packet waits for one frame at most
+    for (int64_t latency : result.added_latency_us) {
+        CHECK(latency <= FRAME_US);
+    }
+    Report(trace, result);
+}
+
+static void TestLossyReorderedTrace() {
+    // 5% loss and up to 150 ms of jitter, so packets overtake each other
+    Trace trace = BuildTrace("lossy_reordered", 2000, 5, 150000);
+    ReplayResult result = Replay(trace);
+    CheckReplay(trace, result);
+    CHECK(result.statistics.reordered > 0);
+    CHECK(result.concealed >= trace.lost / 2);
+    // The target follows the jitter up instead of dropping reordered packets
+    CHECK(result.statistics.late < trace.sent / 20);
+    Report(trace, result);
+}
+
+static void TestBurstLossTrace() {
+    // Ten frames in a row lost: the buffer runs dry and playout restarts after the gap instead of
+    // concealing it, which would delay every later frame by the concealed ones
+    Trace trace = BuildTrace("burst_loss", 500, 0, 20000, 200, 10);
+    ReplayResult result = Replay(trace);
+    CheckReplay(trace, result);
+    CHECK_EQ(result.played, trace.sent - trace.lost);
+    CHECK_EQ(result.statistics.skipped, 10u);
+    CHECK_EQ(result.concealed, 0u);
+    for (int64_t latency : result.added_latency_us) {
+        CHECK(latency <= 2 * FRAME_US);
+    }
+    Report(trace, result);
+}
+
+// statistics() is read by other tasks while the decoder task updates the buffer
+static void TestStatisticsSnapshot() {
+    JitterBuffer buffer(1, 6, 3);
+    std::atomic<bool> done{false};
+    std::thread reader([&]() {
+        uint32_t last = 0;
+        while (!done) {
+            JitterBufferStatistics statistics = buffer.statistics();
+            CHECK(statistics.received >= last);
+            last = statistics.received;
+        }
+    });
+    for (uint32_t sequence = 1; sequence <= 20000; sequence++) {
+        auto packet = AcquireAudioStreamPacket();
+        packet->sequence = sequence;
+        buffer.Put(std::move(packet), sequence * FRAME_US);
+        AudioStreamPacketPtr out;
+        buffer.Get(out);
+    }
+    done = true;
+    reader.join();
+    CHECK_EQ(buffer.statistics().received, 20000u);
+}
+
+int main() {
+    TestCleanTrace();
+    TestLossyReorderedTrace();
+    TestBurstLossTrace();
+    TestStatisticsSnapshot();
+    return TestResult("jitter_buffer_test");
+}
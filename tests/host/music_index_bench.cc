@@ -0,0 +1,279 @@
+// Music library scan with and without the persistent index, on a synthetic tree of 100 category
+// directories holding 10000 songs in total (2000 with --quick). The scan follows
+// Esp32Music::ScanMusicDirectory(): every directory is read for its entry signature and stat()ed
+// for its mtime; a directory the index does not vouch for has each file parsed from its name and
+// stat()ed for its size, as ExtractMusicInfo() does, and the index is saved afterwards.
+//
+//   cold      no index yet: everything is parsed, the song view sorted and the index written
+//   warm      unchanged tree: the index is loaded and every directory reused from it
+//   one_dir   a song added to one directory: only that directory is parsed again
+//
+// Each run prints one JSON line with the time, directories parsed and reused, file stat() calls
+// and the index size. On the device the SD card makes every call far slower than on the host page
+// cache; the counts say how many of them a warm boot saves.
+//
+// Usage: music_index_bench [--quick]
+
+#include "music_library_index.h"
+#include "test_util.h"
+
+#include <dirent.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define BENCH_DIRS 100
+
+struct ScanResult {
+    std::vector<PSMusicInfo> library;
+    std::vector<MusicLibraryIndex::ScannedDir> dirs;
+    uint32_t parsed_dirs = 0;
+    uint32_t reused_dirs = 0;
+    uint32_t file_stats = 0;
+    bool saved = false;
+    double ms = 0;
+};
+
+// Strings of the parsed songs, stand-in for the PSRAM string pool of the firmware
+static std::deque<std::string> string_pool;
+
+static char* PoolString(std::string value) {
+    string_pool.push_back(std::move(value));
+    return const_cast<char*>(string_pool.back().c_str());
+}
+
+static std::string Trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(' ');
+    size_t end = s.find_last_not_of(' ');
+    return begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+}
+
+// "【01-20】Category/M007 = Song - Artist.mp3": the name split of ExtractMusicInfo() and its size stat()
+static PSMusicInfo ParseFile(const std::string& dir, const std::string& name, uint32_t& file_stats) {
+    PSMusicInfo info;
+    std::string path = dir + "/" + name;
+    info.file_path = PoolString(path);
+    info.file_name = PoolString(name);
+
+    std::string folder = dir.substr(dir.find_last_of('/') + 1);
+    size_t bracket = folder.find("】");
+    info.category = PoolString(Trim(bracket != std::string::npos ? folder.substr(bracket + 3) : folder));
+
+    std::string base = name.substr(0, name.find_last_of('.'));
+    std::string title = base;
+    size_t equal = base.find('=');
+    if (equal != std::string::npos && (base[0] == 'M' || base[0] == 'm')) {
+        info.index_id = PoolString("M" + std::to_string(atoi(base.c_str() + 1)));
+        title = Trim(base.substr(equal + 1));
+    } else {
+        info.index_id = PoolString("");
+    }
+    size_t dash = title.find(" - ");
+    std::string song = dash != std::string::npos ? title.substr(0, dash) : title;
+    std::string artist = dash != std::string::npos ? title.substr(dash + 3) : "";
+    std::string song_norm = song;
+    std::transform(song_norm.begin(), song_norm.end(), song_norm.begin(), ::tolower);
+    std::string artist_norm = artist;
+    std::transform(artist_norm.begin(), artist_norm.end(), artist_norm.begin(), ::tolower);
+    info.song_name = PoolString(song_norm);
+    info.token_norm = PoolString(song_norm);
+    info.artist = PoolString(artist);
+    info.artist_norm = PoolString(artist_norm);
+
+    struct stat st;
+    file_stats++;
+    info.file_size = stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+    return info;
+}
+
+static void ScanDirectory(const std::string& path, MusicLibraryIndex& index, ScanResult& result,
+                          std::vector<std::string>& subdirs) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return;
+    }
+    std::vector<std::string> files;
+    uint32_t signature = MusicLibraryIndex::kSignatureSeed;
+    while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        signature = MusicLibraryIndex::Hash(signature, entry->d_name, strlen(entry->d_name) + 1);
+        signature = MusicLibraryIndex::Hash(signature, (const char*)&entry->d_type, 1);
+        if (entry->d_type == DT_DIR) {
+            subdirs.push_back(path + "/" + entry->d_name);
+        } else if (entry->d_type == DT_REG) {
+            files.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    struct stat st;
+    int64_t mtime = stat(path.c_str(), &st) == 0 ? (int64_t)st.st_mtime : 0;
+    const MusicIndexDir* cached = index.FindDir(path, signature, mtime);
+    size_t first = result.library.size();
+    if (cached) {
+        for (uint32_t i = 0; i < cached->record_count; i++) {
+            const MusicIndexRecord& record = index.record(cached->first_record + i);
+            PSMusicInfo info;
+            info.file_path = const_cast<char*>(index.string(record.file_path));
+            info.file_name = const_cast<char*>(index.string(record.file_name));
+            info.song_name = const_cast<char*>(index.string(record.song_name));
+            info.artist = const_cast<char*>(index.string(record.artist));
+            info.artist_norm = const_cast<char*>(index.string(record.artist_norm));
+            info.token_norm = const_cast<char*>(index.string(record.token_norm));
+            info.category = const_cast<char*>(index.string(record.category));
+            info.index_id = const_cast<char*>(index.string(record.index_id));
+            info.file_size = record.file_size;
+            result.library.push_back(info);
+        }
+        result.reused_dirs++;
+    } else {
+        for (const auto& name : files) {
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".mp3") == 0) {
+                result.library.push_back(ParseFile(path, name, result.file_stats));
+            }
+        }
+        result.parsed_dirs++;
+    }
+    result.dirs.push_back({ path, signature, mtime, (uint32_t)first, (uint32_t)(result.library.size() - first) });
+}
+
+// Pre-order walk with an explicit stack, as ScanMusicDirectories() does
+static ScanResult Scan(const std::string& root, const std::string& index_path) {
+    ScanResult result;
+    double start = NowMs();
+    MusicLibraryIndex index;
+    index.Load(index_path, MusicLibraryIndex::kSignatureSeed);
+
+    std::vector<std::string> pending{ root };
+    std::vector<std::string> subdirs;
+    while (!pending.empty()) {
+        std::string path = std::move(pending.back());
+        pending.pop_back();
+        subdirs.clear();
+        ScanDirectory(path, index, result, subdirs);
+        pending.insert(pending.end(), subdirs.rbegin(), subdirs.rend());
+    }
+
+    bool unchanged = index.loaded() && result.parsed_dirs == 0 && result.dirs.size() == index.dir_count() &&
+                     result.library.size() == index.record_count();
+    std::vector<uint32_t> view(result.library.size());
+    if (unchanged) {
+        std::copy(index.view(), index.view() + view.size(), view.begin());
+    } else {
+        for (size_t i = 0; i < view.size(); i++) {
+            view[i] = i;
+        }
+        std::sort(view.begin(), view.end(), [&](uint32_t a, uint32_t b) {
+            return strcmp(result.library[a].song_name, result.library[b].song_name) < 0;
+        });
+        result.saved = MusicLibraryIndex::Save(index_path, MusicLibraryIndex::kSignatureSeed, result.dirs,
+                                               result.library.data(), result.library.size(), view.data());
+    }
+    result.ms = NowMs() - start;
+    // The reused strings point into the index, which goes away with it
+    for (auto& info : result.library) {
+        info.file_path = PoolString(info.file_path);
+        info.song_name = PoolString(info.song_name);
+    }
+    return result;
+}
+
+static void WriteSong(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file) {
+        fwrite("ID3", 1, 3, file);
+        fclose(file);
+    }
+}
+
+static void BuildTree(const std::string& root, int songs) {
+    mkdir(root.c_str(), 0755);
+    for (int d = 0; d < BENCH_DIRS; d++) {
+        char dir[256];
+        snprintf(dir, sizeof(dir), "%s/【%02d-%02d】Category %d", root.c_str(), d * 20 + 1, d * 20 + 20, d);
+        mkdir(dir, 0755);
+        for (int i = d; i < songs; i += BENCH_DIRS) {
+            char name[512];
+            snprintf(name, sizeof(name), "%s/M%05d = Song %d - Artist %d.mp3", dir, i, i, i % 37);
+            WriteSong(name);
+        }
+    }
+}
+
+static void PrintResult(const char* run, const ScanResult& result, const std::string& index_path) {
+    struct stat st;
+    long long index_bytes = stat(index_path.c_str(), &st) == 0 ? (long long)st.st_size : 0;
+    printf("{\"bench\":\"music_index\",\"run\":\"%s\",\"songs\":%u,\"dirs\":%u,\"ms\":%.1f,\"parsed_dirs\":%u,"
+           "\"reused_dirs\":%u,\"file_stats\":%u,\"saved\":%s,\"index_bytes\":%lld}\n",
+           run, (unsigned)result.library.size(), (unsigned)result.dirs.size(), result.ms, result.parsed_dirs,
+           result.reused_dirs, result.file_stats, result.saved ? "true" : "false", index_bytes);
+    fflush(stdout);
+}
+
+static bool SameLibrary(const ScanResult& a, const ScanResult& b) {
+    if (a.library.size() != b.library.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.library.size(); i++) {
+        if (strcmp(a.library[i].file_path, b.library[i].file_path) != 0 ||
+            strcmp(a.library[i].song_name, b.library[i].song_name) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int songs = quick ? 2000 : 10000;
+
+    char base[] = "/tmp/music_index_benchXXXXXX";
+    if (!mkdtemp(base)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    // As on the device, the index sits next to the music folder so writing it leaves the tree unchanged
+    std::string root = std::string(base) + "/music";
+    std::string index_path = root + ".idx";
+    BuildTree(root, songs);
+
+    ScanResult cold = Scan(root, index_path);
+    PrintResult("cold", cold, index_path);
+    CHECK_EQ(cold.library.size(), (size_t)songs);
+    CHECK_EQ(cold.parsed_dirs, BENCH_DIRS + 1u);
+    CHECK_EQ(cold.file_stats, (uint32_t)songs);
+    CHECK(cold.saved);
+
+    ScanResult warm = Scan(root, index_path);
+    PrintResult("warm", warm, index_path);
+    CHECK(SameLibrary(cold, warm));
+    CHECK_EQ(warm.parsed_dirs, 0u);
+    CHECK_EQ(warm.file_stats, 0u);
+    CHECK(!warm.saved);
+
+    // A new song changes the entry signature of its directory even if the mtime does not move
+    char added[512];
+    snprintf(added, sizeof(added), "%s/【%02d-%02d】Category %d/M%05d = Added Song - Artist 1.mp3",
+             root.c_str(), 7 * 20 + 1, 7 * 20 + 20, 7, songs);
+    WriteSong(added);
+    ScanResult one_dir = Scan(root, index_path);
+    PrintResult("one_dir", one_dir, index_path);
+    CHECK_EQ(one_dir.library.size(), (size_t)songs + 1);
+    CHECK_EQ(one_dir.parsed_dirs, 1u);
+    CHECK_EQ(one_dir.reused_dirs, (uint32_t)BENCH_DIRS);
+    CHECK_EQ(one_dir.file_stats, (uint32_t)(songs / BENCH_DIRS + 1));
+    CHECK(one_dir.saved);
+
+    nftw(base, [](const char* path, const struct stat*, int, struct FTW*) { return remove(path); }, 16,
+         FTW_DEPTH | FTW_PHYS);
+    return TestResult("music_index_bench");
+}
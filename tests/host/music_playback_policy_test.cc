@@ -0,0 +1,184 @@
+// Drives the music playback policy through the device state sequences of a conversation, with a
+// player that steps like the loop in Esp32Music::PlayAudioStream(), and checks when the music
+// plays, pauses and ends the conversation.
+
+#include "music_playback_policy.h"
+#include "test_util.h"
+
+#define STEP_MS 50
+
+struct Device {
+    DeviceState state = kDeviceStateIdle;
+    bool aborted = false;   // Application::IsSpeakingAborted()
+};
+
+struct Player {
+    DeviceState current;
+    bool first_play = true;
+    bool paused = false;
+    bool playing = false;
+    bool idle_requested = false;
+    int idle_requests = 0;
+    int64_t listening_ms = 0;
+
+    explicit Player(DeviceState state) : current(state) {}
+
+    void RequestIdle() {
+        if (!idle_requested) {
+            idle_requested = true;
+            idle_requests++;
+        }
+    }
+
+    void Step(const Device& device) {
+        DeviceState previous = current;
+        current = device.state;
+        if (current == kDeviceStateListening) {
+            listening_ms = previous == kDeviceStateListening ? listening_ms + STEP_MS : 0;
+        } else {
+            listening_ms = 0;
+            idle_requested = false;
+        }
+
+        if (paused) {
+            if (!ShouldResumeMusic(previous, current, device.aborted)) {
+                return;
+            }
+            paused = false;
+            if (current == kDeviceStateListening) {
+                RequestIdle();
+            }
+            previous = current;
+        }
+
+        switch (DecideMusicPlayback(previous, current, listening_ms, first_play, device.aborted)) {
+        case kMusicPlaybackPlay:
+            first_play = false;
+            playing = true;
+            break;
+        case kMusicPlaybackRequestIdle:
+            RequestIdle();
+            playing = false;
+            break;
+        case kMusicPlaybackPause:
+            paused = true;
+            playing = false;
+            break;
+        case kMusicPlaybackWait:
+            playing = false;
+            break;
+        }
+    }
+
+    void Run(const Device& device, int ms) {
+        for (int t = 0; t < ms; t += STEP_MS) {
+            Step(device);
+        }
+    }
+};
+
+// "play X": the tool call arrives while listening, the reply is spoken, then the server stops the
+// TTS and the device goes back to listening. The music must start without waiting for a timeout.
+static void TestPlayRequestThenReply() {
+    Device device;
+    device.state = kDeviceStateListening;
+    Player player(device.state);
+
+    player.Run(device, 1000);
+    CHECK(!player.playing);
+    CHECK_EQ(player.idle_requests, 0);
+
+    device.state = kDeviceStateSpeaking;
+    player.Run(device, 2000);
+    CHECK(player.playing);
+
+    device.state = kDeviceStateListening;
+    player.Step(device);
+    CHECK_EQ(player.idle_requests, 1);
+    player.Run(device, 500);
+    CHECK_EQ(player.idle_requests, 1);
+    CHECK(!player.paused);
+
+    // ToggleChatState() closes the audio channel
+    device.state = kDeviceStateIdle;
+    player.Step(device);
+    CHECK(player.playing);
+    printf("{\"test\":\"play_request_then_reply\",\"idle_requests\":%d,\"playing\":%d}\n",
+           player.idle_requests, player.playing);
+}
+
+// The reply never comes: the music starts after the listening timeout
+static void TestPlayRequestWithoutReply() {
+    Device device;
+    device.state = kDeviceStateListening;
+    Player player(device.state);
+
+    player.Run(device, MUSIC_FIRST_PLAY_LISTEN_TIMEOUT_MS - STEP_MS);
+    CHECK_EQ(player.idle_requests, 0);
+    player.Run(device, 2 * STEP_MS);
+    CHECK_EQ(player.idle_requests, 1);
+
+    device.state = kDeviceStateIdle;
+    player.Step(device);
+    CHECK(player.playing);
+}
+
+// The wake word cuts the reply short: the user is talking, the music pauses through the next reply
+// and resumes when that one ends normally
+static void TestBargeIn() {
+    Device device;
+    device.state = kDeviceStateSpeaking;
+    Player player(device.state);
+    player.Run(device, 500);
+    CHECK(player.playing);
+
+    device.aborted = true;
+    device.state = kDeviceStateListening;
+    player.Run(device, 2000);
+    CHECK(player.paused);
+    CHECK(!player.playing);
+    CHECK_EQ(player.idle_requests, 0);
+
+    device.aborted = false;
+    device.state = kDeviceStateSpeaking;
+    player.Run(device, 1000);
+    CHECK(player.paused);
+
+    device.state = kDeviceStateListening;
+    player.Step(device);
+    CHECK(!player.paused);
+    CHECK_EQ(player.idle_requests, 1);
+
+    device.state = kDeviceStateIdle;
+    player.Step(device);
+    CHECK(player.playing);
+}
+
+// The wake word from idle pauses the music, back to idle resumes it
+static void TestWakeFromIdle() {
+    Device device;
+    Player player(device.state);
+    player.Run(device, 500);
+    CHECK(player.playing);
+
+    device.state = kDeviceStateConnecting;
+    player.Step(device);
+    CHECK(player.paused);
+    device.state = kDeviceStateListening;
+    player.Run(device, 3000);
+    CHECK(player.paused);
+    CHECK_EQ(player.idle_requests, 0);
+
+    device.state = kDeviceStateIdle;
+    player.Step(device);
+    CHECK(!player.paused);
+    CHECK(player.playing);
+}
+
+int main() {
+    TestPlayRequestThenReply();
+    TestPlayRequestWithoutReply();
+    TestBargeIn();
+    TestWakeFromIdle();
+    return TestResult("music_playback_policy_test");
+}
@@ -0,0 +1,284 @@
+// Hands frames between the audio tasks at the device cadence, once through the queues AudioService
+// used before the SPSC rings (one mutex and one condition variable shared by every queue, notify_all
+// on every push and pop) and once through SpscQueue and QueueWaiter wired as AudioService wires them.
+//
+// A driver thread plays the network and the mic: every OPUS_FRAME_DURATION_MS it pushes one packet
+// to the decode queue and one frame to the encode queue, and drains the send queue. The codec task
+// moves decode to playback and encode to send, the output task takes playback. There is no codec
+// work, so the numbers are those of the handoff alone.
+//
+// One JSON line per queue kind reports the wakeups per frame (returns from a blocking wait, useful
+// or not, summed over the codec and output tasks) and the mean, p99 and max latency of a hop (push
+// to pop of the decode, playback and encode queues).
+//
+// Usage: queue_handoff_bench [--quick]
+
+#include "audio_service.h"
+#include "spsc_queue.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Frame {
+    int64_t pushed_us = 0;
+};
+
+static int64_t NowUs() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct HandoffStats {
+    std::atomic<uint64_t> wakeups{0};
+    std::vector<int64_t> codec_hops_us;     // Written by the codec task only
+    std::vector<int64_t> output_hops_us;    // Written by the output task only
+};
+
+// AudioService before the SPSC rings
+class LockedQueues {
+public:
+    explicit LockedQueues(HandoffStats& stats) : stats_(stats) {}
+
+    void PushDecode(Frame frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        decode_.push_back(frame);
+        cv_.notify_all();
+    }
+
+    void PushEncode(Frame frame) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        encode_.push_back(frame);
+        cv_.notify_all();
+    }
+
+    void DrainSend() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!send_.empty()) {
+            send_.pop_front();
+            cv_.notify_all();
+        }
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+        cv_.notify_all();
+    }
+
+    void CodecTask() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            Wait(lock, [this]() {
+                return stopped_ || (!encode_.empty() && send_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
+                    (!decode_.empty() && playback_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
+            });
+            if (stopped_) {
+                break;
+            }
+            if (!decode_.empty() && playback_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
+                Frame frame = decode_.front();
+                decode_.pop_front();
+                cv_.notify_all();
+                lock.unlock();
+                stats_.codec_hops_us.push_back(NowUs() - frame.pushed_us);
+                frame.pushed_us = NowUs();
+                lock.lock();
+                playback_.push_back(frame);
+                cv_.notify_all();
+            }
+            if (!encode_.empty() && send_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+                Frame frame = encode_.front();
+                encode_.pop_front();
+                cv_.notify_all();
+                lock.unlock();
+                stats_.codec_hops_us.push_back(NowUs() - frame.pushed_us);
+                lock.lock();
+                send_.push_back(frame);
+            }
+        }
+    }
+
+    void OutputTask() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            Wait(lock, [this]() { return stopped_ || !playback_.empty(); });
+            if (stopped_) {
+                break;
+            }
+            Frame frame = playback_.front();
+            playback_.pop_front();
+            cv_.notify_all();
+            lock.unlock();
+            stats_.output_hops_us.push_back(NowUs() - frame.pushed_us);
+            lock.lock();
+        }
+    }
+
+private:
+    HandoffStats& stats_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Frame> decode_;
+    std::deque<Frame> playback_;
+    std::deque<Frame> encode_;
+    std::deque<Frame> send_;
+    bool stopped_ = false;
+
+    template <typename Predicate>
+    void Wait(std::unique_lock<std::mutex>& lock, Predicate predicate) {
+        while (!predicate()) {
+            cv_.wait(lock);
+            stats_.wakeups++;
+        }
+    }
+};
+
+// AudioService with the SPSC rings, waiters as in its constructor
+class SpscQueues {
+public:
+    explicit SpscQueues(HandoffStats& stats)
+        : stats_(stats),
+          decode_(MAX_DECODE_PACKETS_IN_QUEUE),
+          playback_(MAX_PLAYBACK_TASKS_IN_QUEUE),
+          encode_(MAX_ENCODE_TASKS_IN_QUEUE),
+          send_(MAX_SEND_PACKETS_IN_QUEUE) {
+        encode_.SetConsumerWaiter(&codec_waiter_);
+        encode_.SetProducerWaiter(&encode_space_waiter_);
+        decode_.SetConsumerWaiter(&codec_waiter_);
+        decode_.SetProducerWaiter(&decode_space_waiter_);
+        send_.SetProducerWaiter(&codec_waiter_);
+        playback_.SetConsumerWaiter(&output_waiter_);
+        playback_.SetProducerWaiter(&codec_waiter_);
+    }
+
+    void PushDecode(Frame frame) { CHECK(decode_.TryPush(std::move(frame))); }
+    void PushEncode(Frame frame) { CHECK(encode_.TryPush(std::move(frame))); }
+
+    void DrainSend() {
+        Frame frame;
+        while (send_.TryPop(frame)) {
+        }
+    }
+
+    void Stop() {
+        stopped_ = true;
+        codec_waiter_.Signal();
+        output_waiter_.Signal();
+    }
+
+    void CodecTask() {
+        while (true) {
+            Wait(codec_waiter_, [this]() {
+                return stopped_ || (encode_.pending() && send_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
+                    (decode_.pending() && !playback_.full());
+            });
+            if (stopped_) {
+                break;
+            }
+            Frame frame;
+            if (!playback_.full() && decode_.TryPop(frame)) {
+                stats_.codec_hops_us.push_back(NowUs() - frame.pushed_us);
+                frame.pushed_us = NowUs();
+                playback_.TryPush(std::move(frame));
+            }
+            if (send_.size() < MAX_SEND_PACKETS_IN_QUEUE && encode_.TryPop(frame)) {
+                stats_.codec_hops_us.push_back(NowUs() - frame.pushed_us);
+                send_.TryPush(std::move(frame));
+            }
+        }
+    }
+
+    void OutputTask() {
+        while (true) {
+            Wait(output_waiter_, [this]() { return playback_.pending() || stopped_; });
+            if (stopped_) {
+                break;
+            }
+            Frame frame;
+            if (playback_.TryPop(frame)) {
+                stats_.output_hops_us.push_back(NowUs() - frame.pushed_us);
+            }
+        }
+    }
+
+private:
+    HandoffStats& stats_;
+    SpscQueue<Frame> decode_;
+    SpscQueue<Frame> playback_;
+    SpscQueue<Frame> encode_;
+    SpscQueue<Frame> send_;
+    QueueWaiter codec_waiter_;
+    QueueWaiter output_waiter_;
+    QueueWaiter encode_space_waiter_;
+    QueueWaiter decode_space_waiter_;
+    std::atomic<bool> stopped_{false};
+
+    // QueueWaiter::Wait() evaluates the predicate on entry, once more under its lock before sleeping
+    // and once after every wakeup
+    template <typename Predicate>
+    void Wait(QueueWaiter& waiter, Predicate predicate) {
+        int calls = 0;
+        waiter.Wait([&]() {
+            calls++;
+            return predicate();
+        });
+        if (calls > 2) {
+            stats_.wakeups += calls - 2;
+        }
+    }
+};
+
+template <typename Queues>
+static void Run(const char* name, int frames) {
+    HandoffStats stats;
+    Queues queues(stats);
+    std::thread codec([&queues]() { queues.CodecTask(); });
+    std::thread output([&queues]() { queues.OutputTask(); });
+
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        next += std::chrono::milliseconds(OPUS_FRAME_DURATION_MS);
+        std::this_thread::sleep_until(next);
+        queues.PushDecode({ NowUs() });
+        queues.PushEncode({ NowUs() });
+        queues.DrainSend();
+    }
+    // Let the last frame through before stopping
+    std::this_thread::sleep_for(std::chrono::milliseconds(OPUS_FRAME_DURATION_MS));
+    queues.Stop();
+    codec.join();
+    output.join();
+
+    std::vector<int64_t> hops = stats.codec_hops_us;
+    hops.insert(hops.end(), stats.output_hops_us.begin(), stats.output_hops_us.end());
+    CHECK_EQ(hops.size(), (size_t)frames * 3);
+    std::sort(hops.begin(), hops.end());
+    int64_t total = 0;
+    for (int64_t us : hops) total += us;
+    double mean_us = hops.empty() ? 0 : (double)total / hops.size();
+    int64_t p99_us = hops.empty() ? 0 : hops[hops.size() * 99 / 100];
+    int64_t max_us = hops.empty() ? 0 : hops.back();
+
+    printf("{\"bench\":\"queue_handoff\",\"queues\":\"%s\",\"frames\":%d,\"frame_ms\":%d,"
+           "\"wakeups_per_frame\":%.2f,\"hop_us\":{\"mean\":%.1f,\"p99\":%lld,\"max\":%lld}}\n",
+           name, frames, OPUS_FRAME_DURATION_MS, (double)stats.wakeups.load() / frames, mean_us,
+           (long long)p99_us, (long long)max_us);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int frames = quick ? 20 : 500;
+
+    Run<LockedQueues>("mutex_condvar", frames);
+    Run<SpscQueues>("spsc_waiter", frames);
+    return TestResult("queue_handoff_bench");
+}
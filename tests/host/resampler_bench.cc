@@ -0,0 +1,179 @@
+// Quality and throughput of the local music resampler for the MP3 rates (44.1, 48, 22.05 kHz) to the
+// codec output rates (16, 24 kHz). For every pair it prints one JSON line with:
+//
+//   snr_1k_db          a -6 dBFS 1 kHz tone against the best fitting sine at the output
+//   snr_edge_db        the same for a tone at 80% of the lower Nyquist frequency (top of the pass band)
+//   stopband_db        how far a tone above the output Nyquist frequency is attenuated instead of
+//                      folding back into the pass band (downsampling only, null otherwise)
+//   msamples_per_s     input samples per second fed in 1152 sample MP3 frames, and the realtime factor
+//
+// It also checks that feeding frame by frame matches one large call, and that Reset() returns the
+// resampler to the state of a freshly configured one, as the music player relies on at a new track.
+//
+// Usage: resampler_bench [--quick]
+
+#include "polyphase_resampler.h"
+#include "test_util.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define MP3_FRAME_SAMPLES 1152
+
+static std::vector<int16_t> Tone(int sample_rate, double frequency, double amplitude, size_t samples) {
+    std::vector<int16_t> tone(samples);
+    for (size_t i = 0; i < samples; i++) {
+        tone[i] = (int16_t)lround(amplitude * 32767 * sin(2 * M_PI * frequency * i / sample_rate));
+    }
+    return tone;
+}
+
+static std::vector<int16_t> Resample(PolyphaseResampler& resampler, const std::vector<int16_t>& input,
+                                     size_t chunk) {
+    std::vector<int16_t> output;
+    std::vector<int16_t> buffer;
+    for (size_t offset = 0; offset < input.size(); offset += chunk) {
+        size_t samples = std::min(chunk, input.size() - offset);
+        buffer.resize(resampler.GetOutputSamples(samples));
+        size_t count = resampler.Process(input.data() + offset, samples, buffer.data());
+        CHECK(count <= buffer.size());
+        output.insert(output.end(), buffer.begin(), buffer.begin() + count);
+    }
+    return output;
+}
+
+static double RmsDb(const std::vector<int16_t>& samples, size_t skip) {
+    double power = 0;
+    for (size_t i = skip; i < samples.size(); i++) {
+        power += (double)samples[i] * samples[i];
+    }
+    power /= std::max<size_t>(1, samples.size() - skip);
+    return 10 * log10(power + 1e-9);
+}
+
+// Least squares fit of a sine and cosine of the given frequency; the residual is everything else
+static double ToneSnrDb(const std::vector<int16_t>& samples, int sample_rate, double frequency, size_t skip) {
+    double ss = 0, cc = 0, sc = 0, sy = 0, cy = 0;
+    for (size_t i = skip; i < samples.size(); i++) {
+        double s = sin(2 * M_PI * frequency * i / sample_rate);
+        double c = cos(2 * M_PI * frequency * i / sample_rate);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        sy += s * samples[i];
+        cy += c * samples[i];
+    }
+    double det = ss * cc - sc * sc;
+    double a = (sy * cc - cy * sc) / det;
+    double b = (cy * ss - sy * sc) / det;
+    double signal = 0, noise = 0;
+    for (size_t i = skip; i < samples.size(); i++) {
+        double fit = a * sin(2 * M_PI * frequency * i / sample_rate) + b * cos(2 * M_PI * frequency * i / sample_rate);
+        double error = samples[i] - fit;
+        signal += fit * fit;
+        noise += error * error;
+    }
+    return 10 * log10(signal / (noise + 1e-9));
+}
+
+struct PairResult {
+    double snr_1k_db = 0;
+    double snr_edge_db = 0;
+    bool has_stopband = false;
+    double stopband_db = 0;
+    double msamples_per_s = 0;
+    double realtime_factor = 0;
+};
+
+static PairResult RunPair(int input_rate, int output_rate, int seconds) {
+    PairResult result;
+    PolyphaseResampler resampler;
+    CHECK(resampler.Configure(input_rate, output_rate));
+    // Skip the filter warm-up at the start of the output
+    const size_t skip = output_rate / 50;
+
+    resampler.Reset();
+    auto output = Resample(resampler, Tone(input_rate, 1000, 0.5, input_rate), MP3_FRAME_SAMPLES);
+    result.snr_1k_db = ToneSnrDb(output, output_rate, 1000, skip);
+
+    double edge = 0.8 * std::min(input_rate, output_rate) / 2;
+    resampler.Reset();
+    output = Resample(resampler, Tone(input_rate, edge, 0.5, input_rate), MP3_FRAME_SAMPLES);
+    result.snr_edge_db = ToneSnrDb(output, output_rate, edge, skip);
+
+    if (input_rate > output_rate) {
+        // A tone that would alias to 1 kHz, or as far into the stop band as the input allows
+        double stop = std::min(output_rate - 1000.0, input_rate / 2 - 500.0);
+        auto input = Tone(input_rate, stop, 0.5, input_rate);
+        resampler.Reset();
+        output = Resample(resampler, input, MP3_FRAME_SAMPLES);
+        result.has_stopband = true;
+        result.stopband_db = RmsDb(input, 0) - RmsDb(output, skip);
+    }
+
+    // Frame by frame must match a single call over the same input
+    std::mt19937 rng(input_rate + output_rate);
+    std::uniform_int_distribution<int> dist(-20000, 20000);
+    std::vector<int16_t> noise(input_rate);
+    for (auto& s : noise) {
+        s = dist(rng);
+    }
+    resampler.Reset();
+    auto framed = Resample(resampler, noise, MP3_FRAME_SAMPLES);
+    resampler.Reset();
+    auto whole = Resample(resampler, noise, noise.size());
+    CHECK(framed == whole);
+
+    // Reset() after another stream behaves like a freshly configured resampler
+    PolyphaseResampler fresh;
+    CHECK(fresh.Configure(input_rate, output_rate));
+    CHECK(Resample(fresh, noise, MP3_FRAME_SAMPLES) == framed);
+
+    // Throughput over the MP3 frame sized calls the music player makes
+    std::vector<int16_t> buffer(resampler.GetOutputSamples(MP3_FRAME_SAMPLES));
+    size_t total = (size_t)input_rate * seconds;
+    volatile int16_t sink = 0;
+    resampler.Reset();
+    double start = NowMs();
+    for (size_t fed = 0; fed < total; fed += MP3_FRAME_SAMPLES) {
+        size_t offset = fed % (noise.size() - MP3_FRAME_SAMPLES);
+        size_t count = resampler.Process(noise.data() + offset, MP3_FRAME_SAMPLES, buffer.data());
+        sink = sink + buffer[count / 2];
+    }
+    double elapsed_ms = std::max(NowMs() - start, 1e-3);
+    result.msamples_per_s = total / elapsed_ms / 1000.0;
+    result.realtime_factor = seconds * 1000.0 / elapsed_ms;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int seconds = quick ? 10 : 300;
+    const int input_rates[] = { 44100, 48000, 22050 };
+    const int output_rates[] = { 16000, 24000 };
+
+    for (int input_rate : input_rates) {
+        for (int output_rate : output_rates) {
+            PairResult result = RunPair(input_rate, output_rate, seconds);
+            // The Kaiser window is specified for about 70 dB of stop band, the pass band is limited by
+            // the Q14 taps and 16 bit samples
+            CHECK(result.snr_1k_db > 70);
+            CHECK(result.snr_edge_db > 65);
+            CHECK(!result.has_stopband || result.stopband_db > 65);
+            CHECK(result.realtime_factor > 1);
+
+            char stopband[32] = "null";
+            if (result.has_stopband) {
+                snprintf(stopband, sizeof(stopband), "%.1f", result.stopband_db);
+            }
+            printf("{\"bench\":\"resampler\",\"input_rate\":%d,\"output_rate\":%d,\"snr_1k_db\":%.1f,"
+                   "\"snr_edge_db\":%.1f,\"stopband_db\":%s,\"msamples_per_s\":%.1f,\"realtime_factor\":%.0f}\n",
+                   input_rate, output_rate, result.snr_1k_db, result.snr_edge_db, stopband,
+                   result.msamples_per_s, result.realtime_factor);
+            fflush(stdout);
+        }
+    }
+    return TestResult("resampler_bench");
+}
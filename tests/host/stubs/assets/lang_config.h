@@ -0,0 +1,33 @@
+// Host stand-in for the generated language config: no strings, one pre-indexed prompt
+#pragma once
+
+#include <string_view>
+
+#include "prompt_sound.h"
+
+namespace Lang {
+    constexpr const char* CODE = "en-US";
+
+    namespace Sounds {
+        // A 1.5 s prompt of 25 packets of 60 ms at 16 kHz, the payloads only feed the stub decoder
+        inline constexpr uint16_t HOST_PROMPT_PACKET_COUNT = 25;
+        inline constexpr uint16_t HOST_PROMPT_PACKET_SIZE = 40;
+        inline constexpr char ogg_host_prompt_start[HOST_PROMPT_PACKET_COUNT * HOST_PROMPT_PACKET_SIZE] = { 'O', 'g', 'g', 'S' };
+        inline constexpr std::string_view OGG_HOST_PROMPT { ogg_host_prompt_start, sizeof(ogg_host_prompt_start) };
+
+        struct HostPromptPackets {
+            PromptPacket packets[HOST_PROMPT_PACKET_COUNT] = {};
+            constexpr HostPromptPackets() {
+                for (uint16_t i = 0; i < HOST_PROMPT_PACKET_COUNT; i++) {
+                    packets[i] = { (uint32_t)i * HOST_PROMPT_PACKET_SIZE, HOST_PROMPT_PACKET_SIZE };
+                }
+            }
+        };
+        inline constexpr HostPromptPackets OGG_HOST_PROMPT_PACKETS;
+
+        inline constexpr PromptSound PROMPT_SOUNDS[] = {
+            { ogg_host_prompt_start, OGG_HOST_PROMPT_PACKETS.packets, HOST_PROMPT_PACKET_COUNT, 16000 },
+            { nullptr, nullptr, 0, 0 }
+        };
+    }
+}
@@ -0,0 +1,7 @@
+#ifndef HOST_STUB_BOARD_H
+#define HOST_STUB_BOARD_H
+
+// The audio modules only name the board, the host builds have none
+class Board;
+
+#endif // HOST_STUB_BOARD_H
@@ -0,0 +1,42 @@
+#ifndef HOST_STUB_CJSON_H
+#define HOST_STUB_CJSON_H
+
+/*
+ * The part of the cJSON API that the host-built modules use to produce JSON. No parser: the
+ * host tests never read JSON back through cJSON.
+ */
+
+#define cJSON_False  (1 << 0)
+#define cJSON_True   (1 << 1)
+#define cJSON_NULL   (1 << 2)
+#define cJSON_Number (1 << 3)
+#define cJSON_String (1 << 4)
+#define cJSON_Array  (1 << 5)
+#define cJSON_Object (1 << 6)
+
+typedef struct cJSON {
+    struct cJSON* next;
+    struct cJSON* prev;
+    struct cJSON* child;
+    int type;
+    char* valuestring;
+    int valueint;
+    double valuedouble;
+    char* string;
+} cJSON;
+
+cJSON* cJSON_CreateObject(void);
+cJSON* cJSON_CreateArray(void);
+cJSON* cJSON_CreateNumber(double number);
+cJSON* cJSON_CreateString(const char* string);
+cJSON* cJSON_CreateBool(int boolean);
+int cJSON_AddItemToObject(cJSON* object, const char* name, cJSON* item);
+int cJSON_AddItemToArray(cJSON* array, cJSON* item);
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number);
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string);
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, int boolean);
+char* cJSON_PrintUnformatted(const cJSON* item);
+void cJSON_free(void* object);
+void cJSON_Delete(cJSON* item);
+
+#endif // HOST_STUB_CJSON_H
@@ -0,0 +1,162 @@
+#include "cJSON.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static cJSON* NewItem(int type) {
+    cJSON* item = (cJSON*)calloc(1, sizeof(cJSON));
+    item->type = type;
+    return item;
+}
+
+cJSON* cJSON_CreateObject(void) {
+    return NewItem(cJSON_Object);
+}
+
+cJSON* cJSON_CreateArray(void) {
+    return NewItem(cJSON_Array);
+}
+
+cJSON* cJSON_CreateNumber(double number) {
+    cJSON* item = NewItem(cJSON_Number);
+    item->valuedouble = number;
+    item->valueint = (int)number;
+    return item;
+}
+
+cJSON* cJSON_CreateString(const char* string) {
+    cJSON* item = NewItem(cJSON_String);
+    item->valuestring = strdup(string);
+    return item;
+}
+
+cJSON* cJSON_CreateBool(int boolean) {
+    return NewItem(boolean ? cJSON_True : cJSON_False);
+}
+
+int cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == nullptr || item == nullptr) {
+        return 0;
+    }
+    if (array->child == nullptr) {
+        array->child = item;
+    } else {
+        cJSON* last = array->child;
+        while (last->next != nullptr) {
+            last = last->next;
+        }
+        last->next = item;
+        item->prev = last;
+    }
+    return 1;
+}
+
+int cJSON_AddItemToObject(cJSON* object, const char* name, cJSON* item) {
+    if (item == nullptr) {
+        return 0;
+    }
+    item->string = strdup(name);
+    return cJSON_AddItemToArray(object, item);
+}
+
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) {
+    cJSON* item = cJSON_CreateNumber(number);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) {
+    cJSON* item = cJSON_CreateString(string);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, int boolean) {
+    cJSON* item = cJSON_CreateBool(boolean);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+static void PrintString(const char* string, std::string& out) {
+    out += '"';
+    for (const char* p = string; *p; p++) {
+        char c = *p;
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+static void PrintItem(const cJSON* item, std::string& out) {
+    char number[32];
+    switch (item->type) {
+    case cJSON_False:
+        out += "false";
+        break;
+    case cJSON_True:
+        out += "true";
+        break;
+    case cJSON_Number:
+        // Integers print without a fraction, like cJSON does
+        if (std::floor(item->valuedouble) == item->valuedouble && std::fabs(item->valuedouble) < 1e15) {
+            snprintf(number, sizeof(number), "%.0f", item->valuedouble);
+        } else {
+            snprintf(number, sizeof(number), "%.15g", item->valuedouble);
+        }
+        out += number;
+        break;
+    case cJSON_String:
+        PrintString(item->valuestring, out);
+        break;
+    case cJSON_Array:
+    case cJSON_Object:
+        out += item->type == cJSON_Array ? '[' : '{';
+        for (const cJSON* child = item->child; child != nullptr; child = child->next) {
+            if (child != item->child) {
+                out += ',';
+            }
+            if (item->type == cJSON_Object) {
+                PrintString(child->string, out);
+                out += ':';
+            }
+            PrintItem(child, out);
+        }
+        out += item->type == cJSON_Array ? ']' : '}';
+        break;
+    default:
+        out += "null";
+        break;
+    }
+}
+
+char* cJSON_PrintUnformatted(const cJSON* item) {
+    std::string out;
+    PrintItem(item, out);
+    return strdup(out.c_str());
+}
+
+void cJSON_free(void* object) {
+    free(object);
+}
+
+void cJSON_Delete(cJSON* item) {
+    while (item != nullptr) {
+        cJSON* next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef HOST_STUB_DRIVER_I2S_COMMON_H
+#define HOST_STUB_DRIVER_I2S_COMMON_H
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+// Codecs on the host are fakes without I2S channels, the handles stay null
+typedef struct HostI2sChannel* i2s_chan_handle_t;
+
+inline esp_err_t i2s_channel_enable(i2s_chan_handle_t) { return ESP_OK; }
+inline esp_err_t i2s_channel_disable(i2s_chan_handle_t) { return ESP_OK; }
+
+#endif // HOST_STUB_DRIVER_I2S_COMMON_H
@@ -0,0 +1,22 @@
+#ifndef HOST_STUB_DRIVER_I2S_STD_H
+#define HOST_STUB_DRIVER_I2S_STD_H
+
+#include "driver/i2s_common.h"
+
+typedef enum {
+    I2S_CLK_SRC_DEFAULT,
+} i2s_clock_src_t;
+
+typedef enum {
+    I2S_MCLK_MULTIPLE_256 = 256,
+} i2s_mclk_multiple_t;
+
+typedef struct {
+    uint32_t sample_rate_hz;
+    i2s_clock_src_t clk_src;
+    i2s_mclk_multiple_t mclk_multiple;
+} i2s_std_clk_config_t;
+
+inline esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t, const i2s_std_clk_config_t*) { return ESP_OK; }
+
+#endif // HOST_STUB_DRIVER_I2S_STD_H
@@ -0,0 +1,96 @@
+#include "esp_afe_sr_models.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#define HOST_AFE_RING_SAMPLES 65536
+
+static int feed_chunksize = 256;
+static int fetch_chunksize = 512;
+
+struct esp_afe_sr_data_t {
+    int channels = 1;
+    int feed_chunksize = 0;
+    int fetch_chunksize = 0;
+    std::mutex mutex;
+    std::condition_variable changed;
+    // First microphone channel, positions count samples
+    std::vector<int16_t> ring;
+    uint64_t read = 0;
+    uint64_t write = 0;
+    std::vector<int16_t> output;
+    afe_fetch_result_t result = {};
+};
+
+void HostAfeSetChunkSizes(int feed, int fetch) {
+    feed_chunksize = feed;
+    fetch_chunksize = fetch;
+}
+
+afe_config_t* afe_config_init(const char* input_format, srmodel_list_t* models, afe_type_t type, afe_mode_t mode) {
+    static afe_config_t config;
+    config = {};
+    strncpy(config.input_format, input_format, sizeof(config.input_format) - 1);
+    config.type = type;
+    return &config;
+}
+
+static esp_afe_sr_iface_t host_afe = {
+    .create_from_config = [](afe_config_t* config) -> esp_afe_sr_data_t* {
+        auto afe = new esp_afe_sr_data_t;
+        afe->channels = std::max<int>(1, strlen(config->input_format));
+        afe->feed_chunksize = feed_chunksize;
+        afe->fetch_chunksize = fetch_chunksize;
+        afe->ring.resize(HOST_AFE_RING_SAMPLES);
+        afe->output.resize(fetch_chunksize);
+        return afe;
+    },
+    .get_feed_chunksize = [](esp_afe_sr_data_t* afe) { return afe->feed_chunksize; },
+    .get_fetch_chunksize = [](esp_afe_sr_data_t* afe) { return afe->fetch_chunksize; },
+    .feed = [](esp_afe_sr_data_t* afe, const int16_t* in) {
+        std::unique_lock<std::mutex> lock(afe->mutex);
+        // Like the device ring buffer, feeding waits for the fetch side to make room
+        afe->changed.wait(lock, [afe]() { return afe->write - afe->read + afe->feed_chunksize <= afe->ring.size(); });
+        for (int i = 0; i < afe->feed_chunksize; i++) {
+            afe->ring[afe->write++ % afe->ring.size()] = in[i * afe->channels];
+        }
+        afe->changed.notify_all();
+        return afe->feed_chunksize;
+    },
+    .fetch_with_delay = [](esp_afe_sr_data_t* afe, TickType_t ticks) -> afe_fetch_result_t* {
+        std::unique_lock<std::mutex> lock(afe->mutex);
+        auto ready = [afe]() { return afe->write - afe->read >= (uint64_t)afe->fetch_chunksize; };
+        if (ticks == portMAX_DELAY) {
+            afe->changed.wait(lock, ready);
+        } else if (!afe->changed.wait_for(lock, std::chrono::milliseconds(ticks), ready)) {
+            return nullptr;
+        }
+        for (int i = 0; i < afe->fetch_chunksize; i++) {
+            afe->output[i] = afe->ring[afe->read++ % afe->ring.size()];
+        }
+        afe->changed.notify_all();
+        afe->result.data = afe->output.data();
+        afe->result.data_size = afe->fetch_chunksize * sizeof(int16_t);
+        afe->result.vad_state = VAD_SILENCE;
+        afe->result.ret_value = ESP_OK;
+        return &afe->result;
+    },
+    .reset_buffer = [](esp_afe_sr_data_t* afe) {
+        std::lock_guard<std::mutex> lock(afe->mutex);
+        afe->read = afe->write;
+        afe->changed.notify_all();
+        return 0;
+    },
+    .enable_aec = [](esp_afe_sr_data_t* afe) { return 0; },
+    .disable_aec = [](esp_afe_sr_data_t* afe) { return 0; },
+    .enable_vad = [](esp_afe_sr_data_t* afe) { return 0; },
+    .disable_vad = [](esp_afe_sr_data_t* afe) { return 0; },
+    .destroy = [](esp_afe_sr_data_t* afe) { delete afe; },
+};
+
+esp_afe_sr_iface_t* esp_afe_handle_from_config(afe_config_t* config) {
+    return &host_afe;
+}
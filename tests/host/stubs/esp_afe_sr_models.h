@@ -0,0 +1,108 @@
+#ifndef HOST_STUB_ESP_AFE_SR_MODELS_H
+#define HOST_STUB_ESP_AFE_SR_MODELS_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "model_path.h"
+
+/*
+ * A pass-through front end: feed() takes get_feed_chunksize() frames of every input channel and
+ * fetch() returns the first microphone channel in chunks of get_fetch_chunksize() samples, blocking
+ * until that much was fed. No AEC, NS or VAD runs (the state is always silence), so tests see the
+ * framing around the AFE with chunk sizes they choose through HostAfeSetChunkSizes().
+ */
+
+typedef enum {
+    AFE_TYPE_SR = 0,
+    AFE_TYPE_VC = 1,
+} afe_type_t;
+
+typedef enum {
+    AFE_MODE_LOW_COST = 0,
+    AFE_MODE_HIGH_PERF = 1,
+} afe_mode_t;
+
+typedef enum {
+    AEC_MODE_SR_LOW_COST = 0,
+    AEC_MODE_SR_HIGH_PERF = 1,
+    AEC_MODE_VOIP_LOW_COST = 2,
+    AEC_MODE_VOIP_HIGH_PERF = 3,
+} afe_aec_mode_t;
+
+typedef enum {
+    VAD_MODE_0 = 0,
+    VAD_MODE_1,
+    VAD_MODE_2,
+    VAD_MODE_3,
+    VAD_MODE_4,
+} vad_mode_t;
+
+typedef enum {
+    VAD_SILENCE = 0,
+    VAD_SPEECH = 1,
+} vad_state_t;
+
+typedef enum {
+    AFE_NS_MODE_WEBRTC = 0,
+    AFE_NS_MODE_NET = 1,
+} afe_ns_mode_t;
+
+typedef enum {
+    AFE_MEMORY_ALLOC_MORE_INTERNAL = 1,
+    AFE_MEMORY_ALLOC_INTERNAL_PSRAM_BALANCE = 2,
+    AFE_MEMORY_ALLOC_MORE_PSRAM = 3,
+} afe_memory_alloc_mode_t;
+
+typedef struct {
+    char input_format[16];
+    afe_type_t type;
+    bool aec_init;
+    afe_aec_mode_t aec_mode;
+    bool vad_init;
+    vad_mode_t vad_mode;
+    int vad_min_noise_ms;
+    char* vad_model_name;
+    bool ns_init;
+    char* ns_model_name;
+    afe_ns_mode_t afe_ns_mode;
+    bool agc_init;
+    int afe_perferred_core;
+    int afe_perferred_priority;
+    afe_memory_alloc_mode_t memory_alloc_mode;
+} afe_config_t;
+
+typedef struct {
+    int16_t* data;
+    int data_size;          // Bytes
+    vad_state_t vad_state;
+    int wakeup_state;
+    int ret_value;
+} afe_fetch_result_t;
+
+typedef struct esp_afe_sr_data_t esp_afe_sr_data_t;
+
+typedef struct {
+    esp_afe_sr_data_t* (*create_from_config)(afe_config_t* config);
+    int (*get_feed_chunksize)(esp_afe_sr_data_t* afe);
+    int (*get_fetch_chunksize)(esp_afe_sr_data_t* afe);
+    int (*feed)(esp_afe_sr_data_t* afe, const int16_t* in);
+    afe_fetch_result_t* (*fetch_with_delay)(esp_afe_sr_data_t* afe, TickType_t ticks);
+    int (*reset_buffer)(esp_afe_sr_data_t* afe);
+    int (*enable_aec)(esp_afe_sr_data_t* afe);
+    int (*disable_aec)(esp_afe_sr_data_t* afe);
+    int (*enable_vad)(esp_afe_sr_data_t* afe);
+    int (*disable_vad)(esp_afe_sr_data_t* afe);
+    void (*destroy)(esp_afe_sr_data_t* afe);
+} esp_afe_sr_iface_t;
+
+// The returned config stays valid until the next call
+afe_config_t* afe_config_init(const char* input_format, srmodel_list_t* models, afe_type_t type, afe_mode_t mode);
+esp_afe_sr_iface_t* esp_afe_handle_from_config(afe_config_t* config);
+
+// Host only: chunk sizes of the front ends created from now on (defaults 256 and 512, as on the device)
+void HostAfeSetChunkSizes(int feed_chunksize, int fetch_chunksize);
+
+#endif // HOST_STUB_ESP_AFE_SR_MODELS_H
@@ -0,0 +1,28 @@
+#ifndef HOST_STUB_ESP_ERR_H
+#define HOST_STUB_ESP_ERR_H
+
+#include <cstdio>
+#include <cstdlib>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+
+inline const char* esp_err_to_name(esp_err_t error) {
+    return error == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+#define ESP_ERROR_CHECK(x)                                                          \
+    do {                                                                            \
+        esp_err_t _err = (x);                                                       \
+        if (_err != ESP_OK) {                                                       \
+            fprintf(stderr, "%s:%d: ESP_ERROR_CHECK failed: %s\n", __FILE__, __LINE__, #x); \
+            abort();                                                                \
+        }                                                                           \
+    } while (0)
+
+#endif // HOST_STUB_ESP_ERR_H
@@ -0,0 +1,27 @@
+#ifndef HOST_STUB_ESP_ROM_CRC_H
+#define HOST_STUB_ESP_ROM_CRC_H
+
+#include <cstdint>
+
+// Table driven CRC32 (IEEE 802.3, reflected) like the ROM routine, with the same values
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i;
+                for (int k = 0; k < 8; k++) {
+                    value = (value >> 1) ^ (0xEDB88320u & -(value & 1));
+                }
+                entries[i] = value;
+            }
+        }
+    } table;
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ table.entries[(crc ^ buf[i]) & 0xFF];
+    }
+    return ~crc;
+}
+
+#endif // HOST_STUB_ESP_ROM_CRC_H
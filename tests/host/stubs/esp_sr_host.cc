@@ -0,0 +1,49 @@
+#include "model_path.h"
+#include "esp_wn_iface.h"
+#include "esp_wn_models.h"
+
+#include <cstring>
+
+#define HOST_WAKENET_SAMPLE_RATE 16000
+#define HOST_WAKENET_CHUNK_SAMPLES 480
+
+struct model_iface_data_t {
+    uint64_t energy = 0;
+};
+
+char* esp_srmodel_filter(srmodel_list_t* models, const char* keyword1, const char* keyword2) {
+    if (models == nullptr) {
+        return nullptr;
+    }
+    for (int i = 0; i < models->num; i++) {
+        char* name = models->model_name[i];
+        if (keyword1 != nullptr && strncmp(name, keyword1, strlen(keyword1)) != 0) {
+            continue;
+        }
+        if (keyword2 != nullptr && strstr(name, keyword2) == nullptr) {
+            continue;
+        }
+        return name;
+    }
+    return nullptr;
+}
+
+static const esp_wn_iface_t host_wakenet = {
+    .create = [](const char* model_name, det_mode_t det_mode) -> model_iface_data_t* {
+        return new model_iface_data_t;
+    },
+    .get_samp_chunksize = [](model_iface_data_t* model) { return HOST_WAKENET_CHUNK_SAMPLES; },
+    .get_samp_rate = [](model_iface_data_t* model) { return HOST_WAKENET_SAMPLE_RATE; },
+    .get_word_name = [](model_iface_data_t* model, int word_index) { return "host"; },
+    .detect = [](model_iface_data_t* model, int16_t* samples) {
+        for (int i = 0; i < HOST_WAKENET_CHUNK_SAMPLES; i++) {
+            model->energy += (int32_t)samples[i] * samples[i];
+        }
+        return 0;
+    },
+    .destroy = [](model_iface_data_t* model) { delete model; },
+};
+
+const esp_wn_iface_t* esp_wn_handle_from_name(const char* model_name) {
+    return &host_wakenet;
+}
@@ -0,0 +1,22 @@
+#ifndef HOST_STUB_ESP_WN_IFACE_H
+#define HOST_STUB_ESP_WN_IFACE_H
+
+#include <cstdint>
+
+typedef struct model_iface_data_t model_iface_data_t;
+
+typedef enum {
+    DET_MODE_90 = 0,
+    DET_MODE_95 = 1,
+} det_mode_t;
+
+typedef struct {
+    model_iface_data_t* (*create)(const char* model_name, det_mode_t det_mode);
+    int (*get_samp_chunksize)(model_iface_data_t* model);
+    int (*get_samp_rate)(model_iface_data_t* model);
+    const char* (*get_word_name)(model_iface_data_t* model, int word_index);
+    int (*detect)(model_iface_data_t* model, int16_t* samples);
+    void (*destroy)(model_iface_data_t* model);
+} esp_wn_iface_t;
+
+#endif // HOST_STUB_ESP_WN_IFACE_H
@@ -0,0 +1,12 @@
+#ifndef HOST_STUB_ESP_WN_MODELS_H
+#define HOST_STUB_ESP_WN_MODELS_H
+
+#include "esp_wn_iface.h"
+
+/*
+ * Every name resolves to the host wakenet: it takes 30 ms chunks at 16 kHz, costs a pass over
+ * the chunk and never detects anything, so benchmarks measure the feeding path around it.
+ */
+const esp_wn_iface_t* esp_wn_handle_from_name(const char* model_name);
+
+#endif // HOST_STUB_ESP_WN_MODELS_H
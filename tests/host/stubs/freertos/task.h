@@ -0,0 +1,30 @@
+#ifndef HOST_STUB_FREERTOS_TASK_H
+#define HOST_STUB_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+// Tasks are std::threads; priorities, cores and stack sizes are ignored
+typedef struct HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+typedef uint8_t StackType_t;
+typedef struct { uint8_t reserved; } StaticTask_t;
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core_id);
+// The stack and task buffers are the caller's as on the device, the thread does not use them
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                               UBaseType_t priority, StackType_t* stack, StaticTask_t* task_buffer);
+// Only a task deleting itself (NULL) is supported, the thread ends when its function returns
+void vTaskDelete(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle);
+// The idle tasks of the host run all the time: the counters follow the monotonic clock in microseconds
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core_id);
+configRUN_TIME_COUNTER_TYPE ulTaskGetRunTimeCounter(TaskHandle_t handle);
+
+// Host only: waits for every task created so far to return
+void HostJoinTasks();
+
+#endif // HOST_STUB_FREERTOS_TASK_H
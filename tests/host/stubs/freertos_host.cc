@@ -0,0 +1,125 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct HostTask {
+    std::thread thread;
+};
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+static std::mutex tasks_mutex;
+// Never destroyed, so tasks still running at exit (ones that loop forever) keep their handles reachable
+static std::vector<HostTask*>& tasks = *new std::vector<HostTask*>();
+static HostTask idle_task;
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    HostTask* task = new HostTask;
+    task->thread = std::thread(function, arg);
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    tasks.push_back(task);
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core_id) {
+    return xTaskCreate(function, name, stack_depth, arg, priority, handle);
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                               UBaseType_t priority, StackType_t* stack, StaticTask_t* task_buffer) {
+    TaskHandle_t handle = nullptr;
+    xTaskCreate(function, name, stack_depth, arg, priority, &handle);
+    return handle;
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle) {
+    return 0;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core_id) {
+    return &idle_task;
+}
+
+configRUN_TIME_COUNTER_TYPE ulTaskGetRunTimeCounter(TaskHandle_t handle) {
+    return handle == &idle_task ? (configRUN_TIME_COUNTER_TYPE)esp_timer_get_time() : 0;
+}
+
+void HostJoinTasks() {
+    std::vector<HostTask*> joining;
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        joining.swap(tasks);
+    }
+    for (HostTask* task : joining) {
+        task->thread.join();
+        delete task;
+    }
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto satisfied = [&]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    if (ticks == portMAX_DELAY) {
+        group->changed.wait(lock, satisfied);
+    } else {
+        group->changed.wait_for(lock, std::chrono::milliseconds(ticks), satisfied);
+    }
+    EventBits_t result = group->bits;
+    if (clear_on_exit && satisfied()) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
@@ -0,0 +1,21 @@
+#ifndef HOST_STUB_MODEL_PATH_H
+#define HOST_STUB_MODEL_PATH_H
+
+#define ESP_MN_PREFIX "mn"
+#define ESP_WN_PREFIX "wn"
+#define ESP_NSNET_PREFIX "nsnet"
+#define ESP_VADN_PREFIX "vadnet"
+
+typedef struct {
+    char** model_name;
+    char** model_info;
+    int num;
+} srmodel_list_t;
+
+// First model whose name starts with keyword1 (and contains keyword2 if given)
+char* esp_srmodel_filter(srmodel_list_t* models, const char* keyword1, const char* keyword2);
+// There is no model partition on the host
+inline srmodel_list_t* esp_srmodel_init(const char* partition_label) { return nullptr; }
+inline void esp_srmodel_deinit(srmodel_list_t* models) {}
+
+#endif // HOST_STUB_MODEL_PATH_H
@@ -0,0 +1,38 @@
+#ifndef HOST_STUB_OPUS_DECODER_H
+#define HOST_STUB_OPUS_DECODER_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Stand-in for the Opus decoder wrapper: every packet turns into one frame of a tone seeded by
+ * the payload, an empty packet (concealment) into silence.
+ */
+class OpusDecoderWrapper {
+public:
+    OpusDecoderWrapper(int sample_rate, int channels, int duration_ms = 60)
+        : sample_rate_(sample_rate), duration_ms_(duration_ms) {}
+
+    void ResetState() {}
+
+    bool Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm) {
+        size_t samples = (size_t)sample_rate_ * duration_ms_ / 1000;
+        pcm.resize(samples);
+        int16_t step = opus.empty() ? 0 : (int16_t)(opus[0] | 1);
+        int16_t value = 0;
+        for (size_t i = 0; i < samples; i++) {
+            value += step;
+            pcm[i] = value;
+        }
+        return true;
+    }
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline int duration_ms() const { return duration_ms_; }
+
+private:
+    int sample_rate_;
+    int duration_ms_;
+};
+
+#endif // HOST_STUB_OPUS_DECODER_H
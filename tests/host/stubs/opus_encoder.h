@@ -0,0 +1,60 @@
+#ifndef HOST_STUB_OPUS_ENCODER_H
+#define HOST_STUB_OPUS_ENCODER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Stand-in for the Opus encoder wrapper: frames are checked and folded into a payload of the
+ * size a 16 kbit/s voice stream would have, so the pipeline around the codec can be measured
+ * without libopus. The payload carries the frame sum, which is enough to tell frames apart.
+ * HostOpusEncodeCostUs() makes every frame keep the CPU busy that long, for measurements that
+ * depend on how long encoding takes.
+ */
+
+// Host only: busy time of one encoded frame in microseconds, 0 by default
+inline std::atomic<int64_t>& HostOpusEncodeCostUs() {
+    static std::atomic<int64_t> cost_us{0};
+    return cost_us;
+}
+class OpusEncoderWrapper {
+public:
+    OpusEncoderWrapper(int sample_rate, int channels, int duration_ms = 60)
+        : sample_rate_(sample_rate), duration_ms_(duration_ms) {}
+
+    void SetDtx(bool enable) {}
+    void SetComplexity(int complexity) {}
+    void ResetState() {}
+
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+        if (pcm.size() != (size_t)sample_rate_ * duration_ms_ / 1000) {
+            return false;
+        }
+        int64_t cost_us = HostOpusEncodeCostUs().load();
+        if (cost_us > 0) {
+            auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(cost_us);
+            while (std::chrono::steady_clock::now() < end) {
+            }
+        }
+        int32_t sum = 0;
+        for (int16_t sample : pcm) {
+            sum += sample;
+        }
+        opus.assign(duration_ms_ * 2, 0);
+        for (size_t i = 0; i < sizeof(sum); i++) {
+            opus[i] = (uint8_t)(sum >> (i * 8));
+        }
+        return true;
+    }
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline int duration_ms() const { return duration_ms_; }
+
+private:
+    int sample_rate_;
+    int duration_ms_;
+};
+
+#endif // HOST_STUB_OPUS_ENCODER_H
@@ -0,0 +1,33 @@
+#ifndef HOST_STUB_OPUS_RESAMPLER_H
+#define HOST_STUB_OPUS_RESAMPLER_H
+
+#include <algorithm>
+
+#include "polyphase_resampler.h"
+
+/*
+ * Stand-in for the Opus (silk) resampler, backed by the firmware's polyphase resampler so the
+ * benchmarks still pay for a real filter. Callers size the output with GetOutputSamples() and
+ * use all of it, like with the silk resampler; samples the filter has not produced yet are zero.
+ */
+class OpusResampler {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate) {
+        resampler_.Configure(input_sample_rate, output_sample_rate);
+    }
+    void Process(const int16_t* input, int input_samples, int16_t* output) {
+        size_t expected = resampler_.GetOutputSamples(input_samples);
+        size_t written = resampler_.Process(input, input_samples, output);
+        std::fill(output + written, output + expected, 0);
+    }
+    int GetOutputSamples(int input_samples) const {
+        return resampler_.GetOutputSamples(input_samples);
+    }
+    inline int input_sample_rate() const { return resampler_.input_sample_rate(); }
+    inline int output_sample_rate() const { return resampler_.output_sample_rate(); }
+
+private:
+    PolyphaseResampler resampler_;
+};
+
+#endif // HOST_STUB_OPUS_RESAMPLER_H
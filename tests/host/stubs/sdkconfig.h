@@ -0,0 +1,23 @@
+#ifndef HOST_STUB_SDKCONFIG_H
+#define HOST_STUB_SDKCONFIG_H
+
+// Kconfig defaults of the options the host builds depend on (main/Kconfig.projbuild)
+#define CONFIG_OPUS_FRAME_DURATION_MS 60
+#define CONFIG_OPUS_ENCODER_TASK_CORE_ID -1
+#define CONFIG_OPUS_ENCODER_TASK_PRIORITY 2
+#define CONFIG_OPUS_ENCODER_TASK_STACK_SIZE 20480
+#define CONFIG_OPUS_ENCODER_COMPLEXITY_MIN 0
+#define CONFIG_OPUS_ENCODER_COMPLEXITY_MAX 3
+#define CONFIG_OPUS_DECODER_TASK_CORE_ID -1
+#define CONFIG_OPUS_DECODER_TASK_PRIORITY 3
+#define CONFIG_OPUS_DECODER_TASK_STACK_SIZE 10240
+#define CONFIG_JITTER_BUFFER_MIN_FRAMES 1
+#define CONFIG_JITTER_BUFFER_MAX_FRAMES 6
+#define CONFIG_JITTER_BUFFER_JITTER_MULTIPLIER 3
+#define CONFIG_VAD_MIN_NOISE_MS 100
+#define CONFIG_ENDPOINT_MIN_SPEECH_MS 300
+#define CONFIG_ENDPOINT_HANGOVER_MS 600
+#define CONFIG_ENDPOINT_MAX_HANGOVER_MS 1200
+#define CONFIG_ENDPOINT_DECAY_DB 15
+
+#endif // HOST_STUB_SDKCONFIG_H
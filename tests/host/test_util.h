@@ -0,0 +1,50 @@
+#ifndef HOST_TEST_UTIL_H
+#define HOST_TEST_UTIL_H
+
+#include <chrono>
+#include <cstdio>
+
+/*
+ * Minimal assertion helpers for the host tests. A failed CHECK is reported and counted, the test
+ * keeps running so one run shows every failure; TestResult() is the exit code for ctest.
+ */
+
+inline int& TestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);    \
+            TestFailures()++;                                                           \
+        }                                                                               \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                  \
+    do {                                                                                \
+        auto _a = (a);                                                                  \
+        auto _b = (b);                                                                  \
+        if (!(_a == _b)) {                                                              \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n",        \
+                    __FILE__, __LINE__, #a, #b, (long long)_a, (long long)_b);          \
+            TestFailures()++;                                                           \
+        }                                                                               \
+    } while (0)
+
+inline int TestResult(const char* name) {
+    if (TestFailures() == 0) {
+        printf("%s: all checks passed\n", name);
+        return 0;
+    }
+    printf("%s: %d check(s) failed\n", name, TestFailures());
+    return 1;
+}
+
+inline double NowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // HOST_TEST_UTIL_H
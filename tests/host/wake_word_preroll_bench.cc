@@ -0,0 +1,155 @@
+// Time from a wake word detection to the pre-roll packets for the server, for the WakeWordPreroll
+// that encodes the ring while detection runs (CONFIG_SEND_WAKE_WORD_DATA) and for the encoding
+// it replaced, which only started at the detection (copied below from AfeWakeWord).
+//
+// Both are fed 32 ms chunks in real time, as the AFE fetches them, then detect. The stub encoder
+// keeps the CPU busy STUB_ENCODE_MS_PER_FRAME per 60 ms frame: it stands in for Opus on the device,
+// so the times scale with it, while the first packet and the remainder of the new encoding show how
+// little is left once detection fires. One JSON line per implementation reports the packets and the
+// time from the detection to the first and to the last packet.
+//
+// Usage: wake_word_preroll_bench [--quick]
+
+#include "wake_words/wake_word_preroll.h"
+#include "opus_encoder.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define SAMPLE_RATE 16000
+#define CHUNK_SAMPLES 512
+#define FRAME_MS 60
+#define FRAME_SAMPLES (SAMPLE_RATE * FRAME_MS / 1000)
+#define STUB_ENCODE_MS_PER_FRAME 10
+
+// The pre-roll of AfeWakeWord before WakeWordPreroll: chunks of the last two seconds, encoded
+// in a new task after the detection
+class FullEncodePreroll {
+public:
+    ~FullEncodePreroll() {
+        if (encode_thread_.joinable()) {
+            encode_thread_.join();
+        }
+    }
+
+    void Store(const int16_t* data, size_t samples) {
+        pcm_.emplace_back(std::vector<int16_t>(data, data + samples));
+        while (pcm_.size() > 2000 / 30) {
+            pcm_.pop_front();
+        }
+    }
+
+    void Encode() {
+        opus_.clear();
+        encode_thread_ = std::thread([this]() {
+            auto encoder = std::make_unique<OpusEncoderWrapper>(SAMPLE_RATE, 1, FRAME_MS);
+            encoder->SetComplexity(0);
+            // The encoder wrapper of the time buffered the chunks into whole frames
+            std::vector<int16_t> frame;
+            std::vector<uint8_t> opus;
+            for (auto& pcm : pcm_) {
+                frame.insert(frame.end(), pcm.begin(), pcm.end());
+                while (frame.size() >= FRAME_SAMPLES) {
+                    std::vector<int16_t> head(frame.begin(), frame.begin() + FRAME_SAMPLES);
+                    frame.erase(frame.begin(), frame.begin() + FRAME_SAMPLES);
+                    if (encoder->Encode(std::move(head), opus)) {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        opus_.emplace_back(std::move(opus));
+                        cv_.notify_all();
+                    }
+                }
+            }
+            pcm_.clear();
+            std::lock_guard<std::mutex> lock(mutex_);
+            opus_.push_back(std::vector<uint8_t>());
+            cv_.notify_all();
+        });
+    }
+
+    bool GetOpus(std::vector<uint8_t>& opus) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return !opus_.empty(); });
+        opus.swap(opus_.front());
+        opus_.pop_front();
+        return !opus.empty();
+    }
+
+private:
+    std::deque<std::vector<int16_t>> pcm_;
+    std::deque<std::vector<uint8_t>> opus_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread encode_thread_;
+};
+
+// Feeds feed_ms of a tone in real time, detects, and reports the packets of the pre-roll
+template <typename Preroll>
+static int Run(const char* name, Preroll& preroll, int feed_ms) {
+    std::vector<int16_t> chunk(CHUNK_SAMPLES);
+    size_t phase = 0;
+    int chunks = feed_ms * SAMPLE_RATE / 1000 / CHUNK_SAMPLES;
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < chunks; i++) {
+        for (auto& sample : chunk) {
+            sample = (int16_t)(6000 * std::sin(2 * M_PI * 300 * phase++ / SAMPLE_RATE));
+        }
+        preroll.Store(chunk.data(), chunk.size());
+        next += std::chrono::microseconds(CHUNK_SAMPLES * 1000000LL / SAMPLE_RATE);
+        std::this_thread::sleep_until(next);
+    }
+
+    double detected_ms = NowMs();
+    if constexpr (std::is_same_v<Preroll, WakeWordPreroll>) {
+        preroll.Encode(FRAME_MS);
+    } else {
+        preroll.Encode();
+    }
+    std::vector<uint8_t> opus;
+    int packets = 0;
+    double first_ms = 0;
+    while (preroll.GetOpus(opus)) {
+        if (packets++ == 0) {
+            first_ms = NowMs() - detected_ms;
+        }
+        CHECK_EQ(opus.size(), (size_t)FRAME_MS * 2);
+    }
+    double last_ms = NowMs() - detected_ms;
+
+    printf("{\"bench\":\"wake_word_preroll\",\"preroll\":\"%s\",\"encode_ms_per_frame\":%d,\"stored_ms\":%d,"
+           "\"packets\":%d,\"first_packet_ms\":%.2f,\"last_packet_ms\":%.2f}\n",
+           name, STUB_ENCODE_MS_PER_FRAME, chunks * CHUNK_SAMPLES * 1000 / SAMPLE_RATE, packets, first_ms, last_ms);
+    fflush(stdout);
+    return packets;
+}
+
+int main(int argc, char** argv) {
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    int feed_ms = quick ? 1200 : 3000;
+    HostOpusEncodeCostUs() = STUB_ENCODE_MS_PER_FRAME * 1000;
+
+    {
+        FullEncodePreroll preroll;
+        int packets = Run("full_encode", preroll, feed_ms);
+        CHECK(packets > 0);
+    }
+    {
+        WakeWordPreroll preroll;
+        CHECK(preroll.Initialize());
+        preroll.Reset();
+        int packets = Run("incremental", preroll, feed_ms);
+        // Every whole frame of the last two seconds
+        int stored_samples = feed_ms * SAMPLE_RATE / 1000 / CHUNK_SAMPLES * CHUNK_SAMPLES;
+        CHECK_EQ(packets, std::min(stored_samples / FRAME_SAMPLES, 2000 / FRAME_MS));
+    }
+    HostJoinTasks();
+    return TestResult("wake_word_preroll_bench");
+}